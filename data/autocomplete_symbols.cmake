@@ -0,0 +1,72 @@
+# -*- mode: CMake; cmake-tab-width: 4; -*-
+#
+# Converts autocomplete_symbols.txt into the header src/CMakeLists.txt compiles
+# into wxMaxima:
+#
+#   cmake -DINPUT=autocomplete_symbols.txt -DOUTPUT=AutocompleteSymbols.h -P autocomplete_symbols.cmake
+#
+# The header contains one array per kind of symbol (commands, templates and
+# units) that is sorted by the UTF-8 bytes of the symbols, which allows
+# AutoComplete to find all symbols that start with a given text by a binary search.
+#
+# Templates contain chars CMake lists cannot hold (";", "[", "]" and "\")
+# => we work on a hex dump of the file in which every byte is represented
+# as ",xx". As "," sorts before all hex digits sorting the dumps of two symbols
+# sorts them exactly as sorting their bytes would.
+
+if(NOT INPUT OR NOT OUTPUT)
+    message(FATAL_ERROR "Usage: cmake -DINPUT=<symbol list> -DOUTPUT=<header> -P autocomplete_symbols.cmake")
+endif()
+
+file(READ "${INPUT}" hexdump HEX)
+string(REGEX REPLACE "(..)" ",\\1" hexdump "${hexdump}")
+string(REPLACE ",0d" "" hexdump "${hexdump}")
+string(REPLACE ",0a" ";" lines "${hexdump}")
+
+# "FUNCTION: ", "OPTION  : ", "TEMPLATE: " and "UNIT: "
+set(function_prefix ",46,55,4e,43,54,49,4f,4e,3a,20")
+set(option_prefix   ",4f,50,54,49,4f,4e,20,20,3a,20")
+set(template_prefix ",54,45,4d,50,4c,41,54,45,3a,20")
+set(unit_prefix     ",55,4e,49,54,3a,20")
+
+set(commands)
+set(templates)
+set(units)
+foreach(line IN LISTS lines)
+    foreach(type function option template unit)
+        string(LENGTH "${${type}_prefix}" prefix_length)
+        string(FIND "${line}" "${${type}_prefix}" pos)
+        if(pos EQUAL 0)
+            string(SUBSTRING "${line}" ${prefix_length} -1 symbol)
+            if(symbol)
+                if(type STREQUAL "template")
+                    list(APPEND templates "${symbol}")
+                elseif(type STREQUAL "unit")
+                    list(APPEND units "${symbol}")
+                else()
+                    list(APPEND commands "${symbol}")
+                endif()
+            endif()
+        endif()
+    endforeach()
+endforeach()
+
+set(header "// Generated from autocomplete_symbols.txt by autocomplete_symbols.cmake. Do not edit.\n")
+foreach(table commands templates units)
+    if(NOT ${table})
+        message(FATAL_ERROR "${INPUT} contains no ${table}")
+    endif()
+    list(REMOVE_DUPLICATES ${table})
+    list(SORT ${table})
+    string(SUBSTRING "${table}" 0 1 first)
+    string(TOUPPER "${first}" first)
+    string(SUBSTRING "${table}" 1 -1 rest)
+    set(header "${header}\nstatic const char *const AutocompleteBuiltin${first}${rest}[] =\n{\n")
+    foreach(symbol IN LISTS ${table})
+        string(REPLACE "," "\\x" symbol "${symbol}")
+        set(header "${header}  \"${symbol}\",\n")
+    endforeach()
+    set(header "${header}};\n")
+endforeach()
+
+file(WRITE "${OUTPUT}" "${header}")
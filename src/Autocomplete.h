@@ -31,25 +31,36 @@
 #define AUTOCOMPLETE_H
 
 #include <wx/wx.h>
-#include <wx/dir.h>
 #include <wx/arrstr.h>
 #include <wx/regex.h>
 #include <wx/filename.h>
 #include "Configuration.h"
+#include "WordIndex.h"
+#include "CompletionRanker.h"
+#include "DirectoryIndex.h"
 
 /* The autocompletion logic
 
    The wordlists for autocompletion for keywords come from several sources:
 
-     - wxMaxima::ReadLoadSymbols receive the contents of maxima's variables
+     - wxMaxima::InterpretDataFromMaxima receives the contents of maxima's variables
        "values" and "functions" after a package is loaded.
-     - all words that appear in the worksheet
-     - and a list of maxima's builtin commands.
+     - all words that appear in the worksheet. The EditorCells keep a WordIndex
+       of them up to date.
+     - and a list of maxima's builtin commands. This list is generated from
+       data/autocomplete_symbols.txt at build time and compiled into wxMaxima
+       as sorted arrays of UTF-8 strings.
+
+   The names of files load() and demo() can be applied on come from a
+   DirectoryIndex that crawls maxima's share directories in the background and
+   keeps track of the directories file names are completed in.
+
+   The lists of commands, templates, units and esc commands are kept sorted
+   which means that all symbols that start with a given text can be found by
+   a binary search.
  */
 class AutoComplete
 {
-  WX_DECLARE_STRING_HASH_MAP(int, WorksheetWords);
-
 public:
   //! All types of things we can autocomplete
   enum autoCompletionType
@@ -63,7 +74,13 @@ public:
     unit    //! Unit names. \attention Must be the last entry in this enum
   };
 
-  AutoComplete(Configuration *configuration);
+  /*! The constructor
+
+    \param configuration The configuration of the worksheet
+    \param worksheetWords The index of the words that appear in the worksheet's
+                          code cells
+   */
+  AutoComplete(Configuration *configuration, const WordIndex *worksheetWords);
 
   Configuration *m_configuration;
   
@@ -81,147 +98,74 @@ public:
   //! Assemble a list of files
   void UpdateGeneralFiles(wxString partial, wxString maximaDir);
   
-  //! Add words to the list of words that appear in the workSheet's code cells
-  void AddWorksheetWords(wxArrayString wordlist);
-
-  //! Clear the list of words that appear in the workSheet's code cells
-  void ClearWorksheetWords();
   //! Clear the list of files load() can be applied on
-  void ClearLoadfileList(){m_wordList[loadfile] = m_builtInLoadFiles;}
+  void ClearLoadfileList();
   //! Clear the list of files demo() can be applied on
-  void ClearDemofileList(){m_wordList[demofile] = m_builtInDemoFiles;}
+  void ClearDemofileList();
   
-  //! Returns a list of possible autocompletions for the string "partial"
-  wxArrayString CompleteSymbol(wxString partial, autoCompletionType type = command);
+  /*! Returns a list of possible autocompletions for the string "partial"
+
+    Commands, templates and units are matched fuzzily and returned in the order
+    CompletionRanker ranks them in; All other completions are sorted
+    alphabetically.
+
+    \param partial The text that is to be completed
+    \param type The kind of symbol that is to be completed
+    \param partialIsIndexed true means: The cell partial is typed in has added
+           partial itself to the worksheet's word index. In this case partial is
+           only offered as a completion if it appears somewhere else, too.
+   */
+  wxArrayString CompleteSymbol(wxString partial, autoCompletionType type = command,
+                               bool partialIsIndexed = false);
+
+  //! Tells us which completion the user has chosen so it can be offered first next time
+  void CompletionAccepted(const wxString &completion, autoCompletionType type);
   wxString FixTemplate(wxString templ);
 
 private:
-
+  //! Adds all built-in symbols of this type that start with partial to completions
+  static void AddBuiltinCompletions(autoCompletionType type, const wxString &partial,
+                                    wxArrayString &completions);
+  //! Adds all words of the sorted list words that start with partial to completions
+  static void AddCompletions(const wxArrayString &words, const wxString &partial,
+                             wxArrayString &completions);
+  //! Is this symbol a built-in symbol or one we have been told about before?
+  bool IsKnown(const wxString &symbol, autoCompletionType type) const;
+  //! Inserts a symbol into the sorted list for its type, if it isn't known yet
+  void InsertSymbol(const wxString &symbol, autoCompletionType type);
+
+  /*! Re-assembles the lists of maxima's loadable files and demos if the
+    directories they are in have changed
+   */
+  void UpdateBuiltInFiles();
+  /*! Adds the entries of a directory load(), demo() or a file name can be applied on
+
+    \param dir The directory
+    \param prefix The text the user has typed in front of the file name
+    \param type The type of file that is to be completed
+    \param files The list to add the entries to
+   */
+  void AddDirectoryEntries(const wxString &dir, const wxString &prefix,
+                           autoCompletionType type, wxArrayString &files);
+
+  //! The directory maxima's demo files are searched in
+  wxString DemoDir() const;
+
+  //! The files maxima's share directories contain. Sorted.
   wxArrayString m_builtInLoadFiles;
+  //! The demos maxima's share directories contain. Sorted.
   wxArrayString m_builtInDemoFiles;
-
-  class GetGeneralFiles : public wxDirTraverser
-  {
-  public:
-    GetGeneralFiles(wxArrayString& files, wxString prefix = wxEmptyString) :
-      m_files(files) { m_prefix = prefix; }
-    virtual wxDirTraverseResult OnFile(const wxString& filename)
-      {
-        wxFileName newItemName(filename);
-        wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "\"";
-        newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
-        return wxDIR_CONTINUE;
-      }
-    virtual wxDirTraverseResult OnDir(const wxString& dirname)
-      {
-        wxFileName newItemName(dirname);
-        wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
-        newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
-        return wxDIR_IGNORE;
-      }
-    wxArrayString& GetResult(){return m_files;}
-  protected: 
-    wxArrayString& m_files;
-    wxString m_prefix;
-  };
-
-  class GetMacFiles_includingSubdirs : public wxDirTraverser
-  {
-  public:
-    GetMacFiles_includingSubdirs(wxArrayString& files, wxString prefix = wxEmptyString) :
-      m_files(files) { m_prefix = prefix; }
-    virtual wxDirTraverseResult OnFile(const wxString& filename)
-      {
-        if(
-          (filename.EndsWith(".mac"))||
-          (filename.EndsWith(".lisp"))||
-          (filename.EndsWith(".wxm"))
-          )
-        {
-          wxFileName newItemName(filename);
-          wxString newItem = "\"" + m_prefix + newItemName.GetName() + "\"";
-          newItem.Replace(wxFileName::GetPathSeparator(),"/");
-          if(m_files.Index(newItem) == wxNOT_FOUND)
-            m_files.Add(newItem);
-        }
-        return wxDIR_CONTINUE;
-      }
-    virtual wxDirTraverseResult OnDir(const wxString& WXUNUSED(dirname))
-      {
-        return wxDIR_CONTINUE;
-      }
-    wxArrayString& GetResult(){return m_files;}
-  protected: 
-    wxArrayString& m_files;
-    wxString m_prefix;
-  };
-  
-  class GetMacFiles : public GetMacFiles_includingSubdirs
-  {
-  public:
-    GetMacFiles(wxArrayString& files, wxString prefix = wxEmptyString) :
-      GetMacFiles_includingSubdirs(files, prefix){ }
-    virtual wxDirTraverseResult OnDir(const wxString& dirname)
-      {
-        wxFileName newItemName(dirname);
-        wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
-        newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
-        return wxDIR_IGNORE;
-      }
-  };
-  
-  class GetDemoFiles_includingSubdirs : public wxDirTraverser
-  {
-  public:
-    GetDemoFiles_includingSubdirs(wxArrayString& files, wxString prefix = wxEmptyString) :
-      m_files(files) { m_prefix = prefix; }
-    virtual wxDirTraverseResult OnFile(const wxString& filename)
-      {
-        if(filename.EndsWith(".dem"))
-        {
-          wxFileName newItemName(filename);
-          wxString newItem = "\"" + m_prefix + newItemName.GetName() + "\"";
-          newItem.Replace(wxFileName::GetPathSeparator(),"/");
-          if(m_files.Index(newItem) == wxNOT_FOUND)
-            m_files.Add(newItem);
-        }
-        return wxDIR_CONTINUE;
-      }
-    virtual wxDirTraverseResult OnDir(const wxString& WXUNUSED(dirname))
-      {
-        return wxDIR_CONTINUE;
-      }
-    wxArrayString& GetResult(){return m_files;}
-  protected: 
-    wxArrayString& m_files;
-    wxString m_prefix;
-  };
-  
-  class GetDemoFiles : public GetDemoFiles_includingSubdirs
-  {
-  public:
-    GetDemoFiles(wxArrayString& files, wxString prefix = wxEmptyString) :
-      GetDemoFiles_includingSubdirs(files, prefix){ }
-    virtual wxDirTraverseResult OnDir(const wxString& dirname)
-      {
-        wxFileName newItemName(dirname);
-        wxString newItem = "\"" + m_prefix + newItemName.GetFullName() + "/\"";
-        newItem.Replace(wxFileName::GetPathSeparator(),"/");
-        if(m_files.Index(newItem) == wxNOT_FOUND)
-          m_files.Add(newItem);
-        return wxDIR_IGNORE;
-      }
-  };
+  //! The generation of m_directoryIndex m_builtInLoadFiles and m_builtInDemoFiles are from
+  long m_builtInFilesGeneration;
+  //! Maxima's share directories and the directories the user reads files from
+  DirectoryIndex m_directoryIndex;
 
   wxArrayString m_wordList[7];
   wxRegEx m_args;
-  WorksheetWords m_worksheetWords;
+  //! The words that appear in the worksheet's code cells
+  const WordIndex *m_worksheetWords;
+  //! Matches and ranks the commands, templates and units
+  CompletionRanker m_ranker;
 };
 
 #endif // AUTOCOMPLETE_H
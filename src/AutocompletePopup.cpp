@@ -37,8 +37,8 @@
 
 void AutocompletePopup::UpdateResults()
 {
-  m_completions = m_autocomplete->CompleteSymbol(m_partial, m_type);
-  m_completions.Sort();
+  m_completions = m_autocomplete->CompleteSymbol(m_partial, m_type,
+                                                 m_editor->ContainsIndexedWord(m_partial));
 
   switch (m_completions.GetCount())
   {
@@ -60,6 +60,7 @@ void AutocompletePopup::UpdateResults()
         m_completions[0]
         );
       m_editor->ClearSelection();
+      m_autocomplete->CompletionAccepted(m_completions[0], m_type);
     }
     else
       m_editor->InsertEscCommand(m_completions[0]);
@@ -101,15 +102,25 @@ void AutocompletePopup::OnKeyDown(wxKeyEvent &event)
       bool addChar = true;
       wxString word = m_editor->GetSelectionString();
       size_t index = word.Length();
+
+      // Only the completions that start with the word can be used for extending
+      // the word by the chars they have in common.
+      wxArrayString prefixCompletions;
+      for (size_t i = 0; i < m_completions.GetCount(); i++)
+        if (m_completions[i].StartsWith(word))
+          prefixCompletions.Add(m_completions[i]);
+      if (prefixCompletions.IsEmpty())
+        break;
+
       do
       {
-        if (m_completions[0].Length() <= index)
+        if (prefixCompletions[0].Length() <= index)
           addChar = false;
         else
         {
-          ch = m_completions[0][index];
-          for (size_t i = 0; i < m_completions.GetCount(); i++)
-            if ((m_completions[i].Length() < index + 1) || (m_completions[i][index] != ch))
+          ch = prefixCompletions[0][index];
+          for (size_t i = 0; i < prefixCompletions.GetCount(); i++)
+            if ((prefixCompletions[i].Length() < index + 1) || (prefixCompletions[i][index] != ch))
               addChar = false;
         }
 
@@ -136,10 +147,13 @@ void AutocompletePopup::OnKeyDown(wxKeyEvent &event)
     if (m_completions.GetCount() > 0)
     {
       if(m_type != AutoComplete::esccommand)
+      {
         m_editor->ReplaceSelection(
           m_editor->GetSelectionString(),
           m_completions[selection]
           );
+        m_autocomplete->CompletionAccepted(m_completions[selection], m_type);
+      }
       else
         m_editor->InsertEscCommand(m_completions[selection]);
     }
@@ -304,10 +318,13 @@ void AutocompletePopup::OnClick(wxMouseEvent& WXUNUSED(event))
       m_value = 0;
     m_partial = m_completions[m_value];
     if(m_type != AutoComplete::esccommand)
+    {
       m_editor->ReplaceSelection(
         m_editor->GetSelectionString(),
         m_partial
         );
+      m_autocomplete->CompletionAccepted(m_partial, m_type);
+    }
     else
       m_editor->InsertEscCommand(m_partial);
     m_parent->GetParent()->Refresh();
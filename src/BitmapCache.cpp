@@ -0,0 +1,108 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class BitmapCache
+
+  BitmapCache limits the memory the scaled bitmaps of all images use.
+ */
+
+#include "BitmapCache.h"
+#include "Image.h"
+#include <wx/config.h>
+
+BitmapCache *BitmapCache::Get()
+{
+  static BitmapCache cache;
+  return &cache;
+}
+
+BitmapCache::BitmapCache()
+{
+  m_usage = 0;
+  long megabytes = 256;
+  if (wxConfig::Get() != NULL)
+    wxConfig::Get()->Read(wxT("bitmapCacheSize"), &megabytes);
+  if (megabytes < 1)
+    megabytes = 1;
+  m_budget = (size_t) megabytes * 1024 * 1024;
+}
+
+void BitmapCache::SetBudget(size_t bytes)
+{
+  m_budget = bytes;
+  Evict();
+}
+
+void BitmapCache::Used(Image *image, size_t bytes)
+{
+  EntryIndex::iterator it = m_index.find(image);
+  if (it != m_index.end())
+  {
+    // Move the image to the front of the list of recently used images
+    m_usage -= it->second->m_bytes;
+    it->second->m_bytes = bytes;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+  }
+  else
+  {
+    Entry entry;
+    entry.m_image = image;
+    entry.m_bytes = bytes;
+    m_entries.push_front(entry);
+    m_index[image] = m_entries.begin();
+  }
+  m_usage += bytes;
+  Evict();
+}
+
+void BitmapCache::Remove(Image *image)
+{
+  EntryIndex::iterator it = m_index.find(image);
+  if (it == m_index.end())
+    return;
+  m_usage -= it->second->m_bytes;
+  m_entries.erase(it->second);
+  m_index.erase(it);
+}
+
+void BitmapCache::Evict()
+{
+  long evicted = 0;
+  // The image that has been drawn last is needed right now => we keep it even
+  // if it alone exceeds the budget.
+  while ((m_usage > m_budget) && (m_entries.size() > 1))
+  {
+    Entry entry = m_entries.back();
+    m_entries.pop_back();
+    m_index.erase(entry.m_image);
+    m_usage -= entry.m_bytes;
+    entry.m_image->ClearCache();
+    evicted++;
+  }
+
+  if (evicted > 0)
+    wxLogDebug(wxT("Bitmap cache: Forgot %li scaled bitmaps, %lu of %lu MB in use"),
+               evicted,
+               (unsigned long) (m_usage / 1024 / 1024),
+               (unsigned long) (m_budget / 1024 / 1024));
+}
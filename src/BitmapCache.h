@@ -0,0 +1,103 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef BITMAPCACHE_H
+#define BITMAPCACHE_H
+
+#include <wx/hashmap.h>
+#include <list>
+
+/*!\file
+
+  This file declares the class BitmapCache.
+
+  BitmapCache limits the memory the scaled bitmaps of all images use.
+ */
+
+class Image;
+
+/*! Limits the memory the scaled bitmaps of all images use
+
+  Every Image keeps a bitmap that is scaled to the size it is displayed with.
+  A worksheet with a few hundred big plots or animations would keep gigabytes
+  of decoded pixels this way. This class knows which images have drawn their
+  bitmap least recently and makes them forget it as soon as all bitmaps
+  together exceed the memory budget. An image whose bitmap has been forgotten
+  creates it anew from its compressed data once it is drawn again.
+
+  The budget is read from the config key "bitmapCacheSize" (in megabytes).
+
+  Only to be used by the GUI thread.
+ */
+class BitmapCache
+{
+public:
+  //! Returns the cache all images share
+  static BitmapCache *Get();
+
+  /*! Tells the cache that an image has drawn its scaled bitmap
+
+    Makes the image the most recently used one and makes the least recently
+    used images forget their bitmaps if the budget is exceeded.
+    \param image The image
+    \param bytes The memory the image's scaled bitmap occupies
+   */
+  void Used(Image *image, size_t bytes);
+
+  //! Tells the cache that an image no more has a scaled bitmap
+  void Remove(Image *image);
+
+  //! The memory all scaled bitmaps currently occupy
+  size_t GetUsage() const {return m_usage;}
+
+  //! The memory all scaled bitmaps may occupy
+  size_t GetBudget() const {return m_budget;}
+
+  //! Changes the memory all scaled bitmaps may occupy
+  void SetBudget(size_t bytes);
+
+private:
+  BitmapCache();
+
+  //! Makes the least recently used images forget their bitmaps until we are within the budget
+  void Evict();
+
+  //! An image whose scaled bitmap we count
+  struct Entry
+  {
+    Image *m_image;
+    size_t m_bytes;
+  };
+  typedef std::list<Entry> EntryList;
+  WX_DECLARE_HASH_MAP(Image *, EntryList::iterator, wxPointerHash, wxPointerEqual, EntryIndex);
+
+  //! The images, the one that has drawn its bitmap most recently first
+  EntryList m_entries;
+  //! Where to find an image in m_entries
+  EntryIndex m_index;
+  //! The memory all scaled bitmaps currently occupy
+  size_t m_usage;
+  //! The memory all scaled bitmaps may occupy
+  size_t m_budget;
+};
+
+#endif // BITMAPCACHE_H
@@ -61,7 +61,6 @@ BitmapOut::~BitmapOut()
   wxDELETE(m_dc);
   wxDELETE(*m_configuration);
   *m_configuration = m_oldconfig;
-  (*m_configuration)->FontChanged(true);
   (*m_configuration)->RecalculationForce(true);
 }
 
@@ -294,7 +293,7 @@ void BitmapOut::Draw()
   m_ppi.y *= m_scale;
 }
 
-wxSize BitmapOut::ToFile(wxString file)
+wxImage BitmapOut::ToImage()
 {
   // Assign an resolution to the bitmap.
   wxImage img = m_bmp.ConvertToImage();
@@ -302,6 +301,17 @@ wxSize BitmapOut::ToFile(wxString file)
   if (resolution <= 0)
     resolution = 75;
   img.SetOption(wxIMAGE_OPTION_RESOLUTION, resolution * m_scale);
+  return img;
+}
+
+wxSize BitmapOut::GetSize()
+{
+  return wxSize(GetRealWidth(), GetRealHeight());
+}
+
+wxSize BitmapOut::ToFile(wxString file)
+{
+  wxImage img = ToImage();
 
   bool success = false;
   if (file.Right(4) == wxT(".bmp"))
@@ -319,11 +329,7 @@ wxSize BitmapOut::ToFile(wxString file)
 
   wxSize retval;
   if (success)
-  {
-    retval.x = GetRealWidth();
-    retval.y = GetRealHeight();
-    return retval;
-  }
+    return GetSize();
   else
   {
     retval.x = -1;
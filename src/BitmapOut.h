@@ -60,6 +60,16 @@ public:
    */
   wxSize ToFile(wxString file);
 
+  /*! Returns the image ToFile() would save, with its resolution already set
+
+    Encoding the image can be left to a background thread: wxImage, other than
+    wxBitmap, doesn't need the GUI.
+   */
+  wxImage ToImage();
+
+  //! The size ToFile() returns if it succeeds
+  wxSize GetSize();
+
   //! Returns the bitmap representation of the list of cells that was passed to SetData()
   wxBitmap GetBitmap()
   { return m_bmp; }
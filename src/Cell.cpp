@@ -220,6 +220,23 @@ int Cell::CellsInListRecursive()
   return cells;
 }
 
+void Cell::SetConfigurationList(Configuration **config)
+{
+  Cell *tmp = this;
+
+  while(tmp != NULL)
+  {
+    tmp->SetConfiguration(config);
+    std::list<Cell*> cellList = tmp->GetInnerCells();
+    for (std::list<Cell *>::iterator it = cellList.begin(); it != cellList.end(); ++it)
+    {
+      if(*it != NULL)
+        (*it)->SetConfigurationList(config);
+    }
+    tmp = tmp->m_next;
+  }
+}
+
 void Cell::SetGroup(Cell *group)
 {
   m_group = group;
@@ -433,6 +450,23 @@ void Cell::ResetSizeList()
   }
 }
 
+void Cell::ResetSizeListRecursive()
+{
+  Cell *tmp = this;
+
+  while (tmp != NULL)
+  {
+    tmp->ResetSize();
+    std::list<Cell*> cellList = tmp->GetInnerCells();
+    for (std::list<Cell *>::iterator it = cellList.begin(); it != cellList.end(); ++it)
+    {
+      if(*it != NULL)
+        (*it)->ResetSizeListRecursive();
+    }
+    tmp = tmp->m_next;
+  }
+}
+
 
 void Cell::RecalculateHeightList(int fontsize)
 {
@@ -968,6 +1002,12 @@ void Cell::SelectRectText(const wxPoint &WXUNUSED(one), const wxPoint &WXUNUSED(
 
 void Cell::PasteFromClipboard(const bool &WXUNUSED(primary)){}
 
+void Cell::XMLChanged()
+{
+  if ((m_group != NULL) && (m_group != this))
+    m_group->XMLChanged();
+}
+
 wxString Cell::ListToXML()
 {
   bool highlight = false;
@@ -1452,6 +1492,7 @@ Cell::CellPointers::CellPointers(wxScrolledCanvas *mathCtrl)
   m_scrollToCell = false;
   m_cellToScrollTo = NULL;
   m_wxmxImgCounter = 0;
+  m_wxmxCollectFiles = false;
   m_mathCtrl = mathCtrl;
   m_cellMouseSelectionStartedIn = NULL;
   m_cellKeyboardSelectionStartedIn = NULL;
@@ -1463,6 +1504,8 @@ Cell::CellPointers::CellPointers(wxScrolledCanvas *mathCtrl)
   m_groupCellUnderPointer = NULL;
   m_lastWorkingGroup = NULL;
   m_workingGroup = NULL;
+  m_workingGroupBeforePrompt = NULL;
+  m_workingGroupAfterPrompt = NULL;
   m_selectionString = wxEmptyString;
   m_selectionStart = NULL;
   m_selectionEnd = NULL;
@@ -38,6 +38,11 @@
 #endif // wxUSE_ACCESSIBILITY
 #include "Configuration.h"
 #include "TextStyle.h"
+#include "GroupCellIndex.h"
+#include "WordIndex.h"
+#include "SearchIndex.h"
+
+class Image;
 
 /*! The supported types of math cells
  */
@@ -147,6 +152,17 @@ class Cell
   //! How many cells does this cell contain?
   int CellsInListRecursive();
 
+  /*! Make this list of cells and all the cells they contain use another configuration
+
+    Used for cells that were created with a configuration of their own, for example
+    by the thread that parses maxima's output in the background.
+   */
+  void SetConfigurationList(Configuration **config);
+
+  //! Make this cell use another configuration
+  virtual void SetConfiguration(Configuration **config)
+  { m_configuration = config; }
+
   /*! If the cell is moved to the undo buffer this function drops pointers to it
   
     Examples are the pointer to the start or the end of the selection.
@@ -368,7 +384,7 @@ class Cell
 
     See m_currentPoint for more details.
    */
-  int GetCurrentY()
+  virtual int GetCurrentY()
   { return m_currentPoint.y; }
 
   /*! Get the smallest rectangle this cell fits in
@@ -433,6 +449,9 @@ class Cell
   //! Mark the cached height information of the whole list of cells as "to be calculated".
   void ResetSizeList();
 
+  //! Like ResetSizeList(), but for the cells inside these cells, too.
+  void ResetSizeListRecursive();
+
   void SetSkip(bool skip)
   { m_bigSkip = skip; }
 
@@ -570,6 +589,13 @@ class Cell
   //! Convert this cell to an representation fit for saving in a .wxmx file
   virtual wxString ToXML();
 
+  /*! Tell the GroupCell this cell belongs to that ToXML() will return something new
+
+    GroupCells keep the XML they have been saved as last so cells that haven't
+    changed since don't need to be serialized again.
+   */
+  virtual void XMLChanged();
+
   //! Convert this cell to an representation fit for saving in a .wxmx file
   virtual wxString ToMathML();
 
@@ -897,6 +923,59 @@ public:
     int WXMXImageCount()
       { return m_wxmxImgCounter; }
 
+    //! Skip the names of count images that have been named by an earlier save.
+    void WXMXSkipFileNames(int count)
+      { m_wxmxImgCounter += count; }
+
+    //! The parts of an image that end up as separate files in a .wxmx file
+    enum WXMXFileType
+    {
+      WXMX_IMAGE,          //!< The compressed image itself
+      WXMX_GNUPLOTSOURCE,  //!< The gnuplot commands the image was created by
+      WXMX_GNUPLOTDATA     //!< The data gnuplot has plotted
+    };
+
+    //! A file the .wxmx file we are currently saving will contain
+    struct WXMXFile
+    {
+      WXMXFile(wxString name, Image *image, WXMXFileType type)
+        {m_name = name; m_image = image; m_type = type;}
+      //! The name of the file in the .zip archive
+      wxString m_name;
+      //! The image that contains the data for this file
+      Image *m_image;
+      //! Which part of the image goes to this file?
+      WXMXFileType m_type;
+    };
+    typedef std::list<WXMXFile> WXMXFileList;
+
+    /*! Start or stop collecting the files ToXML() wants to see in a .wxmx file
+
+      Starting and stopping both forget about the files that have been collected
+      before.
+     */
+    void WXMXCollectFiles(bool collect)
+      { m_wxmxCollectFiles = collect; m_wxmxFiles.clear(); }
+
+    //! Are we collecting the files ToXML() wants to see in a .wxmx file?
+    bool WXMXCollectingFiles()
+      { return m_wxmxCollectFiles; }
+
+    /*! Tells the .wxmx file we are currently saving to contain a part of an image
+
+      Only the image is remembered: The data is written directly into the .zip
+      file later without creating a copy of it first.
+     */
+    void WXMXAddFile(wxString name, Image *image, WXMXFileType type)
+      {
+        if(m_wxmxCollectFiles)
+          m_wxmxFiles.push_back(WXMXFile(name, image, type));
+      }
+
+    //! The files the .wxmx file we are currently saving will contain
+    WXMXFileList &WXMXFiles()
+      { return m_wxmxFiles; }
+
     //! A list of editor cells containing error messages.
     class ErrorList
     {
@@ -946,6 +1025,19 @@ public:
       NULL means that maxima isn't currently evaluating a cell.
     */
     Cell *m_workingGroup;
+    /*! The WorkingGroup that was active before the last prompt from maxima
+
+      The output maxima sends directly after a prompt still belongs to this cell.
+     */
+    Cell *m_workingGroupBeforePrompt;
+    //! The WorkingGroup that was active after the last prompt from maxima
+    Cell *m_workingGroupAfterPrompt;
+    //! Finds the GroupCell at a y position
+    GroupCellIndex m_groupCellIndex;
+    //! The words in the worksheet's code cells autocompletion offers
+    WordIndex m_worksheetWords;
+    //! The text of the worksheet's EditorCells the find dialog searches
+    SearchIndex m_searchIndex;
     /*! The currently selected string. 
 
       Since this string is defined here it is available in every editor cell
@@ -1012,6 +1104,10 @@ public:
     wxScrolledCanvas *m_mathCtrl;
     //! The image counter for saving .wxmx files
     int m_wxmxImgCounter;
+    //! Do we currently collect the files for a .wxmx file?
+    bool m_wxmxCollectFiles;
+    //! The files the .wxmx file we are currently saving will contain
+    WXMXFileList m_wxmxFiles;
   };
 
 protected:
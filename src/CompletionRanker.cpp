@@ -0,0 +1,285 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+/*! \file
+  This file defines the class CompletionRanker
+
+  CompletionRanker decides which symbols match the text the user wants to have
+  completed and in which order they are offered.
+ */
+
+#include "CompletionRanker.h"
+#include <algorithm>
+#include <string.h>
+#include <wx/tokenzr.h>
+
+const int CompletionRanker::PrefixScore;
+const size_t CompletionRanker::m_maxUsageEntries;
+
+//! Converts ASCII uppercase letters to lowercase
+template <class Char> static inline Char Fold(Char ch)
+{
+  if ((ch >= 'A') && (ch <= 'Z'))
+    return static_cast<Char>(ch - 'A' + 'a');
+  return ch;
+}
+
+//! Is ch an ASCII letter or digit?
+template <class Char> static inline bool IsAlnum(Char ch)
+{
+  return ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z')) ||
+    ((ch >= '0') && (ch <= '9'));
+}
+
+//! Does a word start at position pos of symbol?
+template <class Char> static inline bool IsWordStart(const Char *symbol, size_t pos)
+{
+  if (pos == 0)
+    return true;
+  Char previous = symbol[pos - 1];
+  Char current = symbol[pos];
+  if (!IsAlnum(previous))
+    return IsAlnum(current);
+  // camelCase
+  return (previous >= 'a') && (previous <= 'z') && (current >= 'A') && (current <= 'Z');
+}
+
+/*! The length of the part of symbol that is matched against the partial
+
+  Templates are matched by the name of the function only: Their placeholders
+  ("<expr>", "<a_1>") would match nearly every partial.
+ */
+static inline size_t NameLength(const char *symbol)
+{
+  const char *parenthesis = strchr(symbol, '(');
+  if (parenthesis == NULL)
+    return strlen(symbol);
+  return static_cast<size_t>(parenthesis - symbol);
+}
+
+static inline size_t NameLength(const wxString &symbol)
+{
+  size_t parenthesis = symbol.find(wxT('('));
+  if (parenthesis == wxString::npos)
+    return symbol.Length();
+  return parenthesis;
+}
+
+/*! How well does symbol match pattern? -1 = not at all.
+
+  Works on the chars of a wxString as well as on the bytes of an UTF-8 string:
+  Only ASCII chars are treated specially.
+ */
+template <class Char> static int Score(const Char *symbol, size_t length,
+                                       const Char *pattern, size_t patternLength)
+{
+  if (patternLength == 0)
+    return CompletionRanker::PrefixScore;
+  if (patternLength > length)
+    return -1;
+
+  // Prefix matches
+  size_t pos = 0;
+  int exactCase = 0;
+  while ((pos < patternLength) && (Fold(symbol[pos]) == Fold(pattern[pos])))
+  {
+    if (symbol[pos] == pattern[pos])
+      exactCase++;
+    pos++;
+  }
+  if (pos == patternLength)
+  {
+    // Exact case and short symbols are preferred
+    int rest = static_cast<int>(std::min(length - patternLength, static_cast<size_t>(40)));
+    return CompletionRanker::PrefixScore + 40 + exactCase - rest;
+  }
+
+  // The first char of the pattern has to match the start of a word
+  Char first = Fold(pattern[0]);
+  for (pos = 0; pos < length; pos++)
+  {
+    if ((Fold(symbol[pos]) == first) && IsWordStart(symbol, pos))
+      break;
+  }
+  if (pos == length)
+    return -1;
+
+  int score = 100;
+  if (pos == 0)
+    score += 20;
+  size_t last = pos;
+  for (size_t i = 1; i < patternLength; i++)
+  {
+    Char ch = Fold(pattern[i]);
+    pos = last + 1;
+    while ((pos < length) && (Fold(symbol[pos]) != ch))
+      pos++;
+    if (pos >= length)
+      return -1;
+
+    if (pos == last + 1)
+      score += 8;
+    else
+    {
+      score -= static_cast<int>(std::min(pos - last - 1, static_cast<size_t>(5)));
+      if (IsWordStart(symbol, pos))
+        score += 6;
+    }
+    last = pos;
+  }
+  score -= static_cast<int>(std::min(length - last - 1, static_cast<size_t>(40))) / 4;
+
+  // A fuzzy match never gets as good as a prefix match - even with the
+  // maximum usage bonus added.
+  return std::max(0, std::min(score, CompletionRanker::PrefixScore / 2));
+}
+
+CompletionRanker::CompletionRanker()
+{
+}
+
+void CompletionRanker::Start(const wxString &partial)
+{
+  m_partial = partial;
+  m_partialUTF8 = partial.utf8_str();
+  m_matches.clear();
+}
+
+int CompletionRanker::MatchScore(const wxString &symbol, const wxString &partial)
+{
+  return Score<wchar_t>(symbol.wc_str(), NameLength(symbol), partial.wc_str(), partial.Length());
+}
+
+void CompletionRanker::Add(const wxString &symbol)
+{
+  int score = Score<wchar_t>(symbol.wc_str(), NameLength(symbol),
+                             m_partial.wc_str(), m_partial.Length());
+  if (score >= 0)
+    AddMatch(symbol, score);
+}
+
+void CompletionRanker::Add(const char *symbol)
+{
+  int score = Score<char>(symbol, NameLength(symbol),
+                          m_partialUTF8.data(), m_partialUTF8.length());
+  if (score >= 0)
+    AddMatch(wxString::FromUTF8(symbol), score);
+}
+
+void CompletionRanker::AddMatch(const wxString &symbol, int score)
+{
+  if (!m_usage.empty())
+    score += UsageBonus(GetUsage(symbol));
+  m_matches.push_back(Match(symbol, score));
+}
+
+wxArrayString CompletionRanker::GetRanked()
+{
+  std::sort(m_matches.begin(), m_matches.end());
+
+  // Identical symbols have identical scores => duplicates are neighbours now.
+  wxArrayString ranked;
+  ranked.Alloc(m_matches.size());
+  for (size_t i = 0; i < m_matches.size(); i++)
+  {
+    if ((i == 0) || (m_matches[i].m_symbol != m_matches[i - 1].m_symbol))
+      ranked.Add(m_matches[i].m_symbol);
+  }
+  return ranked;
+}
+
+wxString CompletionRanker::UsageName(const wxString &symbol)
+{
+  return symbol.BeforeFirst(wxT('('));
+}
+
+int CompletionRanker::UsageBonus(long count)
+{
+  // 25 points for the first time a symbol is chosen, 25 more each time the
+  // count doubles.
+  int bonus = 0;
+  while ((count > 0) && (bonus < 250))
+  {
+    bonus += 25;
+    count /= 2;
+  }
+  return bonus;
+}
+
+void CompletionRanker::Accepted(const wxString &symbol)
+{
+  wxString name = UsageName(symbol);
+  if (name.IsEmpty() || name.Contains(wxT(" ")))
+    return;
+  m_usage[name]++;
+
+  // Don't let the list grow forever: If it gets too long the counts age and
+  // the symbols that haven't been used for a long time are forgotten.
+  if (m_usage.size() > m_maxUsageEntries)
+  {
+    UsageCounts::iterator it = m_usage.begin();
+    while (it != m_usage.end())
+    {
+      if ((it->second /= 2) <= 0)
+        m_usage.erase(it++);
+      else
+        ++it;
+    }
+  }
+}
+
+long CompletionRanker::GetUsage(const wxString &symbol) const
+{
+  UsageCounts::const_iterator it = m_usage.find(UsageName(symbol));
+  if (it == m_usage.end())
+    return 0;
+  return it->second;
+}
+
+void CompletionRanker::ReadUsage(wxConfigBase *config)
+{
+  m_usage.clear();
+  wxString usage;
+  if (!config->Read(wxT("autocompleteUsage"), &usage))
+    return;
+
+  // The format is "symbol count symbol count ..."
+  wxStringTokenizer tokens(usage, wxT(" "), wxTOKEN_STRTOK);
+  while (tokens.HasMoreTokens())
+  {
+    wxString name = tokens.GetNextToken();
+    long count;
+    if (!tokens.HasMoreTokens() || !tokens.GetNextToken().ToLong(&count))
+      break;
+    if (count > 0)
+      m_usage[name] = count;
+  }
+}
+
+void CompletionRanker::WriteUsage(wxConfigBase *config) const
+{
+  wxString usage;
+  for (UsageCounts::const_iterator it = m_usage.begin(); it != m_usage.end(); ++it)
+    usage << it->first << wxT(" ") << it->second << wxT(" ");
+  config->Write(wxT("autocompleteUsage"), usage.Trim());
+}
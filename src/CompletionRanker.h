@@ -0,0 +1,137 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+#ifndef COMPLETIONRANKER_H
+#define COMPLETIONRANKER_H
+
+#include <map>
+#include <vector>
+#include <wx/string.h>
+#include <wx/arrstr.h>
+#include <wx/config.h>
+
+/*!\file
+
+  This file declares the class CompletionRanker.
+
+  CompletionRanker decides which symbols match the text the user wants to have
+  completed and in which order they are offered.
+ */
+
+/*! Finds the symbols that match a partial word and ranks them
+
+  A symbol matches if the partial is a prefix of it or if the chars of the partial
+  appear in the symbol in the same order, the first of them at the start of a word
+  ("intg" matches "integrate", "lsq" matches "lsquares_estimates"). Case is ignored
+  for matching. Templates are matched by the name of their function only, the
+  same name their usage is counted for.
+
+  The symbols are ranked by a score that combines the quality of the match and
+  how often the user has chosen the symbol before:
+   - Symbols the partial is a prefix of always come before all other matches.
+   - Runs of consecutive chars and chars at the start of a word make a match
+     better; skipped chars and a long rest of the symbol make it worse.
+   - Each time the user chooses a symbol its bonus grows, with diminishing
+     returns, up to a limit that never lifts a non-prefix match above a
+     prefix match.
+   - Symbols with the same score are sorted alphabetically.
+
+  Usage:
+   - Start() a new search for each keystroke,
+   - Add() every candidate symbol and
+   - GetRanked() returns the symbols that matched.
+
+  The usage counts are stored in the configuration.
+ */
+class CompletionRanker
+{
+public:
+  CompletionRanker();
+
+  //! Starts collecting the symbols that match partial
+  void Start(const wxString &partial);
+  //! Offers a symbol; It is kept if it matches the partial
+  void Add(const wxString &symbol);
+  //! Offers a symbol that is stored as an UTF-8 string
+  void Add(const char *symbol);
+  //! The number of symbols that have matched since Start()
+  size_t GetCount() const {return m_matches.size();}
+  //! Returns the symbols that have matched, the best match first
+  wxArrayString GetRanked();
+
+  /*! How well does symbol match partial?
+
+    \return -1 if it doesn't match at all. Prefix matches always score higher
+            than other matches.
+   */
+  static int MatchScore(const wxString &symbol, const wxString &partial);
+
+  //! Remembers that the user has chosen this symbol
+  void Accepted(const wxString &symbol);
+  //! How often has the user chosen this symbol?
+  long GetUsage(const wxString &symbol) const;
+  //! Reads the usage counts from the configuration
+  void ReadUsage(wxConfigBase *config);
+  //! Writes the usage counts to the configuration
+  void WriteUsage(wxConfigBase *config) const;
+
+  //! The score all prefix matches have at least
+  static const int PrefixScore = 1000;
+
+private:
+  //! The name usage is counted for: Templates count for the function they call
+  static wxString UsageName(const wxString &symbol);
+  //! The bonus a symbol that has been chosen count times before gets
+  static int UsageBonus(long count);
+  //! Adds a symbol that has matched with the score score
+  void AddMatch(const wxString &symbol, int score);
+
+  //! A symbol that matched and its rank
+  struct Match
+  {
+    Match(const wxString &symbol, int score){m_symbol = symbol; m_score = score;}
+    wxString m_symbol;
+    int m_score;
+    //! Better matches sort first; equally good matches alphabetically
+    bool operator<(const Match &other) const
+      {
+        if (m_score != other.m_score)
+          return m_score > other.m_score;
+        return m_symbol < other.m_symbol;
+      }
+  };
+  //! The symbols that have matched since Start()
+  std::vector<Match> m_matches;
+  //! The partial that is to be completed
+  wxString m_partial;
+  //! The partial as UTF-8, for symbols that are stored as UTF-8
+  wxCharBuffer m_partialUTF8;
+
+  typedef std::map<wxString, long> UsageCounts;
+  //! How often the user has chosen each symbol
+  UsageCounts m_usage;
+  //! The number of symbols we keep usage counts for at most
+  static const size_t m_maxUsageEntries = 2000;
+};
+
+#endif // COMPLETIONRANKER_H
@@ -33,10 +33,12 @@
 #include <wx/config.h>
 #include <wx/wfstream.h>
 #include <wx/fileconf.h>
+#include <cmath>
 #include "Cell.h"
 
-Configuration::Configuration(wxDC *dc) : m_dc(dc) 
+Configuration::Configuration(wxDC *dc, bool writeStyles) : m_dc(dc) 
 {
+  m_writeStyles = writeStyles;
   m_documentclass = wxT("article");
   m_documentclassOptions = wxT("fleqn");
   
@@ -46,6 +48,9 @@ Configuration::Configuration(wxDC *dc) : m_dc(dc)
   m_BackgroundBrush = *wxWHITE_BRUSH;
   m_clipToDrawRegion = true;
   m_fontChanged = true;
+  m_textExtentCacheHits = 0;
+  m_textExtentCacheMisses = 0;
+  m_fontsConstructed = 0;
   m_mathJaxURL_UseUser = false;
   m_TOCshowsSectionNumbers = false;
   m_antialiassingDC = NULL;
@@ -484,7 +489,26 @@ wxFont Configuration::GetFont(TextStyle textStyle, int fontSize)
   fontWeight = IsBold(textStyle);
   
   fontEncoding = GetFontEncoding();
-  
+
+  return GetFont(fontName, fontStyle, fontWeight, underlined, fontEncoding, fontSize1);
+}
+
+wxFont Configuration::GetFont(const wxString &fontName, wxFontStyle fontStyle, wxFontWeight fontWeight,
+                              bool underlined, wxFontEncoding fontEncoding, double pointSize)
+{
+  wxString key = wxString::Format(wxT("%i:%i:%i:%i:%g:"),
+                                  fontStyle, fontWeight, underlined, fontEncoding, pointSize) +
+    fontName;
+
+  FontCacheIndex::iterator it = m_fontCacheIndex.find(key);
+  if (it != m_fontCacheIndex.end())
+  {
+    // Move the font to the front of the list of recently used fonts
+    m_fontCache.splice(m_fontCache.begin(), m_fontCache, it->second);
+    return m_fontCache.front().m_font;
+  }
+
+  m_fontsConstructed++;
   wxFont font;
   font.SetFamily(wxFONTFAMILY_MODERN);
   font.SetFaceName(fontName);
@@ -495,21 +519,52 @@ wxFont Configuration::GetFont(TextStyle textStyle, int fontSize)
   font.SetEncoding(fontEncoding);
   if (!font.IsOk())
   {
+    wxLogMessage(wxString::Format(_("Ignoring the font name %s as the selected font didn't work"), fontName));
     font.SetFamily(wxFONTFAMILY_MODERN);
     font.SetEncoding(fontEncoding);
     font.SetStyle(fontStyle);
     font.SetWeight(fontWeight);
     font.SetUnderlined(underlined);
   }
-  
+
   if (!font.IsOk())
     font = *wxNORMAL_FONT;
-  
-  font.SetPointSize(fontSize1);
 
+#if wxCHECK_VERSION(3, 1, 2)
+  font.SetFractionalPointSize(pointSize);
+#else
+  font.SetPointSize(pointSize);
+#endif
+
+  CachedFont cachedFont;
+  cachedFont.m_key = key;
+  cachedFont.m_font = font;
+  m_fontCache.push_front(cachedFont);
+  m_fontCacheIndex[key] = m_fontCache.begin();
+
+  // Forget the font that has been used least recently
+  if (m_fontCache.size() > m_fontCacheSize)
+  {
+    m_fontCacheIndex.erase(m_fontCache.back().m_key);
+    m_fontCache.pop_back();
+  }
   return font;
 }
 
+void Configuration::ClearFontCache()
+{
+  m_fontCache.clear();
+  m_fontCacheIndex.clear();
+}
+
+void Configuration::LogFontConstructions()
+{
+  if (m_fontsConstructed == 0)
+    return;
+  wxLogDebug(wxT("%li fonts have been constructed"), m_fontsConstructed);
+  m_fontsConstructed = 0;
+}
+
 Configuration::drawMode Configuration::GetGrouphesisDrawMode()
 {
   if(m_parenthesisDrawMode == unknown)
@@ -580,7 +635,8 @@ void Configuration::SetZoomFactor(double newzoom)
 
 Configuration::~Configuration()
 {
-  WriteStyles();
+  if (m_writeStyles)
+    WriteStyles();
 }
 
 bool Configuration::CharsExistInFont(wxFont font, wxString char1,wxString char2, wxString char3)
@@ -705,8 +761,78 @@ wxString Configuration::MaximaDefaultLocation()
   return Dirstructure::Get()->MaximaDefaultLocation();
 }
 
+void Configuration::LogTextExtentCacheStats()
+{
+  long lookups = m_textExtentCacheHits + m_textExtentCacheMisses;
+  if(lookups == 0)
+    return;
+  wxLogDebug(wxT("Text size cache: %li of %li lookups were hits (%.1f%%), %li sizes cached"),
+             m_textExtentCacheHits, lookups,
+             100.0 * m_textExtentCacheHits / lookups,
+             (long) (m_textExtents.size() + m_oldTextExtents.size()));
+  m_textExtentCacheHits = 0;
+  m_textExtentCacheMisses = 0;
+}
+
+wxSize Configuration::GetLabelExtent(const wxString &text, TextStyle textStyle, double fontSize)
+{
+  wxString key = TextExtentKey(text, textStyle, fontSize, wxT("label"));
+  wxSize size;
+  if (!GetCachedTextExtent(key, size))
+  {
+    wxFont font = GetFont(textStyle, fontSize);
+#if wxCHECK_VERSION(3, 1, 2)
+    font.SetFractionalPointSize(Scale_Px(fontSize));
+#else
+    font.SetPointSize(Scale_Px(fontSize));
+#endif
+    m_dc->SetFont(font);
+    size = m_dc->GetTextExtent(text);
+    CacheTextExtent(key, size);
+  }
+  return size;
+}
+
+double Configuration::GetLabelFontSize(const wxString &text, TextStyle textStyle, double fontSize,
+                                       int width, wxSize &size)
+{
+  wxString key = TextExtentKey(text, textStyle, fontSize, wxString::Format(wxT("label width %i"), width));
+  LabelSizeMap::const_iterator it = m_labelSizes.find(key);
+  if (it != m_labelSizes.end())
+  {
+    size = it->second.m_size;
+    return it->second.m_fontSize;
+  }
+
+  // We try the font sizes fontSize, fontSize - 1,... down to 2 and want the first
+  // one the label fits in. The width of a text grows with its font size
+  // => we can bisect instead of trying them one by one.
+  int first = 0;
+  int last = 0;
+  if (fontSize > 2)
+    last = ceil(fontSize - 2);
+  while (first < last)
+  {
+    int middle = (first + last) / 2;
+    if (GetLabelExtent(text, textStyle, fontSize - middle).x < width)
+      last = middle;
+    else
+      first = middle + 1;
+  }
+
+  LabelSize labelSize;
+  labelSize.m_fontSize = fontSize - first;
+  labelSize.m_size = size = GetLabelExtent(text, textStyle, labelSize.m_fontSize);
+  m_labelSizes[key] = labelSize;
+  return labelSize.m_fontSize;
+}
+
 void Configuration::ReadStyles(wxString file)
 {
+  // The fonts might change
+  ClearTextExtentCache();
+  m_labelSizes.clear();
+  ClearFontCache();
   wxConfigBase *config = NULL;
   if (file == wxEmptyString)
     config = wxConfig::Get();
@@ -28,6 +28,7 @@
 #include <wx/fontenum.h>
 
 #include "TextStyle.h"
+#include <list>
 
 #define MC_LINE_SKIP Scale_Px(2)
 #define MC_TEXT_PADDING Scale_Px(1)
@@ -114,8 +115,11 @@ public:
   /*! The constructor
     
     \param dc The drawing context that is to be used for drawing objects
+    \param writeStyles false means: Don't write the styles to the config on
+           destruction. For read-only copies of the settings whose styles might
+           be outdated by the time they are deleted.
    */
-  Configuration(wxDC *dc = NULL);
+  Configuration(wxDC *dc = NULL, bool writeStyles = true);
 
   //! Set the drawing context that is currently active
   void SetContext(wxDC &dc)
@@ -187,11 +191,10 @@ public:
 
   //! Sets the zoom factor without storing the new value in the config file/registry.
   void SetZoomFactor_temporarily(double newzoom){
+    // The fonts stay the same, only their size changes => The text sizes that
+    // have been measured at the other zoom factor can be kept.
     if(m_zoomFactor != newzoom)
-    {
       RecalculationForce(true);
-      FontChanged(true);
-    }
     m_zoomFactor = newzoom;
   }
 
@@ -330,9 +333,90 @@ public:
     {
       m_fontChanged = fontChanged;
       if(fontChanged)
+      {
         RecalculationForce(true);
+        ClearTextExtentCache();
+        m_labelSizes.clear();
+      }
       m_charsInFontMap.clear();
     }
+
+  /*! Builds the key the size of a text is remembered by
+
+    \param text The text to measure
+    \param textStyle The text style the text is displayed in
+    \param fontSize The unscaled font size
+    \param fontVariant Describes everything else that makes the font differ
+                       from the one GetFont() returns for this text style
+   */
+  wxString TextExtentKey(const wxString &text, TextStyle textStyle, double fontSize,
+                         const wxString &fontVariant = wxEmptyString)
+    {
+      return wxString::Format(wxT("%i:%g:%g:"), textStyle, fontSize, GetZoomFactor()) +
+        fontVariant + wxT(":") + text;
+    }
+
+  /*! Looks up the size of a text that has already been measured
+
+    Measuring text is expensive and most worksheets contain lots of copies of the
+    same snippets of text (x, +, 1,...). Therefore we remember the size of each text 
+    we have measured until a font changes or until it hasn't been used for a long
+    time. The key contains the zoom factor, so zooming doesn't invalidate the cache.
+    \param key The key TextExtentKey() has generated
+    \param size Returns the size of the text
+    \return false, if the text hasn't been measured in this font, yet.
+   */
+  bool GetCachedTextExtent(const wxString &key, wxSize &size)
+    {
+      TextExtentMap::const_iterator it = m_textExtents.find(key);
+      if(it != m_textExtents.end())
+      {
+        m_textExtentCacheHits++;
+        size = it->second;
+        return true;
+      }
+      it = m_oldTextExtents.find(key);
+      if(it != m_oldTextExtents.end())
+      {
+        m_textExtentCacheHits++;
+        size = it->second;
+        CacheTextExtent(key, size);
+        return true;
+      }
+      m_textExtentCacheMisses++;
+      return false;
+    }
+
+  //! Remembers the size of a text for GetCachedTextExtent()
+  void CacheTextExtent(const wxString &key, const wxSize &size)
+    {
+      // Don't let the cache grow forever: Once it is full the sizes that haven't
+      // been used since the last time it was full are forgotten.
+      if(m_textExtents.size() >= m_textExtentCacheSize)
+      {
+        m_oldTextExtents = m_textExtents;
+        m_textExtents.clear();
+      }
+      m_textExtents[key] = size;
+    }
+
+  //! Logs the hit rate of the text extent cache since the last call
+  void LogTextExtentCacheStats();
+
+  /*! Determines the font size a label or a prompt is displayed with
+
+    Labels and prompts have a fixed width: If their text doesn't fit we reduce its
+    font size until it does. The font size is searched for by bisection and then
+    remembered until the next font change.
+    \param text The text of the label
+    \param textStyle The text style of the label
+    \param fontSize The unscaled font size the label is displayed with if it fits
+    \param width The width [in pixels] the label has to fit in
+    \param size Returns the size of the label in the font size we have chosen
+    \return The unscaled font size the label is to be displayed with
+   */
+  double GetLabelFontSize(const wxString &text, TextStyle textStyle, double fontSize,
+                          int width, wxSize &size);
   
   //! Set the height of the visible window for GetClientHeight()
   void SetClientHeight(int height)
@@ -733,6 +817,25 @@ public:
    */
   wxFont GetFont(TextStyle textStyle, int fontSize);
 
+  /*! Get a font with the given properties
+
+    Constructing a font is expensive on some platforms (on GTK it involves pango)
+    and the same fonts are requested for nearly every cell on every recalculation
+    => the fonts we have constructed recently are kept in a cache that is cleared
+    when the styles are read.
+    \param fontName The face name of the font
+    \param fontStyle Is the font italic or slanted?
+    \param fontWeight Is the font bold?
+    \param underlined Is the font underlined?
+    \param fontEncoding The encoding of the font
+    \param pointSize The (already scaled) point size of the font
+   */
+  wxFont GetFont(const wxString &fontName, wxFontStyle fontStyle, wxFontWeight fontWeight,
+                 bool underlined, wxFontEncoding fontEncoding, double pointSize);
+
+  //! Logs how many fonts had to be constructed since the last call
+  void LogFontConstructions();
+
   //! Get the worksheet this configuration storage is valid for
   wxWindow *GetWorkSheet(){return m_workSheet;}
   //! Set the worksheet this configuration storage is valid for
@@ -795,6 +898,54 @@ private:
   wxRect m_updateRegion;
   //! Has the font changed?
   bool m_fontChanged;
+  //! Write the styles to the config on destruction?
+  bool m_writeStyles;
+  WX_DECLARE_STRING_HASH_MAP(wxSize, TextExtentMap);
+  //! The sizes of the texts we have measured since the cache was last full
+  TextExtentMap m_textExtents;
+  //! The sizes that were in m_textExtents when it was last full
+  TextExtentMap m_oldTextExtents;
+  //! The number of sizes m_textExtents holds at most
+  static const size_t m_textExtentCacheSize = 20000;
+  //! Forget all text sizes that have been measured
+  void ClearTextExtentCache()
+  {
+    m_textExtents.clear();
+    m_oldTextExtents.clear();
+  }
+  //! How many text sizes could be read from m_textExtents?
+  long m_textExtentCacheHits;
+  //! How many text sizes had to be measured?
+  long m_textExtentCacheMisses;
+  //! Forget all fonts GetFont() has constructed
+  void ClearFontCache();
+  //! A font GetFont() has constructed
+  struct CachedFont
+  {
+    wxString m_key;
+    wxFont m_font;
+  };
+  typedef std::list<CachedFont>::iterator FontCacheIterator;
+  WX_DECLARE_STRING_HASH_MAP(FontCacheIterator, FontCacheIndex);
+  //! The fonts GetFont() has constructed, the most recently used one first
+  std::list<CachedFont> m_fontCache;
+  //! Where in m_fontCache to find the font for a key
+  FontCacheIndex m_fontCacheIndex;
+  //! The number of fonts GetFont() has constructed since the last LogFontConstructions()
+  long m_fontsConstructed;
+  //! The number of fonts m_fontCache holds at most
+  static const size_t m_fontCacheSize = 256;
+  //! Measures a label in the font size fontSize
+  wxSize GetLabelExtent(const wxString &text, TextStyle textStyle, double fontSize);
+  //! A label font size GetLabelFontSize() has determined
+  struct LabelSize
+  {
+    double m_fontSize;
+    wxSize m_size;
+  };
+  WX_DECLARE_STRING_HASH_MAP(LabelSize, LabelSizeMap);
+  //! The label font sizes GetLabelFontSize() has determined since the last font change
+  LabelSizeMap m_labelSizes;
   /*! The interval between auto-saves (in milliseconds). 
 
     Values <10000 mean: Auto-save is off.
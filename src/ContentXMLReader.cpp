@@ -0,0 +1,275 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ContentXMLReader
+
+  ContentXMLReader reads the content.xml of a .wxmx file one cell at a time.
+ */
+
+#include "ContentXMLReader.h"
+#include <wx/sstream.h>
+
+ContentXMLReader::ContentXMLReader(wxInputStream &stream) :
+  m_stream(stream),
+  m_text(stream, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8))
+{
+  m_pos = 0;
+  m_complete = false;
+  m_peakSize = 0;
+}
+
+bool ContentXMLReader::ReadMore()
+{
+  if (m_stream.Eof())
+    return false;
+
+  // Reading the file in big pieces means that we don't need to search the same
+  // text for the end of an element too often.
+  size_t oldLength = m_data.Length();
+  while ((!m_stream.Eof()) && (m_data.Length() < oldLength + 65536))
+  {
+    wxString line = m_text.ReadLine();
+    // A typical error in old wxMaxima versions was to include a letter of
+    // ascii code 27 in content.xml. Any char XML doesn't allow would make the
+    // whole file unreadable.
+    for (wxString::iterator it = line.begin(); it != line.end(); ++it)
+    {
+      wxChar ch = *it;
+      if ((ch < wxT(' ')) && (ch != wxT('\t')) && (ch != wxT('\r')))
+        *it = wxT('|');
+    }
+    m_data += line + wxT("\n");
+  }
+  if (m_data.Length() > m_peakSize)
+    m_peakSize = m_data.Length();
+  return true;
+}
+
+size_t ContentXMLReader::Find(const wxString &str, size_t from)
+{
+  for (;;)
+  {
+    size_t pos = m_data.find(str, from);
+    if (pos != wxString::npos)
+      return pos;
+
+    // A match can only start in the last few chars we have already searched
+    if (m_data.Length() + 1 > from + str.Length())
+      from = m_data.Length() + 1 - str.Length();
+    if (!ReadMore())
+      return wxString::npos;
+  }
+}
+
+bool ContentXMLReader::StartsAt(size_t pos, const wxString &str)
+{
+  while (m_data.Length() < pos + str.Length())
+  {
+    if (!ReadMore())
+      return false;
+  }
+  return m_data.compare(pos, str.Length(), str) == 0;
+}
+
+bool ContentXMLReader::TagIs(size_t pos, const wxString &name) const
+{
+  if (m_data.compare(pos, name.Length(), name) != 0)
+    return false;
+  wxChar ch = m_data[pos + name.Length()];
+  return (ch == wxT('>')) || (ch == wxT('/')) || (ch == wxT(' ')) ||
+    (ch == wxT('\t')) || (ch == wxT('\r')) || (ch == wxT('\n'));
+}
+
+void ContentXMLReader::Compact()
+{
+  if (m_pos == 0)
+    return;
+  m_data.erase(0, m_pos);
+  m_pos = 0;
+}
+
+bool ContentXMLReader::ReadStartTag()
+{
+  for (;;)
+  {
+    size_t start = Find(wxT("<"), m_pos);
+    if (start == wxString::npos)
+      return false;
+    m_pos = start;
+
+    // Skip the xml declaration and comments
+    if (StartsAt(m_pos, wxT("<?")))
+    {
+      size_t end = Find(wxT("?>"), m_pos + 2);
+      if (end == wxString::npos)
+        return false;
+      m_pos = end + 2;
+      continue;
+    }
+    if (StartsAt(m_pos, wxT("<!--")))
+    {
+      size_t end = Find(wxT("-->"), m_pos + 4);
+      if (end == wxString::npos)
+        return false;
+      m_pos = end + 3;
+      continue;
+    }
+
+    size_t end = Find(wxT(">"), m_pos);
+    if (end == wxString::npos)
+      return false;
+
+    // Let wxXmlDocument parse the attributes of the start tag.
+    wxString tag = m_data.SubString(m_pos, end);
+    m_pos = end + 1;
+    if (tag.EndsWith(wxT("/>")))
+      m_complete = true;
+    else
+    {
+      wxString name = tag.Mid(1).BeforeFirst(wxT('>')).BeforeFirst(wxT(' '));
+      name = name.BeforeFirst(wxT('\t')).BeforeFirst(wxT('\r')).BeforeFirst(wxT('\n'));
+      tag += wxT("</") + name + wxT(">");
+    }
+    wxStringInputStream istream(tag);
+    return m_startTag.Load(istream, wxT("UTF-8"));
+  }
+}
+
+wxString ContentXMLReader::GetRootName() const
+{
+  if (!m_startTag.IsOk())
+    return wxEmptyString;
+  return m_startTag.GetRoot()->GetName();
+}
+
+wxString ContentXMLReader::GetAttribute(const wxString &name, const wxString &defaultVal) const
+{
+  if (!m_startTag.IsOk())
+    return defaultVal;
+  return m_startTag.GetRoot()->GetAttribute(name, defaultVal);
+}
+
+size_t ContentXMLReader::FindElementEnd()
+{
+  // The name of the element
+  size_t nameEnd = m_pos + 1;
+  for (;;)
+  {
+    if ((nameEnd >= m_data.Length()) && (!ReadMore()))
+      return wxString::npos;
+    wxChar ch = m_data[nameEnd];
+    if ((ch == wxT('>')) || (ch == wxT('/')) || (ch == wxT(' ')) ||
+        (ch == wxT('\t')) || (ch == wxT('\r')) || (ch == wxT('\n')))
+      break;
+    nameEnd++;
+  }
+  wxString startTag = m_data.SubString(m_pos, nameEnd - 1);
+  wxString endTag = wxT("</") + startTag.Mid(1);
+
+  // Elements of the same name might be nested: A folded cell contains the
+  // cells that are hidden inside it.
+  long depth = 0;
+  size_t pos = m_pos;
+  for (;;)
+  {
+    pos = Find(wxT("<"), pos);
+    if (pos == wxString::npos)
+      return wxString::npos;
+    if (StartsAt(pos, wxT("<!--")))
+    {
+      pos = Find(wxT("-->"), pos + 4);
+      if (pos == wxString::npos)
+        return wxString::npos;
+      continue;
+    }
+    size_t tagEnd = Find(wxT(">"), pos);
+    if (tagEnd == wxString::npos)
+      return wxString::npos;
+
+    if (TagIs(pos, endTag))
+    {
+      depth--;
+      if (depth <= 0)
+        return tagEnd + 1;
+    }
+    else if (TagIs(pos, startTag))
+    {
+      if (m_data[tagEnd - 1] != wxT('/'))
+        depth++;
+      else if (depth == 0)
+        return tagEnd + 1;
+    }
+    pos = tagEnd + 1;
+  }
+}
+
+bool ContentXMLReader::NextElement(wxXmlDocument &element)
+{
+  Compact();
+  if (m_complete)
+    return false;
+
+  for (;;)
+  {
+    // Skip the whitespace between the elements
+    size_t start = Find(wxT("<"), m_pos);
+    if (start == wxString::npos)
+    {
+      m_pos = m_data.Length();
+      return false;
+    }
+    m_pos = start;
+
+    if (StartsAt(m_pos, wxT("<!--")))
+    {
+      size_t end = Find(wxT("-->"), m_pos + 4);
+      if (end == wxString::npos)
+      {
+        m_pos = m_data.Length();
+        return false;
+      }
+      m_pos = end + 3;
+      continue;
+    }
+
+    // The end tag of the document
+    if (StartsAt(m_pos, wxT("</")))
+    {
+      m_complete = true;
+      m_pos = m_data.Length();
+      return false;
+    }
+
+    size_t end = FindElementEnd();
+    if (end == wxString::npos)
+    {
+      m_pos = m_data.Length();
+      return false;
+    }
+
+    wxStringInputStream istream(m_data.Mid(m_pos, end - m_pos));
+    m_pos = end;
+    element.Load(istream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
+    return true;
+  }
+}
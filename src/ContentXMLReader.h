@@ -0,0 +1,129 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef CONTENTXMLREADER_H
+#define CONTENTXMLREADER_H
+
+#include <wx/stream.h>
+#include <wx/txtstrm.h>
+#include <wx/xml/xml.h>
+
+/*!\file
+
+  This file declares the class ContentXMLReader.
+
+  ContentXMLReader reads the content.xml of a .wxmx file one cell at a time.
+ */
+
+/*! Reads the content.xml of a .wxmx file one cell at a time
+
+  Loading the whole file into a wxXmlDocument would need several times the
+  memory the file needs. This class instead only keeps the XML text of the
+  element it is currently reading in memory and hands out each child element
+  of the \<wxMaximaDocument\> tag as a wxXmlDocument of its own as soon as its
+  end tag has arrived.
+
+  Characters that aren't allowed in XML (old wxMaxima versions sometimes
+  wrote an ASCII 27 to content.xml) are replaced by a "|" while the file is
+  read.
+ */
+class ContentXMLReader
+{
+public:
+  //! The constructor. The stream must exist as long as the reader does.
+  explicit ContentXMLReader(wxInputStream &stream);
+
+  /*! Reads everything up to and including the start tag of the document
+
+    \return false, if no start tag could be read.
+   */
+  bool ReadStartTag();
+
+  //! The name of the document's start tag
+  wxString GetRootName() const;
+
+  //! Returns an attribute of the document's start tag
+  wxString GetAttribute(const wxString &name, const wxString &defaultVal = wxEmptyString) const;
+
+  /*! Reads the next child element of the document
+
+    \param element Returns the element. If the element isn't well-formed XML
+    element.IsOk() is false.
+    \return false, if there are no more elements.
+   */
+  bool NextElement(wxXmlDocument &element);
+
+  /*! Has the end tag of the document been read?
+
+    If NextElement() has returned false and this is false the file has been
+    truncated.
+   */
+  bool IsComplete() const {return m_complete;}
+
+  //! The longest piece of XML text we had to keep in memory at once
+  size_t GetPeakSize() const {return m_peakSize;}
+
+private:
+  /*! Reads the next lines of the file
+
+    \return false, if the end of the file has been reached.
+   */
+  bool ReadMore();
+
+  /*! Finds str, reading more of the file if necessary
+
+    \return The position of str or wxString::npos, if the file ends before
+    str is found.
+   */
+  size_t Find(const wxString &str, size_t from);
+
+  //! Does str start at pos? Reads more of the file if necessary.
+  bool StartsAt(size_t pos, const wxString &str);
+
+  //! Does the tag starting at pos start with name and end directly after it?
+  bool TagIs(size_t pos, const wxString &name) const;
+
+  /*! Finds the end of the element that starts at m_pos
+
+    \return The position after its end tag or wxString::npos, if the file
+    ends before.
+   */
+  size_t FindElementEnd();
+
+  //! Drops the text that has already been handed out
+  void Compact();
+
+  wxInputStream &m_stream;
+  wxTextInputStream m_text;
+  //! The part of the file we have read but not handed out yet
+  wxString m_data;
+  //! The position in m_data the next element is searched for at
+  size_t m_pos;
+  //! The start tag of the document
+  wxXmlDocument m_startTag;
+  //! Have we read the end tag of the document?
+  bool m_complete;
+  //! The longest m_data we have seen
+  size_t m_peakSize;
+};
+
+#endif // CONTENTXMLREADER_H
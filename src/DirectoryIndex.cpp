@@ -0,0 +1,435 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class DirectoryIndex
+
+  DirectoryIndex keeps the contents of the directories autocompletion offers
+  file names from in memory.
+ */
+
+#include "DirectoryIndex.h"
+#include <wx/dir.h>
+#include <wx/log.h>
+#include <wx/intl.h>
+#include <wx/time.h>
+#include <algorithm>
+
+//! The directory an element of a std::set of directories stands for
+static const wxString &DirOf(const wxString &dir)
+{
+  return dir;
+}
+
+//! The directory an element of a std::map indexed by directories stands for
+template <class T> static const wxString &DirOf(const std::pair<const wxString, T> &entry)
+{
+  return entry.first;
+}
+
+//! Removes the directory key and all directories below it from a sorted container
+template <class Container> static void EraseBelow(Container &container, const wxString &key)
+{
+  typename Container::iterator it = container.lower_bound(key);
+  while ((it != container.end()) && DirOf(*it).StartsWith(key))
+    container.erase(it++);
+}
+
+DirectoryIndex::DirectoryIndex()
+{
+  m_generation = 0;
+  m_quitting = false;
+  Connect(DirectoryIndexed(), wxEVT_THREAD,
+          wxThreadEventHandler(DirectoryIndex::OnDirectoryIndexed),
+          NULL, this);
+#if wxUSE_FSWATCHER
+  // The watcher needs a running event loop => it is created when the first
+  // directory is to be watched.
+  m_watcher = NULL;
+  Connect(wxEVT_FSWATCHER,
+          wxFileSystemWatcherEventHandler(DirectoryIndex::OnFileSystemEvent),
+          NULL, this);
+#endif
+
+  m_worker = new Worker(this);
+  if (m_worker->Run() != wxTHREAD_NO_ERROR)
+  {
+    wxLogMessage(_("Cannot start a thread for indexing directories."));
+    delete m_worker;
+    m_worker = NULL;
+  }
+}
+
+DirectoryIndex::~DirectoryIndex()
+{
+  if (m_worker != NULL)
+  {
+    {
+      wxMutexLocker lock(m_mutex);
+      m_quitting = true;
+    }
+    Job *quit = new Job;
+    quit->m_recursive = false;
+    quit->m_quit = true;
+    m_jobs.Post(quit);
+    m_worker->Wait();
+    delete m_worker;
+  }
+  for (size_t i = 0; i < m_results.size(); i++)
+    delete m_results[i];
+#if wxUSE_FSWATCHER
+  wxDELETE(m_watcher);
+#endif
+}
+
+wxString DirectoryIndex::Key(const wxString &dir)
+{
+  wxFileName name = wxFileName::DirName(dir);
+  name.Normalize(wxPATH_NORM_DOTS | wxPATH_NORM_ABSOLUTE | wxPATH_NORM_TILDE);
+  wxString key = name.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR);
+  key.Replace(wxFileName::GetPathSeparator(), wxT("/"));
+  return key;
+}
+
+bool DirectoryIndex::List(const wxString &dir, wxArrayString &entries)
+{
+  // A directory we cannot read is of no interest to us => no error messages.
+  wxLogNull suppressErrors;
+  if (!wxDirExists(dir))
+    return false;
+  wxDir directory(dir);
+  if (!directory.IsOpened())
+    return false;
+
+  wxString name;
+  bool more = directory.GetFirst(&name);
+  while (more)
+  {
+    if (wxDirExists(dir + name))
+      entries.Add(name + wxT("/"));
+    else
+      entries.Add(name);
+    more = directory.GetNext(&name);
+  }
+  entries.Sort();
+  return true;
+}
+
+void DirectoryIndex::Index(const wxString &dir, bool recursive)
+{
+  wxString key = Key(dir);
+  if (IsBelowRecursiveRoot(key))
+    return;
+  if (!recursive && (m_requested.find(key) != m_requested.end()))
+    return;
+  if (recursive)
+  {
+    m_recursiveRoots.insert(key);
+    m_crawled[key] = wxGetLocalTime();
+  }
+  m_requested.insert(key);
+  Post(key, recursive);
+}
+
+void DirectoryIndex::Refresh()
+{
+  long now = wxGetLocalTime();
+  for (std::map<wxString, long>::iterator it = m_crawled.begin(); it != m_crawled.end(); ++it)
+  {
+    if ((now >= it->second) && (now - it->second < m_refreshInterval))
+      continue;
+    it->second = now;
+    Post(it->first, true);
+  }
+}
+
+void DirectoryIndex::Post(const wxString &key, bool recursive)
+{
+  Job *job = new Job;
+  // wxString's reference counting isn't thread-safe => Make a real copy.
+  job->m_dir = wxString(key.wc_str());
+  job->m_recursive = recursive;
+  job->m_quit = false;
+
+  // Without a crawler thread we have to crawl the directory ourselves.
+  if (m_worker == NULL)
+  {
+    Process(*job);
+    delete job;
+  }
+  else
+    m_jobs.Post(job);
+}
+
+bool DirectoryIndex::IsBelowRecursiveRoot(const wxString &key) const
+{
+  for (std::set<wxString>::const_iterator it = m_recursiveRoots.begin();
+       it != m_recursiveRoots.end(); ++it)
+  {
+    if (key.StartsWith(*it))
+      return true;
+  }
+  return false;
+}
+
+const wxArrayString &DirectoryIndex::GetListing(const wxString &dir)
+{
+  static const wxArrayString noEntries;
+  wxString key = Key(dir);
+
+  // A directory that is watched is known to be up to date.
+  std::map<wxString, wxArrayString>::iterator it = m_listings.find(key);
+  if ((it != m_listings.end()) && (m_watched.find(key) != m_watched.end()))
+    return it->second;
+
+  wxArrayString entries;
+  if (!List(key, entries))
+    return noEntries;
+
+  bool known = (it != m_listings.end());
+  if (!known || (it->second != entries))
+    m_generation++;
+  m_listings[key] = entries;
+  m_requested.insert(key);
+  Watch(key);
+
+  // The next thing the user types might be the name of a subdirectory.
+  if (!known)
+  {
+    for (size_t i = 0; i < entries.GetCount(); i++)
+    {
+      if (!entries[i].EndsWith(wxT("/")))
+        continue;
+      wxString subdir = key + entries[i];
+      if (!IsBelowRecursiveRoot(subdir) && m_requested.insert(subdir).second)
+        Post(subdir, false);
+    }
+  }
+  return m_listings[key];
+}
+
+void DirectoryIndex::GetFilesBelow(const wxString &dir, wxArrayString &files) const
+{
+  wxString key = Key(dir);
+  for (std::map<wxString, wxArrayString>::const_iterator it = m_listings.lower_bound(key);
+       (it != m_listings.end()) && (it->first.StartsWith(key)); ++it)
+  {
+    for (size_t i = 0; i < it->second.GetCount(); i++)
+    {
+      if (!it->second[i].EndsWith(wxT("/")))
+        files.Add(it->second[i]);
+    }
+  }
+}
+
+void DirectoryIndex::Process(const Job &job)
+{
+  Result *result = new Result;
+  result->m_dir = wxString(job.m_dir.wc_str());
+  result->m_recursive = job.m_recursive;
+
+  // The crawler reads the directories breadth-first and only hands the GUI
+  // thread strings it holds no other reference to.
+  std::vector<wxString> dirs;
+  dirs.push_back(wxString(job.m_dir.wc_str()));
+  for (size_t i = 0; i < dirs.size(); i++)
+  {
+    {
+      wxMutexLocker lock(m_mutex);
+      if (m_quitting)
+      {
+        delete result;
+        return;
+      }
+    }
+
+    Listing listing;
+    if (!List(dirs[i], listing.m_entries))
+      continue;
+    listing.m_dir = wxString(dirs[i].wc_str());
+    if (job.m_recursive)
+    {
+      for (size_t j = 0; j < listing.m_entries.GetCount(); j++)
+      {
+        if (listing.m_entries[j].EndsWith(wxT("/")))
+          dirs.push_back(dirs[i] + listing.m_entries[j]);
+      }
+    }
+    result->m_listings.push_back(listing);
+  }
+
+  {
+    wxMutexLocker lock(m_mutex);
+    m_results.push_back(result);
+  }
+  wxQueueEvent(this, new wxThreadEvent(wxEVT_THREAD, DirectoryIndexed()));
+}
+
+void DirectoryIndex::OnDirectoryIndexed(wxThreadEvent &WXUNUSED(event))
+{
+  std::vector<Result *> results;
+  {
+    wxMutexLocker lock(m_mutex);
+    results.swap(m_results);
+  }
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    Store(*results[i]);
+    delete results[i];
+  }
+}
+
+void DirectoryIndex::Store(const Result &result)
+{
+  // Subdirectories the crawler hasn't found any more have been deleted.
+  if (result.m_recursive)
+    Forget(result.m_dir);
+  for (size_t i = 0; i < result.m_listings.size(); i++)
+    m_listings[result.m_listings[i].m_dir] = result.m_listings[i].m_entries;
+  // Trees are kept up to date by Refresh().
+  if (!result.m_recursive)
+    Watch(result.m_dir);
+  m_generation++;
+}
+
+void DirectoryIndex::Forget(const wxString &key)
+{
+  EraseBelow(m_listings, key);
+  std::set<wxString>::iterator it = m_watched.lower_bound(key);
+  while ((it != m_watched.end()) && (it->StartsWith(key)))
+  {
+#if wxUSE_FSWATCHER
+    wxLogNull suppressErrors;
+    m_watcher->Remove(wxFileName::DirName(*it));
+#endif
+    m_watched.erase(it++);
+  }
+}
+
+void DirectoryIndex::Watch(const wxString &key)
+{
+  if (m_watched.find(key) != m_watched.end())
+    return;
+#if wxUSE_FSWATCHER
+  if (m_watcher == NULL)
+  {
+    m_watcher = new wxFileSystemWatcher();
+    m_watcher->SetOwner(this);
+  }
+  // If we run out of watches the directory's listing is read every time it is
+  // needed, instead.
+  wxLogNull suppressErrors;
+  if (m_watcher->Add(wxFileName::DirName(key),
+                     wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME |
+                     wxFSW_EVENT_WARNING | wxFSW_EVENT_ERROR))
+    m_watched.insert(key);
+#endif
+}
+
+void DirectoryIndex::EntryAdded(const wxFileName &path)
+{
+  wxString dir = Key(path.GetPath(wxPATH_GET_VOLUME));
+  std::map<wxString, wxArrayString>::iterator it = m_listings.find(dir);
+  if (it == m_listings.end())
+    return;
+
+  bool isDir = wxDirExists(path.GetFullPath());
+  wxString entry = path.GetFullName();
+  if (isDir)
+    entry += wxT("/");
+  wxArrayString &entries = it->second;
+  wxArrayString::iterator pos = std::lower_bound(entries.begin(), entries.end(), entry);
+  if ((pos == entries.end()) || (*pos != entry))
+  {
+    entries.Insert(entry, static_cast<size_t>(pos - entries.begin()));
+    m_generation++;
+  }
+
+  // A new directory in a tree we index recursively needs to be crawled, too.
+  if (isDir && IsBelowRecursiveRoot(dir))
+    Post(dir + entry, true);
+}
+
+void DirectoryIndex::EntryRemoved(const wxFileName &path)
+{
+  wxString dir = Key(path.GetPath(wxPATH_GET_VOLUME));
+  std::map<wxString, wxArrayString>::iterator it = m_listings.find(dir);
+  if (it != m_listings.end())
+  {
+    wxArrayString &entries = it->second;
+    wxString name = path.GetFullName();
+    int index;
+    if ((index = entries.Index(name)) != wxNOT_FOUND)
+      entries.RemoveAt(index);
+    if ((index = entries.Index(name + wxT("/"))) != wxNOT_FOUND)
+      entries.RemoveAt(index);
+  }
+
+  // If it was a directory everything we know about its contents is obsolete.
+  wxString key = dir + path.GetFullName() + wxT("/");
+  Forget(key);
+  EraseBelow(m_requested, key);
+  m_generation++;
+}
+
+#if wxUSE_FSWATCHER
+void DirectoryIndex::OnFileSystemEvent(wxFileSystemWatcherEvent &event)
+{
+  int change = event.GetChangeType();
+  if (change & (wxFSW_EVENT_WARNING | wxFSW_EVENT_ERROR))
+  {
+    // We might have missed changes => Read everything anew.
+    wxLogMessage(_("Directory index: Lost track of file system changes. Re-reading all directories."));
+    for (std::set<wxString>::const_iterator it = m_requested.begin();
+         it != m_requested.end(); ++it)
+    {
+      bool recursive = (m_recursiveRoots.find(*it) != m_recursiveRoots.end());
+      if (recursive || !IsBelowRecursiveRoot(*it))
+        Post(*it, recursive);
+    }
+    return;
+  }
+
+  if (change & (wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME))
+    EntryRemoved(event.GetPath());
+  if (change & wxFSW_EVENT_CREATE)
+    EntryAdded(event.GetPath());
+  if (change & wxFSW_EVENT_RENAME)
+    EntryAdded(event.GetNewPath());
+}
+#endif
+
+wxThread::ExitCode DirectoryIndex::Worker::Entry()
+{
+  DirectoryIndex::Job *job;
+  while (m_index->m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR)
+  {
+    if (job->m_quit)
+    {
+      delete job;
+      break;
+    }
+    m_index->Process(*job);
+    delete job;
+  }
+  return static_cast<ExitCode>(0);
+}
@@ -0,0 +1,197 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef DIRECTORYINDEX_H
+#define DIRECTORYINDEX_H
+
+#include <wx/event.h>
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include <wx/arrstr.h>
+#include <wx/filename.h>
+#include <wx/fswatcher.h>
+#include <vector>
+#include <map>
+#include <set>
+
+/*!\file
+
+  This file declares the class DirectoryIndex.
+
+  DirectoryIndex keeps the contents of the directories autocompletion offers
+  file names from in memory.
+ */
+
+/*! Keeps the contents of directories in memory and up to date
+
+  Autocompleting the argument of load(), demo() or of a file name needs the
+  files in maxima's share directories and in the directory the worksheet lies in.
+  Instead of reading these directories on every keystroke this class crawls
+  them on a background thread and keeps a sorted listing of every directory.
+
+  Watching every directory of a big tree would need one watch - and on some
+  systems one file descriptor - per directory. Therefore only the directories
+  the user completes file names in (see GetListing()) and the directories that
+  are indexed non-recursively are kept up to date using a wxFileSystemWatcher.
+  Trees that are indexed recursively are crawled anew by Refresh() instead.
+
+  All methods are to be called from the GUI thread only.
+ */
+class DirectoryIndex : public wxEvtHandler
+{
+public:
+  //! Starts the thread that crawls the directories
+  DirectoryIndex();
+  //! Stops the crawler thread
+  ~DirectoryIndex();
+
+  //! The id of the wxThreadEvents the crawler thread informs us about its results with
+  static int DirectoryIndexed(){return wxID_HIGHEST + 4001;}
+
+  /*! Schedules a directory for being crawled in the background
+
+    \param dir The directory
+    \param recursive true means: Index all subdirectories, too.
+   */
+  void Index(const wxString &dir, bool recursive);
+
+  /*! Returns the sorted names of the files and subdirectories in a directory
+
+    The names of subdirectories end in a "/". If the directory isn't indexed, yet,
+    it is read immediately and its subdirectories are scheduled for being indexed
+    in the background.
+   */
+  const wxArrayString &GetListing(const wxString &dir);
+
+  //! Adds the names of all indexed files in dir and its subdirectories to files
+  void GetFilesBelow(const wxString &dir, wxArrayString &files) const;
+
+  /*! Crawls the trees that are indexed recursively anew if that hasn't been done for a while
+
+    The new contents are available once the crawler thread is done.
+   */
+  void Refresh();
+
+  //! Is increased every time the contents of the index change
+  long GetGeneration() const {return m_generation;}
+
+  //! The name of a directory in the form the index uses: absolute and ending in "/"
+  static wxString Key(const wxString &dir);
+
+private:
+  //! A directory that waits to be crawled
+  struct Job
+  {
+    //! The directory as returned by Key(). A copy only the crawler thread may access.
+    wxString m_dir;
+    bool m_recursive;
+    //! Tells the crawler thread to exit
+    bool m_quit;
+  };
+
+  //! The contents of one directory
+  struct Listing
+  {
+    wxString m_dir;
+    wxArrayString m_entries;
+  };
+
+  //! The directories a Job has found
+  struct Result
+  {
+    wxString m_dir;
+    bool m_recursive;
+    std::vector<Listing> m_listings;
+  };
+
+  //! The thread that crawls the directories
+  class Worker : public wxThread
+  {
+  public:
+    explicit Worker(DirectoryIndex *index) : wxThread(wxTHREAD_JOINABLE){m_index = index;}
+  protected:
+    virtual ExitCode Entry();
+  private:
+    DirectoryIndex *m_index;
+  };
+
+  /*! Reads the contents of a directory
+
+    Can be called from any thread.
+    \return false, if the directory cannot be read.
+   */
+  static bool List(const wxString &dir, wxArrayString &entries);
+  //! Crawls the directory a job names and hands the result to the GUI thread
+  void Process(const Job &job);
+  //! Hands a directory to the crawler thread
+  void Post(const wxString &key, bool recursive);
+  //! Is this directory inside a directory that is indexed recursively?
+  bool IsBelowRecursiveRoot(const wxString &key) const;
+  //! Replaces the listings below a crawled directory by what the crawler has found
+  void Store(const Result &result);
+  //! Forgets a directory and all its subdirectories
+  void Forget(const wxString &key);
+  //! Adds a file or directory that has been created to the listing of its directory
+  void EntryAdded(const wxFileName &path);
+  //! Removes a file or directory that has been deleted from the listing of its directory
+  void EntryRemoved(const wxFileName &path);
+  /*! Starts watching a directory for changes
+
+    Only to be used for single directories, not for all directories of a tree.
+   */
+  void Watch(const wxString &key);
+  //! Called when the crawler thread has finished a job
+  void OnDirectoryIndexed(wxThreadEvent &event);
+#if wxUSE_FSWATCHER
+  //! Called when a file in an indexed directory is created, deleted or renamed
+  void OnFileSystemEvent(wxFileSystemWatcherEvent &event);
+  //! Watches all indexed directories
+  wxFileSystemWatcher *m_watcher;
+#endif
+  //! The directories that are watched
+  std::set<wxString> m_watched;
+
+  //! The sorted contents of every indexed directory
+  std::map<wxString, wxArrayString> m_listings;
+  //! The directories that are indexed including their subdirectories
+  std::set<wxString> m_recursiveRoots;
+  //! When each of m_recursiveRoots has last been handed to the crawler [s since the epoch]
+  std::map<wxString, long> m_crawled;
+  //! The number of seconds after which Refresh() crawls a tree anew
+  static const long m_refreshInterval = 60;
+  //! The directories that are indexed or are scheduled for being indexed
+  std::set<wxString> m_requested;
+  long m_generation;
+
+  //! The directories that wait to be crawled. They are deleted by the crawler thread.
+  wxMessageQueue<Job *> m_jobs;
+  //! The thread that crawls the directories. NULL, if it could not be started.
+  Worker *m_worker;
+  //! Protects m_results and m_quitting
+  wxMutex m_mutex;
+  //! The results the GUI thread hasn't picked up, yet
+  std::vector<Result *> m_results;
+  //! Tells the crawler thread to abandon the directory it crawls
+  bool m_quitting;
+};
+
+#endif // DIRECTORYINDEX_H
@@ -85,7 +85,6 @@ Emfout::~Emfout()
       wxLogMessage(_("Cannot remove the file %s"),m_tempFileName);
   }
   *m_configuration = m_oldconfig;
-  (*m_configuration)->FontChanged(true);
   (*m_configuration)->RecalculationForce(true);
   m_configuration = NULL;
 }
@@ -35,6 +35,7 @@
 #include "MarkDown.h"
 #include "wxMaximaFrame.h"
 #include <wx/tokenzr.h>
+#include <algorithm>
 
 #define ESC_CHAR wxT('\xA6')
 
@@ -42,6 +43,7 @@ EditorCell::EditorCell(Cell *parent, Configuration **config,
                        CellPointers *cellPointers, wxString text) : Cell(parent, config)
 {
   m_errorIndex = -1;
+  m_codeChunksChangeAsterisk = false;
   m_autoAnswer = false;
   m_cellPointers = cellPointers;
   m_numberOfLines = 1;
@@ -70,6 +72,8 @@ EditorCell::EditorCell(Cell *parent, Configuration **config,
   m_containsChangesCheck = false;
   m_firstLineOnly = false;
   m_historyPosition = -1;
+  m_indexed = true;
+  m_wordsIndexed = false;
   SetValue(TabExpand(text, 0));
   ResetSize();  
 }
@@ -185,6 +189,7 @@ void EditorCell::AddDrawParameter(wxString param)
   }
   m_text += textAfterParameter;
   StyleText();
+  XMLChanged();
   ResetSize();
   if (m_group != NULL)
     m_group->ResetSize();
@@ -387,6 +392,8 @@ wxString EditorCell::ToRTF()
 EditorCell::~EditorCell()
 {
   MarkAsDeleted();
+  ClearCodeChunks();
+  ClearOwnTokens();
 }
 
 void EditorCell::MarkAsDeleted()
@@ -402,10 +409,66 @@ void EditorCell::MarkAsDeleted()
   }
   if (m_cellPointers->m_activeCell == this)
     m_cellPointers->m_activeCell = NULL;
+  SetIndexed(false);
 
   Cell::MarkAsDeleted();
 }
 
+void EditorCell::SetIndexed(bool indexed)
+{
+  m_indexed = indexed;
+  if (indexed)
+    AddWordsToIndex();
+  else
+    RemoveWordsFromIndex();
+  UpdateSearchIndex();
+}
+
+void EditorCell::AddWordsToIndex()
+{
+  if (m_wordsIndexed || !m_indexed || (m_type != MC_TYPE_INPUT))
+    return;
+
+  // Only the input of code cells is searched for words: Not the cells maxima's
+  // questions are answered in.
+  GroupCell *group = dynamic_cast<GroupCell *>(m_group);
+  if ((group == NULL) || (group->GetGroupType() != GC_TYPE_CODE) ||
+      (group->GetEditable() != this))
+    return;
+
+  m_cellPointers->m_worksheetWords.Add(m_wordList);
+  m_wordsIndexed = true;
+}
+
+void EditorCell::RemoveWordsFromIndex()
+{
+  if (!m_wordsIndexed)
+    return;
+  m_cellPointers->m_worksheetWords.Remove(m_wordList);
+  m_wordsIndexed = false;
+}
+
+void EditorCell::UpdateSearchIndex()
+{
+  // The find dialog only searches the editable part of each GroupCell.
+  if (m_indexed)
+  {
+    GroupCell *group = dynamic_cast<GroupCell *>(m_group);
+    if ((group != NULL) && (group->GetEditable() == this))
+    {
+      m_cellPointers->m_searchIndex.Update(this, m_text);
+      return;
+    }
+  }
+  m_cellPointers->m_searchIndex.Remove(this);
+}
+
+bool EditorCell::ContainsIndexedWord(const wxString &word) const
+{
+  return m_wordsIndexed &&
+    std::binary_search(m_wordList.begin(), m_wordList.end(), word);
+}
+
 std::list<Cell *> EditorCell::GetInnerCells()
 {
   std::list<Cell *> innerCells;
@@ -1008,35 +1071,12 @@ void EditorCell::SetFont()
   m_underlined = configuration->IsUnderlined(m_textStyle);
   m_fontEncoding = configuration->GetFontEncoding();
 
-  wxFont font;
-  font.SetFamily(wxFONTFAMILY_MODERN);
-  font.SetFaceName(m_fontName);
-  font.SetEncoding(m_fontEncoding);
-  font.SetStyle(m_fontStyle);
-  font.SetWeight(m_fontWeight);
-  font.SetUnderlined(m_underlined);
-  font.SetEncoding(m_fontEncoding);
-  if (!font.IsOk())
-  {
-    wxLogMessage(_("EditorCell Ignoring the font name as the selected font didn't work"));
-    font.SetFamily(wxFONTFAMILY_MODERN);
-    font.SetEncoding(m_fontEncoding);
-    font.SetStyle(m_fontStyle);
-    font.SetWeight(m_fontWeight);
-    font.SetUnderlined(m_underlined);
-  }
-
-  if (!font.IsOk())
-    font = *wxNORMAL_FONT;
-
   wxASSERT(m_fontSize >= 0);
   if(m_fontSize < 4)
     m_fontSize = 4;
-#if wxCHECK_VERSION(3, 1, 2)
-  font.SetFractionalPointSize(m_fontSize);
-#else
-  font.SetPointSize(m_fontSize);
-#endif
+
+  wxFont font = configuration->GetFont(m_fontName, m_fontStyle, m_fontWeight, m_underlined,
+                                       m_fontEncoding, m_fontSize);
   wxASSERT_MSG(font.IsOk(),
                _("Seems like something is broken with a font. Installing http://www.math.union.edu/~dpvc/jsmath/download/jsMath-fonts.html and checking \"Use JSmath fonts\" in the configuration dialogue should fix it."));
   dc->SetFont(font);
@@ -1283,7 +1323,10 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
     FindMatchingParens();
 
   if (m_isDirty)
+  {
     ResetSize();
+    XMLChanged();
+  }
   m_displayCaret = true;
 }
 
@@ -2689,6 +2732,7 @@ bool EditorCell::AddEnding()
     m_text += wxT(";");
     m_paren1 = m_paren2 = m_width = -1;
     StyleText();
+    XMLChanged();
     return true;
   }
   return false;
@@ -3178,6 +3222,7 @@ bool EditorCell::CutToClipboard()
   m_text = m_text.SubString(0, start - 1) +
            m_text.SubString(end, m_text.Length());
   StyleText();
+  XMLChanged();
 
   ClearSelection();
   m_paren1 = m_paren2 = -1;
@@ -3311,6 +3356,7 @@ void EditorCell::Undo()
   // We cannot use SetValue() here, since SetValue() tends to move the cursor.
   m_text = m_textHistory.Item(m_historyPosition);
   StyleText();
+  XMLChanged();
 
   m_positionOfCaret = m_positionHistory[m_historyPosition];
   SetSelection(m_startHistory[m_historyPosition], m_endHistory[m_historyPosition]);
@@ -3341,6 +3387,7 @@ void EditorCell::Redo()
   // We cannot use SetValue() here, since SetValue() tends to move the cursor.
   m_text = m_textHistory.Item(m_historyPosition);
   StyleText();
+  XMLChanged();
 
   m_positionOfCaret = m_positionHistory[m_historyPosition];
   SetSelection(m_startHistory[m_historyPosition], m_endHistory[m_historyPosition]);
@@ -3438,6 +3485,8 @@ void EditorCell::StyleTextCode()
   int indentationPixels = 0;
   wxString textToStyle = m_text;
   SetFont();
+  ClearOwnTokens();
+  m_tokens.clear();
   
   // Handle folding of EditorCells
   if (m_firstLineOnly)
@@ -3455,8 +3504,18 @@ void EditorCell::StyleTextCode()
     }
   }
 
+  // If the text isn't folded and doesn't get soft line breaks we only need to
+  // style the lines that have changed.
+  if ((!m_firstLineOnly) && (!(*m_configuration)->GetAutoWrapCode()) &&
+      (!(*m_configuration)->InLispMode()))
+  {
+    StyleTextCodeIncrementally();
+    return;
+  }
+
   // Split the line into commands, numbers etc.
-  m_tokens = MaximaTokenizer(textToStyle, *m_configuration).GetTokens();
+  m_ownTokens = MaximaTokenizer(textToStyle, *m_configuration).GetTokens();
+  m_tokens = m_ownTokens;
 
   // Now handle the text pieces one by one
   wxString lastTokenWithText;
@@ -3498,23 +3557,7 @@ void EditorCell::StyleTextCode()
       continue;
     }
     
-    // Most of the other item types can contain Newlines - that we want as separate tokens
-    wxString txt = tokenString;
-    wxString line;      
-    for (wxString::iterator it2 = txt.begin(); it2 < txt.end(); ++it2)
-    {
-      if(*it2 != '\n')
-        line +=wxString(*it2);
-      else
-      {
-        if(line != wxEmptyString)
-          m_styledText.push_back(StyledText(token.GetStyle(), line));
-        m_styledText.push_back(StyledText(token.GetStyle(), "\n"));
-        line = wxEmptyString;
-      }
-    }
-    if(line != wxEmptyString)
-      m_styledText.push_back(StyledText(token.GetStyle(), line));
+    AppendStyledToken(token, m_styledText);
     HandleSoftLineBreaks_Code(lastSpace, lineWidth, token, pos, m_text, lastSpacePos,
                               indentationPixels);
     if ((token.GetStyle() == TS_CODE_VARIABLE) || (token.GetStyle() == TS_CODE_FUNCTION))
@@ -3526,6 +3569,243 @@ void EditorCell::StyleTextCode()
   m_wordList.Sort();
 }
 
+void EditorCell::AppendStyledToken(MaximaTokenizer::Token &token, std::vector<StyledText> &styledText)
+{
+  // Most of the item types can contain Newlines - that we want as separate tokens
+  wxString txt = token.GetText();
+  wxString line;
+  for (wxString::iterator it = txt.begin(); it < txt.end(); ++it)
+  {
+    if(*it != '\n')
+      line +=wxString(*it);
+    else
+    {
+      if(line != wxEmptyString)
+        styledText.push_back(StyledText(token.GetStyle(), line));
+      styledText.push_back(StyledText(token.GetStyle(), "\n"));
+      line = wxEmptyString;
+    }
+  }
+  if(line != wxEmptyString)
+    styledText.push_back(StyledText(token.GetStyle(), line));
+}
+
+EditorCell::CodeChunk::CodeChunk(const wxString &text)
+{
+  m_text = text;
+  m_lookaheadToken = NULL;
+  m_lookaheadStyledText = 0;
+  m_styled = false;
+}
+
+EditorCell::CodeChunk::~CodeChunk()
+{
+  for(MaximaTokenizer::TokenList::iterator it = m_tokens.begin(); it != m_tokens.end(); ++it)
+    delete *it;
+}
+
+void EditorCell::CodeChunk::Style(Configuration *configuration)
+{
+  if(m_styled)
+    return;
+  m_styled = true;
+
+  m_tokens = MaximaTokenizer(m_text, configuration).GetTokens();
+
+  // The tokenizer couldn't look beyond the end of this chunk in order to decide if
+  // the last name in it is followed by a "(".
+  for(MaximaTokenizer::TokenList::reverse_iterator it = m_tokens.rbegin(); it != m_tokens.rend(); ++it)
+  {
+    wxString text = (*it)->GetText();
+    text.Trim(true);
+    if(text.IsEmpty())
+      continue;
+    if((*it)->GetStyle() == TS_CODE_VARIABLE)
+      m_lookaheadToken = *it;
+    break;
+  }
+
+  for(MaximaTokenizer::TokenList::iterator it = m_tokens.begin(); it != m_tokens.end(); ++it)
+  {
+    MaximaTokenizer::Token &token = *(*it);
+    wxString tokenString = token.GetText();
+    if (tokenString.IsEmpty())
+      continue;
+
+    // All spaces except the last one share the same piece of styled text
+    if (tokenString[0] == wxT(' '))
+    {
+      if (tokenString.Length() > 1)
+        m_styledText.push_back(StyledText(tokenString.Right(tokenString.Length()-1)));
+      m_styledText.push_back(StyledText(wxT(" ")));
+      continue;
+    }
+
+    if (*it == m_lookaheadToken)
+      m_lookaheadStyledText = m_styledText.size();
+    AppendStyledToken(token, m_styledText);
+    if ((token.GetStyle() == TS_CODE_VARIABLE) || (token.GetStyle() == TS_CODE_FUNCTION))
+      m_words.Add(tokenString);
+  }
+}
+
+void EditorCell::ClearCodeChunks()
+{
+  for(std::vector<CodeChunk *>::iterator it = m_codeChunks.begin(); it != m_codeChunks.end(); ++it)
+    delete *it;
+  m_codeChunks.clear();
+}
+
+void EditorCell::ClearOwnTokens()
+{
+  for(MaximaTokenizer::TokenList::iterator it = m_ownTokens.begin(); it != m_ownTokens.end(); ++it)
+    delete *it;
+  m_ownTokens.clear();
+}
+
+void EditorCell::UpdateCodeChunks()
+{
+  Configuration *configuration = (*m_configuration);
+  if(m_codeChunksChangeAsterisk != configuration->GetChangeAsterisk())
+  {
+    ClearCodeChunks();
+    m_codeChunksChangeAsterisk = configuration->GetChangeAsterisk();
+  }
+
+  // The chunks at the beginning of the text that haven't changed
+  size_t first = 0;
+  size_t start = 0;
+  while (first < m_codeChunks.size())
+  {
+    const wxString &chunkText = m_codeChunks[first]->m_text;
+    if (m_text.compare(start, chunkText.Length(), chunkText) != 0)
+      break;
+    // A chunk that didn't end in a newline has to be followed by the end of the text.
+    if ((!chunkText.EndsWith(wxT("\n"))) && (start + chunkText.Length() != m_text.Length()))
+      break;
+    start += chunkText.Length();
+    first++;
+  }
+
+  // The chunks at the end of the text that haven't changed
+  size_t last = m_codeChunks.size();
+  size_t end = m_text.Length();
+  while (last > first)
+  {
+    const wxString &chunkText = m_codeChunks[last - 1]->m_text;
+    if ((end < start + chunkText.Length()) ||
+        (m_text.compare(end - chunkText.Length(), chunkText.Length(), chunkText) != 0))
+      break;
+    // A chunk has to start at the beginning of a line.
+    if ((end - chunkText.Length() > 0) && (m_text[end - chunkText.Length() - 1] != wxT('\n')))
+      break;
+    end -= chunkText.Length();
+    last--;
+  }
+
+  // Split the text in between into chunks. If the last line of it is part of
+  // a comment, a string or lisp code that extends into the chunks that follow
+  // we need to split these chunks anew, too.
+  std::vector<CodeChunk *> newChunks;
+  size_t pos = start;
+  while (pos < end)
+  {
+    MaximaTokenizer::TokenList tokens =
+      MaximaTokenizer(m_text.SubString(pos, end - 1), configuration).GetTokens();
+    size_t chunkStart = pos;
+    std::vector<size_t> chunkEnds;
+    for(MaximaTokenizer::TokenList::iterator it = tokens.begin(); it != tokens.end(); ++it)
+    {
+      pos += (*it)->GetText().Length();
+      // A newline that isn't part of a longer token ends a chunk.
+      if((*it)->GetText() == wxT("\n"))
+        chunkEnds.push_back(pos);
+      delete *it;
+    }
+
+    // If the tokens don't add up to the text we cannot tell where the lines
+    // start => style everything that follows as one big chunk.
+    if (pos != end)
+    {
+      chunkEnds.clear();
+      end = m_text.Length();
+      last = m_codeChunks.size();
+    }
+    for (std::vector<size_t>::iterator it = chunkEnds.begin(); it != chunkEnds.end(); ++it)
+    {
+      newChunks.push_back(new CodeChunk(m_text.SubString(chunkStart, *it - 1)));
+      chunkStart = *it;
+    }
+
+    pos = chunkStart;
+    if (pos >= end)
+      break;
+    if (last >= m_codeChunks.size())
+    {
+      newChunks.push_back(new CodeChunk(m_text.SubString(pos, end - 1)));
+      break;
+    }
+    end += m_codeChunks[last]->m_text.Length();
+    last++;
+  }
+
+  for (size_t i = first; i < last; i++)
+    delete m_codeChunks[i];
+  m_codeChunks.erase(m_codeChunks.begin() + first, m_codeChunks.begin() + last);
+  m_codeChunks.insert(m_codeChunks.begin() + first, newChunks.begin(), newChunks.end());
+}
+
+void EditorCell::StyleTextCodeIncrementally()
+{
+  UpdateCodeChunks();
+
+  size_t chunkEnd = 0;
+  for(std::vector<CodeChunk *>::iterator it = m_codeChunks.begin(); it != m_codeChunks.end(); ++it)
+  {
+    CodeChunk *chunk = *it;
+    chunk->Style(*m_configuration);
+    chunkEnd += chunk->m_text.Length();
+
+    // Is the last name of this chunk a function name?
+    bool lookaheadIsFunction = false;
+    if (chunk->m_lookaheadToken != NULL)
+    {
+      size_t next = chunkEnd;
+      while ((next < m_text.Length()) &&
+             ((m_text[next] == ' ') || (m_text[next] == '\t') ||
+              (m_text[next] == '\n') || (m_text[next] == '\r')))
+        next++;
+      lookaheadIsFunction = (next < m_text.Length()) && (m_text[next] == '(');
+    }
+
+    for(MaximaTokenizer::TokenList::iterator tok = chunk->m_tokens.begin();
+        tok != chunk->m_tokens.end(); ++tok)
+    {
+      if (lookaheadIsFunction && (*tok == chunk->m_lookaheadToken))
+      {
+        MaximaTokenizer::Token *function =
+          new MaximaTokenizer::Token((*tok)->GetText(), TS_CODE_FUNCTION);
+        m_ownTokens.push_back(function);
+        m_tokens.push_back(function);
+      }
+      else
+        m_tokens.push_back(*tok);
+    }
+
+    for (size_t i = 0; i < chunk->m_styledText.size(); i++)
+    {
+      if (lookaheadIsFunction && (i == chunk->m_lookaheadStyledText))
+        m_styledText.push_back(StyledText(TS_CODE_FUNCTION, chunk->m_styledText[i].GetText()));
+      else
+        m_styledText.push_back(chunk->m_styledText[i]);
+    }
+
+    for (size_t i = 0; i < chunk->m_words.GetCount(); i++)
+      m_wordList.Add(chunk->m_words[i]);
+  }
+  m_wordList.Sort();
+}
+
 void EditorCell::StyleTextTexts()
 {
   Configuration *configuration = (*m_configuration);
@@ -3831,9 +4111,10 @@ void EditorCell::StyleText()
   // the font type and size.
   SetFont();
 
-
+  RemoveWordsFromIndex();
   m_wordList.Clear();
   m_styledText.clear();
+  UpdateSearchIndex();
 
   if(m_text == wxEmptyString)
     return;
@@ -3846,6 +4127,8 @@ void EditorCell::StyleText()
     StyleTextCode();
   else
     StyleTextTexts();
+
+  AddWordsToIndex();
 }
 
 
@@ -3915,6 +4198,7 @@ void EditorCell::SetValue(const wxString &text)
 
   // Style the text.
   StyleText();
+  XMLChanged();
   if (m_group != NULL)
     m_group->ResetSize();
   ResetData();
@@ -3973,6 +4257,7 @@ int EditorCell::ReplaceAll(wxString oldString, wxString newString, bool IgnoreCa
     m_containsChanges = true;
     ClearSelection();
     StyleText();
+    XMLChanged();
   }
 
   // If text is selected setting the selection again updates m_selectionString
@@ -4058,6 +4343,7 @@ bool EditorCell::ReplaceSelection(wxString oldStr, wxString newStr, bool keepSel
              newStr +
              text_right;
     StyleText();
+    XMLChanged();
 
     m_containsChanges = true;
     m_positionOfCaret = start + newStr.Length();
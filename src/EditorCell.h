@@ -71,6 +71,16 @@ private:
 
   //! A list of all potential autoComplete targets within this cell
   wxArrayString m_wordList;
+  //! Is this cell part of the worksheet's word and search indices?
+  bool m_indexed;
+  //! Are the words in m_wordList currently counted in the worksheet's word index?
+  bool m_wordsIndexed;
+  //! Adds m_wordList to the worksheet's word index, if this is the input of a code cell
+  void AddWordsToIndex();
+  //! Removes m_wordList from the worksheet's word index, if it was added to it
+  void RemoveWordsFromIndex();
+  //! Hands our text to the worksheet's search index, if this is the editable part of a GroupCell
+  void UpdateSearchIndex();
 
   //! Draw a box that marks the current selection
   void MarkSelection(long start, long end, TextStyle style, int fontsize);
@@ -182,9 +192,19 @@ public:
   { m_cellPointers->m_selectionString = string; }
 
   //! A list of words that might be applicable to the autocomplete function.
-  wxArrayString GetWordList()
+  const wxArrayString &GetWordList() const
   { return m_wordList; }
 
+  /*! Shall the words of this cell be offered by autocompletion and its text be searchable?
+
+    Cells that are deleted (and might be kept in the undo buffer) don't offer their
+    words; Cells that are inserted into the worksheet do.
+   */
+  void SetIndexed(bool indexed);
+
+  //! Is word one of the words this cell has added to the worksheet's word index?
+  bool ContainsIndexedWord(const wxString &word) const;
+
   //! Has the selection changed since the last draw event?
   bool m_selectionChanged;
 
@@ -671,6 +691,58 @@ private:
 
   std::vector<StyledText> m_styledText;
 
+  /*! A piece of code that ends in a newline that isn't part of a comment, a string or lisp code
+
+    Tokenizing such a chunk doesn't depend on the text that precedes or follows it:
+    Only the decision if the last name in the chunk is the name of a function
+    requires to know if the next chunk begins with a "(". This allows
+    StyleTextCode() to tokenize and style only the chunks that have changed.
+   */
+  class CodeChunk
+  {
+  public:
+    explicit CodeChunk(const wxString &text);
+    ~CodeChunk();
+    //! Splits the chunk into tokens and styled text, if that hasn't been done, yet.
+    void Style(Configuration *configuration);
+    //! The text of this chunk. Ends in a newline if it isn't the last chunk of the cell.
+    wxString m_text;
+    //! The tokens this chunk consists of. Owned by this chunk.
+    MaximaTokenizer::TokenList m_tokens;
+    //! The styled text this chunk consists of
+    std::vector<StyledText> m_styledText;
+    //! The variable and function names this chunk contains
+    wxArrayString m_words;
+    /*! The last name in this chunk, if it is styled as a variable
+
+      If the next chunk begins with a "(" it is a function name, instead.
+      NULL, if the chunk doesn't end in a variable name.
+     */
+    MaximaTokenizer::Token *m_lookaheadToken;
+    //! The index of the styled text of m_lookaheadToken
+    size_t m_lookaheadStyledText;
+    //! Has Style() been called?
+    bool m_styled;
+  };
+
+  //! The chunks this code cell consisted of the last time it was styled
+  std::vector<CodeChunk *> m_codeChunks;
+  //! Did the configuration replace "*" by a centered dot when m_codeChunks were tokenized?
+  bool m_codeChunksChangeAsterisk;
+  //! Forget all code chunks
+  void ClearCodeChunks();
+  /*! Splits m_text into code chunks reusing the chunks from the last call
+
+    Only the chunks between the first and the last line that has changed are split
+    anew - plus the chunks a comment, a string or lisp code that now begins in
+    the changed lines extends to.
+   */
+  void UpdateCodeChunks();
+  //! Styles a code cell reusing the styled text of all chunks that haven't changed
+  void StyleTextCodeIncrementally();
+  //! Appends a token that isn't whitespace to a list of styled text
+  static void AppendStyledToken(MaximaTokenizer::Token &token, std::vector<StyledText> &styledText);
+
   /*! Adds soft line breaks to code cells, if needed.
 
     \todo: We could do an incremental indentation calculation that starts at the last word: 
@@ -731,6 +803,10 @@ private:
   bool m_firstLineOnly;
   //! The individual commands, parenthesis, strings and whitespaces a code cell consists of
   MaximaTokenizer::TokenList m_tokens;
+  //! The tokens in m_tokens that don't belong to a code chunk
+  MaximaTokenizer::TokenList m_ownTokens;
+  //! Delete the tokens in m_ownTokens
+  void ClearOwnTokens();
 };
 
 #endif // EDITORCELL_H
@@ -50,6 +50,14 @@ public:
   void SetFindString(wxString string)
   { m_contents->SetFindString(string); }
 
+  //! Displays which match the worksheet has selected and how many matches there are
+  void SetMatchCount(long match, long matches)
+  { m_contents->SetMatchCount(match, matches); }
+
+  //! Stops displaying the number of matches
+  void ClearMatchCount()
+  { m_contents->ClearMatchCount(); }
+
 protected:
   //! Is called if this element looses or gets the focus
   void OnActivate(wxActivateEvent &WXUNUSED(event));
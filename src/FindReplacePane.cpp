@@ -120,6 +120,9 @@ FindReplacePane::FindReplacePane(wxWindow *parent, wxFindReplaceData *data) :
           NULL, this
   );
 
+  m_matchCount = new wxStaticText(this, -1, wxEmptyString);
+  grid_sizer->Add(m_matchCount, wxSizerFlags().Center().Border(wxALL, 5));
+
   // If I press <tab> in the search text box I want to arrive in the
   // replacement text box immediately.
   m_replaceText->MoveAfterInTabOrder(m_searchText);
@@ -132,6 +135,21 @@ void FindReplacePane::SetFindString(wxString string)
   m_searchText->SetValue(string);
 }
 
+void FindReplacePane::SetMatchCount(long match, long matches)
+{
+  if (matches == 0)
+    m_matchCount->SetLabel(_("No matches"));
+  else
+    m_matchCount->SetLabel(wxString::Format(_("%li of %li"), match, matches));
+  Layout();
+}
+
+void FindReplacePane::ClearMatchCount()
+{
+  m_matchCount->SetLabel(wxEmptyString);
+  Layout();
+}
+
 void FindReplacePane::OnSearch(wxCommandEvent &WXUNUSED(event))
 {
   wxFindDialogEvent *findEvent = new wxFindDialogEvent(wxEVT_FIND_NEXT);
@@ -171,6 +189,7 @@ void FindReplacePane::OnMatchCase(wxCommandEvent &event)
   m_findReplaceData->SetFlags(
           (m_findReplaceData->GetFlags() & (~wxFR_MATCHCASE)) | (event.IsChecked() * wxFR_MATCHCASE));
   wxConfig::Get()->Write(wxT("findFlags"), m_findReplaceData->GetFlags());  
+  ClearMatchCount();
 }
 
 void FindReplacePane::OnActivate(wxActivateEvent &event)
@@ -185,6 +204,7 @@ void FindReplacePane::OnActivate(wxActivateEvent &event)
 void FindReplacePane::OnFindStringChange(wxCommandEvent &WXUNUSED(event))
 {
   m_findReplaceData->SetFindString(m_searchText->GetValue());
+  ClearMatchCount();
 }
 
 void FindReplacePane::OnReplaceStringChange(wxCommandEvent &WXUNUSED(event))
@@ -36,6 +36,7 @@
 #include <wx/radiobut.h>
 #include <wx/checkbox.h>
 #include <wx/textctrl.h>
+#include <wx/stattext.h>
 
 /*! The find+replace pane
  */
@@ -54,6 +55,8 @@ private:
   wxRadioButton *m_forward;
   wxRadioButton *m_backwards;
   wxCheckBox *m_matchCase;
+  //! Tells which of the matches is selected and how many matches there are
+  wxStaticText *m_matchCount;
 
 public:
   FindReplacePane(wxWindow *parent, wxFindReplaceData *data);
@@ -66,6 +69,16 @@ public:
   wxFindReplaceData *GetData()
   { return m_findReplaceData; }
 
+  /*! Displays which match the worksheet has selected
+
+    \param match The number of the selected match, starting at 1
+    \param matches The number of matches. 0 means: The search string wasn't found.
+   */
+  void SetMatchCount(long match, long matches);
+
+  //! Stops displaying the number of matches, for example when the search string has changed
+  void ClearMatchCount();
+
 protected:
   void OnActivate(wxActivateEvent &event);
 
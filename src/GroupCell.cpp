@@ -37,6 +37,7 @@
 #include "TextCell.h"
 #include "EditorCell.h"
 #include "ImgCell.h"
+#include "ImageStore.h"
 #include "BitmapOut.h"
 #include "list"
 
@@ -69,6 +70,10 @@ GroupCell::GroupCell(Configuration **config, GroupType groupType, CellPointers *
   m_groupType = groupType;
   m_lastInOutput = NULL;
   m_appendedCells = NULL;
+  m_sizeIsEstimated = false;
+  m_xmlChanged = true;
+  m_xmlValidated = false;
+  m_xmlFirstImage = m_xmlImages = 0;
 
   // set up cell depending on groupType, so we have a working cell
   if (groupType != GC_TYPE_PAGEBREAK)
@@ -240,6 +245,7 @@ void GroupCell::SetCellStyle(int style)
   }
   if(GetEditable() != NULL)
     GetEditable()->StyleText();
+  XMLChanged();
 }
 
 /*! Set the parent of this group cell
@@ -446,12 +452,32 @@ void GroupCell::MarkAsDeleted()
     m_cellPointers->m_workingGroup = NULL;
   if (this == m_cellPointers->m_lastWorkingGroup)
     m_cellPointers->m_lastWorkingGroup = NULL;
+  if (this == m_cellPointers->m_workingGroupBeforePrompt)
+    m_cellPointers->m_workingGroupBeforePrompt = NULL;
+  if (this == m_cellPointers->m_workingGroupAfterPrompt)
+    m_cellPointers->m_workingGroupAfterPrompt = NULL;
   if (this == m_cellPointers->m_groupCellUnderPointer)
     m_cellPointers->m_groupCellUnderPointer = NULL;
+  m_cellPointers->m_groupCellIndex.Forget(this);
+  SetIndexed(false);
 
   Cell::MarkAsDeleted();
 }
 
+void GroupCell::SetIndexed(bool indexed)
+{
+  EditorCell *editor = GetEditable();
+  if (editor != NULL)
+    editor->SetIndexed(indexed);
+
+  GroupCell *hidden = m_hiddenTree;
+  while (hidden != NULL)
+  {
+    hidden->SetIndexed(indexed);
+    hidden = dynamic_cast<GroupCell *>(hidden->m_next);
+  }
+}
+
 std::list<Cell *> GroupCell::GetInnerCells()
 {
   std::list<Cell *> innerCells;
@@ -479,6 +505,7 @@ void GroupCell::SetInput(Cell *input)
   wxDELETE(m_inputLabel);
   m_inputLabel = input;
   m_inputLabel->SetGroup(this);
+  XMLChanged();
 }
 
 void GroupCell::AppendInput(Cell *cell)
@@ -503,6 +530,7 @@ void GroupCell::AppendInput(Cell *cell)
       m_hide = false;
     }
   }
+  XMLChanged();
 }
 
 
@@ -527,6 +555,7 @@ void GroupCell::SetOutput(Cell *output)
   }
   UpdateCellsInGroup();
   Recalculate();
+  XMLChanged();
 }
 
 void GroupCell::RemoveOutput()
@@ -554,10 +583,15 @@ void GroupCell::RemoveOutput()
   m_hide = false;
 
   // Move all cells that follow the current one up by the amount this cell has shrinked.
-  GroupCell *cell = dynamic_cast<GroupCell *>(this->m_next);
-  while(cell != NULL)
-    cell = cell->UpdateYPosition();
+  // If the cells are indexed they will ask the index for their new position instead.
+  if(!m_cellPointers->m_groupCellIndex.IsValid())
+  {
+    GroupCell *cell = dynamic_cast<GroupCell *>(this->m_next);
+    while(cell != NULL)
+      cell = cell->UpdateYPosition();
+  }
   UpdateCellsInGroup();
+  XMLChanged();
 }
 
 void GroupCell::AppendOutput(Cell *cell)
@@ -598,6 +632,7 @@ void GroupCell::AppendOutput(Cell *cell)
     m_appendedCells = cell;
 
   UpdateCellsInGroup();
+  XMLChanged();
 }
 
 void GroupCell::Recalculate()
@@ -609,6 +644,55 @@ void GroupCell::Recalculate()
 
   RecalculateWidths(fontsize);
   RecalculateHeight(fontsize);
+  m_sizeIsEstimated = false;
+}
+
+void GroupCell::EstimateSize()
+{
+  Configuration *configuration = (*m_configuration);
+
+  // If the cell is measured only after the next recalculation has ended it
+  // cannot tell anymore that the font or the style have changed in between
+  // => forget the sizes of its contents now.
+  if(configuration->RecalculationForce() || configuration->FontChanged())
+  {
+    if(m_inputLabel != NULL)
+      m_inputLabel->ResetSizeListRecursive();
+    if(m_output != NULL)
+      m_output->ResetSizeListRecursive();
+  }
+
+  if((m_width < 0) || (m_height < 0) || (m_center < 0))
+  {
+    int lineHeight = Scale_Px(1.5 * configuration->GetDefaultFontSize());
+    int lines = 0;
+    if ((configuration->ShowCodeCells()) ||
+        (m_groupType != GC_TYPE_CODE))
+    {
+      lines = 1;
+      if(GetEditable() != NULL)
+        lines += GetEditable()->GetValue().Freq(wxT('\n'));
+    }
+    if((m_output != NULL) && !m_hide)
+    {
+      Cell *tmp = m_output;
+      while (tmp != NULL)
+      {
+        if(tmp->BreakLineHere())
+          lines++;
+        tmp = tmp->m_next;
+      }
+    }
+    if (m_groupType == GC_TYPE_PAGEBREAK)
+      lines = 0;
+    m_width = configuration->GetCellBracketWidth();
+    m_center = lineHeight / 2;
+    m_height = wxMax(lines * lineHeight, 2);
+    m_outputRect.SetHeight(0);
+  }
+  ResetData();
+  m_sizeIsEstimated = true;
+  UpdateYPosition();
 }
 
 void GroupCell::RecalculateWidths(int fontsize)
@@ -800,7 +884,7 @@ void GroupCell::RecalculateHeightOutput()
 
 bool GroupCell::NeedsRecalculation()
 {
-  return Cell::NeedsRecalculation() ||
+  return m_sizeIsEstimated || Cell::NeedsRecalculation() ||
     ((GetInput() != NULL) &&
      ((GetInput()->GetWidth() <= 0) || (GetInput()->GetHeight() <= 0) ||
       (GetInput()->GetCurrentPoint().x <= 0) || (GetInput()->GetCurrentPoint().y <= 0)
@@ -911,34 +995,49 @@ void GroupCell::RecalculateAppended()
   ResetData();
   
   // Move all cells that follow the current one down by the amount this cell has grown.
-  GroupCell *cell = this;
-  while(cell != NULL)
-    cell = cell->UpdateYPosition();
+  // If the cells are indexed they will ask the index for their new position instead.
+  GroupCell *cell = UpdateYPosition();
+  if(!m_cellPointers->m_groupCellIndex.IsValid())
+  {
+    while(cell != NULL)
+      cell = cell->UpdateYPosition();
+  }
   (*m_configuration)->AdjustWorksheetSize(true);
 }
 
 GroupCell *GroupCell::UpdateYPosition()
 {
   Configuration *configuration = (*m_configuration);
-  
-  if (m_previous == NULL)
-  {
-    m_currentPoint.x = configuration->GetIndent();
-    m_currentPoint.y = configuration->GetBaseIndent() + GetMaxCenter();
-  }
+
+  m_currentPoint.x = configuration->GetIndent();
+  // If the cell is indexed we don't depend on the previous cell's position being
+  // up to date.
+  if(m_cellPointers->m_groupCellIndex.Update(this))
+    m_currentPoint.y = m_cellPointers->m_groupCellIndex.GetYPosition(this);
   else
   {
-    m_currentPoint.x = configuration->GetIndent();
-    if(dynamic_cast<GroupCell *>(m_previous)->m_height > 0)
-      m_currentPoint.y = dynamic_cast<GroupCell *>(m_previous)->m_currentPoint.y +
-        dynamic_cast<GroupCell *>(m_previous)->GetMaxDrop() + GetMaxCenter() +
-        configuration->GetGroupSkip();
+    if (m_previous == NULL)
+      m_currentPoint.y = GetYOffset();
     else
-      m_currentPoint.y = dynamic_cast<GroupCell *>(m_previous)->m_currentPoint.y;
+      m_currentPoint.y = dynamic_cast<GroupCell *>(m_previous)->m_currentPoint.y + GetYOffset();
   }
   return dynamic_cast<GroupCell *>(m_next);
 }
 
+int GroupCell::GetYOffset()
+{
+  Configuration *configuration = (*m_configuration);
+
+  if (m_previous == NULL)
+    return configuration->GetBaseIndent() + GetMaxCenter();
+
+  GroupCell *previous = dynamic_cast<GroupCell *>(m_previous);
+  if(previous->m_height > 0)
+    return previous->GetMaxDrop() + GetMaxCenter() + configuration->GetGroupSkip();
+  else
+    return 0;
+}
+
 int GroupCell::GetInputIndent()
 {
   int labelWidth = 0;
@@ -1067,10 +1166,17 @@ void GroupCell::Draw(wxPoint point)
 
 wxRect GroupCell::GetRect(bool WXUNUSED(all))
 {
-  return wxRect(m_currentPoint.x, m_currentPoint.y - m_center,
+  return wxRect(m_currentPoint.x, GetCurrentY() - m_center,
                 m_width, m_height);
 }
 
+int GroupCell::GetCurrentY()
+{
+  if(m_cellPointers->m_groupCellIndex.Update(this))
+    m_currentPoint.y = m_cellPointers->m_groupCellIndex.GetYPosition(this);
+  return m_currentPoint.y;
+}
+
 int GroupCell::GetLineIndent(Cell *cell)
 {
   int indent = 0;
@@ -1430,7 +1536,7 @@ wxString GroupCell::ToRTF()
   return retval;
 }
 
-wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter, ImageStore *images)
 {
   wxASSERT_MSG((imgCounter != NULL), _("Bug: No image counter to write to!"));
   if (imgCounter == NULL) return wxEmptyString;
@@ -1452,7 +1558,13 @@ wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
         if (!wxDirExists(imgDir))
           wxMkdir(imgDir);
 
-        if (dynamic_cast<ImgCell *>(copy)->ToImageFile(file).x >= 0)
+        wxSize size;
+        if (images != NULL)
+          image = filename + wxT("_") + images->WriteImage(dynamic_cast<ImgCell *>(copy), size);
+        else
+          size = dynamic_cast<ImgCell *>(copy)->ToImageFile(file);
+
+        if (size.x >= 0)
         {
           str << wxT("\\begin{figure}[htb]\n")
               << wxT("  \\centering\n")
@@ -1467,7 +1579,7 @@ wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
       break;
 
     case GC_TYPE_CODE:
-      str = ToTeXCodeCell(imgDir, filename, imgCounter);
+      str = ToTeXCodeCell(imgDir, filename, imgCounter, images);
       str.Replace(wxT("\\[\\displaystyle \\]"),wxT(""));
       break;
 
@@ -1517,7 +1629,7 @@ wxString GroupCell::ToTeX(wxString imgDir, wxString filename, int *imgCounter)
   return str;
 }
 
-wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter, ImageStore *images)
 {
   wxString str;
   Configuration *configuration = (*m_configuration);
@@ -1560,7 +1672,7 @@ wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCo
       if (tmp->GetType() == MC_TYPE_IMAGE ||
           tmp->GetType() == MC_TYPE_SLIDE)
       {
-        str << ToTeXImage(tmp, imgDir, filename, imgCounter);
+        str << ToTeXImage(tmp, imgDir, filename, imgCounter, images);
       }
       else
       {
@@ -1615,7 +1727,8 @@ wxString GroupCell::ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCo
   return str;
 }
 
-wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter)
+wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter,
+                               ImageStore *images)
 {
   wxASSERT_MSG((imgCounter != NULL), _("Bug: No image counter to write to!"));
   if (imgCounter == NULL) return wxEmptyString;
@@ -1654,7 +1767,12 @@ wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, in
     else
     {
       wxString file = imgDir + wxT("/") + image + wxT(".") + dynamic_cast<ImgCell *>(copy)->GetExtension();
-      if (dynamic_cast<ImgCell *>(copy)->ToImageFile(file).x >= 0)
+      wxSize size;
+      if (images != NULL)
+        image = filename + wxT("_") + images->WriteImage(dynamic_cast<ImgCell *>(copy), size);
+      else
+        size = dynamic_cast<ImgCell *>(copy)->ToImageFile(file);
+      if (size.x >= 0)
         str += wxT("\\includegraphics[width=.95\\linewidth,height=.80\\textheight,keepaspectratio]{") +
                filename + wxT("_img/") + image + wxT("}");
       else
@@ -1665,6 +1783,44 @@ wxString GroupCell::ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, in
   return str;
 }
 
+wxString GroupCell::CachedXML()
+{
+  // The cache is only valid if it knows all the files its XML references.
+  if (!m_cellPointers->WXMXCollectingFiles())
+    return ToXML();
+
+  int firstImage = m_cellPointers->WXMXImageCount();
+  if ((!m_xmlChanged) && (firstImage == m_xmlFirstImage))
+  {
+    m_cellPointers->WXMXSkipFileNames(m_xmlImages);
+    for (CellPointers::WXMXFileList::iterator it = m_xmlFiles.begin(); it != m_xmlFiles.end(); ++it)
+      m_cellPointers->WXMXAddFile(it->m_name, it->m_image, it->m_type);
+    return m_xml;
+  }
+
+  // Let ToXML() collect the files this cell references into an empty list
+  CellPointers::WXMXFileList files;
+  files.swap(m_cellPointers->WXMXFiles());
+  m_xml = ToXML();
+  m_xmlFiles = m_cellPointers->WXMXFiles();
+  files.splice(files.end(), m_cellPointers->WXMXFiles());
+  files.swap(m_cellPointers->WXMXFiles());
+
+  m_xmlFirstImage = firstImage;
+  m_xmlImages = m_cellPointers->WXMXImageCount() - firstImage;
+  m_xmlChanged = false;
+  m_xmlValidated = false;
+  return m_xml;
+}
+
+void GroupCell::XMLChanged()
+{
+  m_xmlChanged = true;
+  // A folded-away cell is part of the XML of the cell it is folded into.
+  if (m_hiddenTreeParent != NULL)
+    m_hiddenTreeParent->XMLChanged();
+}
+
 wxString GroupCell::ToXML()
 {
   wxString str;
@@ -2175,6 +2331,7 @@ void GroupCell::Hide(bool hide)
 
   ResetSize();
   GetEditable()->ResetSize();
+  XMLChanged();
 }
 
 void GroupCell::SwitchHide()
@@ -2201,6 +2358,7 @@ bool GroupCell::HideTree(GroupCell *tree)
     tmp = dynamic_cast<GroupCell *>(tmp->m_next);
   }
 
+  XMLChanged();
   return true;
 }
 
@@ -2209,6 +2367,7 @@ GroupCell *GroupCell::UnhideTree()
   GroupCell *tree = m_hiddenTree;
   m_hiddenTree->SetHiddenTreeParent(m_hiddenTreeParent);
   m_hiddenTree = NULL;
+  XMLChanged();
   return tree;
 }
 
@@ -2285,6 +2444,7 @@ GroupCell *GroupCell::Fold()
   start->m_previous = start->m_previousToDraw = NULL;
   m_hiddenTree = start; // save the torn out tree into m_hiddenTree
   m_hiddenTree->SetHiddenTreeParent(this);
+  XMLChanged();
   return this;
 }
 
@@ -2311,6 +2471,7 @@ GroupCell *GroupCell::Unfold()
 
   m_hiddenTree->SetHiddenTreeParent(m_hiddenTreeParent);
   m_hiddenTree = NULL;
+  XMLChanged();
   return dynamic_cast<GroupCell *>(tmp);
 }
 
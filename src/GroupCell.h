@@ -33,6 +33,8 @@
 #include "Cell.h"
 #include "EditorCell.h"
 
+class ImageStore;
+
 #define EMPTY_INPUT_LABEL wxT(" -->  ")
 
 //! All types a GroupCell can be of
@@ -87,12 +89,16 @@ public:
   void AutoAnswer(bool autoAnswer){
     m_autoAnswer = autoAnswer;
     if(GetEditable() != NULL) GetEditable()->AutoAnswer(autoAnswer);
+    XMLChanged();
   }
   // Add a new answer to the cell
   void SetAnswer(wxString question, wxString answer)
     {
       if(answer != wxEmptyString)
+      {
         m_knownAnswers[question] = answer;
+        XMLChanged();
+      }
     }
   /*! Tell this cell to remove it from all gui actions.
 
@@ -104,6 +110,13 @@ public:
     no more displayed currently.
    */
   void MarkAsDeleted();
+
+  /*! Shall autocompletion and the find dialog know about this cell and the cells folded into it?
+
+    Is switched off for cells that are deleted and switched on for cells that are
+    inserted into the worksheet.
+   */
+  void SetIndexed(bool indexed);
   std::list<Cell *> GetInnerCells();
 
   /*! Which GroupCell was the last maxima was working on?
@@ -136,7 +149,7 @@ public:
   { return m_groupType; }
 
   void SetGroupType(GroupType type)
-  { m_groupType = type; }
+  { m_groupType = type; XMLChanged(); }
 
   void SetCellStyle(int style);
 
@@ -167,7 +180,12 @@ public:
   */
   void RemoveOutput();
 
-  wxString ToTeX(wxString imgDir, wxString filename, int *imgCounter);
+  /*! Convert this cell to its TeX representation
+
+    \param images If this isn't NULL image files are written only once
+                  even if the same image appears many times.
+   */
+  wxString ToTeX(wxString imgDir, wxString filename, int *imgCounter, ImageStore *images = NULL);
 
   /*! Convert the current cell to its wxm representation.
 
@@ -179,9 +197,10 @@ public:
 
   wxString ToRTF();
 
-  wxString ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter);
+  wxString ToTeXCodeCell(wxString imgDir, wxString filename, int *imgCounter, ImageStore *images = NULL);
 
-  wxString ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter);
+  wxString ToTeXImage(Cell *tmp, wxString imgDir, wxString filename, int *imgCounter,
+                      ImageStore *images = NULL);
 
   wxString ToTeX();
 
@@ -190,6 +209,30 @@ public:
 
   wxString ToXML();
 
+  /*! The XML representation of this cell, as ExportToWXMX() saves it
+
+    Only calls ToXML() if the cell has changed since the last save or if the
+    number of images before it has changed: The images in a .wxmx file are
+    numbered in the order they appear in. Else the text of the last save is
+    returned and the files it references are added to the .wxmx file again.
+   */
+  wxString CachedXML();
+
+  //! Tell this cell that ToXML() will return something new
+  void XMLChanged();
+
+  /*! Has the text CachedXML() has returned last already been found to be valid XML?
+
+    ExportToWXMX() tests each cell's XML for being readable again. For cells
+    that haven't changed since the last save this test can be skipped.
+   */
+  bool XMLValidated()
+  { return m_xmlValidated; }
+
+  //! Remember that the text CachedXML() has returned last is valid XML
+  void XMLValidated(bool validated)
+  { m_xmlValidated = validated; }
+
   //! Return the hide status
   bool IsHidden()
   { return m_hide; }
@@ -248,6 +291,13 @@ public:
   //! Recalculate the height of the input part of the cell
   void RecalculateHeightInput();
   virtual wxRect GetRect(bool all = false);
+
+  /*! Get the y position of the top left of this cell
+
+    While the GroupCells are indexed the cells below a cell that has changed its
+    size aren't moved immediately. In this case the position is read from the index.
+   */
+  virtual int GetCurrentY();
   /*! Recalculate the height of the output part of the cell
 
     \attention Needs to be in sync with the height calculation done during Draw() and
@@ -498,10 +548,31 @@ public:
     \return The next GroupCell or NULL if there isn't any.
   */
   GroupCell *UpdateYPosition();
-  
+
+  /*! The distance between the y position of the previous GroupCell and this one's
+
+    For the first GroupCell this is its y position.
+  */
+  int GetYOffset();
+
+  /*! Guess the size of this cell instead of measuring it
+
+    Measuring a cell's contents is expensive and only needed once the cell is
+    scrolled into view. Until then the cell keeps the size it had when it was last
+    measured, or, if it never was, a rough estimate based on the number of lines
+    of its input and output.
+  */
+  void EstimateSize();
+
+  //! Is the size of this cell only a guess made by EstimateSize()?
+  bool SizeIsEstimated() const
+  { return m_sizeIsEstimated; }
+
+  //! Does this cell need to be measured before it can be drawn?
+  bool NeedsRecalculation();
+
 protected:
   int m_labelWidth_cached;
-  bool NeedsRecalculation();
   int GetInputIndent();
   int GetLineIndent(Cell *cell);
   GroupCell *m_hiddenTree; //!< here hidden (folded) tree of GCs is stored
@@ -528,6 +599,20 @@ private:
   //! The number of cells the current group contains (-1, if no GroupCell)
   int m_cellsInGroup;
   int m_numberedAnswersCount;
+  //! Is the size of this cell only a guess made by EstimateSize()?
+  bool m_sizeIsEstimated;
+  //! The XML text CachedXML() has returned last
+  wxString m_xml;
+  //! Has this cell changed since m_xml was generated?
+  bool m_xmlChanged;
+  //! Has m_xml been found to be valid XML?
+  bool m_xmlValidated;
+  //! The number of images before this cell when m_xml was generated
+  int m_xmlFirstImage;
+  //! The number of images m_xml contains
+  int m_xmlImages;
+  //! The files m_xml wants to see in the .wxmx file
+  CellPointers::WXMXFileList m_xmlFiles;
   void UpdateCellsInGroup(){
     if(m_output != NULL)
       m_cellsInGroup = 2 + m_output->CellsInListRecursive();
@@ -0,0 +1,193 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+/*! \file
+  This file defines the class GroupCellIndex
+
+  GroupCellIndex finds the GroupCell at a given y position without walking
+  through the list of GroupCells.
+ */
+
+#include "GroupCellIndex.h"
+#include "GroupCell.h"
+
+GroupCellIndex::GroupCellIndex()
+{
+  m_valid = false;
+}
+
+void GroupCellIndex::Invalidate()
+{
+  if(!m_valid)
+    return;
+  m_valid = false;
+
+  long y = 0;
+  for(size_t i = 0; i < m_cells.size(); i++)
+  {
+    y += m_distances[i];
+    m_cells[i]->SetCurrentPoint(m_cells[i]->GetCurrentPoint().x, y);
+  }
+  m_positions.clear();
+  m_cells.clear();
+  m_distances.clear();
+  m_fenwickTree.clear();
+}
+
+void GroupCellIndex::Forget(GroupCell *cell)
+{
+  if(m_positions.find(cell) != m_positions.end())
+    Invalidate();
+}
+
+void GroupCellIndex::Rebuild(GroupCell *tree)
+{
+  Invalidate();
+  for(GroupCell *tmp = tree; tmp != NULL; tmp = dynamic_cast<GroupCell *>(tmp->m_next))
+  {
+    m_positions[tmp] = m_cells.size();
+    m_cells.push_back(tmp);
+    m_distances.push_back(tmp->GetYOffset());
+  }
+
+  // Build the Fenwick tree in O(n) by adding every node to its parent
+  m_fenwickTree.resize(m_cells.size() + 1, 0);
+  for(size_t i = 1; i < m_fenwickTree.size(); i++)
+  {
+    m_fenwickTree[i] += m_distances[i - 1];
+    size_t parent = i + LowestBit(i);
+    if(parent < m_fenwickTree.size())
+      m_fenwickTree[parent] += m_fenwickTree[i];
+  }
+  m_valid = true;
+}
+
+bool GroupCellIndex::IsLinked(size_t pos)
+{
+  GroupCell *cell = m_cells[pos];
+  Cell *previous = NULL;
+  if(pos > 0)
+    previous = m_cells[pos - 1];
+  Cell *next = NULL;
+  if(pos + 1 < m_cells.size())
+    next = m_cells[pos + 1];
+  return (cell->m_previous == previous) && (cell->m_next == next);
+}
+
+void GroupCellIndex::Add(size_t pos, long delta)
+{
+  for(size_t i = pos + 1; i < m_fenwickTree.size(); i += LowestBit(i))
+    m_fenwickTree[i] += delta;
+}
+
+long GroupCellIndex::Prefix(size_t pos)
+{
+  long sum = 0;
+  for(size_t i = pos + 1; i > 0; i -= LowestBit(i))
+    sum += m_fenwickTree[i];
+  return sum;
+}
+
+size_t GroupCellIndex::CountUpTo(long y)
+{
+  size_t step = 1;
+  while(step * 2 < m_fenwickTree.size())
+    step *= 2;
+
+  size_t count = 0;
+  for(; step > 0; step /= 2)
+  {
+    if((count + step < m_fenwickTree.size()) && (m_fenwickTree[count + step] <= y))
+    {
+      count += step;
+      y -= m_fenwickTree[count];
+    }
+  }
+  return count;
+}
+
+bool GroupCellIndex::Update(GroupCell *cell)
+{
+  if(!m_valid)
+    return false;
+  PositionHash::iterator it = m_positions.find(cell);
+  if(it == m_positions.end())
+    return false;
+  size_t pos = it->second;
+  if(!IsLinked(pos))
+  {
+    // Someone has changed the list of cells without telling us.
+    Invalidate();
+    return false;
+  }
+
+  // The distance of the next cell depends on the size of this one.
+  for(size_t i = pos; (i <= pos + 1) && (i < m_cells.size()); i++)
+  {
+    int distance = m_cells[i]->GetYOffset();
+    if(distance != m_distances[i])
+    {
+      Add(i, distance - m_distances[i]);
+      m_distances[i] = distance;
+    }
+  }
+  return true;
+}
+
+int GroupCellIndex::GetYPosition(GroupCell *cell)
+{
+  if(!m_valid)
+    return -1;
+  PositionHash::iterator it = m_positions.find(cell);
+  if(it == m_positions.end())
+    return -1;
+  return Prefix(it->second);
+}
+
+GroupCell *GroupCellIndex::GetGroupAt(GroupCell *tree, int y)
+{
+  if((!m_valid) || (m_cells.empty()) || (m_cells[0] != tree))
+    Rebuild(tree);
+  if(m_cells.empty())
+    return NULL;
+
+  // The last cell whose y position is <= y.
+  size_t count = CountUpTo(y);
+  if(count == 0)
+    return m_cells[0];
+  size_t pos = count - 1;
+  if(!IsLinked(pos))
+  {
+    Rebuild(tree);
+    return GetGroupAt(tree, y);
+  }
+
+  // y might lie in the part of this cell that is below its y position or in
+  // the part of the next cell that is above the next cell's y position.
+  GroupCell *cell = m_cells[pos];
+  if(Prefix(pos) - cell->GetCenter() + cell->GetHeight() - 1 >= y)
+    return cell;
+  if(pos + 1 < m_cells.size())
+    return m_cells[pos + 1];
+  return NULL;
+}
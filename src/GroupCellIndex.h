@@ -0,0 +1,120 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+#ifndef GROUPCELLINDEX_H
+#define GROUPCELLINDEX_H
+
+#include <vector>
+#include <wx/hashmap.h>
+
+/*!\file
+
+  This file declares the class GroupCellIndex.
+
+  GroupCellIndex finds the GroupCell at a given y position without walking
+  through the list of GroupCells.
+ */
+
+class GroupCell;
+
+/*! An index of the y positions of the GroupCells of a worksheet
+
+  The y position of a GroupCell is the y position of the previous GroupCell plus
+  the distance GroupCell::GetYOffset() returns. This class stores these distances
+  in a Fenwick tree which means that the y position of any cell and the cell at
+  any y position can be determined in O(log n) time and that updating the
+  distance of one cell costs O(log n) time, too.
+
+  The index is built from the list of GroupCells on demand. Every change to the
+  list of cells must invalidate it; Changing the size of a cell only requires a
+  call to Update(). While the index is valid the cells below a cell that has
+  changed its size don't need to be moved immediately: GroupCell::UpdateYPosition()
+  and GroupCell::GetCurrentY() ask the index for the current position of a cell.
+ */
+class GroupCellIndex
+{
+public:
+  GroupCellIndex();
+
+  //! Builds the index from a list of GroupCells
+  void Rebuild(GroupCell *tree);
+
+  /*! Forget everything we know about the list of GroupCells
+
+    Before that the cells are moved to the position the index knows for them as
+    cells whose position was only known to the index would end up in a wrong place
+    otherwise.
+   */
+  void Invalidate();
+
+  //! Has the index been built (and not been invalidated since)?
+  bool IsValid() const {return m_valid;}
+
+  //! Informs the index that a cell is about to be deleted
+  void Forget(GroupCell *cell);
+
+  /*! Informs the index that the size of a cell might have changed
+
+    \return false, if the cell isn't part of the index.
+   */
+  bool Update(GroupCell *cell);
+
+  //! The y position of a cell. -1 if the cell isn't part of the index.
+  int GetYPosition(GroupCell *cell);
+
+  /*! The cell at the y coordinate y
+
+    If y lies between two cells the cell below y is returned.
+    \param tree The first GroupCell of the worksheet. Is needed for building the
+                index if it isn't valid.
+    \param y The y coordinate
+    \return The first cell whose bottom isn't above y or NULL, if there is none.
+   */
+  GroupCell *GetGroupAt(GroupCell *tree, int y);
+
+private:
+  //! Is the cell at position pos still linked to the same neighbours as on Rebuild()?
+  bool IsLinked(size_t pos);
+  //! Adds delta to the distance of the cell at position pos
+  void Add(size_t pos, long delta);
+  //! The y position of the cell at position pos
+  long Prefix(size_t pos);
+  //! The number of cells whose y position is <= y
+  size_t CountUpTo(long y);
+  //! The lowest bit that is set in i
+  static size_t LowestBit(size_t i){return i & (~i + 1);}
+
+  WX_DECLARE_HASH_MAP(GroupCell *, size_t, wxPointerHash, wxPointerEqual, PositionHash);
+  //! The position of each cell in m_cells
+  PositionHash m_positions;
+  //! The cells in the order they appear on the worksheet
+  std::vector<GroupCell *> m_cells;
+  //! The distance of each cell to the previous one
+  std::vector<int> m_distances;
+  //! The Fenwick tree of m_distances. Index 0 is unused.
+  std::vector<long> m_fenwickTree;
+  //! Has the index been built?
+  bool m_valid;
+};
+
+#endif // GROUPCELLINDEX_H
@@ -49,8 +49,128 @@ wxMemoryBuffer Image::ReadCompressedImage(wxInputStream *data)
   return retval;
 }
 
+Image::LazySources Image::s_lazySources;
+
+Image::LazySources::~LazySources()
+{
+  for (size_t i = 0; i < m_tempFiles.GetCount(); i++)
+    if (wxFileExists(m_tempFiles[i]))
+      wxRemoveFile(m_tempFiles[i]);
+}
+
+wxString *Image::LazySources::Add(wxString location)
+{
+  for (std::list<Location>::iterator it = m_locations.begin(); it != m_locations.end(); ++it)
+  {
+    if (it->m_location == location)
+    {
+      it->m_users++;
+      return &it->m_location;
+    }
+  }
+  Location newLocation;
+  newLocation.m_location = location;
+  newLocation.m_users = 1;
+  m_locations.push_back(newLocation);
+  return &m_locations.back().m_location;
+}
+
+void Image::LazySources::AddUser(wxString *location)
+{
+  for (std::list<Location>::iterator it = m_locations.begin(); it != m_locations.end(); ++it)
+  {
+    if (&it->m_location == location)
+    {
+      it->m_users++;
+      return;
+    }
+  }
+}
+
+void Image::LazySources::Release(wxString *location)
+{
+  for (std::list<Location>::iterator it = m_locations.begin(); it != m_locations.end(); ++it)
+  {
+    if (&it->m_location == location)
+    {
+      if (--it->m_users <= 0)
+        m_locations.erase(it);
+      return;
+    }
+  }
+}
+
+void Image::LazySources::Preserve(wxString fileURI, wxString file)
+{
+  wxString tempFile;
+  for (std::list<Location>::iterator it = m_locations.begin(); it != m_locations.end(); ++it)
+  {
+    wxString rest;
+    if (!it->m_location.StartsWith(fileURI + wxT("#"), &rest))
+      continue;
+
+    if (tempFile == wxEmptyString)
+    {
+      tempFile = wxFileName::CreateTempFileName(wxT("wxmx"));
+      if ((tempFile == wxEmptyString) || (!wxCopyFile(file, tempFile, true)))
+      {
+        wxLogMessage(_("Cannot preserve the images of %s that haven't been loaded, yet"), file);
+        return;
+      }
+      m_tempFiles.Add(tempFile);
+    }
+    it->m_location = wxFileSystem::FileNameToURL(wxFileName(tempFile)) + wxT("#") + rest;
+  }
+}
+
+void Image::LoadCompressedImage()
+{
+  if (!m_imageLocation.IsSet())
+    return;
+
+  wxFileSystem filesystem;
+  filesystem.ChangePathTo(m_imageLocation.Get(), true);
+  m_imageLocation.Clear();
+  wxFSFile *fsfile = filesystem.OpenFile(m_imageName);
+  if (fsfile)
+    m_compressedImage = ReadCompressedImage(fsfile->GetStream());
+  else
+    m_isOk = false;
+  wxDELETE(fsfile);
+}
+
+void Image::LoadGnuplotSource()
+{
+  if (!m_gnuplotLocation.IsSet())
+    return;
+
+  wxFileSystem filesystem;
+  filesystem.ChangePathTo(m_gnuplotLocation.Get(), true);
+  m_gnuplotLocation.Clear();
+  LoadGnuplotSource(&filesystem);
+}
+
+void Image::SetWXMXEntry(Cell::CellPointers::WXMXFileType type, long archive, wxString name)
+{
+  if (m_wxmxArchive != archive)
+  {
+    for (int i = 0; i <= Cell::CellPointers::WXMX_GNUPLOTDATA; i++)
+      m_wxmxEntries[i] = wxEmptyString;
+    m_wxmxArchive = archive;
+  }
+  m_wxmxEntries[type] = name;
+}
+
+wxString Image::GetWXMXEntry(Cell::CellPointers::WXMXFileType type, long archive)
+{
+  if ((archive < 0) || (m_wxmxArchive != archive))
+    return wxEmptyString;
+  return m_wxmxEntries[type];
+}
+
 wxBitmap Image::GetUnscaledBitmap()
 {
+  LoadCompressedImage();
   wxMemoryInputStream istream(m_compressedImage.GetData(), m_compressedImage.GetDataLen());
   wxImage img(istream, wxBITMAP_TYPE_ANY);
   wxBitmap bmp;
@@ -62,6 +182,7 @@ wxBitmap Image::GetUnscaledBitmap()
 Image::Image(Configuration **config)
 {
   m_configuration = config;
+  m_wxmxArchive = -1;
   m_width = 1;
   m_height = 1;
   m_originalWidth = 1;
@@ -75,6 +196,7 @@ Image::Image(Configuration **config)
 Image::Image(Configuration **config, wxMemoryBuffer image, wxString type)
 {
   m_configuration = config;
+  m_wxmxArchive = -1;
   m_scaledBitmap.Create(1, 1);
   m_compressedImage = image;
   m_extension = type;
@@ -107,7 +229,8 @@ Image::Image(Configuration **config, const wxBitmap &bitmap)
 }
 
 // constructor which loads an image
-Image::Image(Configuration **config, wxString image, bool remove, wxFileSystem *filesystem)
+Image::Image(Configuration **config, wxString image, bool remove, wxFileSystem *filesystem,
+             wxSize originalSize)
 {
   m_configuration = config;
   m_scaledBitmap.Create(1, 1);
@@ -115,11 +238,12 @@ Image::Image(Configuration **config, wxString image, bool remove, wxFileSystem *
   m_height = 1;
   m_maxWidth = -1;
   m_maxHeight = -1;
-  LoadImage(image, remove, filesystem);
+  LoadImage(image, remove, filesystem, originalSize);
 }
 
 Image::~Image()
 {
+  BitmapCache::Get()->Remove(this);
   if(m_gnuplotSource != wxEmptyString)
   {
     if(wxFileExists(m_gnuplotSource))
@@ -137,6 +261,7 @@ Image::~Image()
 
 void Image::GnuplotSource(wxString gnuplotFilename, wxString dataFilename, wxFileSystem *filesystem)
 {
+  ForgetWXMXEntries();
   m_gnuplotSource = gnuplotFilename;
   m_gnuplotData = dataFilename;
 
@@ -225,60 +350,22 @@ void Image::GnuplotSource(wxString gnuplotFilename, wxString dataFilename, wxFil
   }
   else
   {
-    {
-      wxFSFile *fsfile = filesystem->OpenFile(m_gnuplotSource);
-      if (fsfile)
-      { // open successful
-        wxInputStream *input = fsfile->GetStream();
-          if(input->IsOk())
-          {
-            wxTextInputStream textIn(*input, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-
-            wxMemoryOutputStream mstream;
-            int zlib_flags;
-            if(wxZlibOutputStream::CanHandleGZip())
-              zlib_flags = wxZLIB_GZIP;
-            else
-              zlib_flags = wxZLIB_ZLIB;
-            wxZlibOutputStream zstream(mstream,wxZ_BEST_COMPRESSION,zlib_flags);
-            wxTextOutputStream textOut(zstream);
-            wxString line;
-            
-            // A RegEx that matches the name of the data file (needed if we ever want to
-            // move a data file into the temp directory of a new computer that locates its
-            // temp data somewhere strange).
-            wxRegEx replaceDataFileName("'[^']*maxout_[^']*_[0-9*]\\.data'");
-            while(!input->Eof())
-            {
-              line = textIn.ReadLine();
-              if(replaceDataFileName.Matches(line))
-              {
-                wxString dataFileName;
-                dataFileName = replaceDataFileName.GetMatch(line);
-                if(dataFileName != wxEmptyString)
-                  wxLogMessage(_("Gnuplot Data File Name: ") + dataFileName);
-                replaceDataFileName.Replace(&line,wxT("'<DATAFILENAME>'"));
-              }
-              textOut << line + wxT("\n");
-            }
-            textOut.Flush();
-            zstream.Close();
-            m_gnuplotSource_Compressed.Clear();
-            m_gnuplotSource_Compressed.AppendData(mstream.GetOutputStreamBuffer()->GetBufferStart(),
-                                                  mstream.GetOutputStreamBuffer()->GetBufferSize());
-            wxDELETE(input);
-          }
-      }
-    }
-    {
-      wxFSFile *fsfile = filesystem->OpenFile(m_gnuplotData);
-      if (fsfile)
-      { // open successful
-        wxInputStream *input = fsfile->GetStream();
+    // The gnuplot files are read from the .wxmx file only once they are needed.
+    m_gnuplotLocation.Set(filesystem->GetPath());
+  }
+}
+
+void Image::LoadGnuplotSource(wxFileSystem *filesystem)
+{
+  {
+    wxFSFile *fsfile = filesystem->OpenFile(m_gnuplotSource);
+    if (fsfile)
+    { // open successful
+      wxInputStream *input = fsfile->GetStream();
         if(input->IsOk())
         {
           wxTextInputStream textIn(*input, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-            
+
           wxMemoryOutputStream mstream;
           int zlib_flags;
           if(wxZlibOutputStream::CanHandleGZip())
@@ -288,19 +375,63 @@ void Image::GnuplotSource(wxString gnuplotFilename, wxString dataFilename, wxFil
           wxZlibOutputStream zstream(mstream,wxZ_BEST_COMPRESSION,zlib_flags);
           wxTextOutputStream textOut(zstream);
           wxString line;
-            
+          
+          // A RegEx that matches the name of the data file (needed if we ever want to
+          // move a data file into the temp directory of a new computer that locates its
+          // temp data somewhere strange).
+          wxRegEx replaceDataFileName("'[^']*maxout_[^']*_[0-9*]\\.data'");
           while(!input->Eof())
           {
             line = textIn.ReadLine();
+            if(replaceDataFileName.Matches(line))
+            {
+              wxString dataFileName;
+              dataFileName = replaceDataFileName.GetMatch(line);
+              if(dataFileName != wxEmptyString)
+                wxLogMessage(_("Gnuplot Data File Name: ") + dataFileName);
+              replaceDataFileName.Replace(&line,wxT("'<DATAFILENAME>'"));
+            }
             textOut << line + wxT("\n");
           }
           textOut.Flush();
           zstream.Close();
-            
-          m_gnuplotData_Compressed.Clear();
-          m_gnuplotData_Compressed.AppendData(mstream.GetOutputStreamBuffer()->GetBufferStart(),
-                                              mstream.GetOutputStreamBuffer()->GetBufferSize());
+          m_gnuplotSource_Compressed.Clear();
+          m_gnuplotSource_Compressed.AppendData(mstream.GetOutputStreamBuffer()->GetBufferStart(),
+                                                mstream.GetOutputStreamBuffer()->GetBufferSize());
+          wxDELETE(input);
         }
+    }
+  }
+  {
+    wxFSFile *fsfile = filesystem->OpenFile(m_gnuplotData);
+    if (fsfile)
+    { // open successful
+      wxInputStream *input = fsfile->GetStream();
+      if(input->IsOk())
+      {
+        wxTextInputStream textIn(*input, wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
+          
+        wxMemoryOutputStream mstream;
+        int zlib_flags;
+        if(wxZlibOutputStream::CanHandleGZip())
+          zlib_flags = wxZLIB_GZIP;
+        else
+          zlib_flags = wxZLIB_ZLIB;
+        wxZlibOutputStream zstream(mstream,wxZ_BEST_COMPRESSION,zlib_flags);
+        wxTextOutputStream textOut(zstream);
+        wxString line;
+          
+        while(!input->Eof())
+        {
+          line = textIn.ReadLine();
+          textOut << line + wxT("\n");
+        }
+        textOut.Flush();
+        zstream.Close();
+          
+        m_gnuplotData_Compressed.Clear();
+        m_gnuplotData_Compressed.AppendData(mstream.GetOutputStreamBuffer()->GetBufferStart(),
+                                            mstream.GetOutputStreamBuffer()->GetBufferSize());
       }
     }
   }
@@ -308,6 +439,7 @@ void Image::GnuplotSource(wxString gnuplotFilename, wxString dataFilename, wxFil
 
 wxMemoryBuffer Image::GetGnuplotSource()
 {
+  LoadGnuplotSource();
   wxMemoryBuffer retval;
   
   wxMemoryOutputStream output;
@@ -337,6 +469,7 @@ wxMemoryBuffer Image::GetGnuplotSource()
 
 wxMemoryBuffer Image::GetGnuplotData()
 {
+  LoadGnuplotSource();
   wxMemoryBuffer retval;
   
   wxMemoryOutputStream output;
@@ -369,6 +502,8 @@ wxString Image::GnuplotData()
   if((m_gnuplotData == wxEmptyString) || (wxFileExists(m_gnuplotData)))
     return m_gnuplotData;
 
+  LoadGnuplotSource();
+
   // Move the gnuplot data and data file into our temp directory
   wxFileName gnuplotSourceFile(m_gnuplotSource);
   m_gnuplotSource = wxStandardPaths::Get().GetTempDir() + "/" + gnuplotSourceFile.GetFullName();
@@ -403,6 +538,8 @@ wxString Image::GnuplotSource()
   if((m_gnuplotSource == wxEmptyString) || (wxFileExists(m_gnuplotSource)))
     return m_gnuplotSource;
 
+  LoadGnuplotSource();
+
   // Move the gnuplot source and data file into our temp directory
   wxFileName gnuplotSourceFile(m_gnuplotSource);
   m_gnuplotSource = wxStandardPaths::Get().GetTempDir() + "/" + gnuplotSourceFile.GetFullName();
@@ -439,6 +576,7 @@ wxSize Image::ToImageFile(wxString filename)
 {
   wxFileName fn(filename);
   wxString ext = fn.GetExt();
+  LoadCompressedImage();
   if (filename.Lower().EndsWith(GetExtension().Lower()))
   {
     wxFile file(filename, wxFile::write);
@@ -481,74 +619,160 @@ wxSize Image::ToImageFile(wxString filename)
   }
 }
 
-wxBitmap Image::GetBitmap(double scale)
+void Image::ScalingJob::Cancel()
 {
-  Recalculate(scale);
-
-  // Let's see if we have cached the scaled bitmap with the right size
-  if (m_scaledBitmap.GetWidth() == m_width)
-    return m_scaledBitmap;
+  if ((m_id >= 0) && ImageScaler::Running())
+    ImageScaler::Get()->Cancel(m_id);
+  m_id = -1;
+}
 
+bool Image::PickUpScaledBitmap()
+{
+  // Make sure we stay within sane defaults
+  if (m_width < 1)m_width = 1;
+  if (m_height < 1)m_height = 1;
 
-  // Seems like we need to create a new scaled bitmap.
-  if (m_scaledBitmap.GetWidth() != m_width)
-  {
-    wxImage img;
-    if (m_compressedImage.GetDataLen() > 0)
-    {
-      wxMemoryInputStream istream(m_compressedImage.GetData(), m_compressedImage.GetDataLen());
+  // A bitmap that is scaled for the wrong size is of no use.
+  if (m_scalingJob.Running() &&
+      ((m_scalingJob.m_width != m_width) || (m_scalingJob.m_height != m_height)))
+    m_scalingJob.Cancel();
+
+  // Has a background thread already prepared the image for us?
+  if (!m_scalingJob.Running())
+    return false;
+  wxImage img;
+  if (!ImageScaler::Get()->GetResult(m_scalingJob.m_id, img))
+    return false;
+  m_scalingJob.m_id = -1;
+  m_isOk = img.IsOk();
+  if (m_isOk)
+    m_scaledBitmap = wxBitmap(img, 24);
+  else
+    CreateErrorBitmap();
+  return true;
+}
 
-      img = wxImage(istream, wxBITMAP_TYPE_ANY);
-    }
-    m_isOk = true;
+bool Image::StartScalingJob()
+{
+  if (m_scalingJob.Running())
+    return true;
 
-    if (img.Ok())
-      m_scaledBitmap = wxBitmap(img);
-    else
-    {
-      m_isOk = false;
-      // Create a "image not loaded" bitmap.
-      m_scaledBitmap.Create(m_width, m_height);
+  // Printing and exporting need the image right now.
+  Configuration *configuration = (*m_configuration);
+  if ((configuration->GetWorkSheet() == NULL) || configuration->GetPrinting())
+    return false;
+
+  LoadCompressedImage();
+  if (m_compressedImage.GetDataLen() == 0)
+    return false;
+
+  m_scalingJob.m_id = ImageScaler::Get()->Scale(m_compressedImage, m_width, m_height,
+                                                configuration->GetWorkSheet());
+  m_scalingJob.m_width = m_width;
+  m_scalingJob.m_height = m_height;
+  return true;
+}
 
-      wxString error;
-      if(m_imageName != wxEmptyString)
-        error = wxString::Format(_("Error: Cannot render %s."), m_imageName);
-      else
-        error = wxString::Format(_("Error: Cannot render the image."));
+bool Image::ScaledBitmapReady(double scale)
+{
+  Recalculate(scale);
+  if (m_scaledBitmap.GetWidth() == m_width)
+    return true;
+  return PickUpScaledBitmap();
+}
 
-      wxMemoryDC dc;
-      dc.SelectObject(m_scaledBitmap);
+void Image::Prefetch(double scale)
+{
+  if (!ScaledBitmapReady(scale))
+    StartScalingJob();
+}
 
-      int width = 0, height = 0;
-      dc.GetTextExtent(error, &width, &height);
+wxBitmap Image::GetBitmap(double scale)
+{
+  if (ScaledBitmapReady(scale))
+    return UseScaledBitmap();
+
+  // On the screen we can display a placeholder until a background thread has
+  // scaled the image.
+  if (StartScalingJob())
+    return GetPlaceholderBitmap();
+
+  LoadCompressedImage();
+  wxImage img = ImageScaler::DecodeAndScale(m_compressedImage.GetData(),
+                                            m_compressedImage.GetDataLen(),
+                                            m_width, m_height);
+  m_isOk = img.IsOk();
+  if (m_isOk)
+    m_scaledBitmap = wxBitmap(img, 24);
+  else
+    CreateErrorBitmap();
+  return UseScaledBitmap();
+}
 
-      dc.DrawRectangle(0, 0, m_width - 1, m_height - 1);
-      dc.DrawLine(0, 0, m_width - 1, m_height - 1);
-      dc.DrawLine(0, m_height - 1, m_width - 1, 0);
+wxBitmap Image::UseScaledBitmap()
+{
+  BitmapCache::Get()->Used(this, (size_t) m_scaledBitmap.GetWidth() * m_scaledBitmap.GetHeight() * 4);
+  return m_scaledBitmap;
+}
 
-      dc.GetTextExtent(error, &width, &height);
-      dc.DrawText(error, (m_width - width) / 2, (m_height - height) / 2);
-    }
+wxBitmap Image::GetPlaceholderBitmap()
+{
+  wxBitmap placeholder(m_width, m_height);
+  wxMemoryDC dc;
+  dc.SelectObject(placeholder);
+  dc.SetBackground(*(wxTheBrushList->FindOrCreateBrush((*m_configuration)->DefaultBackgroundColor())));
+  dc.Clear();
+
+  // The bitmap for the previous scale, stretched by the DC, will look better
+  // than an empty rectangle.
+  if ((m_scaledBitmap.GetWidth() > 1) || (m_scaledBitmap.GetHeight() > 1))
+  {
+    wxMemoryDC source;
+    source.SelectObject(m_scaledBitmap);
+    dc.StretchBlit(0, 0, m_width, m_height, &source,
+                   0, 0, m_scaledBitmap.GetWidth(), m_scaledBitmap.GetHeight());
   }
+  dc.SelectObject(wxNullBitmap);
+  return placeholder;
+}
 
-  // Make sure we stay within sane defaults
-  if (m_width < 1)m_width = 1;
-  if (m_height < 1)m_height = 1;
+void Image::CreateErrorBitmap()
+{
+  // Create a "image not loaded" bitmap.
+  m_scaledBitmap.Create(m_width, m_height);
 
-  // Create a scaled bitmap and return it.
-  wxImage img = m_scaledBitmap.ConvertToImage();
-  img.Rescale(m_width, m_height, wxIMAGE_QUALITY_BICUBIC);
-  m_scaledBitmap = wxBitmap(img, 24);
-  return m_scaledBitmap;
+  wxString error;
+  if(m_imageName != wxEmptyString)
+    error = wxString::Format(_("Error: Cannot render %s."), m_imageName);
+  else
+    error = wxString::Format(_("Error: Cannot render the image."));
+
+  wxMemoryDC dc;
+  dc.SelectObject(m_scaledBitmap);
+
+  int width = 0, height = 0;
+  dc.GetTextExtent(error, &width, &height);
+
+  dc.DrawRectangle(0, 0, m_width - 1, m_height - 1);
+  dc.DrawLine(0, 0, m_width - 1, m_height - 1);
+  dc.DrawLine(0, m_height - 1, m_width - 1, 0);
+
+  dc.GetTextExtent(error, &width, &height);
+  dc.DrawText(error, (m_width - width) / 2, (m_height - height) / 2);
 }
 
 void Image::LoadImage(const wxBitmap &bitmap)
 {
+  ForgetWXMXEntries();
+  m_imageLocation.Clear();
   // Convert the bitmap to a png image we can use as m_compressedImage
   wxImage image = bitmap.ConvertToImage();
   m_isOk = image.IsOk();
   wxMemoryOutputStream stream;
   image.SaveFile(stream, wxBITMAP_TYPE_PNG);
+  // A .wxmx file that is being saved in the background might still share the
+  // old buffer with us => Don't modify it.
+  m_compressedImage = wxMemoryBuffer();
   m_compressedImage.AppendData(stream.GetOutputStreamBuffer()->GetBufferStart(),
                                stream.GetOutputStreamBuffer()->GetBufferSize());
 
@@ -561,11 +785,26 @@ void Image::LoadImage(const wxBitmap &bitmap)
   m_height = 1;
 }
 
-void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
+void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem, wxSize originalSize)
 {
+  ForgetWXMXEntries();
   m_imageName = image;
-  m_compressedImage.Clear();
+  m_compressedImage = wxMemoryBuffer();
   m_scaledBitmap.Create(1, 1);
+  m_imageLocation.Clear();
+
+  // If we know the image's size we can do the layout without reading the image.
+  // Reading and decoding it can therefore wait until it is drawn or exported.
+  if ((filesystem != NULL) && (originalSize.x > 0) && (originalSize.y > 0))
+  {
+    m_imageLocation.Set(filesystem->GetPath());
+    m_extension = wxFileName(image).GetExt();
+    m_originalWidth = originalSize.x;
+    m_originalHeight = originalSize.y;
+    m_isOk = true;
+    Recalculate();
+    return;
+  }
 
   if (filesystem)
   {
@@ -606,7 +845,21 @@ void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
   }
 
   m_isOk = false;
-  
+  m_extension = wxFileName(image).GetExt();
+
+  // The header of a .png file tells us its size => We don't need to decode the
+  // image before it is displayed. This saves much time for animations with
+  // many frames.
+  wxSize pngSize = GetPNGSize(m_compressedImage);
+  if ((pngSize.x > 0) && (pngSize.y > 0))
+  {
+    m_originalWidth = pngSize.x;
+    m_originalHeight = pngSize.y;
+    m_isOk = true;
+    Recalculate();
+    return;
+  }
+
   wxImage Image;
   if (m_compressedImage.GetDataLen() > 0)
   {
@@ -614,8 +867,6 @@ void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
     Image.LoadFile(istream);
   }
 
-  m_extension = wxFileName(image).GetExt();
-
   m_originalWidth = 700;
   m_originalHeight = 300;
 
@@ -632,6 +883,25 @@ void Image::LoadImage(wxString image, bool remove, wxFileSystem *filesystem)
 
 }
 
+wxSize Image::GetPNGSize(const wxMemoryBuffer &compressedImage)
+{
+  const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  const unsigned char *data = (const unsigned char *) compressedImage.GetData();
+
+  // The signature is followed by the IHDR chunk that starts with the width
+  // and the height as 32-bit big-endian numbers.
+  if ((compressedImage.GetDataLen() < 24) ||
+      (memcmp(data, signature, sizeof(signature)) != 0) ||
+      (memcmp(data + 12, "IHDR", 4) != 0))
+    return wxDefaultSize;
+
+  long width = ((long) data[16] << 24) | ((long) data[17] << 16) | ((long) data[18] << 8) | data[19];
+  long height = ((long) data[20] << 24) | ((long) data[21] << 16) | ((long) data[22] << 8) | data[23];
+  if ((width < 1) || (height < 1) || (width > 0x7FFFFFF) || (height > 0x7FFFFFF))
+    return wxDefaultSize;
+  return wxSize(width, height);
+}
+
 void Image::Recalculate(double scale)
 {
   int width = m_originalWidth;
@@ -693,8 +963,6 @@ void Image::Recalculate(double scale)
     m_height = 100;
     m_width = 100;
   }
-// Clear this cell's image cache if it doesn't contain an image of the size
-  // we need right now.
-  if (m_scaledBitmap.GetWidth() != m_width)
-    ClearCache();
+  // If m_scaledBitmap has the wrong size we keep it nevertheless: GetBitmap()
+  // displays it until the bitmap for the new size is ready.
 }
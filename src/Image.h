@@ -30,6 +30,8 @@
 #define IMAGE_H
 
 #include "Cell.h"
+#include "ImageScaler.h"
+#include "BitmapCache.h"
 #include <wx/image.h>
 
 #include <wx/filesys.h>
@@ -81,8 +83,10 @@ public:
     \param image The name of the file
     \param filesystem The filesystem to load it from
     \param remove true = Delete the file after loading it
+    \param originalSize The size of the image, if known. See LoadImage().
    */
-  Image(Configuration **config, wxString image, bool remove = true, wxFileSystem *filesystem = NULL);
+  Image(Configuration **config, wxString image, bool remove = true, wxFileSystem *filesystem = NULL,
+        wxSize originalSize = wxDefaultSize);
 
   ~Image();
 
@@ -119,12 +123,26 @@ public:
   //! Returns the gnuplot data of this image
   wxMemoryBuffer GetGnuplotData();
   
+  //! Make this image use another configuration
+  void SetConfiguration(Configuration **config)
+  { m_configuration = config; }
+
   /*! Temporarily forget the scaled image in order to save memory
 
     Will recreate the scaled image as soon as needed.
    */
   void ClearCache()
-  { if ((m_scaledBitmap.GetWidth() > 1) || (m_scaledBitmap.GetHeight() > 1))m_scaledBitmap.Create(1, 1); }
+  {
+    m_scalingJob.Cancel();
+    BitmapCache::Get()->Remove(this);
+    if ((m_scaledBitmap.GetWidth() > 1) || (m_scaledBitmap.GetHeight() > 1))m_scaledBitmap.Create(1, 1);
+  }
+
+  /*! Reads the size of a .png image from its header
+
+    \return The size or wxDefaultSize, if the data isn't a .png image.
+   */
+  static wxSize GetPNGSize(const wxMemoryBuffer &compressedImage);
 
   //! Reads the compressed image into a memory buffer
   wxMemoryBuffer ReadCompressedImage(wxInputStream *data);
@@ -133,8 +151,14 @@ public:
   wxString GetExtension()
   { return m_extension; };
 
-  //! Loads an image from a file
-  void LoadImage(wxString image, bool remove = true, wxFileSystem *filesystem = NULL);
+  /*! Loads an image from a file
+
+    If the image is to be read from a filesystem (which normally means: from a
+    .wxmx file) and its size is known the image is only read and decoded once
+    it is actually needed.
+   */
+  void LoadImage(wxString image, bool remove = true, wxFileSystem *filesystem = NULL,
+                 wxSize originalSize = wxDefaultSize);
 
   //! The maximum width this image shall be displayed with
   double GetMaxWidth(){return m_maxWidth;}
@@ -151,9 +175,26 @@ public:
   //! Saves the image in its original form, or as .png if it originates in a bitmap
   wxSize ToImageFile(wxString filename);
 
-  //! Returns the bitmap being displayed with custom scale
+  /*! Returns the bitmap being displayed with custom scale
+
+    When drawing to the worksheet a bitmap that has to be created anew is
+    decoded and scaled by ImageScaler in the background: Until it is ready
+    a placeholder is returned.
+   */
   wxBitmap GetBitmap(double scale = 1.0);
 
+  /*! Is the bitmap for this scale ready to be drawn?
+
+    If this returns false GetBitmap() would return a placeholder.
+   */
+  bool ScaledBitmapReady(double scale = 1.0);
+
+  /*! Have the bitmap for this scale be prepared in the background
+
+    Does nothing if the bitmap is ready or already is being prepared.
+   */
+  void Prefetch(double scale = 1.0);
+
   //! Does the image show an actual image or an "broken image" symbol?
   bool IsOk() {return m_isOk;}
   
@@ -168,9 +209,35 @@ public:
   //! The height of the scaled image
   long m_height;
 
+  /*! Informs all images that are read from a .wxmx file only once they are needed that this file will be overwritten
+
+    If any image has been opened lazily from this file the file is copied to a
+    temporary file first and the images are read from this copy instead.
+
+    \param fileURI The URI of the file, as passed to MathParser.
+    \param file The name of the file.
+   */
+  static void SourceFileWillBeOverwritten(wxString fileURI, wxString file)
+  { s_lazySources.Preserve(fileURI, file); }
+
   //! Returns the original image in its compressed form
   wxMemoryBuffer GetCompressedImage()
-  { return m_compressedImage; }
+  { LoadCompressedImage(); return m_compressedImage; }
+
+  /*! Remembers that one of our files has been saved to a .wxmx file
+
+    \param type Which of our files has been saved
+    \param archive The number the worksheet has given this version of the .wxmx file
+    \param name The name of the file inside the .wxmx file
+   */
+  void SetWXMXEntry(Cell::CellPointers::WXMXFileType type, long archive, wxString name);
+
+  /*! The name one of our files has been saved as in a .wxmx file
+
+    \return wxEmptyString, if the file hasn't been saved to this version of
+    the .wxmx file or has changed since.
+   */
+  wxString GetWXMXEntry(Cell::CellPointers::WXMXFileType type, long archive);
 
   //! Returns the original width
   size_t GetOriginalWidth()
@@ -180,10 +247,9 @@ public:
   size_t GetOriginalHeight()
   { return m_originalHeight; }
 
+protected:
   //! The image in its original compressed form
   wxMemoryBuffer m_compressedImage;
-
-protected:
   //! A zipped version of the gnuplot commands that produced this image.
   wxMemoryBuffer m_gnuplotSource_Compressed;
   //! A zipped version of the gnuplot data needed in order to create this image.
@@ -203,6 +269,132 @@ protected:
   //! The gnuplot data file for this image, if any.
   wxString m_gnuplotData;
 private:
+  /*! The job that scales this image in the background, if any
+
+    Copies of an Image don't share its job: Only one of them could pick up the
+    result.
+   */
+  class ScalingJob
+  {
+  public:
+    ScalingJob(){m_id = -1; m_width = m_height = -1;}
+    ScalingJob(const ScalingJob &WXUNUSED(job)){m_id = -1; m_width = m_height = -1;}
+    ScalingJob &operator=(const ScalingJob &WXUNUSED(job)){Cancel(); return *this;}
+    ~ScalingJob(){Cancel();}
+    //! Tell ImageScaler we no more need the result of this job
+    void Cancel();
+    //! Is there a job?
+    bool Running(){return m_id >= 0;}
+    //! The number ImageScaler knows the job by
+    long m_id;
+    //! The width the job scales the image to
+    int m_width;
+    //! The height the job scales the image to
+    int m_height;
+  };
+  ScalingJob m_scalingJob;
+
+  /*! Returns what to display while the bitmap is scaled in the background
+
+    This is the bitmap for the previous scale, if we still have it, or an empty
+    rectangle.
+   */
+  wxBitmap GetPlaceholderBitmap();
+  //! Sets m_scaledBitmap to a bitmap showing that the image could not be rendered
+  void CreateErrorBitmap();
+  //! Tells BitmapCache that m_scaledBitmap is drawn and returns it
+  wxBitmap UseScaledBitmap();
+  //! Makes the result of m_scalingJob our scaled bitmap, if it is ready
+  bool PickUpScaledBitmap();
+  /*! Makes ImageScaler prepare the scaled bitmap in the background
+
+    \return false, if the bitmap has to be scaled synchronously instead as we
+    are printing or exporting.
+  */
+  bool StartScalingJob();
+
+  /*! The .wxmx files images are read from only once they are needed
+
+    Images don't store the location of the .wxmx file they are read from
+    themselves, but a pointer to a location stored here: This way all of them
+    can be redirected to a copy of the file if it is overwritten. A location
+    is forgotten as soon as no image needs to read from it any more.
+   */
+  class LazySources
+  {
+  public:
+    //! Deletes the temporary copies of the .wxmx files
+    ~LazySources();
+    //! Returns the entry for the directory at this location and counts one more user
+    wxString *Add(wxString location);
+    //! Counts one more user of an entry Add() has returned
+    void AddUser(wxString *location);
+    //! Counts one user less of an entry and forgets the entry if it has no users left
+    void Release(wxString *location);
+    //! Copy the .wxmx file with this URI, if images still need it
+    void Preserve(wxString fileURI, wxString file);
+  private:
+    struct Location
+    {
+      wxString m_location;
+      //! The number of images that still have to read from m_location
+      long m_users;
+    };
+    //! The locations images are read lazily from. Its elements don't move in memory.
+    std::list<Location> m_locations;
+    //! The temporary copies of .wxmx files we have made
+    wxArrayString m_tempFiles;
+  };
+  static LazySources s_lazySources;
+
+  //! An entry in s_lazySources an image still has to read a file from
+  class LazyLocation
+  {
+  public:
+    LazyLocation() : m_location(NULL){}
+    LazyLocation(const LazyLocation &location) : m_location(NULL)
+    { *this = location; }
+    ~LazyLocation()
+    { Clear(); }
+    LazyLocation &operator=(const LazyLocation &location)
+    {
+      if (location.m_location != NULL)
+        s_lazySources.AddUser(location.m_location);
+      Clear();
+      m_location = location.m_location;
+      return *this;
+    }
+    //! Read from this location from now on
+    void Set(wxString location)
+    {
+      Clear();
+      m_location = s_lazySources.Add(location);
+    }
+    //! Nothing needs to be read any more
+    void Clear()
+    {
+      if (m_location != NULL)
+        s_lazySources.Release(m_location);
+      m_location = NULL;
+    }
+    bool IsSet() const
+    { return m_location != NULL; }
+    wxString Get() const
+    { return *m_location; }
+  private:
+    wxString *m_location;
+  };
+
+  //! Reads the compressed image from the .wxmx file if this hasn't been done yet
+  void LoadCompressedImage();
+  //! Reads the gnuplot files from the .wxmx file if this hasn't been done yet
+  void LoadGnuplotSource();
+  //! Reads the gnuplot source and data file from a filesystem
+  void LoadGnuplotSource(wxFileSystem *filesystem);
+  //! The .wxmx file the image still has to be read from. Not set if it already has been read
+  LazyLocation m_imageLocation;
+  //! The .wxmx file the gnuplot files still have to be read from, if any.
+  LazyLocation m_gnuplotLocation;
   Configuration **m_configuration;
   //! The upper width limit for displaying this image
   double m_maxWidth;
@@ -210,6 +402,12 @@ private:
   double m_maxHeight;
   //! The name of the image, if known.
   wxString m_imageName;
+  //! Forget which files have been saved to a .wxmx file as their contents have changed
+  void ForgetWXMXEntries(){m_wxmxArchive = -1;}
+  //! The version of the .wxmx file m_wxmxEntries refer to. -1 = none.
+  long m_wxmxArchive;
+  //! The names of our files in the .wxmx file. Indexed by WXMXFileType.
+  wxString m_wxmxEntries[Cell::CellPointers::WXMX_GNUPLOTDATA + 1];
 };
 
 #endif // IMAGE_H
@@ -0,0 +1,150 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ImageExportQueue
+
+  ImageExportQueue encodes and saves the images of an export on background threads.
+ */
+
+#include "ImageExportQueue.h"
+#include "SlideShowCell.h"
+
+ImageExportQueue::ImageExportQueue()
+{
+  m_lastJob = 0;
+
+  // The GUI thread is busy rendering the equations the workers are to encode.
+  int threads = wxThread::GetCPUCount() - 1;
+  if (threads > 8)
+    threads = 8;
+  if (threads < 1)
+    threads = 1;
+
+  for (int i = 0; i < threads; i++)
+  {
+    Worker *worker = new Worker(this);
+    if (worker->Run() != wxTHREAD_NO_ERROR)
+    {
+      wxLogMessage(_("Cannot start a thread for exporting images."));
+      delete worker;
+      continue;
+    }
+    m_workers.push_back(worker);
+  }
+}
+
+ImageExportQueue::~ImageExportQueue()
+{
+  Finish();
+}
+
+void ImageExportQueue::Finish()
+{
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    Job *quit = new Job;
+    quit->m_type = Job::quit;
+    quit->m_delay = 0;
+    quit->m_id = -1;
+    m_jobs.Post(quit);
+  }
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i]->Wait();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+}
+
+long ImageExportQueue::SavePNG(wxImage &image, const wxString &file)
+{
+  Job *job = new Job;
+  job->m_type = Job::png;
+  job->m_image = image;
+  image = wxImage();
+  job->m_delay = 0;
+  // wxString's reference counting isn't thread-safe => Make a real copy.
+  job->m_file = wxString(file.wc_str());
+  return Post(job);
+}
+
+long ImageExportQueue::SaveGIF(wxImageArray &frames, const wxString &file, int delay)
+{
+  Job *job = new Job;
+  job->m_type = Job::gif;
+  for (size_t i = 0; i < frames.GetCount(); i++)
+    job->m_frames.Add(frames[i]);
+  frames.Clear();
+  job->m_delay = delay;
+  job->m_file = wxString(file.wc_str());
+  return Post(job);
+}
+
+long ImageExportQueue::Post(Job *job)
+{
+  long id = job->m_id = ++m_lastJob;
+
+  // Without worker threads we have to do the job ourselves.
+  if (m_workers.empty())
+    Process(job);
+  else
+    m_jobs.Post(job);
+  return id;
+}
+
+bool ImageExportQueue::Succeeded(long job)
+{
+  wxMutexLocker lock(m_mutex);
+  return m_failed.find(job) == m_failed.end();
+}
+
+void ImageExportQueue::Process(Job *job)
+{
+  bool success = false;
+  if (job->m_type == Job::png)
+    success = job->m_image.SaveFile(job->m_file, wxBITMAP_TYPE_PNG);
+  else
+    success = SlideShow::FramesToGif(job->m_frames, job->m_file, job->m_delay);
+
+  if (!success)
+  {
+    wxMutexLocker lock(m_mutex);
+    m_failed.insert(job->m_id);
+  }
+  delete job;
+}
+
+wxThread::ExitCode ImageExportQueue::Worker::Entry()
+{
+  ImageExportQueue::Job *job;
+  while (m_queue->m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR)
+  {
+    if (job->m_type == Job::quit)
+    {
+      delete job;
+      break;
+    }
+    m_queue->Process(job);
+  }
+  return static_cast<ExitCode>(0);
+}
@@ -0,0 +1,134 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef IMAGEEXPORTQUEUE_H
+#define IMAGEEXPORTQUEUE_H
+
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include <wx/image.h>
+#include <vector>
+#include <set>
+
+/*!\file
+
+  This file declares the class ImageExportQueue.
+
+  ImageExportQueue encodes and saves the images of an export on background threads.
+ */
+
+/*! Encodes and saves the images of an export on a pool of background threads
+
+  Drawing the worksheet needs the GUI thread: wxWidgets' draw contexts (and the
+  text measurements even a wxSVGFileDC does using a wxScreenDC) only are safe
+  to use from there. Compressing a 3x scaled bitmap to a .png file or reducing
+  the frames of an animation to 256 colors and encoding them as a .gif, on the
+  other hand, only needs wxImages and therefore can be done by the workers of
+  this queue while the GUI thread renders the next equation.
+
+  The image data that is handed to the queue is owned by the worker threads
+  from then on: wxImage's reference counting isn't thread-safe.
+ */
+class ImageExportQueue
+{
+public:
+  //! Starts the worker threads
+  ImageExportQueue();
+  //! Waits for all jobs to be finished
+  ~ImageExportQueue();
+
+  /*! Saves an image as .png file
+
+    \param image The image. Is invalid after the call as the worker thread
+                 has taken over the image data.
+    \param file The name of the file to write to
+    \return The number of the job. Is needed for Succeeded().
+   */
+  long SavePNG(wxImage &image, const wxString &file);
+
+  /*! Saves the frames of an animation as animated .gif file
+
+    \param frames The unquantized frames. Is emptied as the worker thread
+                  has taken over the image data.
+    \param file The name of the file to write to
+    \param delay The delay between two frames [in ms]
+    \return The number of the job. Is needed for Succeeded().
+   */
+  long SaveGIF(wxImageArray &frames, const wxString &file, int delay);
+
+  //! Waits until all jobs have been processed and stops the worker threads.
+  void Finish();
+
+  //! Has a job succeeded? Is only meaningful after Finish() has been called.
+  bool Succeeded(long job);
+
+private:
+  //! A file that waits to be written
+  struct Job
+  {
+    enum JobType
+    {
+      png,
+      gif,
+      quit //!< Tells the worker thread to exit
+    };
+    JobType m_type;
+    //! The image for png jobs
+    wxImage m_image;
+    //! The frames for gif jobs
+    wxImageArray m_frames;
+    //! The delay between two frames for gif jobs
+    int m_delay;
+    //! The file name. A copy only the worker thread may access.
+    wxString m_file;
+    long m_id;
+  };
+
+  //! A thread that processes the jobs the queue hands it.
+  class Worker : public wxThread
+  {
+  public:
+    explicit Worker(ImageExportQueue *queue) : wxThread(wxTHREAD_JOINABLE){m_queue = queue;}
+  protected:
+    virtual ExitCode Entry();
+  private:
+    ImageExportQueue *m_queue;
+  };
+
+  //! Hands a job to the worker threads - or processes it if there are none.
+  long Post(Job *job);
+  //! Processes one job and deletes it
+  void Process(Job *job);
+
+  //! The jobs that wait to be processed. They are deleted by the worker thread.
+  wxMessageQueue<Job *> m_jobs;
+  //! The threads that write our files
+  std::vector<Worker *> m_workers;
+  //! Protects m_failed
+  wxMutex m_mutex;
+  //! The jobs that have failed
+  std::set<long> m_failed;
+  //! The number of the last job
+  long m_lastJob;
+};
+
+#endif // IMAGEEXPORTQUEUE_H
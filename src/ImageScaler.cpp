@@ -0,0 +1,208 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ImageScaler
+
+  ImageScaler decodes and rescales images on a pool of background threads.
+ */
+
+#include "ImageScaler.h"
+#include <wx/mstream.h>
+
+ImageScaler *ImageScaler::m_pool = NULL;
+
+ImageScaler *ImageScaler::Get()
+{
+  if (m_pool == NULL)
+    m_pool = new ImageScaler();
+  return m_pool;
+}
+
+void ImageScaler::Destroy()
+{
+  wxDELETE(m_pool);
+}
+
+ImageScaler::ImageScaler()
+{
+  m_lastJob = 0;
+
+  // Leave one core for the GUI thread.
+  int threads = wxThread::GetCPUCount() - 1;
+  if (threads > 4)
+    threads = 4;
+  if (threads < 1)
+    threads = 1;
+
+  for (int i = 0; i < threads; i++)
+  {
+    Worker *worker = new Worker(this);
+    if (worker->Run() != wxTHREAD_NO_ERROR)
+    {
+      wxLogMessage(_("Cannot start a thread for scaling images."));
+      delete worker;
+      continue;
+    }
+    m_workers.push_back(worker);
+  }
+}
+
+ImageScaler::~ImageScaler()
+{
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    Job *quit = new Job;
+    quit->m_width = quit->m_height = 0;
+    quit->m_id = -1;
+    quit->m_handler = NULL;
+    quit->m_quit = true;
+    m_jobs.Post(quit);
+  }
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i]->Wait();
+    delete m_workers[i];
+  }
+
+  // Jobs the workers haven't picked up any more
+  Job *job;
+  while (m_jobs.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+    delete job;
+}
+
+wxImage ImageScaler::DecodeAndScale(const void *data, size_t length, int width, int height)
+{
+  wxImage image;
+  if (length > 0)
+  {
+    wxMemoryInputStream istream(data, length);
+    image.LoadFile(istream, wxBITMAP_TYPE_ANY);
+  }
+
+  if (image.IsOk() && (width > 0) && (height > 0) &&
+      ((image.GetWidth() != width) || (image.GetHeight() != height)))
+    image.Rescale(width, height, wxIMAGE_QUALITY_BICUBIC);
+  return image;
+}
+
+long ImageScaler::Scale(const wxMemoryBuffer &compressedImage, int width, int height, wxEvtHandler *handler)
+{
+  long id;
+  {
+    wxMutexLocker lock(m_mutex);
+    id = ++m_lastJob;
+    if (handler != NULL)
+      m_forgottenHandlers.erase(handler);
+  }
+
+  // Without worker threads we have to do the job ourselves.
+  if (m_workers.empty())
+  {
+    wxImage image = DecodeAndScale(compressedImage.GetData(), compressedImage.GetDataLen(),
+                                   width, height);
+    wxMutexLocker lock(m_mutex);
+    m_results[id] = image;
+    return id;
+  }
+
+  Job *job = new Job;
+  // wxMemoryBuffer's reference counting isn't thread-safe => The worker
+  // thread gets a copy of its own.
+  job->m_compressedImage.AppendData(compressedImage.GetData(), compressedImage.GetDataLen());
+  job->m_width = width;
+  job->m_height = height;
+  job->m_id = id;
+  job->m_handler = handler;
+  job->m_quit = false;
+  m_jobs.Post(job);
+  return id;
+}
+
+bool ImageScaler::GetResult(long job, wxImage &image)
+{
+  wxMutexLocker lock(m_mutex);
+  std::map<long, wxImage>::iterator it = m_results.find(job);
+  if (it == m_results.end())
+    return false;
+  image = it->second;
+  m_results.erase(it);
+  return true;
+}
+
+void ImageScaler::Cancel(long job)
+{
+  wxMutexLocker lock(m_mutex);
+  if (m_results.erase(job) == 0)
+    m_cancelled.insert(job);
+}
+
+void ImageScaler::ForgetHandler(wxEvtHandler *handler)
+{
+  wxMutexLocker lock(m_mutex);
+  m_forgottenHandlers.insert(handler);
+}
+
+void ImageScaler::Process(Job *job)
+{
+  {
+    wxMutexLocker lock(m_mutex);
+    if (m_cancelled.erase(job->m_id) > 0)
+      return;
+  }
+
+  wxImage image = DecodeAndScale(job->m_compressedImage.GetData(),
+                                 job->m_compressedImage.GetDataLen(),
+                                 job->m_width, job->m_height);
+
+  wxMutexLocker lock(m_mutex);
+  if (m_cancelled.erase(job->m_id) > 0)
+    return;
+  m_results[job->m_id] = image;
+  // wxImage's reference counting isn't thread-safe, either => Let the GUI
+  // thread be the only owner of the image before unlocking the mutex.
+  image = wxImage();
+
+  if ((job->m_handler != NULL) &&
+      (m_forgottenHandlers.find(job->m_handler) == m_forgottenHandlers.end()))
+  {
+    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, ImageScaled());
+    event->SetInt(job->m_id);
+    wxQueueEvent(job->m_handler, event);
+  }
+}
+
+wxThread::ExitCode ImageScaler::Worker::Entry()
+{
+  ImageScaler::Job *job;
+  while (m_pool->m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR)
+  {
+    if (job->m_quit)
+    {
+      delete job;
+      break;
+    }
+    m_pool->Process(job);
+    delete job;
+  }
+  return static_cast<ExitCode>(0);
+}
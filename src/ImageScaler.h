@@ -0,0 +1,148 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef IMAGESCALER_H
+#define IMAGESCALER_H
+
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include <wx/event.h>
+#include <wx/image.h>
+#include <wx/buffer.h>
+#include <vector>
+#include <map>
+#include <set>
+
+/*!\file
+
+  This file declares the class ImageScaler.
+
+  ImageScaler decodes and rescales images on a pool of background threads.
+ */
+
+/*! Decodes and rescales images on a pool of background threads
+
+  Decoding a big plot and rescaling it with bicubic interpolation takes long
+  enough to make scrolling or zooming a worksheet with many plots stall if it is
+  done while painting. This class does this work in worker threads instead. It
+  only creates wxImages: Converting them to wxBitmaps has to be done by the
+  GUI thread.
+
+  Once a job is finished a wxThreadEvent with the id ImageScaler::ImageScaled()
+  is sent to the event handler the job was given. The result can then be
+  picked up by GetResult().
+ */
+class ImageScaler
+{
+public:
+  //! Returns the pool, starting it if necessary.
+  static ImageScaler *Get();
+  //! Stops all worker threads. To be called on exiting the program.
+  static void Destroy();
+  //! Is the pool running?
+  static bool Running(){return m_pool != NULL;}
+
+  //! The id of the wxThreadEvents that inform that an image has been scaled
+  static int ImageScaled(){return wxID_HIGHEST + 4000;}
+
+  /*! Decodes an image and rescales it to the size it is displayed with.
+
+    Used by the worker threads - but can be used by anyone who needs the result
+    synchronously.
+    \return The scaled image or an invalid image if the data could not be decoded.
+   */
+  static wxImage DecodeAndScale(const void *data, size_t length, int width, int height);
+
+  /*! Schedules an image for being decoded and rescaled
+
+    \param compressedImage The image in its compressed form
+    \param width The width the image is to be scaled to
+    \param height The height the image is to be scaled to
+    \param handler The event handler to inform once the image is ready. May be NULL.
+    \return The number of the job. Is needed for GetResult() and Cancel().
+   */
+  long Scale(const wxMemoryBuffer &compressedImage, int width, int height, wxEvtHandler *handler);
+
+  /*! Picks up the result of a job
+
+    \return false, if the job isn't finished, yet. Else the image is returned in
+    image - which is invalid if the image could not be decoded.
+   */
+  bool GetResult(long job, wxImage &image);
+
+  //! Tells the pool that we no more are interested in the result of this job
+  void Cancel(long job);
+
+  //! Don't inform this event handler about finished jobs any more
+  void ForgetHandler(wxEvtHandler *handler);
+
+private:
+  ImageScaler();
+  ~ImageScaler();
+
+  //! An image that waits to be scaled
+  struct Job
+  {
+    //! The compressed image. Only the worker thread may access this copy.
+    wxMemoryBuffer m_compressedImage;
+    int m_width;
+    int m_height;
+    long m_id;
+    wxEvtHandler *m_handler;
+    //! Tells the worker thread to exit
+    bool m_quit;
+  };
+
+  //! A thread that scales the images the pool hands it.
+  class Worker : public wxThread
+  {
+  public:
+    explicit Worker(ImageScaler *pool) : wxThread(wxTHREAD_JOINABLE){m_pool = pool;}
+  protected:
+    virtual ExitCode Entry();
+  private:
+    ImageScaler *m_pool;
+  };
+
+  //! Scales one image, if it is still needed
+  void Process(Job *job);
+
+  //! The only instance of this class
+  static ImageScaler *m_pool;
+
+  //! The jobs that wait to be processed. They are deleted by the worker thread.
+  wxMessageQueue<Job *> m_jobs;
+  //! The threads that scale our images
+  std::vector<Worker *> m_workers;
+  //! Protects all data below this mutex
+  wxMutex m_mutex;
+  //! The images that are ready
+  std::map<long, wxImage> m_results;
+  //! The jobs nobody is interested in any more
+  std::set<long> m_cancelled;
+  //! The event handlers that have gone away
+  std::set<wxEvtHandler *> m_forgottenHandlers;
+  //! The number of the last job
+  long m_lastJob;
+};
+
+#endif // IMAGESCALER_H
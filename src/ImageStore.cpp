@@ -0,0 +1,220 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ImageStore
+
+  ImageStore makes sure an export writes identical images only once.
+ */
+
+#include "ImageStore.h"
+#include "ImageExportQueue.h"
+#include "Configuration.h"
+#include "ImgCell.h"
+#include "ErrorRedirector.h"
+#include <wx/filename.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
+ImageStore::ImageStore(const wxString &dir, const wxString &prefix)
+{
+  m_dir = dir;
+  m_prefix = prefix;
+  ReadIndex();
+}
+
+wxString ImageStore::Hash(const void *data, size_t length)
+{
+  // A 64-bit FNV-1a hash
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  wxUint64 hash = wxULL(0xcbf29ce484222325);
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= bytes[i];
+    hash *= wxULL(0x100000001b3);
+  }
+  return wxString::Format(wxT("%08x%08x"),
+                          static_cast<wxUint32>(hash >> 32), static_cast<wxUint32>(hash));
+}
+
+wxString ImageStore::Id(const wxString &key)
+{
+  wxScopedCharBuffer utf8 = key.utf8_str();
+  return Hash(utf8.data(), utf8.length());
+}
+
+wxString ImageStore::Style(Configuration *configuration)
+{
+  // Is to be increased every time the way equations are rendered changes: The
+  // images older wxMaxima versions have written are outdated then.
+  wxString style = wxT("style 1\n");
+
+  style += wxString::Format(wxT("fonts %s|%s|%i|%i|%i\n"),
+                            configuration->GetFontName(), configuration->GetFontName(TS_NUMBER),
+                            configuration->GetDefaultFontSize(), configuration->GetMathFontSize(),
+                            static_cast<int>(configuration->GetFontEncoding()));
+  for (int st = 0; st < NUMBEROFSTYLES; st++)
+    style += wxString::Format(wxT("%i %s|%s|%i|%i|%i|%i\n"), st,
+                              configuration->m_styles[st].FontName(),
+                              configuration->m_styles[st].Color().GetAsString(wxC2S_HTML_SYNTAX),
+                              configuration->m_styles[st].FontSize(),
+                              configuration->m_styles[st].Bold(),
+                              configuration->m_styles[st].Italic(),
+                              configuration->m_styles[st].Underlined());
+  style += wxString::Format(wxT("zoom %g\n"), configuration->GetZoomFactor());
+  style += wxString::Format(wxT("digits %i\n"), configuration->GetDisplayedDigits());
+  style += wxString::Format(wxT("labels %i\n"), configuration->GetLabelChoice());
+  style += wxString::Format(wxT("asterisk %i\n"), configuration->GetChangeAsterisk());
+  style += wxString::Format(wxT("percent %i\n"), configuration->CheckKeepPercent());
+  style += wxString::Format(wxT("texfonts %i|%s|%s|%s|%s\n"), configuration->CheckTeXFonts(),
+                            configuration->GetTeXCMRI(), configuration->GetTeXCMSY(),
+                            configuration->GetTeXCMEX(), configuration->GetTeXCMMI());
+  style += wxString::Format(wxT("latin2greek %i\n"), configuration->Latin2Greek());
+  style += wxString::Format(wxT("unicode %i\n"), configuration->UseUnicodeMaths());
+  style += wxString::Format(wxT("subscript %i\n"), configuration->GetAutosubscript_Num());
+  style += wxString::Format(wxT("antialias %i\n"), configuration->AntiAliasLines());
+  style += wxString::Format(wxT("linewidth %i\n"), configuration->LineWidth_em());
+  return style;
+}
+
+ImageStore::Entry *ImageStore::Find(const wxString &id, const wxString &ext)
+{
+  EntryMap::iterator it = m_images.find(id);
+  if ((it != m_images.end()) && (it->second.m_ext == ext))
+    return &it->second;
+
+  it = m_previousImages.find(id);
+  if ((it == m_previousImages.end()) || (it->second.m_ext != ext))
+    return NULL;
+
+  // Somebody might have deleted the file since the last export.
+  Entry entry = it->second;
+  m_previousImages.erase(it);
+  if (!wxFileExists(GetFileName(id, ext)))
+    return NULL;
+  m_images[id] = entry;
+  return &m_images[id];
+}
+
+void ImageStore::Add(const wxString &id, const wxString &ext, wxSize size, long job)
+{
+  Entry entry;
+  entry.m_ext = ext;
+  entry.m_size = size;
+  entry.m_job = job;
+  m_images[id] = entry;
+  m_previousImages.erase(id);
+}
+
+wxString ImageStore::WriteImage(ImgCell *cell, wxSize &size)
+{
+  wxString ext = cell->GetExtension();
+  wxMemoryBuffer data = cell->GetCompressedImage();
+  wxString id = Id(ext + wxT("\n") + Hash(data.GetData(), data.GetDataLen()));
+
+  Entry *stored = Find(id, ext);
+  if (stored != NULL)
+  {
+    size = stored->m_size;
+    return id;
+  }
+
+  size = cell->ToImageFile(GetFileName(id, ext));
+  if (size.x >= 0)
+    Add(id, ext, size);
+  return id;
+}
+
+void ImageStore::ReadIndex()
+{
+  if (!wxFileExists(IndexFileName()))
+    return;
+
+  wxTextFile index(IndexFileName());
+  if (!index.Open())
+    return;
+
+  for (wxString line = index.GetFirstLine(); !index.Eof(); line = index.GetNextLine())
+  {
+    wxStringTokenizer tokens(line, wxT(" "));
+    if (tokens.CountTokens() != 4)
+      continue;
+    wxString id = tokens.GetNextToken();
+    Entry entry;
+    entry.m_ext = tokens.GetNextToken();
+    long width, height;
+    if (!tokens.GetNextToken().ToLong(&width) || !tokens.GetNextToken().ToLong(&height))
+      continue;
+    entry.m_size = wxSize(width, height);
+    entry.m_job = -1;
+    // The file names are built from the index => Don't accept anything that
+    // could point to a file outside the image directory.
+    if ((id.find_first_not_of(wxT("0123456789abcdef")) != wxString::npos) ||
+        (entry.m_ext.find_first_of(wxT("/\\:.")) != wxString::npos))
+      continue;
+    m_previousImages[id] = entry;
+  }
+}
+
+void ImageStore::Finish(ImageExportQueue *queue)
+{
+  SuppressErrorDialogs messageBlocker;
+
+  // The files the last export has written and that no more are in use.
+  for (EntryMap::iterator it = m_previousImages.begin(); it != m_previousImages.end(); ++it)
+  {
+    wxString file = GetFileName(it->first, it->second.m_ext);
+    if (wxFileExists(file))
+      wxRemoveFile(file);
+  }
+  m_previousImages.clear();
+
+  if (!wxDirExists(m_dir))
+    return;
+
+  if (m_images.empty())
+  {
+    if (wxFileExists(IndexFileName()))
+      wxRemoveFile(IndexFileName());
+    return;
+  }
+
+  wxTextFile index(IndexFileName());
+  if (wxFileExists(IndexFileName()))
+  {
+    if (!index.Open())
+      return;
+    index.Clear();
+  }
+  else if (!index.Create())
+    return;
+
+  for (EntryMap::iterator it = m_images.begin(); it != m_images.end(); ++it)
+  {
+    if ((queue != NULL) && (it->second.m_job >= 0) && !queue->Succeeded(it->second.m_job))
+      continue;
+    index.AddLine(wxString::Format(wxT("%s %s %i %i"), it->first, it->second.m_ext,
+                                   it->second.m_size.x, it->second.m_size.y));
+  }
+  index.Write();
+  index.Close();
+}
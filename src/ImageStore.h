@@ -0,0 +1,133 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <wx/string.h>
+#include <wx/gdicmn.h>
+#include <wx/hashmap.h>
+
+class Configuration;
+class ImageExportQueue;
+class ImgCell;
+
+/*!\file
+
+  This file declares the class ImageStore.
+
+  ImageStore makes sure an export writes identical images only once.
+ */
+
+/*! Remembers which images an export has already written
+
+  Teaching material tends to contain the same equation or plot many times. The
+  store gives every image an id that is made from a hash of everything that
+  determines how it looks like, so the image files are named after their
+  contents and an image that appears many times is written only once.
+
+  The store also remembers the images of the last export of the same document
+  in an index file in the image directory: If the document is exported again
+  only images that have changed need to be rendered. Image files the last
+  export has written and this one no more needs are deleted by Finish().
+ */
+class ImageStore
+{
+public:
+  /*! The constructor
+
+    \param dir The directory the images are written to
+    \param prefix The start of the names of the image files
+  */
+  ImageStore(const wxString &dir, const wxString &prefix);
+
+  //! An image the store knows of
+  struct Entry
+  {
+    //! The file name extension of the image file
+    wxString m_ext;
+    //! The size the export has recorded for this image
+    wxSize m_size;
+    //! The ImageExportQueue job that writes the file or -1, if it already exists.
+    long m_job;
+  };
+
+  //! Calculates the id of the image that is described by key
+  static wxString Id(const wxString &key);
+
+  //! A hash of binary data that can be used as part of a key
+  static wxString Hash(const void *data, size_t length);
+
+  /*! A description of all settings that influence how the cells are rendered
+
+    To be made part of the key of rendered equations, so changing a font, a color,
+    the zoom factor or how numbers and labels are displayed causes them to be
+    rendered anew.
+   */
+  static wxString Style(Configuration *configuration);
+
+  /*! Looks up an image
+
+    \return The image or NULL, if it has still to be written. Images a previous
+    export has written are only returned if their file still exists.
+  */
+  Entry *Find(const wxString &id, const wxString &ext);
+
+  //! Records that the image with this id has been (or is being) written
+  void Add(const wxString &id, const wxString &ext, wxSize size, long job = -1);
+
+  /*! Writes the image of an image cell to the store - if it isn't there already
+
+    \param cell The cell whose image is to be written
+    \param size Returns the size ImgCell::ToImageFile() has returned for the image.
+    \return The image's id
+  */
+  wxString WriteImage(ImgCell *cell, wxSize &size);
+
+  //! The full path of the file the image with this id is stored in
+  wxString GetFileName(const wxString &id, const wxString &ext) const
+    {return m_dir + wxT("/") + m_prefix + wxT("_") + id + wxT(".") + ext;}
+
+  /*! Writes the index and deletes the images the last export needed, but this one doesn't
+
+    \param queue The queue that has written the images. Images whose job has
+    failed will not be written to the index.
+  */
+  void Finish(ImageExportQueue *queue = NULL);
+
+private:
+  WX_DECLARE_STRING_HASH_MAP(Entry, EntryMap);
+
+  //! The name of the file the index is stored in
+  wxString IndexFileName() const {return m_dir + wxT("/") + m_prefix + wxT(".images");}
+  //! Reads the index the last export has written
+  void ReadIndex();
+
+  wxString m_dir;
+  wxString m_prefix;
+  //! The images this export has written or reused
+  EntryMap m_images;
+  //! The images the last export has written that haven't been reused yet
+  EntryMap m_previousImages;
+};
+
+#endif // IMAGESTORE_H
@@ -36,7 +36,6 @@
 #include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/filesys.h>
-#include <wx/fs_mem.h>
 #include <wx/clipbrd.h>
 #include <wx/mstream.h>
 
@@ -74,14 +73,15 @@ ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellpointer
 int ImgCell::s_counter = 0;
 
 // constructor which load image
-ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellpointers, wxString image, bool remove, wxFileSystem *filesystem)
+ImgCell::ImgCell(Cell *parent, Configuration **config, CellPointers *cellpointers, wxString image, bool remove,
+                 wxFileSystem *filesystem, wxSize originalSize)
         : Cell(parent, config)
 {
   m_cellPointers = cellpointers;
   m_type = MC_TYPE_IMAGE;
   m_drawRectangle = true;
   if (image != wxEmptyString)
-    m_image = new Image(m_configuration, image, remove, filesystem);
+    m_image = new Image(m_configuration, image, remove, filesystem, originalSize);
   else
     m_image = new Image(m_configuration);
   m_drawBoundingBox = false;
@@ -91,6 +91,7 @@ void ImgCell::LoadImage(wxString image, bool remove)
 {
   wxDELETE(m_image);
   m_image = new Image(m_configuration, image, remove);
+  XMLChanged();
 }
 
 void ImgCell::SetBitmap(const wxBitmap &bitmap)
@@ -99,6 +100,7 @@ void ImgCell::SetBitmap(const wxBitmap &bitmap)
 
   m_width = m_height = -1;
   m_image = new Image(m_configuration, bitmap);
+  XMLChanged();
 }
 
 Cell *ImgCell::Copy()
@@ -126,6 +128,13 @@ void ImgCell::MarkAsDeleted()
   Cell::MarkAsDeleted();
 }
 
+void ImgCell::SetConfiguration(Configuration **config)
+{
+  Cell::SetConfiguration(config);
+  if (m_image != NULL)
+    m_image->SetConfiguration(config);
+}
+
 std::list<Cell *> ImgCell::GetInnerCells()
 {
   std::list<Cell *> innerCells;
@@ -301,14 +310,12 @@ wxString ImgCell::ToXML()
 {
   wxString basename = m_cellPointers->WXMXGetNewFileName();
 
-  // add the file to memory
+  // add the file to the .wxmx file
   if (m_image)
   {
     if (m_image->GetCompressedImage())
-      wxMemoryFSHandler::AddFile(basename + m_image->GetExtension(),
-                                 m_image->GetCompressedImage().GetData(),
-                                 m_image->GetCompressedImage().GetDataLen()
-      );
+      m_cellPointers->WXMXAddFile(basename + m_image->GetExtension(), m_image,
+                                  CellPointers::WXMX_IMAGE);
   }
 
   wxString flags;
@@ -324,6 +331,12 @@ wxString ImgCell::ToXML()
   if(m_image->GetMaxHeight() > 0)
     flags += wxString::Format(wxT(" maxHeight=\"%f\""), m_image->GetMaxHeight());
 
+  // Knowing the size of the image allows to load it only once it is displayed.
+  if((m_image != NULL) && (m_image->IsOk()))
+    flags += wxString::Format(wxT(" originalWidth=\"%li\" originalHeight=\"%li\""),
+                              (long) m_image->GetOriginalWidth(),
+                              (long) m_image->GetOriginalHeight());
+
   if (m_image)
   {
     // Anonymize the name of our temp directory for saving
@@ -344,26 +357,14 @@ wxString ImgCell::ToXML()
     if(gnuplotSource != wxEmptyString)
     {
       flags += " gnuplotsource=\"" + gnuplotSource + "\"";
-      wxMemoryBuffer data = m_image->GetGnuplotSource();
-      if(data.GetDataLen() > 0)
-      {
-        wxMemoryFSHandler::AddFile(gnuplotSource,
-                                   data.GetData(),
-                                   data.GetDataLen()
-          );
-      }
+      m_cellPointers->WXMXAddFile(gnuplotSource, m_image,
+                                  CellPointers::WXMX_GNUPLOTSOURCE);
     }
     if(gnuplotData != wxEmptyString)
     {
       flags += " gnuplotdata=\"" + gnuplotData + "\"";
-      wxMemoryBuffer data = m_image->GetGnuplotData();
-      if(data.GetDataLen() > 0)
-      {
-        wxMemoryFSHandler::AddFile(gnuplotData,
-                                   data.GetData(),
-                                   data.GetDataLen()
-          );
-      }
+      m_cellPointers->WXMXAddFile(gnuplotData, m_image,
+                                  CellPointers::WXMX_GNUPLOTDATA);
     }
   }
   
@@ -37,8 +37,13 @@ public:
 
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, wxMemoryBuffer image, wxString type);
 
+  /*! A constructor that loads an image
+
+    If the image is read from a .wxmx file and originalSize is known the image is
+    only read once it is needed.
+   */
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, wxString image, bool remove = true,
-          wxFileSystem *filesystem = NULL);
+          wxFileSystem *filesystem = NULL, wxSize originalSize = wxDefaultSize);
 
   ImgCell(Cell *parent, Configuration **config, CellPointers *cellPointers, const wxBitmap &bitmap);
 
@@ -92,6 +97,8 @@ public:
   virtual void ClearCache()
   { if (m_image)m_image->ClearCache(); }
 
+  virtual void SetConfiguration(Configuration **config);
+
   virtual wxString GetToolTip(const wxPoint &point);
   
   //! Sets the bitmap that is shown
@@ -101,7 +108,7 @@ public:
   bool CopyToClipboard();
 
   void DrawRectangle(bool draw)
-  { m_drawRectangle = draw; }
+  { m_drawRectangle = draw; XMLChanged(); }
 
   //! Returns the file name extension that matches the image type
   wxString GetExtension()
@@ -109,12 +116,12 @@ public:
 
   //! Returnes the original compressed version of the image
   wxMemoryBuffer GetCompressedImage()
-  { return m_image->m_compressedImage; }
+  { return m_image->GetCompressedImage(); }
 
   double GetMaxWidth(){if(m_image != NULL) return m_image->GetMaxWidth(); else return -1;}
   double GetMaxHeight(){if(m_image != NULL) return m_image->GetMaxHeight();else return -1;}
-  void SetMaxWidth(double width){if(m_image != NULL) return m_image->SetMaxWidth(width);}
-  void SetMaxHeight(double height){if(m_image != NULL) return m_image->SetMaxHeight(height);}
+  void SetMaxWidth(double width){if(m_image != NULL) m_image->SetMaxWidth(width); XMLChanged();}
+  void SetMaxHeight(double height){if(m_image != NULL) m_image->SetMaxHeight(height); XMLChanged();}
 
 protected:
   Image *m_image;
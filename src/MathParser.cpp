@@ -29,6 +29,8 @@
 #include <wx/sstream.h>
 #include <wx/regex.h>
 #include <wx/intl.h>
+#include <wx/stopwatch.h>
+#include <wx/utils.h>
 
 #include "MathParser.h"
 
@@ -85,6 +87,11 @@ MathParser::MathParser(Configuration **cfg, Cell::CellPointers *cellPointers, wx
   m_ParserStyle = MC_TYPE_DEFAULT;
   m_FracStyle = FracCell::FC_NORMAL;
   m_highlight = false;
+  m_streamPos = 0;
+  m_streamError = false;
+  m_benchmark = wxGetEnv(wxT("WXMAXIMA_BENCHMARK_MATHPARSER"), NULL);
+  m_streamingParserTime = 0;
+  m_domParserTime = 0;
   if (zipfile.Length() > 0)
   {
     m_fileSystem = new wxFileSystem();
@@ -94,6 +101,8 @@ MathParser::MathParser(Configuration **cfg, Cell::CellPointers *cellPointers, wx
     m_fileSystem = NULL;
 }
 
+wxAtomicInt MathParser::s_parsersDisagreed = 0;
+
 MathParser::~MathParser()
 {
   if (m_fileSystem)
@@ -458,8 +467,17 @@ Cell *MathParser::ParseFunTag(wxXmlNode *node)
 Cell *MathParser::ParseText(wxXmlNode *node, TextStyle style)
 {
   wxString str;
+  if (node != NULL)
+    str = node->GetContent();
+  TextCell *retval = ParseTextContents(str, style);
+  ParseCommonAttrs(node, retval);
+  return retval;
+}
+
+TextCell *MathParser::ParseTextContents(wxString str, TextStyle style)
+{
   TextCell *retval = NULL;
-  if ((node != NULL) && ((str = node->GetContent()) != wxEmptyString))
+  if (str != wxEmptyString)
   {
     str.Replace(wxT("-"), wxT("\x2212")); // unicode minus sign
 
@@ -505,7 +523,6 @@ Cell *MathParser::ParseText(wxXmlNode *node, TextStyle style)
   if (retval == NULL)
     retval = new TextCell(NULL, m_configuration, m_cellPointers);
 
-  ParseCommonAttrs(node, retval);
   return retval;
 }
 
@@ -524,11 +541,33 @@ void MathParser::ParseCommonAttrs(wxXmlNode *node, Cell *cell)
     cell->SetToolTip(toolTip);
 }
 
+void MathParser::ParseCommonAttrs(const StreamTag &tag, Cell *cell)
+{
+  if(cell == NULL)
+    return;
+
+  if(tag.GetAttribute(wxT("breakline"), wxT("false")) == wxT("true"))
+    cell->ForceBreakLine(true);
+
+  wxString toolTip = tag.GetAttribute(wxT("tooltip"), wxEmptyString);
+  if(toolTip != wxEmptyString)
+    cell->SetToolTip(toolTip);
+}
+
 Cell *MathParser::ParseCharCode(wxXmlNode *node, TextStyle style)
 {
-  TextCell *cell = new TextCell(NULL, m_configuration, m_cellPointers);
   wxString str;
-  if ((node != NULL) && ((str = node->GetContent()) != wxEmptyString))
+  if (node != NULL)
+    str = node->GetContent();
+  TextCell *cell = ParseCharCodeContents(str, style);
+  ParseCommonAttrs(node, cell);
+  return cell;
+}
+
+TextCell *MathParser::ParseCharCodeContents(wxString str, TextStyle style)
+{
+  TextCell *cell = new TextCell(NULL, m_configuration, m_cellPointers);
+  if (str != wxEmptyString)
   {
     long code;
     if (str.ToLong(&code))
@@ -538,7 +577,6 @@ Cell *MathParser::ParseCharCode(wxXmlNode *node, TextStyle style)
     cell->SetStyle(style);
     cell->SetHighlight(m_highlight);
   }
-  ParseCommonAttrs(node, cell);
   return cell;
 }
 
@@ -880,7 +918,15 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
         wxString filename(node->GetChildren()->GetContent());
 
         if (m_fileSystem) // loading from zip
-          imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, filename, false, m_fileSystem);
+        {
+          // If we know the image's size we don't need to read it before it is displayed.
+          long originalWidth = -1;
+          long originalHeight = -1;
+          node->GetAttribute(wxT("originalWidth"), wxT("-1")).ToLong(&originalWidth);
+          node->GetAttribute(wxT("originalHeight"), wxT("-1")).ToLong(&originalHeight);
+          imageCell = new ImgCell(NULL, m_configuration, m_cellPointers, filename, false, m_fileSystem,
+                                  wxSize(originalWidth, originalHeight));
+        }
         else
         {
           if (node->GetAttribute(wxT("del"), wxT("yes")) != wxT("no"))
@@ -953,8 +999,21 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
             images.Add(token);
           }
         }
+        // The sizes of the frames, if known
+        std::vector<wxSize> sizes;
+        wxStringTokenizer sizeTokens(node->GetAttribute(wxT("sizes"), wxEmptyString), wxT(";"));
+        while (sizeTokens.HasMoreTokens())
+        {
+          wxString token = sizeTokens.GetNextToken();
+          long width = -1;
+          long height = -1;
+          if ((!token.BeforeFirst(wxT('x')).ToLong(&width)) ||
+              (!token.AfterFirst(wxT('x')).ToLong(&height)))
+            width = height = -1;
+          sizes.push_back(wxSize(width, height));
+        }
         if (slideShow)
-          slideShow->LoadImages(images, del);
+          slideShow->LoadImages(images, del, sizes);
         tmp = slideShow;
       }
       else if (tagName == wxT("editor"))
@@ -1030,6 +1089,22 @@ Cell *MathParser::ParseTag(wxXmlNode *node, bool all)
   return retval;
 }
 
+Cell *MathParser::ParseLineUsingDOM(const wxString &s)
+{
+  wxXmlDocument xml;
+
+  wxStringInputStream xmlStream(s);
+
+  xml.Load(xmlStream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
+
+  wxXmlNode *doc = xml.GetRoot();
+
+  if (doc != NULL)
+    return ParseTag(doc->GetChildren());
+  else
+    return NULL;
+}
+
 /***
  * Parse the string s, which is (correct) xml fragment.
  * Put the result in line.
@@ -1065,17 +1140,35 @@ Cell *MathParser::ParseLine(wxString s, CellType style)
 
   if (((long) s.Length() < showLength) || (showLength == 0))
   {
-
-    wxXmlDocument xml;
-
-    wxStringInputStream xmlStream(s);
-
-    xml.Load(xmlStream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
-
-    wxXmlNode *doc = xml.GetRoot();
-
-    if (doc != NULL)
-      cell = ParseTag(doc->GetChildren());
+    if (!m_benchmark)
+    {
+      cell = ParseLineStreaming(s);
+      if (cell == NULL)
+        cell = ParseLineUsingDOM(s);
+    }
+    else
+    {
+      wxStopWatch streamingTime;
+      cell = ParseLineStreaming(s);
+      m_streamingParserTime += streamingTime.Time();
+      wxStopWatch domTime;
+      Cell *domCell = ParseLineUsingDOM(s);
+      m_domParserTime += domTime.Time();
+      if ((cell != NULL) &&
+          ((domCell == NULL) ||
+           (cell->ListToXML() != domCell->ListToXML()) ||
+           (cell->ListToString() != domCell->ListToString())))
+      {
+        wxLogMessage(wxString::Format(_("The streaming and the DOM parser gave different results for %s"), s));
+        wxAtomicInc(s_parsersDisagreed);
+      }
+      wxLogMessage(wxString::Format(_("Parsed %li chars of math: Streaming parser: %li ms, DOM parser: %li ms in total"),
+                                    (long) s.Length(), m_streamingParserTime, m_domParserTime));
+      if (cell == NULL)
+        cell = domCell;
+      else
+        wxDELETE(domCell);
+    }
   }
   else
   {
@@ -1089,3 +1182,905 @@ Cell *MathParser::ParseLine(wxString s, CellType style)
   }
   return cell;
 }
+
+///--------------------------------------------------------------------------------
+///  The streaming parser
+///--------------------------------------------------------------------------------
+
+wxString MathParser::StreamTag::GetAttribute(const wxString &name, const wxString &defaultVal) const
+{
+  wxString value;
+  if (GetAttribute(name, &value))
+    return value;
+  else
+    return defaultVal;
+}
+
+bool MathParser::StreamTag::GetAttribute(const wxString &name, wxString *value) const
+{
+  for (size_t i = 0; i < m_attributeNames.GetCount(); i++)
+  {
+    if (m_attributeNames[i] == name)
+    {
+      if (value != NULL)
+        *value = m_attributeValues[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+Cell *MathParser::ParseLineStreaming(const wxString &s)
+{
+  m_stream = s;
+  m_streamPos = 0;
+  m_streamError = false;
+
+  // Like ParseLineUsingDOM() we parse the children of the root element
+  Cell *cell = NULL;
+  StreamSkipWhitespace();
+  StreamTag root;
+  if (StreamAtStartTag() && StreamReadStartTag(root))
+    cell = StreamParseChildren(root);
+  else
+    m_streamError = true;
+
+  // Only whitespace may follow the root element
+  while ((!m_streamError) && (!StreamAtEnd()))
+  {
+    if (!wxIsspace(m_stream[m_streamPos]))
+      m_streamError = true;
+    m_streamPos++;
+  }
+
+  if (m_streamError)
+    wxDELETE(cell);
+
+  m_stream = wxEmptyString;
+  return cell;
+}
+
+bool MathParser::StreamAtEndTag() const
+{
+  return (m_streamPos + 1 < m_stream.Length()) &&
+    (m_stream[m_streamPos] == wxT('<')) && (m_stream[m_streamPos + 1] == wxT('/'));
+}
+
+bool MathParser::StreamAtStartTag()
+{
+  if ((StreamAtEnd()) || (m_stream[m_streamPos] != wxT('<')))
+    return false;
+  if (m_streamPos + 1 >= m_stream.Length())
+  {
+    m_streamError = true;
+    return false;
+  }
+  wxChar next = m_stream[m_streamPos + 1];
+  // Comments, CDATA sections and processing instructions are left to the
+  // wxXmlDocument-based parser.
+  if ((next == wxT('!')) || (next == wxT('?')))
+  {
+    m_streamError = true;
+    return false;
+  }
+  return next != wxT('/');
+}
+
+wxString MathParser::StreamReadEntity()
+{
+  size_t end = m_stream.find(wxT(';'), m_streamPos);
+  if (end == wxString::npos)
+  {
+    m_streamError = true;
+    return wxEmptyString;
+  }
+  wxString entity = m_stream.SubString(m_streamPos + 1, end - 1);
+  m_streamPos = end + 1;
+
+  if (entity == wxT("lt"))
+    return wxT("<");
+  if (entity == wxT("gt"))
+    return wxT(">");
+  if (entity == wxT("amp"))
+    return wxT("&");
+  if (entity == wxT("quot"))
+    return wxT("\"");
+  if (entity == wxT("apos"))
+    return wxT("'");
+
+  unsigned long code;
+  if ((entity.StartsWith(wxT("#x"))) && (entity.Mid(2).ToULong(&code, 16)))
+    return wxString(wxUniChar(code));
+  if ((entity.StartsWith(wxT("#"))) && (entity.Mid(1).ToULong(&code, 10)))
+    return wxString(wxUniChar(code));
+
+  m_streamError = true;
+  return wxEmptyString;
+}
+
+wxString MathParser::StreamReadText()
+{
+  wxString text;
+  while ((!m_streamError) && (!StreamAtEnd()))
+  {
+    wxChar ch = m_stream[m_streamPos];
+    if (ch == wxT('<'))
+      break;
+    if (ch == wxT('&'))
+      text += StreamReadEntity();
+    else
+    {
+      // Copy everything up to the next tag or entity in one go
+      size_t end = m_streamPos + 1;
+      while ((end < m_stream.Length()) &&
+             (m_stream[end] != wxT('<')) && (m_stream[end] != wxT('&')))
+        end++;
+      text += m_stream.SubString(m_streamPos, end - 1);
+      m_streamPos = end;
+    }
+  }
+  return text;
+}
+
+void MathParser::StreamSkipWhitespace()
+{
+  if ((StreamAtEnd()) || (m_stream[m_streamPos] == wxT('<')))
+    return;
+
+  size_t start = m_streamPos;
+  wxString contents = StreamReadText();
+  contents.Trim();
+  // The same criterion SkipWhitespaceNode() uses.
+  if (contents.Length() > 1)
+    m_streamPos = start;
+}
+
+bool MathParser::StreamReadStartTag(StreamTag &tag)
+{
+  size_t len = m_stream.Length();
+  m_streamPos++;
+  size_t nameStart = m_streamPos;
+  while ((m_streamPos < len) && (!wxIsspace(m_stream[m_streamPos])) &&
+         (m_stream[m_streamPos] != wxT('/')) && (m_stream[m_streamPos] != wxT('>')))
+    m_streamPos++;
+  tag.m_name = m_stream.SubString(nameStart, m_streamPos - 1);
+  if (tag.m_name.IsEmpty())
+  {
+    m_streamError = true;
+    return false;
+  }
+
+  while (!m_streamError)
+  {
+    while ((m_streamPos < len) && (wxIsspace(m_stream[m_streamPos])))
+      m_streamPos++;
+    if (m_streamPos >= len)
+      break;
+
+    if (m_stream[m_streamPos] == wxT('>'))
+    {
+      m_streamPos++;
+      return true;
+    }
+    if (m_stream[m_streamPos] == wxT('/'))
+    {
+      if ((m_streamPos + 1 < len) && (m_stream[m_streamPos + 1] == wxT('>')))
+      {
+        tag.m_isEmpty = true;
+        m_streamPos += 2;
+        return true;
+      }
+      break;
+    }
+
+    // An attribute
+    size_t attrStart = m_streamPos;
+    while ((m_streamPos < len) && (!wxIsspace(m_stream[m_streamPos])) &&
+           (m_stream[m_streamPos] != wxT('=')))
+      m_streamPos++;
+    wxString name = m_stream.SubString(attrStart, m_streamPos - 1);
+    while ((m_streamPos < len) && (wxIsspace(m_stream[m_streamPos])))
+      m_streamPos++;
+    if ((m_streamPos >= len) || (m_stream[m_streamPos] != wxT('=')))
+      break;
+    m_streamPos++;
+    while ((m_streamPos < len) && (wxIsspace(m_stream[m_streamPos])))
+      m_streamPos++;
+    if ((m_streamPos >= len) ||
+        ((m_stream[m_streamPos] != wxT('"')) && (m_stream[m_streamPos] != wxT('\''))))
+      break;
+    wxChar quote = m_stream[m_streamPos];
+    m_streamPos++;
+    wxString value;
+    while ((!m_streamError) && (m_streamPos < len) && (m_stream[m_streamPos] != quote))
+    {
+      if (m_stream[m_streamPos] == wxT('&'))
+        value += StreamReadEntity();
+      else
+      {
+        value += m_stream[m_streamPos];
+        m_streamPos++;
+      }
+    }
+    if (m_streamPos >= len)
+      break;
+    m_streamPos++;
+    tag.m_attributeNames.Add(name);
+    tag.m_attributeValues.Add(value);
+  }
+  m_streamError = true;
+  return false;
+}
+
+void MathParser::StreamReadEndTag(const StreamTag &tag)
+{
+  if (m_streamError)
+    return;
+  if (!StreamAtEndTag())
+  {
+    m_streamError = true;
+    return;
+  }
+  size_t end = m_stream.find(wxT('>'), m_streamPos);
+  if (end == wxString::npos)
+  {
+    m_streamError = true;
+    return;
+  }
+  wxString name = m_stream.SubString(m_streamPos + 2, end - 1);
+  name.Trim();
+  if (name != tag.GetName())
+    m_streamError = true;
+  m_streamPos = end + 1;
+}
+
+void MathParser::StreamSkipToEndTag(const StreamTag &tag)
+{
+  if (tag.IsEmpty())
+    return;
+
+  int depth = 0;
+  while (!m_streamError)
+  {
+    if (StreamAtEnd())
+    {
+      m_streamError = true;
+      return;
+    }
+    if (StreamAtEndTag())
+    {
+      if (depth == 0)
+      {
+        StreamReadEndTag(tag);
+        return;
+      }
+      size_t end = m_stream.find(wxT('>'), m_streamPos);
+      if (end == wxString::npos)
+      {
+        m_streamError = true;
+        return;
+      }
+      m_streamPos = end + 1;
+      depth--;
+    }
+    else if (StreamAtStartTag())
+    {
+      StreamTag child;
+      if (StreamReadStartTag(child) && !child.IsEmpty())
+        depth++;
+    }
+    else
+      StreamReadText();
+  }
+}
+
+Cell *MathParser::StreamParseTag(bool all)
+{
+  Cell *retval = NULL;
+  Cell *cell = NULL;
+
+  StreamSkipWhitespace();
+
+  while ((!m_streamError) && (!StreamAtEnd()) && (!StreamAtEndTag()))
+  {
+    if (StreamAtStartTag())
+    {
+      StreamTag tag;
+      if (!StreamReadStartTag(tag))
+        break;
+      Cell *tmp = StreamParseElement(tag);
+
+      // The new cell may needing being equipped with a "altCopy" tag.
+      wxString altCopy;
+      if ((tmp != NULL) && (tag.GetAttribute(wxT("altCopy"), &altCopy)))
+        tmp->SetAltCopyText(altCopy);
+
+      // Append the cell we found (tmp) to the list of cells we parsed so far (cell).
+      if (tmp != NULL)
+      {
+        ParseCommonAttrs(tag, tmp);
+        if (cell == NULL)
+          cell = tmp;
+        else
+          cell->AppendCell(tmp);
+      }
+    }
+    else
+    {
+      if (m_streamError)
+        break;
+      // We didn't get a tag but got a text cell => Parse the text.
+      TextCell *text = ParseTextContents(StreamReadText(), TS_DEFAULT);
+      if (cell == NULL)
+        cell = text;
+      else
+        cell->AppendCell(text);
+    }
+
+    if (cell != NULL)
+    {
+      // Append the new cell to the return value
+      if (retval == NULL)
+        retval = cell;
+      else
+        cell = cell->m_next;
+    }
+
+    if (!all)
+      break;
+
+    StreamSkipWhitespace();
+  }
+
+  return retval;
+}
+
+Cell *MathParser::StreamParseChildren(const StreamTag &tag)
+{
+  if (tag.IsEmpty())
+    return NULL;
+  Cell *cell = StreamParseTag(true);
+  StreamReadEndTag(tag);
+  return cell;
+}
+
+Cell *MathParser::StreamParseText(const StreamTag &tag, TextStyle style)
+{
+  wxString str;
+  if (!tag.IsEmpty())
+  {
+    // Tags within text tags are left to the wxXmlDocument-based parser.
+    if (StreamAtStartTag())
+      m_streamError = true;
+    else
+      str = StreamReadText();
+  }
+  Cell *cell = ParseTextContents(str, style);
+  StreamSkipToEndTag(tag);
+  return cell;
+}
+
+Cell *MathParser::StreamParseCharCode(const StreamTag &tag)
+{
+  wxString str;
+  if (!tag.IsEmpty())
+  {
+    if (StreamAtStartTag())
+      m_streamError = true;
+    else
+      str = StreamReadText();
+  }
+  Cell *cell = ParseCharCodeContents(str, TS_DEFAULT);
+  StreamSkipToEndTag(tag);
+  return cell;
+}
+
+Cell *MathParser::StreamParseElement(const StreamTag &tag)
+{
+  wxString tagName(tag.GetName());
+
+  Cell *tmp = NULL;
+  if (tagName == wxT("v"))
+    tmp = StreamParseText(tag, TS_VARIABLE);
+  else if (tagName == wxT("t"))
+  {
+    TextStyle style = TS_DEFAULT;
+    if (tag.GetAttribute(wxT("type")) == wxT("error"))
+      style = TS_ERROR;
+    if (tag.GetAttribute(wxT("type")) == wxT("warning"))
+      style = TS_WARNING;
+    tmp = StreamParseText(tag, style);
+  }
+  else if (tagName == wxT("n"))
+    tmp = StreamParseText(tag, TS_NUMBER);
+  else if (tagName == wxT("h"))
+  {
+    tmp = StreamParseText(tag);
+    tmp->m_isHidden = true;
+  }
+  else if (tagName == wxT("p"))
+    tmp = StreamParseParenTag(tag);
+  else if (tagName == wxT("f"))
+    tmp = StreamParseFracTag(tag);
+  else if (tagName == wxT("e"))
+    tmp = StreamParseSupTag(tag);
+  else if (tagName == wxT("i"))
+    tmp = StreamParseSubTag(tag);
+  else if (tagName == wxT("fn"))
+    tmp = StreamParseFunTag(tag);
+  else if (tagName == wxT("g"))
+    tmp = StreamParseText(tag, TS_GREEK_CONSTANT);
+  else if (tagName == wxT("s"))
+    tmp = StreamParseText(tag, TS_SPECIAL_CONSTANT);
+  else if (tagName == wxT("fnm"))
+    tmp = StreamParseText(tag, TS_FUNCTION);
+  else if (tagName == wxT("q"))
+    tmp = StreamParseSqrtTag(tag);
+  else if (tagName == wxT("d"))
+    tmp = StreamParseDiffTag(tag);
+  else if (tagName == wxT("sm"))
+    tmp = StreamParseSumTag(tag);
+  else if (tagName == wxT("in"))
+    tmp = StreamParseIntTag(tag);
+  else if (tagName == wxT("mspace"))
+  {
+    tmp = new TextCell(NULL, m_configuration, m_cellPointers, wxT(" "));
+    StreamSkipToEndTag(tag);
+  }
+  else if (tagName == wxT("at"))
+    tmp = StreamParseAtTag(tag);
+  else if (tagName == wxT("a"))
+    tmp = StreamParseAbsTag(tag);
+  else if (tagName == wxT("cj"))
+    tmp = StreamParseConjugateTag(tag);
+  else if (tagName == wxT("ie"))
+    tmp = StreamParseSubSupTag(tag);
+  else if (tagName == wxT("lm"))
+    tmp = StreamParseLimitTag(tag);
+  else if (tagName == wxT("r"))
+    tmp = StreamParseChildren(tag);
+  else if (tagName == wxT("tb"))
+    tmp = StreamParseTableTag(tag);
+  else if ((tagName == wxT("mth")) || (tagName == wxT("line")))
+  {
+    tmp = StreamParseChildren(tag);
+    if (tmp != NULL)
+      tmp->ForceBreakLine(true);
+    else
+      tmp = new TextCell(NULL, m_configuration, m_cellPointers, wxT(" "));
+  }
+  else if (tagName == wxT("lbl"))
+    tmp = StreamParseLabelTag(tag);
+  else if (tagName == wxT("st"))
+    tmp = StreamParseText(tag, TS_STRING);
+  else if (tagName == wxT("hl"))
+  {
+    bool highlight = m_highlight;
+    m_highlight = true;
+    tmp = StreamParseChildren(tag);
+    m_highlight = highlight;
+  }
+  else if (tagName == wxT("ascii"))
+    tmp = StreamParseCharCode(tag);
+  else if ((tagName == wxT("img")) || (tagName == wxT("slide")) ||
+           (tagName == wxT("editor")) || (tagName == wxT("cell")))
+    // Loading images and worksheet cells is left to the wxXmlDocument-based parser.
+    m_streamError = true;
+  else
+    tmp = StreamParseChildren(tag);
+
+  if (m_streamError)
+    wxDELETE(tmp);
+  return tmp;
+}
+
+Cell *MathParser::StreamParseLabelTag(const StreamTag &tag)
+{
+  wxString user_lbl = tag.GetAttribute(wxT("userdefinedlabel"), m_userDefinedLabel);
+  wxString userdefined = tag.GetAttribute(wxT("userdefined"), wxT("no"));
+  Cell *tmp;
+
+  if ( userdefined != wxT("yes"))
+  {
+    tmp = StreamParseText(tag, TS_LABEL);
+  }
+  else
+  {
+    tmp = StreamParseText(tag, TS_USERLABEL);
+
+    // Backwards compatibility to 17.04/17.12:
+    // If we cannot find the user-defined label's text but still know that there
+    // is one it's value has been saved as "automatic label" instead.
+    if(user_lbl == wxEmptyString)
+    {
+      user_lbl = dynamic_cast<TextCell *>(tmp)->GetValue();
+      user_lbl = user_lbl.substr(1,user_lbl.Length() - 2);
+    }
+  }
+
+  dynamic_cast<TextCell *>(tmp)->SetUserDefinedLabel(user_lbl);
+  tmp->ForceBreakLine(true);
+  return tmp;
+}
+
+Cell *MathParser::StreamParseFracTag(const StreamTag &tag)
+{
+  FracCell *frac = new FracCell(NULL, m_configuration, m_cellPointers);
+  frac->SetFracStyle(m_FracStyle);
+  frac->SetHighlight(m_highlight);
+  if (!tag.IsEmpty())
+  {
+    frac->SetNum(HandleNullPointer(StreamParseTag(false)));
+    frac->SetDenom(HandleNullPointer(StreamParseTag(false)));
+  }
+  else
+  {
+    frac->SetNum(HandleNullPointer(NULL));
+    frac->SetDenom(HandleNullPointer(NULL));
+  }
+  StreamSkipToEndTag(tag);
+
+  if (tag.GetAttribute(wxT("line")) == wxT("no"))
+    frac->SetFracStyle(FracCell::FC_CHOOSE);
+  if (tag.GetAttribute(wxT("diffstyle")) == wxT("yes"))
+    frac->SetFracStyle(FracCell::FC_DIFF);
+  frac->SetType(m_ParserStyle);
+  frac->SetStyle(TS_VARIABLE);
+  frac->SetupBreakUps();
+  ParseCommonAttrs(tag, frac);
+  return frac;
+}
+
+Cell *MathParser::StreamParseDiffTag(const StreamTag &tag)
+{
+  DiffCell *diff = new DiffCell(NULL, m_configuration, m_cellPointers);
+  if (!tag.IsEmpty())
+  {
+    StreamSkipWhitespace();
+    if ((!StreamAtEnd()) && (!StreamAtEndTag()))
+    {
+      int fc = m_FracStyle;
+      m_FracStyle = FracCell::FC_DIFF;
+
+      diff->SetDiff(HandleNullPointer(StreamParseTag(false)));
+      m_FracStyle = fc;
+
+      diff->SetBase(HandleNullPointer(StreamParseTag(true)));
+      diff->SetType(m_ParserStyle);
+      diff->SetStyle(TS_VARIABLE);
+    }
+  }
+  StreamSkipToEndTag(tag);
+  ParseCommonAttrs(tag, diff);
+  return diff;
+}
+
+Cell *MathParser::StreamParseSupTag(const StreamTag &tag)
+{
+  ExptCell *expt = new ExptCell(NULL, m_configuration, m_cellPointers);
+  if (tag.HasAttributes())
+    expt->IsMatrix(true);
+
+  Cell *baseCell;
+  Cell *power;
+  if (!tag.IsEmpty())
+  {
+    expt->SetBase(baseCell = HandleNullPointer(StreamParseTag(false)));
+    power = HandleNullPointer(StreamParseTag(false));
+  }
+  else
+  {
+    expt->SetBase(baseCell = HandleNullPointer(NULL));
+    power = HandleNullPointer(NULL);
+  }
+  StreamSkipToEndTag(tag);
+
+  power->SetExponentFlag();
+  expt->SetPower(power);
+  expt->SetType(m_ParserStyle);
+  expt->SetStyle(TS_VARIABLE);
+
+  ParseCommonAttrs(tag, expt);
+  if(tag.GetAttribute(wxT("mat"), wxT("false")) == wxT("true"))
+    expt->SetAltCopyText(baseCell->ToString()+wxT("^^")+power->ToString());
+
+  return expt;
+}
+
+Cell *MathParser::StreamParseSubSupTag(const StreamTag &tag)
+{
+  SubSupCell *subsup = new SubSupCell(NULL, m_configuration, m_cellPointers);
+  Cell *base = NULL;
+  Cell *index = NULL;
+  Cell *power = NULL;
+  if (!tag.IsEmpty())
+  {
+    base = StreamParseTag(false);
+    index = StreamParseTag(false);
+    power = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  subsup->SetBase(HandleNullPointer(base));
+  index = HandleNullPointer(index);
+  index->SetExponentFlag();
+  subsup->SetIndex(index);
+  power = HandleNullPointer(power);
+  power->SetExponentFlag();
+  subsup->SetExponent(power);
+  subsup->SetType(m_ParserStyle);
+  subsup->SetStyle(TS_VARIABLE);
+  ParseCommonAttrs(tag, subsup);
+  return subsup;
+}
+
+Cell *MathParser::StreamParseSubTag(const StreamTag &tag)
+{
+  SubCell *sub = new SubCell(NULL, m_configuration, m_cellPointers);
+  Cell *base = NULL;
+  Cell *index = NULL;
+  if (!tag.IsEmpty())
+  {
+    base = StreamParseTag(false);
+    index = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  sub->SetBase(HandleNullPointer(base));
+  index = HandleNullPointer(index);
+  sub->SetIndex(index);
+  index->SetExponentFlag();
+  sub->SetType(m_ParserStyle);
+  sub->SetStyle(TS_VARIABLE);
+  ParseCommonAttrs(tag, sub);
+  return sub;
+}
+
+Cell *MathParser::StreamParseAtTag(const StreamTag &tag)
+{
+  AtCell *at = new AtCell(NULL, m_configuration, m_cellPointers);
+  Cell *base = NULL;
+  Cell *index = NULL;
+  if (!tag.IsEmpty())
+  {
+    base = StreamParseTag(false);
+    index = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  at->SetBase(HandleNullPointer(base));
+  at->SetHighlight(m_highlight);
+  at->SetIndex(HandleNullPointer(index));
+  at->SetType(m_ParserStyle);
+  at->SetStyle(TS_VARIABLE);
+  ParseCommonAttrs(tag, at);
+  return at;
+}
+
+Cell *MathParser::StreamParseFunTag(const StreamTag &tag)
+{
+  FunCell *fun = new FunCell(NULL, m_configuration, m_cellPointers);
+  Cell *name = NULL;
+  Cell *arg = NULL;
+  if (!tag.IsEmpty())
+  {
+    name = StreamParseTag(false);
+    arg = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  fun->SetName(HandleNullPointer(name));
+  fun->SetType(m_ParserStyle);
+  fun->SetStyle(TS_FUNCTION);
+  fun->SetArg(HandleNullPointer(arg));
+  ParseCommonAttrs(tag, fun);
+  return fun;
+}
+
+Cell *MathParser::StreamParseSqrtTag(const StreamTag &tag)
+{
+  SqrtCell *cell = new SqrtCell(NULL, m_configuration, m_cellPointers);
+  Cell *inner = NULL;
+  if (!tag.IsEmpty())
+    inner = StreamParseTag(true);
+  StreamSkipToEndTag(tag);
+  cell->SetInner(HandleNullPointer(inner));
+  cell->SetType(m_ParserStyle);
+  cell->SetStyle(TS_VARIABLE);
+  cell->SetHighlight(m_highlight);
+  ParseCommonAttrs(tag, cell);
+  return cell;
+}
+
+Cell *MathParser::StreamParseAbsTag(const StreamTag &tag)
+{
+  AbsCell *cell = new AbsCell(NULL, m_configuration, m_cellPointers);
+  Cell *inner = NULL;
+  if (!tag.IsEmpty())
+    inner = StreamParseTag(true);
+  StreamSkipToEndTag(tag);
+  cell->SetInner(HandleNullPointer(inner));
+  cell->SetType(m_ParserStyle);
+  cell->SetStyle(TS_VARIABLE);
+  cell->SetHighlight(m_highlight);
+  ParseCommonAttrs(tag, cell);
+  return cell;
+}
+
+Cell *MathParser::StreamParseConjugateTag(const StreamTag &tag)
+{
+  ConjugateCell *cell = new ConjugateCell(NULL, m_configuration, m_cellPointers);
+  Cell *inner = NULL;
+  if (!tag.IsEmpty())
+    inner = StreamParseTag(true);
+  StreamSkipToEndTag(tag);
+  cell->SetInner(HandleNullPointer(inner));
+  cell->SetType(m_ParserStyle);
+  cell->SetStyle(TS_VARIABLE);
+  cell->SetHighlight(m_highlight);
+  ParseCommonAttrs(tag, cell);
+  return cell;
+}
+
+Cell *MathParser::StreamParseParenTag(const StreamTag &tag)
+{
+  ParenCell *cell = new ParenCell(NULL, m_configuration, m_cellPointers);
+  Cell *inner = NULL;
+  if (!tag.IsEmpty())
+    inner = StreamParseTag(true);
+  StreamSkipToEndTag(tag);
+  // No special Handling for NULL args here: They are completely legal in this case.
+  cell->SetInner(inner, m_ParserStyle);
+  cell->SetHighlight(m_highlight);
+  cell->SetStyle(TS_VARIABLE);
+  if (tag.HasAttributes())
+    cell->SetPrint(false);
+  ParseCommonAttrs(tag, cell);
+  return cell;
+}
+
+Cell *MathParser::StreamParseLimitTag(const StreamTag &tag)
+{
+  LimitCell *limit = new LimitCell(NULL, m_configuration, m_cellPointers);
+  Cell *name = NULL;
+  Cell *under = NULL;
+  Cell *base = NULL;
+  if (!tag.IsEmpty())
+  {
+    name = StreamParseTag(false);
+    under = StreamParseTag(false);
+    base = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  limit->SetName(HandleNullPointer(name));
+  limit->SetUnder(HandleNullPointer(under));
+  limit->SetBase(HandleNullPointer(base));
+  limit->SetType(m_ParserStyle);
+  limit->SetStyle(TS_VARIABLE);
+  ParseCommonAttrs(tag, limit);
+  return limit;
+}
+
+Cell *MathParser::StreamParseSumTag(const StreamTag &tag)
+{
+  SumCell *sum = new SumCell(NULL, m_configuration, m_cellPointers);
+  wxString type = tag.GetAttribute(wxT("type"), wxT("sum"));
+
+  if (type == wxT("prod"))
+    sum->SetSumStyle(SM_PROD);
+  sum->SetHighlight(m_highlight);
+  Cell *under = NULL;
+  Cell *over = NULL;
+  Cell *base = NULL;
+  if (!tag.IsEmpty())
+  {
+    under = StreamParseTag(false);
+    // The upper limit of a lsum is ignored, but nevertheless present.
+    over = StreamParseTag(false);
+    base = StreamParseTag(false);
+  }
+  StreamSkipToEndTag(tag);
+  sum->SetUnder(HandleNullPointer(under));
+  if (type != wxT("lsum"))
+    sum->SetOver(HandleNullPointer(over));
+  else
+    wxDELETE(over);
+  sum->SetBase(HandleNullPointer(base));
+  sum->SetType(m_ParserStyle);
+  sum->SetStyle(TS_VARIABLE);
+  ParseCommonAttrs(tag, sum);
+  return sum;
+}
+
+Cell *MathParser::StreamParseIntTag(const StreamTag &tag)
+{
+  IntCell *in = new IntCell(NULL, m_configuration, m_cellPointers);
+  in->SetHighlight(m_highlight);
+  wxString definiteAtt = tag.GetAttribute(wxT("def"), wxT("true"));
+  Cell *under = NULL;
+  Cell *over = NULL;
+  Cell *base = NULL;
+  Cell *var = NULL;
+  if (!tag.IsEmpty())
+  {
+    if (definiteAtt == wxT("true"))
+    {
+      under = StreamParseTag(false);
+      over = StreamParseTag(false);
+    }
+    base = StreamParseTag(false);
+    var = StreamParseTag(true);
+  }
+  StreamSkipToEndTag(tag);
+  if (definiteAtt != wxT("true"))
+  {
+    in->SetBase(HandleNullPointer(base));
+    in->SetVar(HandleNullPointer(var));
+    in->SetType(m_ParserStyle);
+    in->SetStyle(TS_VARIABLE);
+  }
+  else
+  {
+    // A Definite integral
+    in->SetIntStyle(IntCell::INT_DEF);
+    in->SetUnder(HandleNullPointer(under));
+    in->SetOver(HandleNullPointer(over));
+    in->SetBase(HandleNullPointer(base));
+    in->SetVar(HandleNullPointer(var));
+    in->SetType(m_ParserStyle);
+    in->SetStyle(TS_VARIABLE);
+  }
+  ParseCommonAttrs(tag, in);
+  return in;
+}
+
+Cell *MathParser::StreamParseTableTag(const StreamTag &tag)
+{
+  MatrCell *matrix = new MatrCell(NULL, m_configuration, m_cellPointers);
+  matrix->SetHighlight(m_highlight);
+
+  if (tag.GetAttribute(wxT("special"), wxT("false")) == wxT("true"))
+    matrix->SetSpecialFlag(true);
+  if (tag.GetAttribute(wxT("inference"), wxT("false")) == wxT("true"))
+  {
+    matrix->SetInferenceFlag(true);
+    matrix->SetSpecialFlag(true);
+  }
+  if (tag.GetAttribute(wxT("colnames"), wxT("false")) == wxT("true"))
+    matrix->ColNames(true);
+  if (tag.GetAttribute(wxT("rownames"), wxT("false")) == wxT("true"))
+    matrix->RowNames(true);
+  if (tag.GetAttribute(wxT("roundedParens"), wxT("false")) == wxT("true"))
+    matrix->RoundedParens(true);
+
+  if (!tag.IsEmpty())
+  {
+    // Like ParseTableTag() we only skip whitespace in front of the first row.
+    StreamSkipWhitespace();
+    while ((!m_streamError) && (!StreamAtEnd()) && (!StreamAtEndTag()))
+    {
+      matrix->NewRow();
+      if (StreamAtStartTag())
+      {
+        StreamTag row;
+        if (!StreamReadStartTag(row))
+          break;
+        if (!row.IsEmpty())
+        {
+          StreamSkipWhitespace();
+          while ((!m_streamError) && (!StreamAtEnd()) && (!StreamAtEndTag()))
+          {
+            matrix->NewColumn();
+            matrix->AddNewCell(HandleNullPointer(StreamParseTag(false)));
+            StreamSkipWhitespace();
+          }
+        }
+        StreamSkipToEndTag(row);
+      }
+      else
+        StreamReadText();
+    }
+  }
+  StreamSkipToEndTag(tag);
+  matrix->SetType(m_ParserStyle);
+  matrix->SetStyle(TS_VARIABLE);
+  matrix->SetDimension();
+  ParseCommonAttrs(tag, matrix);
+  return matrix;
+}
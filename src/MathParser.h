@@ -32,6 +32,7 @@ The header file for the xml cell parser
 
 #include <wx/filesys.h>
 #include <wx/fs_arc.h>
+#include <wx/atomic.h>
 
 #include "Cell.h"
 #include "TextCell.h"
@@ -40,6 +41,15 @@ The header file for the xml cell parser
 
 The xml representation of a cell tree can be found in the file contents.xml 
 inside a wxmx file
+
+Math maxima sends us is parsed by a streaming parser that directly creates the 
+cells from the xml text instead of building a wxXmlDocument first. Anything the
+streaming parser doesn't know how to handle (images, editor cells, xml comments,
+malformed xml,...) makes ParseLine() fall back to the wxXmlDocument-based parser.
+
+If the environment variable WXMAXIMA_BENCHMARK_MATHPARSER is set ParseLine() 
+parses every line using both parsers, compares the results and logs the time
+each parser needed.
  */
 class MathParser
 {
@@ -51,11 +61,55 @@ public:
   void SetUserLabel(wxString label){ m_userDefinedLabel = label; }
   Cell *ParseLine(wxString s, CellType style = MC_TYPE_DEFAULT);
 
+  /*! Have the streaming and the DOM parser ever given different results?
+
+    Only checked if the environment variable WXMAXIMA_BENCHMARK_MATHPARSER is
+    set. Makes the test that parses big outputs fail.
+   */
+  static bool ParsersDisagreed()
+  { return s_parsersDisagreed != 0; }
+
   Cell *ParseTag(wxXmlNode *node, bool all = true);
 
 private:
+  /*! A tag the streaming parser has read
+
+    Provides the same accessors for attributes as wxXmlNode, but doesn't know 
+    about its children: The streaming parser reads them directly from the xml 
+    text.
+   */
+  class StreamTag
+  {
+  public:
+    StreamTag(){m_isEmpty = false;}
+    wxString GetName() const {return m_name;}
+    //! Is this an empty-element tag (\<tag/\>)?
+    bool IsEmpty() const {return m_isEmpty;}
+    bool HasAttributes() const {return !m_attributeNames.IsEmpty();}
+    wxString GetAttribute(const wxString &name, const wxString &defaultVal = wxEmptyString) const;
+    bool GetAttribute(const wxString &name, wxString *value) const;
+  private:
+    friend class MathParser;
+    wxString m_name;
+    wxArrayString m_attributeNames;
+    wxArrayString m_attributeValues;
+    bool m_isEmpty;
+  };
+
+  //! Parse s using the wxXmlDocument-based parser
+  Cell *ParseLineUsingDOM(const wxString &s);
+
+  /*! Parse s using the streaming parser
+
+    \return The cells or NULL, if the streaming parser cannot handle s. In this
+    case ParseLineUsingDOM() has to be used instead.
+   */
+  Cell *ParseLineStreaming(const wxString &s);
+
   void ParseCommonAttrs(wxXmlNode *node, Cell *cell);
 
+  void ParseCommonAttrs(const StreamTag &tag, Cell *cell);
+
   Cell *HandleNullPointer(Cell *cell);
 
   /*! Get the next xml tag
@@ -95,8 +149,14 @@ private:
 
   Cell *ParseText(wxXmlNode *node, TextStyle style = TS_DEFAULT);
 
+  //! Creates the text cells for the contents of a text tag
+  TextCell *ParseTextContents(wxString str, TextStyle style);
+
   Cell *ParseCharCode(wxXmlNode *node, TextStyle style = TS_DEFAULT);
 
+  //! Creates the text cell for the contents of a char code tag
+  TextCell *ParseCharCodeContents(wxString str, TextStyle style);
+
   Cell *ParseSupTag(wxXmlNode *node);
 
   Cell *ParseSubTag(wxXmlNode *node);
@@ -127,6 +187,73 @@ private:
 
   Cell *ParseSubSupTag(wxXmlNode *node);
 
+  /*! \name The streaming parser
+
+    Each of these functions reads the xml text starting at m_streamPos. Functions 
+    that are handed a tag whose start has already been read read up to and including 
+    its end tag. If they find anything they cannot handle they set m_streamError.
+    @{
+   */
+  //! Are we at the end of the xml text?
+  bool StreamAtEnd() const {return m_streamPos >= m_stream.Length();}
+  //! Does an end tag start at the current position?
+  bool StreamAtEndTag() const;
+  //! Does a start tag start at the current position?
+  bool StreamAtStartTag();
+  //! Read a start tag
+  bool StreamReadStartTag(StreamTag &tag);
+  //! Read the end tag of tag
+  void StreamReadEndTag(const StreamTag &tag);
+  //! Read text up to the next tag, resolving all entities
+  wxString StreamReadText();
+  //! Resolve the entity starting at the current position
+  wxString StreamReadEntity();
+  //! Skips whitespace text in the same cases SkipWhitespaceNode() does so
+  void StreamSkipWhitespace();
+  //! Skip everything up to and including the end tag of tag
+  void StreamSkipToEndTag(const StreamTag &tag);
+
+  //! The equivalent of ParseTag()
+  Cell *StreamParseTag(bool all = true);
+  //! Parse the element whose start tag we just have read
+  Cell *StreamParseElement(const StreamTag &tag);
+  //! The equivalent of ParseTag(node->GetChildren())
+  Cell *StreamParseChildren(const StreamTag &tag);
+  //! The equivalent of ParseText(node->GetChildren(), style)
+  Cell *StreamParseText(const StreamTag &tag, TextStyle style = TS_DEFAULT);
+  Cell *StreamParseCharCode(const StreamTag &tag);
+  Cell *StreamParseFracTag(const StreamTag &tag);
+  Cell *StreamParseDiffTag(const StreamTag &tag);
+  Cell *StreamParseSupTag(const StreamTag &tag);
+  Cell *StreamParseSubSupTag(const StreamTag &tag);
+  Cell *StreamParseSubTag(const StreamTag &tag);
+  Cell *StreamParseAtTag(const StreamTag &tag);
+  Cell *StreamParseFunTag(const StreamTag &tag);
+  Cell *StreamParseSqrtTag(const StreamTag &tag);
+  Cell *StreamParseAbsTag(const StreamTag &tag);
+  Cell *StreamParseConjugateTag(const StreamTag &tag);
+  Cell *StreamParseParenTag(const StreamTag &tag);
+  Cell *StreamParseLimitTag(const StreamTag &tag);
+  Cell *StreamParseSumTag(const StreamTag &tag);
+  Cell *StreamParseIntTag(const StreamTag &tag);
+  Cell *StreamParseTableTag(const StreamTag &tag);
+  Cell *StreamParseLabelTag(const StreamTag &tag);
+  //! The xml text the streaming parser reads
+  wxString m_stream;
+  //! The position in m_stream the streaming parser is at
+  size_t m_streamPos;
+  //! Has the streaming parser found something it cannot handle?
+  bool m_streamError;
+  //! Parse each line using both parsers and log the time needed?
+  bool m_benchmark;
+  //! The time the streaming parser has needed until now [ms]
+  long m_streamingParserTime;
+  //! The time the wxXmlDocument-based parser has needed until now [ms]
+  long m_domParserTime;
+  //! The number of lines the two parsers have parsed differently. Set by all threads.
+  static wxAtomicInt s_parsersDisagreed;
+  /*! @} */
+
   wxString m_userDefinedLabel;
   wxRegEx m_graphRegex;
 
@@ -0,0 +1,143 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class MathParserThread
+
+  MathParserThread converts the math maxima sends us to cells in the background.
+ */
+
+#include "MathParserThread.h"
+
+MathParserThread::MathParserThread(wxEvtHandler *handler, int id, Cell::CellPointers *cellPointers) :
+  wxThread(wxTHREAD_JOINABLE),
+  m_configuration(NULL),
+  m_parser(&m_configuration, cellPointers)
+{
+  m_handler = handler;
+  m_id = id;
+  m_settings = NULL;
+}
+
+MathParserThread::~MathParserThread()
+{
+  for (std::map<Configuration *, long>::iterator it = m_settingsUsers.begin();
+       it != m_settingsUsers.end(); ++it)
+    delete it->first;
+}
+
+void MathParserThread::Parse(const wxString &xml, CellType type, long job, const wxString &userLabel,
+                             Configuration *config)
+{
+  Job newJob;
+  // Don't let the copy in the queue share its data with a string the GUI thread
+  // continues to use.
+  newJob.m_xml = xml.Clone();
+  newJob.m_type = type;
+  newJob.m_id = job;
+  newJob.m_userLabel = userLabel.Clone();
+
+  // The settings that aren't stored in the config change without anybody
+  // telling us.
+  if ((config->GetWorkingDirectory() != m_settingsWorkingDirectory) ||
+      (config->GetDefaultCellToolTip() != m_settingsToolTip))
+    SettingsChanged();
+
+  if (m_settings == NULL)
+  {
+    // Like the exporters do we read the settings from the config. Only the settings
+    // that aren't stored there need to be copied. The copy never writes the
+    // styles back, as they might have been changed in the meantime.
+    m_settingsWorkingDirectory = config->GetWorkingDirectory();
+    m_settingsToolTip = config->GetDefaultCellToolTip();
+    m_settings = new Configuration(NULL, false);
+    m_settings->SetWorkingDirectory(m_settingsWorkingDirectory.Clone());
+    m_settings->SetDefaultCellToolTip(m_settingsToolTip.Clone());
+    m_settingsUsers[m_settings] = 1;
+  }
+  m_settingsUsers[m_settings]++;
+  newJob.m_configuration = m_settings;
+  newJob.m_quit = false;
+  m_jobs.Post(newJob);
+}
+
+void MathParserThread::SettingsChanged()
+{
+  if (m_settings == NULL)
+    return;
+  Configuration *settings = m_settings;
+  m_settings = NULL;
+  ReleaseSettings(settings);
+}
+
+void MathParserThread::ReleaseSettings(Configuration *settings)
+{
+  std::map<Configuration *, long>::iterator it = m_settingsUsers.find(settings);
+  if (it == m_settingsUsers.end())
+    return;
+  if (--it->second > 0)
+    return;
+  m_settingsUsers.erase(it);
+  delete settings;
+}
+
+void MathParserThread::Stop()
+{
+  Job quit;
+  quit.m_type = MC_TYPE_DEFAULT;
+  quit.m_id = -1;
+  quit.m_configuration = NULL;
+  quit.m_quit = true;
+  m_jobs.Post(quit);
+}
+
+Cell *MathParserThread::TakeCells(wxThreadEvent &event, Configuration **config)
+{
+  Result result = event.GetPayload<Result>();
+  if (result.m_cells != NULL)
+    result.m_cells->SetConfigurationList(config);
+  ReleaseSettings(result.m_configuration);
+  return result.m_cells;
+}
+
+wxThread::ExitCode MathParserThread::Entry()
+{
+  Job job;
+  while (m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR)
+  {
+    if (job.m_quit)
+      break;
+
+    m_configuration = job.m_configuration;
+    m_parser.SetUserLabel(job.m_userLabel);
+    Result result;
+    result.m_cells = m_parser.ParseLine(job.m_xml, job.m_type);
+    result.m_configuration = m_configuration;
+    m_configuration = NULL;
+
+    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, m_id);
+    event->SetInt(job.m_id);
+    event->SetPayload<Result>(result);
+    wxQueueEvent(m_handler, event);
+  }
+  return static_cast<ExitCode>(0);
+}
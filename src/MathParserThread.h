@@ -0,0 +1,153 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef MATHPARSERTHREAD_H
+#define MATHPARSERTHREAD_H
+
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include <wx/event.h>
+#include <map>
+#include "MathParser.h"
+
+/*!\file
+
+  This file declares the class MathParserThread.
+
+  MathParserThread converts the math maxima sends us to cells in the background.
+ */
+
+/*! Converts the math maxima sends us to cells in the background
+
+  Converting a long result to cells can take a while. Doing so in a thread of its
+  own keeps the worksheet responsive while maxima's output is arriving.
+
+  The thread owns its own MathParser and only creates the cell tree: It never
+  touches the worksheet, nor the worksheet's Configuration, that the GUI thread
+  may swap or delete at any time (which the printout and the bitmap, svg and emf
+  exporters do). Instead the jobs are parsed with a copy of the settings the GUI
+  thread reads from the config. The copy is shared by all jobs until the settings
+  change and is deleted once no queued job and no result still uses it.
+  Measuring the cells (which needs the draw context) and inserting them into the
+  worksheet still happens in the GUI thread once the cells have been handed back
+  by a wxThreadEvent: Its id is the one the constructor was given and GetInt() is
+  the number of the job. TakeCells() extracts the cells from the event.
+ */
+class MathParserThread : public wxThread
+{
+public:
+  /*! The constructor
+
+    \param handler The event handler the parsed cells are sent to
+    \param id The id of the wxThreadEvent that informs about parsed cells
+    \param cellPointers The CellPointers of the worksheet the cells are for
+   */
+  MathParserThread(wxEvtHandler *handler, int id, Cell::CellPointers *cellPointers);
+
+  //! Deletes the settings that are still used by jobs nobody has taken the result of
+  ~MathParserThread();
+
+  /*! Parse a chunk of math
+
+    Must be called by the GUI thread.
+
+    \param xml The xml to parse
+    \param type The type of the cells to create
+    \param job A number that identifies the job. Is sent back with the result.
+    \param userLabel The user-defined label the result is to be shown with
+    \param config The configuration of the worksheet the cells are for. Only
+           read while the job is queued.
+   */
+  void Parse(const wxString &xml, CellType type, long job, const wxString &userLabel,
+             Configuration *config);
+
+  /*! Tell the thread that the settings of the worksheet have changed
+
+    Must be called by the GUI thread. The next job reads the settings anew.
+   */
+  void SettingsChanged();
+
+  //! Tells the thread to exit after finishing the current job
+  void Stop();
+
+  /*! Takes the cells out of an event this thread has sent
+
+    Must be called by the GUI thread exactly once for every event.
+
+    \param event The event that informs about the parsed cells
+    \param config The configuration the cells are to use from now on
+    \return The cells, or NULL, if the xml couldn't be parsed. The caller
+            owns the cells.
+   */
+  Cell *TakeCells(wxThreadEvent &event, Configuration **config);
+
+protected:
+  virtual ExitCode Entry();
+
+private:
+  //! A chunk of math that waits to be parsed
+  struct Job
+  {
+    wxString m_xml;
+    CellType m_type;
+    long m_id;
+    wxString m_userLabel;
+    //! The settings the cells are created with
+    Configuration *m_configuration;
+    //! Tells the thread to exit
+    bool m_quit;
+  };
+
+  //! The cells that have been created from a job and the settings they were created with
+  struct Result
+  {
+    Cell *m_cells;
+    Configuration *m_configuration;
+  };
+
+  //! Forget that a job or m_settings uses settings and delete them if nobody does
+  void ReleaseSettings(Configuration *settings);
+
+  //! The settings new jobs are parsed with. Only used by the GUI thread.
+  Configuration *m_settings;
+  //! The working directory of the worksheet m_settings has been created for
+  wxString m_settingsWorkingDirectory;
+  //! The default tooltip of the worksheet m_settings has been created for
+  wxString m_settingsToolTip;
+  /*! How many jobs use each of the settings we have created
+
+    m_settings counts as a user, too. Only used by the GUI thread.
+   */
+  std::map<Configuration *, long> m_settingsUsers;
+  //! The jobs that wait to be processed
+  wxMessageQueue<Job> m_jobs;
+  //! The event handler the results are sent to
+  wxEvtHandler *m_handler;
+  //! The id of the events we send
+  int m_id;
+  //! The configuration of the job that is currently parsed
+  Configuration *m_configuration;
+  //! The parser that is only used by this thread. Uses m_configuration.
+  MathParser m_parser;
+};
+
+#endif // MATHPARSERTHREAD_H
@@ -0,0 +1,171 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class MaximaOutputScanner
+
+  MaximaOutputScanner splits the data we receive from maxima into chunks.
+ */
+
+#include "MaximaOutputScanner.h"
+
+const wxString MaximaOutputScanner::m_startMarkers[miscText] =
+{
+  wxT("<PROMPT-P/>"),
+  wxT("<mth>"),
+  wxT("<wxxml-symbols>"),
+  wxT("<suppressOutput>"),
+  wxT("<variables>"),
+  wxT("<watch_variables_add>"),
+  wxT("<statusbar>")
+};
+
+const wxString MaximaOutputScanner::m_endMarkers[miscText] =
+{
+  wxT("<PROMPT-S/>"),
+  wxT("</mth>"),
+  wxT("</wxxml-symbols>"),
+  wxT("</suppressOutput>"),
+  wxT("</variables>"),
+  wxT("</watch_variables_add>"),
+  wxT("</statusbar>")
+};
+
+MaximaOutputScanner::MaximaOutputScanner()
+{
+  m_pos = 0;
+  m_searchedUpTo = 0;
+}
+
+void MaximaOutputScanner::Clear()
+{
+  m_data = wxEmptyString;
+  m_pos = 0;
+  m_searchedUpTo = 0;
+}
+
+void MaximaOutputScanner::SetRemaining(const wxString &data)
+{
+  m_data = data;
+  m_pos = 0;
+  m_searchedUpTo = 0;
+}
+
+void MaximaOutputScanner::Compact()
+{
+  if(m_pos == 0)
+    return;
+
+  if(m_pos >= m_data.Length())
+    m_data = wxEmptyString;
+  else
+    m_data.erase(0, m_pos);
+
+  if(m_searchedUpTo > m_pos)
+    m_searchedUpTo -= m_pos;
+  else
+    m_searchedUpTo = 0;
+  m_pos = 0;
+}
+
+size_t MaximaOutputScanner::FindChunkEnd(const wxString &endMarker)
+{
+  // An end marker that started before the position we had searched up to would
+  // have been found by the last search unless it was cut off.
+  size_t searchStart = m_pos;
+  if(m_searchedUpTo > m_pos + endMarker.Length())
+    searchStart = m_searchedUpTo - endMarker.Length();
+
+  size_t end = m_data.find(endMarker, searchStart);
+  if(end == wxString::npos)
+  {
+    m_searchedUpTo = m_data.Length();
+    return wxString::npos;
+  }
+  return end + endMarker.Length();
+}
+
+size_t MaximaOutputScanner::FindMiscTextEnd() const
+{
+  // Every error message or other line maxima outputs should end in a newline
+  // character. But sometimes it doesn't and a tag follows directly =>
+  // the text ends with the first tag we know.
+  size_t pos = m_pos;
+  while((pos = m_data.find(wxT('<'), pos)) != wxString::npos)
+  {
+    // Labels only are to be found within math. But if we see one outside
+    // we nevertheless don't want it to be part of a text line.
+    if((pos > m_pos) && TagAt(pos, wxT("<lbl>")))
+      return pos;
+    for(int i = 0; i < miscText; i++)
+      if(TagAt(pos, m_startMarkers[i]))
+        return pos;
+    pos++;
+  }
+  return m_data.Length();
+}
+
+MaximaOutputScanner::ChunkType MaximaOutputScanner::NextChunk(wxString &contents)
+{
+  contents = wxEmptyString;
+
+  // A newline in front of a tag is of no interest to us.
+  if((Length() > 1) && (m_data[m_pos] == wxT('\n')) && (m_data[m_pos + 1] == wxT('<')))
+    m_pos++;
+
+  if(IsEmpty())
+    return none;
+
+  for(int type = 0; type < miscText; type++)
+  {
+    if(!TagAt(m_pos, m_startMarkers[type]))
+      continue;
+
+    size_t end = FindChunkEnd(m_endMarkers[type]);
+    if(end == wxString::npos)
+      return incomplete;
+
+    if(type == prompt)
+      contents = m_data.SubString(
+        m_pos + m_startMarkers[type].Length(),
+        end - m_endMarkers[type].Length() - 1);
+    else
+      contents = m_data.SubString(m_pos, end - 1);
+    m_pos = end;
+    m_searchedUpTo = m_pos;
+
+    // Maxima separates the prompt from the input by a space.
+    if((type == prompt) && RemainingIs(wxT(" ")))
+      m_pos++;
+
+    return static_cast<ChunkType>(type);
+  }
+
+  // The start of a tag we have only received the first chars of yet
+  // is handled as text, too: We cannot know if it is one before the
+  // rest of it arrives.
+  size_t end = FindMiscTextEnd();
+  contents = m_data.SubString(m_pos, end - 1);
+  m_pos = end;
+  m_searchedUpTo = m_pos;
+  return miscText;
+}
@@ -0,0 +1,143 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef MAXIMAOUTPUTSCANNER_H
+#define MAXIMAOUTPUTSCANNER_H
+
+#include <wx/string.h>
+
+/*!\file
+
+  This file declares the class MaximaOutputScanner.
+
+  MaximaOutputScanner splits the data we receive from maxima into chunks.
+ */
+
+/*! Splits the data we receive from maxima into chunks
+
+  Maxima's output is a stream of XML tags (math, prompts, status bar updates,...)
+  and plain text (error messages, warnings, the output of print(),...) between
+  them. All of them can be split between several network packets.
+
+  Instead of cutting every chunk off the front of one big string (which would copy
+  the rest of the data once per chunk) this class remembers how much of the data
+  it has already handed out and only removes the processed data in Compact().
+ */
+class MaximaOutputScanner
+{
+public:
+  MaximaOutputScanner();
+
+  /*! The types of chunks maxima's output consists of.
+
+    The order is the order wxMaxima has always interpreted the chunks in if many
+    of them arrived at once.
+   */
+  enum ChunkType
+  {
+    prompt,           //!< An input prompt or a question: \<PROMPT-P/\>...\<PROMPT-S/\>
+    math,             //!< Math output: \<mth\>...\</mth\>
+    symbols,          //!< Autocompletion templates: \<wxxml-symbols\>...\</wxxml-symbols\>
+    suppressedOutput, //!< Output we are to discard: \<suppressOutput\>...\</suppressOutput\>
+    variables,        //!< Variable values: \<variables\>...\</variables\>
+    addVariables,     //!< Additions to the watch list: \<watch_variables_add\>...
+    statusBar,        //!< Status bar updates: \<statusbar\>...\</statusbar\>
+    miscText,         //!< Text that isn't enclosed in any tag we know
+    incomplete,       //!< A chunk whose end hasn't arrived yet
+    none              //!< We have handed out all data we have
+  };
+
+  //! The marker maxima starts a prompt with
+  static const wxString PromptPrefix(){return m_startMarkers[prompt];}
+  //! The marker maxima ends a prompt with
+  static const wxString PromptSuffix(){return m_endMarkers[prompt];}
+
+  //! Adds new data from maxima
+  void Append(const wxString &data){m_data += data;}
+
+  /*! Extracts the next complete chunk.
+
+    \param contents Returns the chunk's contents. For prompts these are the text
+                    between the prompt markers; For plain text it is the text itself
+                    and for all other chunks the complete XML tag.
+    \return The type of the chunk. incomplete means: The chunk at the current
+            position hasn't been received completely, yet. In this case the caller
+            should wait for more data.
+   */
+  ChunkType NextChunk(wxString &contents);
+
+  //! Is there unprocessed data left?
+  bool IsEmpty() const {return m_pos >= m_data.Length();}
+
+  //! The number of chars we have received, but not processed yet
+  size_t Length() const {return m_data.Length() - m_pos;}
+
+  //! Does the unprocessed data consist of exactly this string?
+  bool RemainingIs(const wxString &str) const
+    {return (Length() == str.Length()) && (m_data.compare(m_pos, wxString::npos, str) == 0);}
+
+  //! Returns a copy of all unprocessed data
+  wxString GetRemaining() const {return m_data.Mid(m_pos);}
+
+  //! Replaces all unprocessed data by a new string
+  void SetRemaining(const wxString &data);
+
+  /*! Drops the data that has already been handed out
+
+    This is the only place the buffer is copied => it should be called only once
+    after all chunks that have arrived are processed.
+   */
+  void Compact();
+
+  //! Forget all data
+  void Clear();
+
+private:
+  //! Does the unprocessed data start with tag at position pos?
+  bool TagAt(size_t pos, const wxString &tag) const
+    {return m_data.compare(pos, tag.Length(), tag) == 0;}
+
+  /*! Find the end marker of the chunk that starts at the current position
+
+    Remembers how far we already have searched so a tag that arrives in many
+    small packets doesn't cause us to search its beginning over and over again.
+    \return The position right after the end marker or wxString::npos.
+   */
+  size_t FindChunkEnd(const wxString &endMarker);
+
+  //! Returns the position the text at the current position ends at
+  size_t FindMiscTextEnd() const;
+
+  //! The data we have received from maxima
+  wxString m_data;
+  //! The position in m_data the unprocessed data starts at
+  size_t m_pos;
+  //! Up to which position in m_data did we search for the end of the current chunk?
+  size_t m_searchedUpTo;
+
+  //! The start markers of all tags we know. Same order as ChunkType
+  static const wxString m_startMarkers[miscText];
+  //! The end markers of all tags we know. Same order as ChunkType
+  static const wxString m_endMarkers[miscText];
+};
+
+#endif // MAXIMAOUTPUTSCANNER_H
@@ -54,7 +54,6 @@ Printout::~Printout()
   if(m_printConfigCreated)
     wxDELETE(*m_configuration);
   *m_configuration = m_oldconfig;
-  (*m_configuration)->FontChanged(true);
   (*m_configuration)->RecalculationForce(true);  
 }
 
@@ -92,7 +92,6 @@ Svgout::~Svgout()
     wxRemoveFile(m_tempFileName);
   }
   *m_configuration = m_oldconfig;
-  (*m_configuration)->FontChanged(true);
   (*m_configuration)->RecalculationForce(true);
   wxSetWorkingDirectory(m_CWD);
 }
@@ -0,0 +1,164 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+/*! \file
+  This file defines the class SearchIndex
+
+  SearchIndex finds the cells of the worksheet a text appears in.
+ */
+
+#include "SearchIndex.h"
+#include <algorithm>
+#include <iterator>
+
+void SearchIndex::GetTrigrams(const wxString &text, std::vector<Trigram> &trigrams)
+{
+  trigrams.clear();
+  Trigram trigram = 0;
+  size_t length = 0;
+  for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+  {
+    // Every unicode character fits into 21 bits => three of them fit into 63.
+    trigram = ((trigram << 21) | static_cast<Trigram>((*it).GetValue() & 0x1FFFFF)) &
+      ((static_cast<Trigram>(1) << 63) - 1);
+    if (++length >= 3)
+      trigrams.push_back(trigram);
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+void SearchIndex::Update(const EditorCell *cell, const wxString &text)
+{
+  wxString newText = text;
+  newText.Replace(wxT("\r"), wxT(" "));
+
+  // Styling a cell anew doesn't need to mean that its text has changed.
+  std::map<const EditorCell *, Entry>::iterator it = m_cells.find(cell);
+  if ((it != m_cells.end()) && (it->second.m_text == newText))
+    return;
+
+  Entry &entry = m_cells[cell];
+  entry.m_text = newText;
+  entry.m_lowerCaseText = newText.Lower();
+  std::vector<Trigram> trigrams;
+  GetTrigrams(entry.m_lowerCaseText, trigrams);
+
+  // Only the trigrams that have appeared or disappeared need to be updated.
+  std::vector<Trigram> removed;
+  std::set_difference(entry.m_trigrams.begin(), entry.m_trigrams.end(),
+                      trigrams.begin(), trigrams.end(), std::back_inserter(removed));
+  std::vector<Trigram> added;
+  std::set_difference(trigrams.begin(), trigrams.end(),
+                      entry.m_trigrams.begin(), entry.m_trigrams.end(),
+                      std::back_inserter(added));
+  for (size_t i = 0; i < removed.size(); i++)
+  {
+    std::map<Trigram, CellSet>::iterator posting = m_postings.find(removed[i]);
+    posting->second.erase(cell);
+    if (posting->second.empty())
+      m_postings.erase(posting);
+  }
+  for (size_t i = 0; i < added.size(); i++)
+    m_postings[added[i]].insert(cell);
+  entry.m_trigrams.swap(trigrams);
+}
+
+void SearchIndex::Remove(const EditorCell *cell)
+{
+  std::map<const EditorCell *, Entry>::iterator it = m_cells.find(cell);
+  if (it == m_cells.end())
+    return;
+
+  const std::vector<Trigram> &trigrams = it->second.m_trigrams;
+  for (size_t i = 0; i < trigrams.size(); i++)
+  {
+    std::map<Trigram, CellSet>::iterator posting = m_postings.find(trigrams[i]);
+    posting->second.erase(cell);
+    if (posting->second.empty())
+      m_postings.erase(posting);
+  }
+  m_cells.erase(it);
+}
+
+void SearchIndex::GetCandidates(const wxString &str, CellSet &cells) const
+{
+  cells.clear();
+  if (str == wxEmptyString)
+    return;
+
+  std::vector<Trigram> trigrams;
+  GetTrigrams(str.Lower(), trigrams);
+
+  // A search string that is too short to contain a trigram can appear anywhere.
+  if (trigrams.empty())
+  {
+    for (std::map<const EditorCell *, Entry>::const_iterator it = m_cells.begin();
+         it != m_cells.end(); ++it)
+      cells.insert(it->first);
+    return;
+  }
+
+  // Start with the trigram that appears in the least cells.
+  std::vector<const CellSet *> postings;
+  for (size_t i = 0; i < trigrams.size(); i++)
+  {
+    std::map<Trigram, CellSet>::const_iterator posting = m_postings.find(trigrams[i]);
+    if (posting == m_postings.end())
+      return;
+    postings.push_back(&posting->second);
+    if (postings.back()->size() < postings.front()->size())
+      std::swap(postings.front(), postings.back());
+  }
+
+  for (CellSet::const_iterator it = postings.front()->begin(); it != postings.front()->end(); ++it)
+  {
+    bool candidate = true;
+    for (size_t i = 1; candidate && (i < postings.size()); i++)
+      candidate = (postings[i]->find(*it) != postings[i]->end());
+    if (candidate)
+      cells.insert(cells.end(), *it);
+  }
+}
+
+void SearchIndex::FindAll(const EditorCell *cell, wxString str, bool ignoreCase,
+                          std::vector<long> &positions) const
+{
+  std::map<const EditorCell *, Entry>::const_iterator it = m_cells.find(cell);
+  if ((it == m_cells.end()) || (str == wxEmptyString))
+    return;
+
+  const wxString *text = &it->second.m_text;
+  if (ignoreCase)
+  {
+    text = &it->second.m_lowerCaseText;
+    str.MakeLower();
+  }
+
+  size_t pos = 0;
+  while ((pos = text->find(str, pos)) != wxString::npos)
+  {
+    positions.push_back(pos);
+    pos++;
+  }
+}
@@ -0,0 +1,108 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <wx/string.h>
+
+/*!\file
+
+  This file declares the class SearchIndex.
+
+  SearchIndex finds the cells of the worksheet a text appears in.
+ */
+
+class EditorCell;
+
+/*! An index of the text of the worksheet's EditorCells for the find dialog
+
+  Every EditorCell that is the editable part of a GroupCell of the worksheet
+  hands its text to this index every time the text changes and removes it once
+  the cell is deleted.
+
+  The index remembers which trigrams (sequences of three characters) of the
+  lower-cased text appear in which cell. Every cell a search string appears in
+  contains all trigrams of the search string => intersecting the sets of cells
+  that contain them yields a short list of cells that might contain the search
+  string. Only these need to be searched, and the search works on a copy of
+  their text that already is lower-cased.
+ */
+class SearchIndex
+{
+public:
+  //! A set of cells
+  typedef std::set<const EditorCell *> CellSet;
+
+  //! Indexes the text of a cell, replacing the text it has been indexed with before
+  void Update(const EditorCell *cell, const wxString &text);
+  //! Removes a cell from the index, if it is part of it
+  void Remove(const EditorCell *cell);
+  //! Is this cell part of the index?
+  bool Contains(const EditorCell *cell) const {return m_cells.find(cell) != m_cells.end();}
+  //! The number of cells in the index
+  size_t Size() const {return m_cells.size();}
+
+  /*! Determines the cells str might appear in
+
+    Every cell str appears in is part of the result.
+   */
+  void GetCandidates(const wxString &str, CellSet &cells) const;
+
+  /*! Appends all positions str appears at in the text of a cell to positions
+
+    The text of the cell is the text it has been indexed with, with soft line
+    breaks replaced by spaces, as EditorCell::FindNext() sees it. Occurrences
+    that overlap are all reported.
+   */
+  void FindAll(const EditorCell *cell, wxString str, bool ignoreCase,
+               std::vector<long> &positions) const;
+
+private:
+  //! Three lower-cased characters
+  typedef wxUint64 Trigram;
+
+  //! What we know about the text of a cell
+  struct Entry
+  {
+    //! The text with soft line breaks replaced by spaces
+    wxString m_text;
+    //! m_text in lower case
+    wxString m_lowerCaseText;
+    //! The sorted trigrams of m_lowerCaseText
+    std::vector<Trigram> m_trigrams;
+  };
+
+  //! Determines the sorted trigrams of a text
+  static void GetTrigrams(const wxString &text, std::vector<Trigram> &trigrams);
+
+  //! The text of each cell
+  std::map<const EditorCell *, Entry> m_cells;
+  //! The cells each trigram appears in
+  std::map<Trigram, CellSet> m_postings;
+};
+
+#endif // SEARCHINDEX_H
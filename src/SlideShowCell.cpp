@@ -37,7 +37,6 @@
 #include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/filesys.h>
-#include <wx/fs_mem.h>
 #include <wx/utils.h>
 #include <wx/clipbrd.h>
 #include <wx/config.h>
@@ -53,6 +52,7 @@ SlideShow::SlideShow(Cell *parent, Configuration **config, CellPointers *cellPoi
   m_timer = NULL;
   m_animationRunning = true;
   m_size = m_displayed = 0;
+  m_direction = 1;
   m_type = MC_TYPE_SLIDE;
   m_fileSystem = filesystem; // NULL when not loading from wxmx
   m_framerate = framerate;
@@ -113,6 +113,7 @@ void SlideShow::AnimationRunning(bool run)
   else
     StopTimer();
   m_animationRunning = run;
+  XMLChanged();
 }
 
 int SlideShow::SetFrameRate(int Freq)
@@ -130,20 +131,25 @@ int SlideShow::SetFrameRate(int Freq)
       m_framerate = 200;
   }
 
+  XMLChanged();
   return m_framerate;
 }
 
-void SlideShow::LoadImages(wxArrayString images, bool deleteRead)
+void SlideShow::LoadImages(wxArrayString images, bool deleteRead, std::vector<wxSize> sizes)
 {
   m_size = images.GetCount();
 
   for (int i = 0; i < m_size; i++)
   {
-    Image *image = new Image(m_configuration, images[i], deleteRead, m_fileSystem);
+    wxSize size = wxDefaultSize;
+    if ((size_t) i < sizes.size())
+      size = sizes[i];
+    Image *image = new Image(m_configuration, images[i], deleteRead, m_fileSystem, size);
     m_images.push_back(image);
   }
   m_fileSystem = NULL;
   m_displayed = 0;
+  XMLChanged();
 }
 
 Cell *SlideShow::Copy()
@@ -190,10 +196,36 @@ std::list<Cell *> SlideShow::GetInnerCells()
 
 void SlideShow::SetDisplayedIndex(int ind)
 {
+  if ((m_size > 0) && (ind == (m_displayed + m_size - 1) % m_size))
+    m_direction = -1;
+  else if (ind != m_displayed)
+    m_direction = 1;
+
   if (ind >= 0 && ind < m_size)
     m_displayed = ind;
   else
     m_displayed = m_size - 1;
+  XMLChanged();
+}
+
+void SlideShow::PrefetchFrames(double scale)
+{
+  // The number of frames ahead of the displayed one we decode in the background
+  const int prefetch = 3;
+
+  for (int i = 0; i < m_size; i++)
+  {
+    if ((m_images[i] == NULL) || (i == m_displayed))
+      continue;
+
+    // How many frames in playback direction is this frame ahead of the displayed one?
+    int ahead = ((i - m_displayed) * m_direction + m_size) % m_size;
+    if (ahead <= prefetch)
+      m_images[i]->Prefetch(scale);
+    else
+      // Frames we won't need soon don't need to keep their bitmap.
+      m_images[i]->ClearCache();
+  }
 }
 
 void SlideShow::RecalculateWidths(int fontsize)
@@ -269,7 +301,20 @@ void SlideShow::Draw(wxPoint point)
 
     dc->DrawRectangle(wxRect(point.x, point.y - m_center, m_width, m_height));
 
-    wxBitmap bitmap = (configuration->GetPrinting() ? m_images[m_displayed]->GetBitmap(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER) : m_images[m_displayed]->GetBitmap());
+    wxBitmap bitmap;
+    if (configuration->GetPrinting())
+      bitmap = m_images[m_displayed]->GetBitmap(configuration->GetZoomFactor() * PRINT_SIZE_MULTIPLIER);
+    else
+    {
+      // Until the displayed frame has been decoded the frame we have drawn
+      // before is better than a placeholder.
+      if (m_images[m_displayed]->ScaledBitmapReady() || (!m_lastFrame.IsOk()))
+        m_lastFrame = m_images[m_displayed]->GetBitmap();
+      else
+        m_images[m_displayed]->Prefetch();
+      bitmap = m_lastFrame;
+      PrefetchFrames(1.0);
+    }
     bitmapDC.SelectObject(bitmap);
 
     int imageBorderWidth = m_imageBorderWidth;
@@ -312,21 +357,28 @@ wxString SlideShow::ToTeX()
 wxString SlideShow::ToXML()
 {
   wxString images;
+  // Knowing the sizes of the frames allows to load them only once they are displayed.
+  wxString sizes;
+  bool sizesKnown = true;
 
   for (int i = 0; i < m_size; i++)
   {
     wxString basename = m_cellPointers->WXMXGetNewFileName();
-    // add the file to memory
+    // add the file to the .wxmx file
     if (m_images[i])
     {
       if (m_images[i]->GetCompressedImage())
-        wxMemoryFSHandler::AddFile(basename + m_images[i]->GetExtension(),
-                                   m_images[i]->GetCompressedImage().GetData(),
-                                   m_images[i]->GetCompressedImage().GetDataLen()
-        );
+        m_cellPointers->WXMXAddFile(basename + m_images[i]->GetExtension(), m_images[i],
+                                    CellPointers::WXMX_IMAGE);
     }
 
     images += basename + m_images[i]->GetExtension() + wxT(";");
+    if (m_images[i]->IsOk())
+      sizes += wxString::Format(wxT("%lix%li;"),
+                                (long) m_images[i]->GetOriginalWidth(),
+                                (long) m_images[i]->GetOriginalHeight());
+    else
+      sizesKnown = false;
   }
 
   wxString flags;
@@ -340,6 +392,8 @@ wxString SlideShow::ToXML()
 
   if (m_framerate > 0)
     flags +=  wxString::Format(wxT(" fr=\"%i\""), GetFrameRate());
+  if ((m_size > 0) && sizesKnown)
+    flags += wxT(" sizes=\"") + sizes + wxT("\"");
   return wxT("\n<slide") + flags + wxT(">") + images + wxT("</slide>");
 }
 
@@ -421,13 +475,33 @@ wxSize SlideShow::ToGif(wxString file)
   // action).
   wxBusyCursor crs;
 
-  wxImageArray gifFrames;
+  wxImageArray frames;
+  GetGifFrames(frames);
+  if(FramesToGif(frames, file, GetGifDelay()))
+    return GetGifSize();
+  return wxSize(-1,-1);
+}
 
+void SlideShow::GetGifFrames(wxImageArray &frames)
+{
   for (int i = 0; i < m_size; i++)
+    frames.Add(m_images[i]->GetUnscaledBitmap().ConvertToImage());
+}
+
+wxSize SlideShow::GetGifSize()
+{
+  return wxSize(m_images[1]->GetOriginalWidth(), m_images[1]->GetOriginalHeight());
+}
+
+bool SlideShow::FramesToGif(wxImageArray &frames, wxString file, int delay)
+{
+  wxImageArray gifFrames;
+
+  for (size_t i = 0; i < frames.GetCount(); i++)
   {
     wxImage frame;
     // Reduce the frame to at most 256 colors
-    wxQuantize::Quantize(m_images[i]->GetUnscaledBitmap().ConvertToImage(),frame);
+    wxQuantize::Quantize(frames[i], frame);
     // Gif supports only fully transparent or not transparent at all.
     frame.ConvertAlphaToMask();
     gifFrames.Add(frame);
@@ -441,11 +515,19 @@ wxSize SlideShow::ToGif(wxString file)
     {
       wxGIFHandler gif;
       
-      if(gif.SaveAnimation(gifFrames, &outStream, true, 1000 / GetFrameRate()))
-        return wxSize(m_images[1]->GetOriginalWidth(), m_images[1]->GetOriginalHeight());
+      if(gif.SaveAnimation(gifFrames, &outStream, true, delay))
+        return true;
     }
   }
-  return wxSize(-1,-1);
+  return false;
+}
+
+void SlideShow::SetConfiguration(Configuration **config)
+{
+  Cell::SetConfiguration(config);
+  for (int i = 0; i < m_size; i++)
+    if(m_images[i] != NULL)
+      m_images[i]->SetConfiguration(config);
 }
 
 void SlideShow::ClearCache()
@@ -453,6 +535,7 @@ void SlideShow::ClearCache()
   for (int i = 0; i < m_size; i++)
     if(m_images[i] != NULL)
       m_images[i]->ClearCache();
+  m_lastFrame = wxNullBitmap;
 }
 
 SlideShow::GifDataObject::GifDataObject(const wxMemoryOutputStream &str) : wxCustomDataObject(m_gifFormat)
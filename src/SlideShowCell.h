@@ -92,7 +92,9 @@ public:
    */
   virtual void ClearCache();
 
-  void LoadImages(wxArrayString images, bool deleteRead);
+  virtual void SetConfiguration(Configuration **config);
+
+  void LoadImages(wxArrayString images, bool deleteRead, std::vector<wxSize> sizes = std::vector<wxSize>());
 
   Cell *Copy();
 
@@ -113,6 +115,22 @@ public:
   //! Exports the whole animation as animated gif
   wxSize ToGif(wxString filename);
 
+  //! Appends the unquantized frames ToGif() would export to frames
+  void GetGifFrames(wxImageArray &frames);
+
+  //! The delay between two frames of the .gif animation [in ms]
+  int GetGifDelay(){return 1000 / GetFrameRate();}
+
+  //! The size ToGif() returns if it succeeds
+  wxSize GetGifSize();
+
+  /*! Quantizes frames to 256 colors and saves them as an animated gif
+
+    Doesn't access anything but its parameters and therefore can be run by a
+    background thread.
+   */
+  static bool FramesToGif(wxImageArray &frames, wxString file, int delay);
+
   bool CopyToClipboard();
   
   //! Put the animation on the clipboard.
@@ -157,6 +175,15 @@ protected:
   bool m_animationRunning;
   int m_size;
   int m_displayed;
+  //! 1, if the animation was last stepped forward, -1 if it was stepped backward
+  int m_direction;
+  /*! The frame we have drawn last
+
+    Is drawn instead of the current frame until this one has been decoded.
+   */
+  wxBitmap m_lastFrame;
+  //! Have the frames that follow the displayed one be decoded in the background
+  void PrefetchFrames(double scale);
   wxFileSystem *m_fileSystem;
   vector<Image *> m_images;
 
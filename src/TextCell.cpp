@@ -103,7 +103,8 @@ void TextCell::SetStyle(TextStyle style)
 void TextCell::SetType(CellType type)
 {
   Cell::SetType(type);
-  SetFont((*m_configuration)->GetDefaultFontSize());
+  // The font itself is set on the DC right before the cell is measured or drawn.
+  SetFontSize((*m_configuration)->GetDefaultFontSize());
 }
 
 void TextCell::SetValue(const wxString &text)
@@ -225,12 +226,7 @@ void TextCell::SetValue(const wxString &text)
     }
     else
     {
-      if(
-        (m_roundingErrorRegEx1.Matches(m_displayedText)) ||
-        (m_roundingErrorRegEx2.Matches(m_displayedText)) ||
-        (m_roundingErrorRegEx3.Matches(m_displayedText)) ||
-        (m_roundingErrorRegEx4.Matches(m_displayedText))
-        )
+      if(LooksLikeRoundingError(m_displayedText))
         m_toolTip = _("As calculating 0.1^12 demonstrates maxima by default doesn't tend to "
                       "hide what looks like being the small error using floating-point "
                       "numbers introduces.\n"
@@ -399,8 +395,8 @@ void TextCell::RecalculateWidths(int fontsize)
       SetValue(m_text);
     
     m_lastCalculationFontSize = fontsize;
-    wxDC *dc = configuration->GetDC();
-    SetFont(fontsize);
+    // The font is only set if we actually need to measure text.
+    SetFontSize(fontsize);
 
     // Labels and prompts are fixed width - adjust font size so that
     // they fit in
@@ -414,43 +410,21 @@ void TextCell::RecalculateWidths(int fontsize)
         m_unescapeRegEx.ReplaceAll(&text,wxT("\\1"));
       }
 
-      wxFont font = dc->GetFont();
-      double fontsize1 = Scale_Px(configuration->GetDefaultFontSize());
-      if(fontsize1 < 4)
-        fontsize1 = 4;
-#if wxCHECK_VERSION(3, 1, 2)
-      font.SetFractionalPointSize(fontsize1);
-#else
-      font.SetPointSize(fontsize1);
-#endif
-      dc->SetFont(font);
-
-      
       m_width = Scale_Px(configuration->GetLabelWidth());
-      // We will decrease it before use
-      m_fontSizeLabel = m_fontSize + 1;
-      int labelWidth,labelHeight;
-      dc->GetTextExtent(text, &labelWidth, &labelHeight);
-      wxASSERT_MSG((labelWidth > 0) || (m_displayedText == wxEmptyString),
+      wxSize labelSize;
+      m_fontSizeLabel = configuration->GetLabelFontSize(text, m_textStyle, m_fontSize,
+                                                        m_width, labelSize);
+      wxASSERT_MSG((labelSize.x > 0) || (m_displayedText == wxEmptyString),
                    _("Seems like something is broken with the maths font. Installing http://www.math.union.edu/~dpvc/jsmath/download/jsMath-fonts.html and checking \"Use JSmath fonts\" in the configuration dialogue should fix it."));
-      font = dc->GetFont();
-      do
-      {
-#if wxCHECK_VERSION(3, 1, 2)
-        font.SetFractionalPointSize(Scale_Px(--m_fontSizeLabel));
-#else
-        font.SetPointSize(Scale_Px(--m_fontSizeLabel));
-#endif
-        dc->SetFont(font);
-        dc->GetTextExtent(text, &labelWidth, &labelHeight);
-      } while ((labelWidth >= m_width) && (m_fontSizeLabel > 2));
-      m_height = labelHeight;
+      m_height = labelSize.y;
       m_center = m_height / 2;
     }
     // Check if we are using jsMath and have jsMath character
     else if (m_altJs && configuration->CheckTeXFonts())
     {
-      dc->GetTextExtent(m_altJsText, &m_width, &m_height);
+      wxSize size = GetTextExtent(m_altJsText, fontsize);
+      m_width = size.x;
+      m_height = size.y;
 
       if (m_texFontname == wxT("jsMath-cmsy10"))
         m_height = m_height / 2;
@@ -459,19 +433,25 @@ void TextCell::RecalculateWidths(int fontsize)
       /// We are using a special symbol
     else if (m_alt)
     {
-      dc->GetTextExtent(m_altText, &m_width, &m_height);
+      wxSize size = GetTextExtent(m_altText, fontsize);
+      m_width = size.x;
+      m_height = size.y;
     }
 
       /// Empty string has height of X
     else if (m_displayedText == wxEmptyString)
     {
-      dc->GetTextExtent(wxT("gXÄy"), &m_width, &m_height);
+      m_height = GetTextExtent(wxT("gXÄy"), fontsize).y;
       m_width = 0;
     }
 
       /// This is the default.
     else
-      dc->GetTextExtent(m_displayedText, &m_width, &m_height);
+    {
+      wxSize size = GetTextExtent(m_displayedText, fontsize);
+      m_width = size.x;
+      m_height = size.y;
+    }
 
     m_width = m_width + 2 * MC_TEXT_PADDING;
     m_height = m_height + 2 * MC_TEXT_PADDING;
@@ -589,10 +569,9 @@ void TextCell::SetFontSizeForLabel(wxDC *dc)
   dc->SetFont(font);
 }
 
-void TextCell::SetFont(int fontsize)
+void TextCell::SetFontSize(int fontsize)
 {
   Configuration *configuration = (*m_configuration);
-  wxDC *dc = configuration->GetDC();
   m_fontSize = configuration->GetDefaultFontSize();
 
   if ((m_textStyle == TS_TITLE) ||
@@ -617,7 +596,17 @@ void TextCell::SetFont(int fontsize)
       )
       m_fontSize = fontsize;
   }
-    
+
+  if(m_fontSize < 4)
+    m_fontSize = 4;
+}
+
+void TextCell::SetFont(int fontsize)
+{
+  Configuration *configuration = (*m_configuration);
+  wxDC *dc = configuration->GetDC();
+  SetFontSize(fontsize);
+
   wxFont font = configuration->GetFont(m_textStyle,fontsize);
 
   // Use jsMath
@@ -633,9 +622,6 @@ void TextCell::SetFont(int fontsize)
   if (!font.IsOk())
     font = *wxNORMAL_FONT;
 
-  if(m_fontSize < 4)
-    m_fontSize = 4;
-  
   // Mark special variables that are printed as ordinary letters as being special.
   if ((!(*m_configuration)->CheckKeepPercent()) &&
       ((m_text == wxT("%e")) || (m_text == wxT("%i"))))
@@ -668,6 +654,32 @@ void TextCell::SetFont(int fontsize)
   }
 }
 
+wxString TextCell::FontVariant()
+{
+  wxString variant;
+  if (m_altJs && (*m_configuration)->CheckTeXFonts())
+    variant = m_texFontname;
+  if ((!(*m_configuration)->CheckKeepPercent()) &&
+      ((m_text == wxT("%e")) || (m_text == wxT("%i"))))
+    variant += wxT("/italic toggled");
+  return variant;
+}
+
+wxSize TextCell::GetTextExtent(const wxString &text, int fontsize)
+{
+  Configuration *configuration = (*m_configuration);
+  SetFontSize(fontsize);
+  wxString key = configuration->TextExtentKey(text, m_textStyle, m_fontSize, FontVariant());
+  wxSize size;
+  if (!configuration->GetCachedTextExtent(key, size))
+  {
+    SetFont(fontsize);
+    size = configuration->GetDC()->GetTextExtent(text);
+    configuration->CacheTextExtent(key, size);
+  }
+  return size;
+}
+
 bool TextCell::IsOperator()
 {
   if (wxString(wxT("+*/-")).Find(m_text) >= 0)
@@ -1873,3 +1885,14 @@ wxRegEx TextCell::m_roundingErrorRegEx1(wxT("\\.000000000000[0-9]+$"));
 wxRegEx TextCell::m_roundingErrorRegEx2(wxT("\\.999999999999[0-9]+$"));
 wxRegEx TextCell::m_roundingErrorRegEx3(wxT("\\.000000000000[0-9]+e"));
 wxRegEx TextCell::m_roundingErrorRegEx4(wxT("\\.999999999999[0-9]+e"));
+wxMutex TextCell::m_roundingErrorRegExMutex;
+
+bool TextCell::LooksLikeRoundingError(const wxString &text)
+{
+  wxMutexLocker lock(m_roundingErrorRegExMutex);
+  return
+    (m_roundingErrorRegEx1.Matches(text)) ||
+    (m_roundingErrorRegEx2.Matches(text)) ||
+    (m_roundingErrorRegEx3.Matches(text)) ||
+    (m_roundingErrorRegEx4.Matches(text));
+}
@@ -24,6 +24,7 @@
 #define TEXTCELL_H
 
 #include "wx/regex.h"
+#include "wx/thread.h"
 #include "Cell.h"
 
 /*! A Text cell
@@ -59,6 +60,9 @@ public:
 
   void SetFont(int fontsize);
 
+  //! Determines the font size SetFont() would use for this cell
+  void SetFontSize(int fontsize);
+
   /*! Calling this function signals that the "(" this cell ends in isn't part of the function name
 
     The "(" is the opening parenthesis of a function instead.
@@ -105,12 +109,34 @@ protected:
   //! Resets the font size to label size
   void SetFontSizeForLabel(wxDC *dc);
 
+  /*! Describes how the font of this cell differs from the one for its text style
+
+    Used as part of the key the text size is cached by.
+   */
+  wxString FontVariant();
+
+  /*! Measures text in the font SetFont() sets
+
+    Reads the size from the configuration's text size cache, if possible.
+    \param text The text to measure
+    \param fontsize The font size to pass to SetFont()
+   */
+  wxSize GetTextExtent(const wxString &text, int fontsize);
+
   bool NeedsRecalculation();
   static wxRegEx m_unescapeRegEx;
   static wxRegEx m_roundingErrorRegEx1;
   static wxRegEx m_roundingErrorRegEx2;
   static wxRegEx m_roundingErrorRegEx3;
   static wxRegEx m_roundingErrorRegEx4;
+  /*! Guards the m_roundingErrorRegEx*
+
+    SetValue() is called by the GUI thread and by the thread that parses maxima's
+    output in the background, and wxRegEx isn't re-entrant.
+   */
+  static wxMutex m_roundingErrorRegExMutex;
+  //! Does the text look like containing a floating-point rounding error?
+  static bool LooksLikeRoundingError(const wxString &text);
 
   //! The text we keep inside this cell
   wxString m_text;
@@ -0,0 +1,330 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class WXMXSnapshot
+
+  WXMXSnapshot contains everything a .wxmx file consists of and can write it
+  to disk in a thread of its own.
+ */
+
+#include "WXMXSnapshot.h"
+#include "ZipEntryCopier.h"
+#include <wx/file.h>
+#include <wx/filefn.h>
+#include <wx/log.h>
+#include <wx/intl.h>
+#include <wx/wfstream.h>
+#include <wx/zipstrm.h>
+#include <wx/txtstrm.h>
+
+WXMXSnapshot::WXMXSnapshot(const wxString &file, const wxString &previousVersion)
+{
+  // Our strings are read by another thread => They mustn't share their data
+  // with anybody else.
+  m_file = wxString(file.wc_str());
+  m_previousVersion = wxString(previousVersion.wc_str());
+  m_writer = NULL;
+  m_succeeded = false;
+  m_copyFailed = false;
+}
+
+WXMXSnapshot::~WXMXSnapshot()
+{
+  if (m_writer != NULL)
+    Wait();
+}
+
+void WXMXSnapshot::AddXML(const wxString &xml)
+{
+  m_xml.push_back(wxString(xml.wc_str()));
+}
+
+void WXMXSnapshot::AddFile(const wxString &name, const wxMemoryBuffer &data, bool compress)
+{
+  File file;
+  file.m_name = wxString(name.wc_str());
+  file.m_data = data;
+  file.m_compress = compress;
+  m_files.push_back(file);
+}
+
+void WXMXSnapshot::CopyFile(const wxString &name, const wxString &previousName)
+{
+  File file;
+  file.m_name = wxString(name.wc_str());
+  file.m_compress = false;
+  file.m_previousName = wxString(previousName.wc_str());
+  m_files.push_back(file);
+}
+
+WXMXSnapshot::Writer::Writer(WXMXSnapshot *snapshot, wxEvtHandler *handler, int id) :
+  wxThread(wxTHREAD_JOINABLE)
+{
+  m_snapshot = snapshot;
+  m_handler = handler;
+  m_id = id;
+}
+
+wxThread::ExitCode WXMXSnapshot::Writer::Entry()
+{
+  m_snapshot->m_succeeded = m_snapshot->Write();
+  wxQueueEvent(m_handler, new wxThreadEvent(wxEVT_THREAD, m_id));
+  return 0;
+}
+
+void WXMXSnapshot::StartWriting(wxEvtHandler *handler, int id)
+{
+  m_writer = new Writer(this, handler, id);
+  if (m_writer->Run() == wxTHREAD_NO_ERROR)
+    return;
+
+  wxLogMessage(_("Cannot start a thread for saving the .wxmx file."));
+  wxDELETE(m_writer);
+  m_succeeded = Write();
+  wxQueueEvent(handler, new wxThreadEvent(wxEVT_THREAD, id));
+}
+
+bool WXMXSnapshot::Wait()
+{
+  if (m_writer != NULL)
+  {
+    m_writer->Wait();
+    wxDELETE(m_writer);
+  }
+  return m_succeeded;
+}
+
+bool WXMXSnapshot::Write()
+{
+  wxLogMessage(_("Starting to save the worksheet as .wxmx"));
+  m_copyFailed = false;
+
+  // delete temp file if it already exists
+  wxString backupfile = m_file + wxT("~");
+  if (wxFileExists(backupfile))
+  {
+    if (!wxRemoveFile(backupfile))
+      return false;
+  }
+
+  // First saves the data to a backup file ending in .wxmx~ so if anything goes
+  // horribly wrong in this step all that is lost is the data that was input
+  // since the last save.
+  if (!WriteArchive(backupfile))
+  {
+    wxRemoveFile(backupfile);
+    return false;
+  }
+
+  // Now we try to open the file in order to see if saving hasn't failed
+  // without returning an error - which can apparently happen on MSW.
+  if (!ContainsContent(backupfile))
+    return false;
+
+  // If all data is saved now we can overwrite the actual save file.
+  // We will try to do so a few times if we suspect a MSW virus scanner or similar
+  // temporarily hindering us from doing so.
+  bool done = false;
+  {
+    // SuppressErrorDialogs isn't thread-safe. But wxLogNull only silences the
+    // thread it has been created in.
+    wxLogNull suppressor;
+    done = wxRenameFile(backupfile, m_file, true);
+    if(!done)
+    {
+      // We might have failed to move the file because an over-eager virus scanner wants to
+      // scan it and a design decision of a filesystem driver might hinder us from moving
+      // it during this action => Wait for a second and retry.
+      wxSleep(1);
+      done = wxRenameFile(backupfile, m_file, true);
+    }
+    if(!done)
+    {
+      wxSleep(1);
+      done = wxRenameFile(backupfile, m_file, true);
+    }
+  }
+  if(!done)
+  {
+    wxSleep(1);
+    if (!wxRenameFile(backupfile, m_file, true))
+      return false;
+  }
+
+  wxLogMessage(_("wxmx file saved"));
+  return true;
+}
+
+bool WXMXSnapshot::WriteArchive(const wxString &backupfile)
+{
+  // Files that haven't changed since the last save are copied from there.
+  ZipEntryCopier previousVersion;
+  if ((!m_previousVersion.IsEmpty()) && (!previousVersion.Open(m_previousVersion)))
+  {
+    wxLogMessage(wxString::Format(
+                   _("Cannot open %s in order to copy unchanged files from it."),
+                   m_previousVersion));
+    m_copyFailed = true;
+    return false;
+  }
+
+  wxFile file(backupfile, wxFile::write);
+  if (!file.IsOpened())
+    return false;
+
+  long writtenFiles = 0;
+  size_t writtenBytes = 0;
+  long copiedFiles = 0;
+  {
+    wxFileOutputStream out(file);
+    if (!out.IsOk())
+      return false;
+    wxZipOutputStream zip(out);
+    wxTextOutputStream output(zip);
+
+    /* The first zip entry is a file named "mimetype": This makes sure that the mimetype
+       is always stored at the same position in the file. This is common practice. One
+       example from an ePub file:
+
+       00000000  50 4b 03 04 14 00 00 08  00 00 cd bd 0a 43 6f 61  |PK...........Coa|
+       00000010  ab 2c 14 00 00 00 14 00  00 00 08 00 00 00 6d 69  |.,............mi|
+       00000020  6d 65 74 79 70 65 61 70  70 6c 69 63 61 74 69 6f  |metypeapplicatio|
+       00000030  6e 2f 65 70 75 62 2b 7a  69 70 50 4b 03 04 14 00  |n/epub+zipPK....|
+
+    */
+
+    // Make sure that the mime type is stored as plain text.
+    //
+    // We will keep that setting for the rest of the file for the following reasons:
+    //  - Compression of the .zip file won't improve compression of the embedded .png images
+    //  - The text part of the file is too small to justify compression
+    //  - not compressing the text part of the file allows version control systems to
+    //    determine which lines have changed and to track differences between file versions
+    //    efficiently (in a compressed text virtually every byte might change when one
+    //    byte at the start of the uncompressed original is)
+    //  - and if anything crashes in a bad way chances are high that the uncompressed
+    //    contents of the .wxmx file can be rescued using a text editor.
+    //  Who would - under these circumstances - care about a kilobyte?
+    zip.SetLevel(0);
+    zip.PutNextEntry(wxT("mimetype"));
+    output << wxT("text/x-wxmathml");
+    zip.CloseEntry();
+    zip.PutNextEntry(wxT("format.txt"));
+    output << wxT(
+      "\n\nThis file contains a wxMaxima session in the .wxmx format.\n"
+      ".wxmx files are .xml-based files contained in a .zip container like .odt\n"
+      "or .docx files. After changing their name to end in .zip the .xml and\n"
+      "eventual bitmap files inside them can be extracted using any .zip file\n"
+      "viewer.\n"
+      "The reason why part of a .wxmx file still might still seem to make sense in a\n"
+      "ordinary text viewer is that the text portion of .wxmx by default\n"
+      "isn't compressed: The text is typically small and compressing it would\n"
+      "mean that changing a single character would (with a high probability) change\n"
+      "big parts of the  whole contents of the compressed .zip archive.\n"
+      "Even if version control tools like git and svn that remember all changes\n"
+      "that were ever made to a file can handle binary files compression would\n"
+      "make the changed part of the file bigger and therefore seriously reduce\n"
+      "the efficiency of version control\n\n"
+      "wxMaxima can be downloaded from https://github.com/wxMaxima-developers/wxmaxima.\n"
+      "It also is part of the windows installer for maxima\n"
+      "(https://wxmaxima-developers.github.io/wxmaxima/).\n\n"
+      "If a .wxmx file is broken but the content.xml portion of the file can still be\n"
+      "viewed using an text editor just save the xml's text as \"content.xml\"\n"
+      "and try to open it using a recent version of wxMaxima.\n"
+      "If it is valid XML (the XML header is intact, all opened tags are closed again,\n"
+      "the text is saved with the text encoding \"UTF8 without BOM\" and the few\n"
+      "special characters XML requires this for are properly escaped)\n"
+      "chances are high that wxMaxima will be able to recover all code and text\n"
+      "from the XML file.\n\n"
+      );
+    zip.CloseEntry();
+
+    // next zip entry is "content.xml"
+    zip.PutNextEntry(wxT("content.xml"));
+    for (std::vector<wxString>::const_iterator it = m_xml.begin(); it != m_xml.end(); ++it)
+      output << *it;
+    output.Flush();
+
+    for (std::vector<File>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+    {
+      zip.CloseEntry();
+      if (!it->m_previousName.IsEmpty())
+      {
+        if (!previousVersion.Copy(it->m_previousName, it->m_name, zip))
+        {
+          // We don't know how much of the entry has been written => The
+          // archive is broken.
+          wxLogMessage(wxString::Format(
+                         _("Cannot copy %s from the last version of the file."),
+                         it->m_previousName));
+          m_copyFailed = true;
+          return false;
+        }
+        copiedFiles++;
+        continue;
+      }
+
+      zip.SetLevel(it->m_compress ? 9 : 0);
+      zip.PutNextEntry(it->m_name);
+      zip.Write(it->m_data.GetData(), it->m_data.GetDataLen());
+      writtenFiles++;
+      writtenBytes += it->m_data.GetDataLen();
+    }
+
+    if (!zip.Close())
+      return false;
+    if (!out.IsOk())
+      return false;
+  }
+
+  // Make sure the data actually is on the disk before we replace the old
+  // version of the file by it.
+  if (!file.Flush())
+    return false;
+  if (!file.Close())
+    return false;
+
+  wxLogMessage(wxString::Format(
+                 _("Wrote %li files (%lu bytes) to the .wxmx file; Copied %li unchanged files (%lu bytes) from the last version of the .wxmx file"),
+                 writtenFiles, (unsigned long) writtenBytes,
+                 copiedFiles, (unsigned long) previousVersion.GetBytesCopied()));
+  return true;
+}
+
+bool WXMXSnapshot::ContainsContent(const wxString &backupfile)
+{
+  wxFFileInputStream in(backupfile);
+  if (!in.IsOk())
+    return false;
+
+  wxZipInputStream zip(in);
+  wxZipEntry *entry;
+  while ((entry = zip.GetNextEntry()) != NULL)
+  {
+    bool found = (entry->GetInternalName() == wxT("content.xml"));
+    delete entry;
+    if (found)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,166 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef WXMXSNAPSHOT_H
+#define WXMXSNAPSHOT_H
+
+#include <wx/string.h>
+#include <wx/buffer.h>
+#include <wx/thread.h>
+#include <wx/event.h>
+#include <vector>
+
+/*!\file
+
+  This file declares the class WXMXSnapshot.
+
+  WXMXSnapshot contains everything a .wxmx file consists of and can write it
+  to disk in a thread of its own.
+ */
+
+/*! Everything a .wxmx file consists of, as it was when the snapshot was taken
+
+  Taking the snapshot (which is done by Worksheet) needs the cell tree and
+  therefore has to happen in the GUI thread. But it only converts the cells to
+  XML and collects references to the compressed images: Compressing data,
+  writing the .zip archive and waiting for the disk is left to Write() which
+  doesn't touch anything outside the snapshot and therefore can be run in a
+  thread of its own by StartWriting().
+
+  The snapshot has to be created and deleted in the GUI thread as the reference
+  counters of the wxMemoryBuffers it shares with the images aren't thread-safe.
+ */
+class WXMXSnapshot
+{
+public:
+  /*! The constructor
+
+    \param file The name of the .wxmx file to write
+    \param previousVersion The name of the file unchanged files can be copied
+    from. wxEmptyString, if there is no such file.
+   */
+  WXMXSnapshot(const wxString &file, const wxString &previousVersion);
+  ~WXMXSnapshot();
+
+  //! Appends a piece of XML to content.xml
+  void AddXML(const wxString &xml);
+
+  /*! Adds a file to the .zip archive
+
+    \param name The name of the file in the archive
+    \param data The contents of the file. Must not be modified afterwards.
+    \param compress true = compress the file, false = store it as it is.
+   */
+  void AddFile(const wxString &name, const wxMemoryBuffer &data, bool compress);
+
+  /*! Adds a file that is to be copied from the previous version of the archive
+
+    \param name The name of the file in the new archive
+    \param previousName The name of the file in the previous version
+   */
+  void CopyFile(const wxString &name, const wxString &previousName);
+
+  /*! Writes the .wxmx file
+
+    Writes everything into a file ending in "~" first, makes sure it is on the
+    disk and then replaces the file by it. Only touches the snapshot itself
+    and can therefore be called from any thread.
+    \return true, if the file has been saved.
+   */
+  bool Write();
+
+  /*! Runs Write() in a thread of its own
+
+    \param handler The event handler that gets sent a wxThreadEvent with the
+    id id when Write() has finished. If no thread can be created Write() is run
+    right away; the event is sent nevertheless.
+    \param id The id of the event
+   */
+  void StartWriting(wxEvtHandler *handler, int id);
+
+  //! Has a thread been started by StartWriting() that hasn't been waited for?
+  bool IsWriting() const {return m_writer != NULL;}
+
+  /*! Waits for the thread StartWriting() has started to finish
+
+    \return The result of Write()
+   */
+  bool Wait();
+
+  //! Has writing failed because a file couldn't be copied from the previous version?
+  bool CopyFailed() const {return m_copyFailed;}
+
+  //! The name of the .wxmx file we write
+  wxString GetFile() const {return m_file;}
+
+private:
+  //! Runs Write() for StartWriting()
+  class Writer : public wxThread
+  {
+  public:
+    Writer(WXMXSnapshot *snapshot, wxEvtHandler *handler, int id);
+
+  protected:
+    virtual ExitCode Entry();
+
+  private:
+    WXMXSnapshot *m_snapshot;
+    wxEvtHandler *m_handler;
+    int m_id;
+  };
+
+  //! A file in the archive that isn't content.xml
+  struct File
+  {
+    //! The name of the file in the archive
+    wxString m_name;
+    //! The contents of the file; Empty if the file is to be copied
+    wxMemoryBuffer m_data;
+    //! Do we want to compress this file?
+    bool m_compress;
+    //! The name of the file in the previous version of the archive
+    wxString m_previousName;
+  };
+
+  //! Writes the .zip archive to backupfile
+  bool WriteArchive(const wxString &backupfile);
+
+  //! Tries to find content.xml in the archive backupfile
+  static bool ContainsContent(const wxString &backupfile);
+
+  //! The name of the .wxmx file we write
+  wxString m_file;
+  //! The name of the file unchanged files are copied from
+  wxString m_previousVersion;
+  //! The pieces content.xml consists of
+  std::vector<wxString> m_xml;
+  //! The files that follow content.xml
+  std::vector<File> m_files;
+  //! The thread StartWriting() has started
+  Writer *m_writer;
+  //! The result of Write()
+  bool m_succeeded;
+  //! Has writing failed because a file couldn't be copied?
+  bool m_copyFailed;
+};
+
+#endif // WXMXSNAPSHOT_H
@@ -0,0 +1,57 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+/*! \file
+  This file defines the class WordIndex
+
+  WordIndex knows which words appear in the code cells of the worksheet.
+ */
+
+#include "WordIndex.h"
+
+void WordIndex::Add(const wxArrayString &words)
+{
+  for (size_t i = 0; i < words.GetCount(); i++)
+    m_counts[words[i]]++;
+}
+
+void WordIndex::Remove(const wxArrayString &words)
+{
+  for (size_t i = 0; i < words.GetCount(); i++)
+  {
+    WordCounts::iterator it = m_counts.find(words[i]);
+    wxASSERT_MSG(it != m_counts.end(), wxT("Bug: Removing a word from the word index that isn't part of it"));
+    if (it == m_counts.end())
+      continue;
+    if (--it->second <= 0)
+      m_counts.erase(it);
+  }
+}
+
+long WordIndex::Count(const wxString &word) const
+{
+  WordCounts::const_iterator it = m_counts.find(word);
+  if (it == m_counts.end())
+    return 0;
+  return it->second;
+}
@@ -0,0 +1,72 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+#ifndef WORDINDEX_H
+#define WORDINDEX_H
+
+#include <map>
+#include <wx/string.h>
+#include <wx/arrstr.h>
+
+/*!\file
+
+  This file declares the class WordIndex.
+
+  WordIndex knows which words appear in the code cells of the worksheet.
+ */
+
+/*! The words that appear in the code cells of a worksheet
+
+  Every EditorCell of a code cell that is part of the worksheet adds the words
+  it contains to this index and removes them again if its text changes or if the
+  cell is deleted => The index always is up-to-date and autocompletion doesn't
+  need to look at the cells at all.
+
+  As a word can appear in many cells (and many times in one cell) the index
+  counts how often each word appears and only forgets about a word if its count
+  drops to zero.
+ */
+class WordIndex
+{
+public:
+  //! How often each word appears in the worksheet
+  typedef std::map<wxString, long> WordCounts;
+
+  //! Counts one more occurrence of each of the words
+  void Add(const wxArrayString &words);
+  //! Counts one occurrence less of each of the words
+  void Remove(const wxArrayString &words);
+  //! How often does this word appear in the worksheet?
+  long Count(const wxString &word) const;
+  //! The number of different words we know
+  size_t Size() const {return m_counts.size();}
+
+  //! All words and how often they appear
+  const WordCounts &GetCounts() const {return m_counts;}
+
+private:
+  //! How often each word appears in the worksheet
+  WordCounts m_counts;
+};
+
+#endif // WORDINDEX_H
@@ -44,6 +44,8 @@
 #include "GroupCell.h"
 #include "SlideShowCell.h"
 #include "ImgCell.h"
+#include "ImageExportQueue.h"
+#include "ImageStore.h"
 #include "MarkDown.h"
 #include "ConfigDialogue.h"
 
@@ -63,8 +65,11 @@
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
 #include <wx/filesys.h>
-#include <wx/fs_mem.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+
+long Worksheet::m_wxmxArchives = 0;
 
 //! This class represents the worksheet shown in the middle of the wxMaxima window.
 Worksheet::Worksheet(wxWindow *parent, int id, wxPoint position, wxSize size) :
@@ -102,6 +107,7 @@ Worksheet::Worksheet(wxWindow *parent, int id, wxPoint position, wxSize size) :
   m_pointer_x = -1;
   m_pointer_y = -1;
   m_recalculateStart = NULL;
+  m_cellsWithEstimatedSize = false;
   m_mouseMotionWas = false;
   m_rectToRefresh = wxRect(-1,-1,-1,-1);
   m_notificationMessage = NULL;
@@ -111,7 +117,7 @@ Worksheet::Worksheet(wxWindow *parent, int id, wxPoint position, wxSize size) :
 
   m_dc = new wxClientDC(this);
   m_configuration->SetContext(*m_dc);
-  m_autocomplete  = new AutoComplete(m_configuration);
+  m_autocomplete  = new AutoComplete(m_configuration, &m_cellPointers.m_worksheetWords);
   m_configuration->SetWorkSheet(this);
   m_configuration->ReadConfig();
   m_redrawStart = NULL;
@@ -148,6 +154,8 @@ Worksheet::Worksheet(wxWindow *parent, int id, wxPoint position, wxSize size) :
   m_timer.SetOwner(this, TIMER_ID);
   m_caretTimer.SetOwner(this, CARET_TIMER_ID);
   m_saved = false;
+  m_wxmxArchive = -1;
+  m_backgroundSave = NULL;
   AdjustSize();
   m_autocompleteTemplates = false;
 
@@ -202,16 +210,7 @@ bool Worksheet::RedrawIfRequested()
       GroupCell *oldGroupCellUnderPointer = dynamic_cast<GroupCell *>(m_cellPointers.m_groupCellUnderPointer);
 
       // find out which group cell lies under the pointer
-      GroupCell *tmp = m_tree;
-      wxRect rect;
-
-      while (tmp != NULL)
-      {
-        rect = tmp->GetRect();
-        if (m_pointer_y <= rect.GetBottom())
-          break;
-        tmp = dynamic_cast<GroupCell *>(tmp->m_next);
-      }
+      GroupCell *tmp = GetGroupAt(m_pointer_y);
       if (m_tree)
         m_tree->CellUnderPointer(tmp);
 
@@ -345,6 +344,9 @@ Worksheet::~Worksheet()
 
   m_mainToolBar = NULL;
 
+  if (ImageScaler::Running())
+    ImageScaler::Get()->ForgetHandler(this);
+  FinishBackgroundSave();
   ClearDocument();
 
   m_configuration = NULL;
@@ -588,6 +590,10 @@ void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event))
       tmp->Recalculate();
       recalculateNecessaryWas = true;
     }
+    // Cells far from the visible region are only measured once they are
+    // scrolled into view.
+    else if((tmp->SizeIsEstimated()) && (tmp->GetRect().GetTop() <= bottom))
+      tmp->Recalculate();
     
     wxRect cellRect = tmp->GetRect();
     
@@ -650,6 +656,16 @@ GroupCell *Worksheet::InsertGroupCells(GroupCell *cells, GroupCell *where)
   return InsertGroupCells(cells, where, &treeUndoActions);
 }
 
+GroupCell *Worksheet::AppendGroupCells(GroupCell *cells)
+{
+  GroupCell *oldLast = m_last;
+  GroupCell *last = InsertGroupCells(cells, oldLast, NULL);
+  if ((last != NULL) && (oldLast != NULL) && (!treeUndoActions.empty()) &&
+      (treeUndoActions.front()->m_newCellsEnd == oldLast))
+    treeUndoActions.front()->m_newCellsEnd = last;
+  return last;
+}
+
 // InsertGroupCells
 // inserts groupcells after position "where" (NULL = top of the document)
 // Multiple groupcells can be inserted when tree->m_next != NULL
@@ -668,13 +684,17 @@ GroupCell *Worksheet::InsertGroupCells(
   GroupCell *next; // next gc to insertion point
   GroupCell *prev;
 
-  // Find the last cell in the tree that is to be inserted
+  // Find the last cell in the tree that is to be inserted. Cells that come
+  // from the undo buffer have stopped offering their words for autocompletion
+  // when they were deleted.
   GroupCell *lastOfCellsToInsert = cells;
+  lastOfCellsToInsert->SetIndexed(true);
   if (lastOfCellsToInsert->IsFoldable() || (lastOfCellsToInsert->GetGroupType() == GC_TYPE_IMAGE))
     renumbersections = true;
   while (lastOfCellsToInsert->m_next)
   {
     lastOfCellsToInsert = dynamic_cast<GroupCell *>(lastOfCellsToInsert->m_next);
+    lastOfCellsToInsert->SetIndexed(true);
     if (lastOfCellsToInsert->IsFoldable() || (lastOfCellsToInsert->GetGroupType() == GC_TYPE_IMAGE))
       renumbersections = true;
   }
@@ -893,10 +913,37 @@ void Worksheet::SetZoomFactor(double newzoom, bool recalc)
   ScheduleScrollToCell(cellToScrollTo);
 }
 
+int Worksheet::MeasureUntil()
+{
+  int width;
+  int height;
+  GetClientSize(&width, &height);
+  wxPoint upperLeft;
+  CalcUnscrolledPosition(0, 0, &upperLeft.x, &upperLeft.y);
+  // Measuring the next screen, too, means that scrolling down by a page
+  // won't move cells whose size was only estimated so far.
+  return upperLeft.y + 2 * height;
+}
+
 bool Worksheet::RecalculateIfNeeded()
 {
   bool recalculate = true;
 
+  // Cells whose size we have only estimated might have been scrolled into view.
+  if((m_recalculateStart == NULL) && (m_cellsWithEstimatedSize) && (m_tree != NULL))
+  {
+    GroupCell *tmp = m_tree;
+    while ((tmp != NULL) && (!tmp->SizeIsEstimated()))
+      tmp = dynamic_cast<GroupCell *>(tmp->m_next);
+    if (tmp == NULL)
+      m_cellsWithEstimatedSize = false;
+    else
+    {
+      if(tmp->GetCurrentPoint().y <= MeasureUntil())
+        m_recalculateStart = tmp;
+    }
+  }
+
   if((m_recalculateStart == NULL) || (m_tree == NULL))
     recalculate = false;
 
@@ -940,6 +987,8 @@ bool Worksheet::RecalculateIfNeeded()
   int height;
   GetClientSize(&width, &height);
 
+  int measureUntil = MeasureUntil();
+  long estimated = 0;
   while (tmp != NULL)
   {
     wxPoint upperLeftScreenCorner;
@@ -949,11 +998,32 @@ bool Worksheet::RecalculateIfNeeded()
                                       upperLeftScreenCorner + wxPoint(width,height)));
     m_configuration->SetWorksheetPosition(GetPosition());
 
-    tmp->Recalculate();
+    // Cells that are far below the visible region are only measured when they
+    // are scrolled into view.
+    GroupCell *previous = dynamic_cast<GroupCell *>(tmp->m_previous);
+    if((previous != NULL) &&
+       (previous->GetCurrentPoint().y + previous->GetMaxDrop() > measureUntil) &&
+       (tmp->NeedsRecalculation()))
+    {
+      tmp->EstimateSize();
+      estimated++;
+    }
+    else
+      tmp->Recalculate();
     tmp = dynamic_cast<GroupCell *>(tmp->m_next);
   }
+  if(estimated > 0)
+  {
+    m_cellsWithEstimatedSize = true;
+    wxLogDebug(wxT("Estimated the size of %li cells outside the visible region"), estimated);
+  }
 
+  // Now that we know more cell sizes the scrollbars might need adjusting.
   AdjustSize();
+  if(!m_cellPointers.m_groupCellIndex.IsValid())
+    m_cellPointers.m_groupCellIndex.Rebuild(m_tree);
+  m_configuration->LogTextExtentCacheStats();
+  m_configuration->LogFontConstructions();
   m_configuration->RecalculationForce(false);
   m_configuration->FontChanged(false);
 
@@ -961,8 +1031,50 @@ bool Worksheet::RecalculateIfNeeded()
   return true;
 }
 
+void Worksheet::MeasureEstimatedCells(GroupCell *upTo)
+{
+  RecalculateIfNeeded();
+  if((!m_cellsWithEstimatedSize) || (m_tree == NULL) || (m_dc == NULL))
+    return;
+
+  bool measured = false;
+  GroupCell *tmp = m_tree;
+  while (tmp != NULL)
+  {
+    if(tmp->SizeIsEstimated())
+    {
+      tmp->Recalculate();
+      measured = true;
+    }
+    else if(measured)
+      tmp->UpdateYPosition();
+
+    if(tmp == upTo)
+      break;
+    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
+  }
+  if(tmp == NULL)
+    m_cellsWithEstimatedSize = false;
+
+  if(!measured)
+    return;
+
+  // The cells below the ones we have measured might have moved. If the cells are
+  // indexed they will ask the index for their new position instead.
+  if(!m_cellPointers.m_groupCellIndex.IsValid())
+  {
+    while (tmp != NULL)
+      tmp = tmp->UpdateYPosition();
+  }
+
+  AdjustSize();
+}
+
 void Worksheet::Recalculate(Cell *start, bool force)
 {
+  // The cells might have been added or removed.
+  m_cellPointers.m_groupCellIndex.Invalidate();
+
   GroupCell *group = m_tree;
   if(start != NULL)
     group = dynamic_cast<GroupCell *>(start->GetGroup());
@@ -1164,6 +1276,7 @@ bool Worksheet::IsLesserGCType(int type, int comparedTo)
  */
 void Worksheet::FoldOccurred()
 {
+  m_cellPointers.m_groupCellIndex.Invalidate();
   SetSaved(false);
   UpdateMLast();
 }
@@ -1881,24 +1994,17 @@ void Worksheet::OnMouseLeftDown(wxMouseEvent &event)
   m_hCaretActive = false;
   SetActiveCell(NULL, false);
 
-  GroupCell *tmp = m_tree;
+  GroupCell *tmp = GetGroupAt(m_down.y);
   wxRect rect;
   GroupCell *clickedBeforeGC = NULL;
   GroupCell *clickedInGC = NULL;
-  while (tmp != NULL)
-  { // go through all groupcells
+  if (tmp != NULL)
+  {
     rect = tmp->GetRect();
     if (m_down.y < rect.GetTop())
-    {
-      clickedBeforeGC = dynamic_cast<GroupCell *>(tmp);
-      break;
-    }
-    else if (m_down.y <= rect.GetBottom())
-    {
-      clickedInGC = dynamic_cast<GroupCell *>(tmp);
-      break;
-    }
-    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
+      clickedBeforeGC = tmp;
+    else
+      clickedInGC = tmp;
   }
 
   if (clickedBeforeGC != NULL)
@@ -1935,19 +2041,20 @@ GroupCell *Worksheet::FirstVisibleGC()
 {
   wxPoint point;
   CalcUnscrolledPosition(0, 0, &point.x, &point.y);
-  wxRect rect;
-  GroupCell *tmp = m_tree;
-
-  while (tmp != NULL)
-  { // go through all groupcells
-    rect = tmp->GetRect();
+  return GetGroupAt(point.y + 1);
+}
 
-    if (point.y < rect.GetBottom())
-      return tmp;
+GroupCell *Worksheet::GetGroupAt(int y)
+{
+  if (m_tree == NULL)
+    return NULL;
 
-    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
-  }
-  return NULL;
+  GroupCell *group = m_cellPointers.m_groupCellIndex.GetGroupAt(m_tree, y);
+  // The cell itself might not have been moved to the position the index knows
+  // for it, yet.
+  if (group != NULL)
+    group->UpdateYPosition();
+  return group;
 }
 
 void Worksheet::OnMouseLeftUp(wxMouseEvent &event)
@@ -2066,32 +2173,20 @@ void Worksheet::SelectGroupCells(wxPoint down, wxPoint up)
   wxRect rect;
 
   // find out the group cell the selection begins in
-  GroupCell *tmp = m_tree;
-  while (tmp != NULL)
-  {
-    rect = tmp->GetRect();
-    if (ytop <= rect.GetBottom())
-    {
-      m_cellPointers.m_selectionStart = tmp;
-      break;
-    }
-    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
-  }
+  m_cellPointers.m_selectionStart = GetGroupAt(ytop);
 
   // find out the group cell the selection ends in
-  tmp = m_tree;
-  while (tmp != NULL)
+  GroupCell *tmp = GetGroupAt(ybottom);
+  if (tmp == NULL)
+    m_cellPointers.m_selectionEnd = m_last;
+  else
   {
     rect = tmp->GetRect();
     if (ybottom < rect.GetTop())
-    {
       m_cellPointers.m_selectionEnd = tmp->m_previous;
-      break;
-    }
-    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
+    else
+      m_cellPointers.m_selectionEnd = tmp;
   }
-  if (tmp == NULL)
-    m_cellPointers.m_selectionEnd = m_last;
 
   if (m_cellPointers.m_selectionStart)
   {
@@ -4413,6 +4508,12 @@ void Worksheet::StepAnimation(int change)
   }
 }
 
+void Worksheet::OnImageScaled(wxThreadEvent &WXUNUSED(event))
+{
+  // The image picks up its bitmap when it is drawn the next time.
+  RequestRedraw();
+}
+
 void Worksheet::OnTimer(wxTimerEvent &event)
 {
   switch (event.GetId())
@@ -5426,6 +5527,23 @@ bool Worksheet::ExportToHTML(wxString file)
   // Write the actual contents
   //////////////////////////////////////////////
 
+  // The bitmaps and animations are encoded by background threads while we render
+  // the rest of the document. Only once they are all written we know if the
+  // lines that tell their size have to contain the size of a failed export.
+  // Until then the html code is kept in parts that are separated by these lines.
+  ImageExportQueue imageQueue;
+  // Identical images are written only once - and only if the last export
+  // hasn't already written them.
+  ImageStore imageStore(imgDir, filename);
+  wxString style;
+  if ((m_configuration->HTMLequationFormat() == Configuration::svg) ||
+      (m_configuration->HTMLequationFormat() == Configuration::bitmap))
+    style = ImageStore::Style(m_configuration);
+  std::vector<wxString> outputParts;
+  std::vector<long> pendingImages;
+  std::vector<wxString> pendingLines;
+  std::vector<wxString> pendingFailedLines;
+
   while (tmp != NULL)
   {
 
@@ -5499,8 +5617,13 @@ bool Worksheet::ExportToHTML(wxString file)
 
           if (chunk->GetType() == MC_TYPE_SLIDE)
           {
-            dynamic_cast<SlideShow *>(chunk)->ToGif(
-                    imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.gif"), count));
+            SlideShow *slideShow = dynamic_cast<SlideShow *>(chunk);
+            wxImageArray frames;
+            slideShow->GetGifFrames(frames);
+            imageQueue.SaveGIF(frames,
+                               imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.gif"), count),
+                               slideShow->GetGifDelay());
+            wxDELETE(chunk);
             output << wxT("  <img src=\"") + filename_encoded + wxT("_htmlimg/") +
                       filename_encoded +
                       wxString::Format(_("_%d.gif\"  alt=\"Animated Diagram\" loading=\"lazy\" style=\"max-width:90%%;\" />\n"), count);
@@ -5537,12 +5660,25 @@ bool Worksheet::ExportToHTML(wxString file)
               wxString alttext = _("Result");
               alttext = chunk->ListToString();
               alttext = EditorCell::EscapeHTMLChars(alttext);
-              Svgout svgout(&m_configuration, imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.svg"), count));
-              wxSize size = svgout.SetData(chunk);
+              wxString id = ImageStore::Id(wxT("svg\n") + style + chunk->ListToXML());
+              wxSize size;
+              ImageStore::Entry *stored = imageStore.Find(id, wxT("svg"));
+              if (stored != NULL)
+              {
+                size = stored->m_size;
+                wxDELETE(chunk);
+              }
+              else
+              {
+                Svgout svgout(&m_configuration, imageStore.GetFileName(id, wxT("svg")));
+                size = svgout.SetData(chunk);
+                if (size.x >= 0)
+                  imageStore.Add(id, wxT("svg"), size);
+              }
               wxString line = wxT("  <img src=\"") +
-                filename_encoded + wxT("_htmlimg/") + filename_encoded +
-                wxString::Format(wxT("_%d.svg\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\"" ),
-                                 count, size.x) +
+                filename_encoded + wxT("_htmlimg/") + filename_encoded + wxT("_") + id +
+                wxString::Format(wxT(".svg\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\"" ),
+                                 size.x) +
                 alttext +
                 wxT("\" /><br/>\n");
 
@@ -5557,23 +5693,49 @@ bool Worksheet::ExportToHTML(wxString file)
               int bitmapScale = 3;
               ext = wxT(".png");
               wxConfig::Get()->Read(wxT("bitmapScale"), &bitmapScale);
-              size = CopyToFile(imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.png"), count),
-                                chunk,
-                                NULL, true, bitmapScale);
+              wxString id = ImageStore::Id(wxString::Format(wxT("png %i\n"), bitmapScale) +
+                                           style + chunk->ListToXML());
+              long job;
+              ImageStore::Entry *stored = imageStore.Find(id, wxT("png"));
+              if (stored != NULL)
+              {
+                size = stored->m_size;
+                job = stored->m_job;
+              }
+              else
+              {
+                // Rendering needs the GUI thread, encoding the .png file doesn't.
+                BitmapOut bmp(&m_configuration, bitmapScale);
+                bmp.SetData(CopySelection(chunk, NULL, true));
+                wxImage image = bmp.ToImage();
+                size = bmp.GetSize();
+                job = imageQueue.SavePNG(image, imageStore.GetFileName(id, wxT("png")));
+                imageStore.Add(id, wxT("png"), size, job);
+              }
               int borderwidth = 0;
               wxString alttext = _("Result");
               alttext = chunk->ListToString();
               alttext = EditorCell::EscapeHTMLChars(alttext);
               borderwidth = chunk->m_imageBorderWidth;
 
-              wxString line = wxT("  <img src=\"") +
-                filename_encoded + wxT("_htmlimg/") + filename_encoded +
-                wxString::Format(wxT("_%d%s\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\" "),
-                                 count, ext, size.x / bitmapScale - 2 * borderwidth) +
-                alttext +
-                wxT("\" /><br/>\n");
-
-              output << line + "\n";
+              // The width we would have written if the image could (or couldn't)
+              // be saved.
+              int widths[2] = {size.x / bitmapScale - 2 * borderwidth,
+                               -1 / bitmapScale - 2 * borderwidth};
+              wxString lines[2];
+              for (int i = 0; i < 2; i++)
+                lines[i] = wxT("  <img src=\"") +
+                  filename_encoded + wxT("_htmlimg/") + filename_encoded + wxT("_") + id +
+                  wxString::Format(wxT("%s\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\" "),
+                                   ext, widths[i]) +
+                  alttext +
+                  wxT("\" /><br/>\n");
+
+              outputParts.push_back(output);
+              output = wxEmptyString;
+              pendingImages.push_back(job);
+              pendingLines.push_back(lines[0] + "\n");
+              pendingFailedLines.push_back(lines[1] + "\n");
               wxDELETE(chunk);
               break;
             }
@@ -5592,8 +5754,7 @@ bool Worksheet::ExportToHTML(wxString file)
             wxString ext;
             wxSize size;
             ext = wxT(".") + dynamic_cast<ImgCell *>(chunk)->GetExtension();
-            size = dynamic_cast<ImgCell *>(chunk)->ToImageFile(
-              imgDir + wxT("/") + filename + wxString::Format(wxT("_%d"), count) + ext);
+            wxString id = imageStore.WriteImage(dynamic_cast<ImgCell *>(chunk), size);
             int borderwidth = 0;
             wxString alttext = _("Image");
             alttext = chunk->ListToString();
@@ -5601,9 +5762,9 @@ bool Worksheet::ExportToHTML(wxString file)
             borderwidth = chunk->m_imageBorderWidth;
 
             wxString line = wxT("  <img src=\"") +
-              filename_encoded + wxT("_htmlimg/") + filename_encoded +
-              wxString::Format(wxT("_%d%s\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\""),
-                               count, ext, size.x - 2 * borderwidth) +
+              filename_encoded + wxT("_htmlimg/") + filename_encoded + wxT("_") + id +
+              wxString::Format(wxT("%s\" width=\"%i\" style=\"max-width:90%%;\" loading=\"lazy\" alt=\""),
+                               ext, size.x - 2 * borderwidth) +
               alttext +
               wxT("\" /><br/>\n");
 
@@ -5694,8 +5855,12 @@ bool Worksheet::ExportToHTML(wxString file)
           output << wxT("<br/>\n");
           if (tmp->GetLabel()->GetType() == MC_TYPE_SLIDE)
           {
-            dynamic_cast<SlideShow *>(tmp->GetOutput())->ToGif(imgDir + wxT("/") + filename +
-                                                               wxString::Format(wxT("_%d.gif"), count));
+            SlideShow *slideShow = dynamic_cast<SlideShow *>(tmp->GetOutput());
+            wxImageArray frames;
+            slideShow->GetGifFrames(frames);
+            imageQueue.SaveGIF(frames,
+                               imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.gif"), count),
+                               slideShow->GetGifDelay());
             output << wxT("  <img src=\"") + filename_encoded + wxT("_htmlimg/") +
                       filename_encoded +
                       wxString::Format(_("_%d.gif\" alt=\"Animated Diagram\" style=\"max-width:90%%;\" loading=\"lazy\" />"), count)
@@ -5704,12 +5869,11 @@ bool Worksheet::ExportToHTML(wxString file)
           else
           {
             ImgCell *imgCell = dynamic_cast<ImgCell *>(out);
-            imgCell->ToImageFile(
-                    imgDir + wxT("/") + filename + wxString::Format(wxT("_%d."), count) +
-                    imgCell->GetExtension());
+            wxSize size;
+            wxString id = imageStore.WriteImage(imgCell, size);
             output << wxT("  <img src=\"") + filename_encoded + wxT("_htmlimg/") +
-                      filename_encoded +
-                      wxString::Format(wxT("_%d.%s\" alt=\"Diagram\" style=\"max-width:90%%;\" loading=\"lazy\" />"), count,
+                      filename_encoded + wxT("_") + id +
+                      wxString::Format(wxT(".%s\" alt=\"Diagram\" style=\"max-width:90%%;\" loading=\"lazy\" />"),
                                        imgCell->GetExtension());
           }
           output << wxT("</div>\n");
@@ -5723,6 +5887,23 @@ bool Worksheet::ExportToHTML(wxString file)
     tmp = dynamic_cast<GroupCell *>(tmp->m_next);
   }
 
+  // Wait for the images and fill in the lines that depend on them.
+  imageQueue.Finish();
+  imageStore.Finish(&imageQueue);
+  {
+    wxString document;
+    for (size_t i = 0; i < pendingImages.size(); i++)
+    {
+      document << outputParts[i];
+      if (imageQueue.Succeeded(pendingImages[i]))
+        document << pendingLines[i];
+      else
+        document << pendingFailedLines[i];
+    }
+    document << output;
+    output = document;
+  }
+
 //////////////////////////////////////////////
 // Footer
 //////////////////////////////////////////////
@@ -6164,6 +6345,8 @@ bool Worksheet::ExportToTeX(wxString file)
   wxFileName::SplitPath(file, &path, &filename, &ext);
   imgDir = path + wxT("/") + filename + wxT("_img");
   int imgCounter = 0;
+  // Images that appear many times are written only once.
+  ImageStore images(imgDir, filename);
 
   wxFileOutputStream outfile(file);
   if (!outfile.IsOk())
@@ -6261,10 +6444,11 @@ bool Worksheet::ExportToTeX(wxString file)
   //
   while (tmp != NULL)
   {
-    wxString s = tmp->ToTeX(imgDir, filename, &imgCounter);
+    wxString s = tmp->ToTeX(imgDir, filename, &imgCounter, &images);
     output << s << wxT("\n");
     tmp = dynamic_cast<GroupCell *>(tmp->m_next);
   }
+  images.Finish();
 
   //
   // Close document
@@ -6498,8 +6682,8 @@ bool Worksheet::ExportToMAC(wxString file)
 /*
   Save the data as wxmx file
 
-  First saves the data to a backup file ending in .wxmx~ so if anything goes
-  horribly wrong in this stepp all that is lost is the data that was input
+  The file is first saved to a backup file ending in .wxmx~ so if anything goes
+  horribly wrong in this step all that is lost is the data that was input
   since the last save. Then the original .wxmx file is replaced in a
   (hopefully) atomic operation.
 */
@@ -6507,81 +6691,93 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
 {
   // Show a busy cursor as long as we export a file.
   wxBusyCursor crs;
-  wxLogMessage(_("Starting to save the worksheet as .wxmx"));
-  // delete temp file if it already exists
-  wxString backupfile = file + wxT("~");
-  if (wxFileExists(backupfile))
+
+  // An autosave that is still writing might write to the same file.
+  FinishBackgroundSave();
+
+  WXMXSnapshot *snapshot = TakeWXMXSnapshot(file, markAsSaved);
+  if (snapshot == NULL)
+    return false;
+
+  bool succeeded = snapshot->Write();
+  bool copyFailed = snapshot->CopyFailed();
+  WXMXSnapshotWritten(snapshot, markAsSaved, succeeded);
+
+  // We don't know what is wrong with the file we copied the unchanged files
+  // from => Retry without copying anything.
+  if (copyFailed)
   {
-    if (!wxRemoveFile(backupfile))
-      return false;
+    wxLogMessage(_("Saving everything anew."));
+    m_wxmxArchive = -1;
+    return ExportToWXMX(file, markAsSaved);
   }
+  return succeeded;
+}
+
+bool Worksheet::StartBackgroundSave(wxString file, wxEvtHandler *handler, int id)
+{
+  // Two saves that write to the same file at once would destroy each other's work.
+  if (m_backgroundSave != NULL)
+    return false;
 
-  wxFFileOutputStream out(backupfile);
-  if (!out.IsOk())
+  m_backgroundSave = TakeWXMXSnapshot(file, true);
+  if (m_backgroundSave == NULL)
     return false;
-  wxZipOutputStream zip(out);
-  wxTextOutputStream output(zip);
 
-  /* The first zip entry is a file named "mimetype": This makes sure that the mimetype
-     is always stored at the same position in the file. This is common practice. One
-     example from an ePub file:
+  m_backgroundSave->StartWriting(handler, id);
+  return true;
+}
 
-     00000000  50 4b 03 04 14 00 00 08  00 00 cd bd 0a 43 6f 61  |PK...........Coa|
-     00000010  ab 2c 14 00 00 00 14 00  00 00 08 00 00 00 6d 69  |.,............mi|
-     00000020  6d 65 74 79 70 65 61 70  70 6c 69 63 61 74 69 6f  |metypeapplicatio|
-     00000030  6e 2f 65 70 75 62 2b 7a  69 70 50 4b 03 04 14 00  |n/epub+zipPK....|
+bool Worksheet::FinishBackgroundSave(wxString *file)
+{
+  if (file != NULL)
+    *file = wxEmptyString;
+  if (m_backgroundSave == NULL)
+    return false;
 
-  */
+  WXMXSnapshot *snapshot = m_backgroundSave;
+  m_backgroundSave = NULL;
+  if (file != NULL)
+    *file = snapshot->GetFile();
+  return WXMXSnapshotWritten(snapshot, true, snapshot->Wait());
+}
 
-  // Make sure that the mime type is stored as plain text.
-  //
-  // We will keep that setting for the rest of the file for the following reasons:
-  //  - Compression of the .zip file won't improve compression of the embedded .png images
-  //  - The text part of the file is too small to justify compression
-  //  - not compressing the text part of the file allows version control systems to
-  //    determine which lines have changed and to track differences between file versions
-  //    efficiently (in a compressed text virtually every byte might change when one
-  //    byte at the start of the uncompressed original is)
-  //  - and if anything crashes in a bad way chances are high that the uncompressed
-  //    contents of the .wxmx file can be rescued using a text editor.
-  //  Who would - under these circumstances - care about a kilobyte?
-  zip.SetLevel(0);
-  zip.PutNextEntry(wxT("mimetype"));
-  output << wxT("text/x-wxmathml");
-  zip.CloseEntry();
-  zip.PutNextEntry(wxT("format.txt"));
-  output << wxT(
-    "\n\nThis file contains a wxMaxima session in the .wxmx format.\n"
-    ".wxmx files are .xml-based files contained in a .zip container like .odt\n"
-    "or .docx files. After changing their name to end in .zip the .xml and\n"
-    "eventual bitmap files inside them can be extracted using any .zip file\n"
-    "viewer.\n"
-    "The reason why part of a .wxmx file still might still seem to make sense in a\n"
-    "ordinary text viewer is that the text portion of .wxmx by default\n"
-    "isn't compressed: The text is typically small and compressing it would\n"
-    "mean that changing a single character would (with a high probability) change\n"
-    "big parts of the  whole contents of the compressed .zip archive.\n"
-    "Even if version control tools like git and svn that remember all changes\n"
-    "that were ever made to a file can handle binary files compression would\n"
-    "make the changed part of the file bigger and therefore seriously reduce\n"
-    "the efficiency of version control\n\n"
-    "wxMaxima can be downloaded from https://github.com/wxMaxima-developers/wxmaxima.\n"
-    "It also is part of the windows installer for maxima\n"
-    "(https://wxmaxima-developers.github.io/wxmaxima/).\n\n"
-    "If a .wxmx file is broken but the content.xml portion of the file can still be\n"
-    "viewed using an text editor just save the xml's text as \"content.xml\"\n"
-    "and try to open it using a recent version of wxMaxima.\n"
-    "If it is valid XML (the XML header is intact, all opened tags are closed again,\n"
-    "the text is saved with the text encoding \"UTF8 without BOM\" and the few\n"
-    "special characters XML requires this for are properly escaped)\n"
-    "chances are high that wxMaxima will be able to recover all code and text\n"
-    "from the XML file.\n\n"
-    );
-  zip.CloseEntry();
+bool Worksheet::WXMXSnapshotWritten(WXMXSnapshot *snapshot, bool markAsSaved, bool succeeded)
+{
+  wxString file = snapshot->GetFile();
+  delete snapshot;
 
-  // next zip entry is "content.xml", xml of m_tree
+  if (!markAsSaved)
+    return succeeded;
 
-  zip.PutNextEntry(wxT("content.xml"));
+  if (succeeded)
+  {
+    m_wxmxArchiveFile = file;
+    m_wxmxArchiveTime = wxFileName(file).GetModificationTime();
+  }
+  else
+  {
+    // The images have already been told that their files can be found in the
+    // new version of the file.
+    m_wxmxArchive = -1;
+    m_saved = false;
+  }
+  return succeeded;
+}
+
+WXMXSnapshot *Worksheet::TakeWXMXSnapshot(wxString file, bool markAsSaved)
+{
+  // If we are overwriting the version of the file we have saved last the images
+  // and gnuplot data that haven't changed since then can be copied from there
+  // without recompressing them.
+  long previousArchive = -1;
+  if ((m_wxmxArchive >= 0) && (file == m_wxmxArchiveFile) && wxFileExists(file) &&
+      (wxFileName(file).GetModificationTime() == m_wxmxArchiveTime))
+    previousArchive = m_wxmxArchive;
+
+  WXMXSnapshot *snapshot = new WXMXSnapshot(file, (previousArchive >= 0) ? file : wxString(wxEmptyString));
+
+  // next zip entry is "content.xml", xml of m_tree
   wxString xmlText;
 
   xmlText << wxT("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
@@ -6651,56 +6847,42 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
   }
   
   xmlText << ">\n";
+  if (m_tree != NULL)
+    snapshot->AddXML(xmlText);
 
   // Reset image counter
   m_cellPointers.WXMXResetCounter();
+  m_cellPointers.WXMXCollectFiles(true);
 
-  if (m_tree)
-    xmlText += m_tree->ListToXML();
-
-  // Delete all but one control character from the string: there should be
-  // no way for them to enter this string, anyway. But sometimes they still
-  // do...
-  for (wxString::iterator it = xmlText.begin(); it != xmlText.end(); ++it)
+  long validatedCells = 0;
+  for (GroupCell *cell = m_tree; cell != NULL; cell = dynamic_cast<GroupCell *>(cell->m_next))
   {
-    wxChar c = *it;
-    if ((c < wxT('\t')) ||
-        ((c > wxT('\n')) && (c < wxT(' '))) ||
-        (c == wxChar((char) 0x7F))
-      )
+    // Cells that haven't changed since the last save aren't serialized again.
+    xmlText = cell->CachedXML();
+
+    // The XML of cells that haven't changed since the last save is known to be
+    // valid.
+    if (cell->XMLValidated())
     {
-      // *it = wxT(' ');
+      snapshot->AddXML(xmlText);
+      continue;
     }
-  }
-
-  xmlText +=  wxT("\n</wxMaximaDocument>");
+    validatedCells++;
 
-  // Prepare reading the files we have stored in memory
-  wxFileSystem *fsystem = new wxFileSystem();
-  fsystem->AddHandler(new wxMemoryFSHandler);
-  fsystem->ChangePathTo(wxT("memory:"), true);
-
-  // In wxWidgets 3.1.1 fsystem->FindFirst crashes if we don't have a file
-  // in the memory filesystem => Let's create a file just to make sure
-  // one exists.
-  wxMemoryBuffer dummyBuf;
-  wxMemoryFSHandler::AddFile("dummyfile",
-                             dummyBuf.GetData(),
-                             dummyBuf.GetDataLen());
-
-  // Let wxWidgets test if the document can be read again by the XML parser before
-  // the user finds out the hard way.
-  {
+    // Let wxWidgets test if the cell can be read again by the XML parser before
+    // the user finds out the hard way.
     wxXmlDocument doc;
     {
       wxMemoryOutputStream ostream;
       wxTextOutputStream txtstrm(ostream);
+      txtstrm.WriteString(wxT("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<wxMaximaDocument>"));
       txtstrm.WriteString(xmlText);
+      txtstrm.WriteString(wxT("</wxMaximaDocument>"));
       wxMemoryInputStream istream(ostream);
       doc.Load(istream);
     }
 
-    // If we fail to load the document we abort the safe process as it will
+    // If we fail to load the cell we abort the safe process as it will
     // only destroy data.
     // But we can still put the erroneous data into the clipboard for debugging purposes.
     if (!doc.IsOk())
@@ -6710,137 +6892,105 @@ bool Worksheet::ExportToWXMX(wxString file, bool markAsSaved)
         wxDataObjectComposite *data = new wxDataObjectComposite;
         data->Add(new wxTextDataObject(xmlText));
         wxTheClipboard->SetData(data);
+        wxTheClipboard->Close();
         wxLogMessage(_("Save failed. The erroneous XML data has been put on the clipboard in order to allow to debug it."));
       }
-
-      // Remove all files from our internal filesystem
-      wxString memFsName = fsystem->FindFirst("*", wxFILE);
-      while(memFsName != wxEmptyString)
-      {
-        wxString name = memFsName.Right(memFsName.Length()-7);
-        wxMemoryFSHandler::RemoveFile(name);
-        memFsName = fsystem->FindNext();
-      }
-      wxDELETE(fsystem);
-      return false;
+      m_cellPointers.WXMXCollectFiles(false);
+      delete snapshot;
+      return NULL;
     }
+
+    // wxWidgets could pretty-print the XML document now. But as no-one will
+    // look at it, anyway, there might be no good reason to do so.
+    snapshot->AddXML(xmlText);
+    cell->XMLValidated(true);
   }
 
-  // wxWidgets could pretty-print the XML document now. But as no-one will
-  // look at it, anyway, there might be no good reason to do so.
-  if (m_tree != NULL)output << xmlText;
+  if (m_tree != NULL)
+    snapshot->AddXML(wxT("\n</wxMaximaDocument>"));
+
+  // The images are only referenced by the snapshot, not copied.
+  long imageCount = 0;
+  size_t imageBytes = 0;
+  long copiedFiles = 0;
+  Cell::CellPointers::WXMXFileList files;
+  files.swap(m_cellPointers.WXMXFiles());
+  m_cellPointers.WXMXCollectFiles(false);
+  for (Cell::CellPointers::WXMXFileList::iterator it = files.begin(); it != files.end();)
+  {
+    // Files that haven't changed since the last save are copied from there.
+    wxString previousName = it->m_image->GetWXMXEntry(it->m_type, previousArchive);
+    if (!previousName.IsEmpty())
+    {
+      snapshot->CopyFile(it->m_name, previousName);
+      copiedFiles++;
+      ++it;
+      continue;
+    }
 
-  // Move all files we have stored in memory during saving to zip file
-  wxString memFsName = fsystem->FindFirst("*", wxFILE);
-  while(memFsName != wxEmptyString)
-  {
-    wxString name = memFsName.Right(memFsName.Length()-7);
-    if(name != wxT("dummyfile"))
+    wxMemoryBuffer data;
+    switch (it->m_type)
     {
-      zip.CloseEntry();
-
-      wxFSFile *fsfile = fsystem->OpenFile(memFsName);
-
-      if (fsfile)
-      {
-        // The data for gnuplot is likely to change in its entirety if it
-        // ever changes => We can store it in a compressed form.
-        if(name.EndsWith(wxT(".data")))
-          zip.SetLevel(9);
-        else
-          zip.SetLevel(0);
-
-        zip.PutNextEntry(name);
-        wxInputStream *imagefile = fsfile->GetStream();
-
-        while (!(imagefile->Eof()))
-          imagefile->Read(zip);
-
-        wxDELETE(imagefile);
-      }
+    case Cell::CellPointers::WXMX_IMAGE:
+      data = it->m_image->GetCompressedImage();
+      imageCount++;
+      imageBytes += data.GetDataLen();
+      break;
+    case Cell::CellPointers::WXMX_GNUPLOTSOURCE:
+      data = it->m_image->GetGnuplotSource();
+      break;
+    case Cell::CellPointers::WXMX_GNUPLOTDATA:
+      data = it->m_image->GetGnuplotData();
+      break;
+    }
+    if (data.GetDataLen() == 0)
+    {
+      it = files.erase(it);
+      continue;
     }
-    wxMemoryFSHandler::RemoveFile(name);
-    memFsName = fsystem->FindNext();
-  }
-
-  wxDELETE(fsystem);
-
-  if (!zip.Close())
-    return false;
-  if (!out.Close())
-    return false;
 
-  // If all data is saved now we can overwrite the actual save file.
-  // We will try to do so a few times if we suspect a MSW virus scanner or similar
-  // temporarily hindering us from doing so.
-  bool done = false;
+    // The data for gnuplot is likely to change in its entirety if it
+    // ever changes => We can store it in a compressed form.
+    snapshot->AddFile(it->m_name, data, it->m_name.EndsWith(wxT(".data")));
+    ++it;
+  }
 
-  // The following line is paranoia as closing (and thus writing) the file has
-  // succeeded.
-  if(!wxFileExists(backupfile))
-    return false;
+  wxLogMessage(wxString::Format(
+                 _("Took a snapshot of the worksheet containing %li images (%lu bytes) without copying them and %li unchanged files; Tested the XML of %li cells for validity"),
+                 imageCount, (unsigned long) imageBytes, copiedFiles, validatedCells));
 
-  // Now we try to open the file in order to see if saving hasn't failed
-  // without returning an error - which can apparently happen on MSW.
-  wxString wxmxURI = wxURI(wxT("file://") + backupfile).BuildURI();
-  wxmxURI.Replace("#", "%23");
+  // Images that haven't been displayed yet are still read from the file we are
+  // about to overwrite.
+  if (wxFileExists(file))
+  {
+    wxString fileURI = wxURI(wxT("file://") + file).BuildURI();
+    fileURI.Replace("#", "%23");
 #ifdef  __WXMSW__
-  // Fixes a missing "///" after the "file:". This works because we always get absolute
-  // file names.
-  wxRegEx uriCorector1("^file:([a-zA-Z]):");
-  wxRegEx uriCorector2("^file:([a-zA-Z][a-zA-Z]):");
-  uriCorector1.ReplaceFirst(&wxmxURI,wxT("file:///\\1:"));
-  uriCorector2.ReplaceFirst(&wxmxURI,wxT("file:///\\1:"));
+    // Fixes a missing "///" after the "file:". This works because we always get absolute
+    // file names.
+    wxRegEx uriCorector1("^file:([a-zA-Z]):");
+    wxRegEx uriCorector2("^file:([a-zA-Z][a-zA-Z]):");
+    uriCorector1.ReplaceFirst(&fileURI,wxT("file:///\\1:"));
+    uriCorector2.ReplaceFirst(&fileURI,wxT("file:///\\1:"));
 #endif
-  // The URI of the wxm code contained within the .wxmx file
-  wxString filename = wxmxURI + wxT("#zip:content.xml");
-
-  // Open the file
-  wxFileSystem fs;
-  wxFSFile *fsfile = fs.OpenFile(filename);
-  if (!fsfile)
-  {
-    filename = wxmxURI + wxT("#zip:/content.xml");
-    fsfile = fs.OpenFile(filename);
+    Image::SourceFileWillBeOverwritten(fileURI, file);
   }
 
-  // Did we succeed in opening the file?
-  if (!fsfile)
-    return false;
-
-  delete fsfile;
-  
-  {
-    SuppressErrorDialogs suppressor;
-    done = wxRenameFile(backupfile, file, true);
-    if(!done)
-    {
-      // We might have failed to move the file because an over-eager virus scanner wants to
-      // scan it and a design decision of a filesystem driver might hinder us from moving
-      // it during this action => Wait for a second and retry.
-      wxSleep(1);
-      done = wxRenameFile(backupfile, file, true);
-    }
-    if(!done)
-    {
-      // We might have failed to move the file because an over-eager virus scanner wants to
-      // scan it and a design decision of a filesystem driver might hinder us from moving
-      // it during this action => Wait for a second and retry.
-      wxSleep(1);
-      done = wxRenameFile(backupfile, file, true);
-    }
-  }
-  if(!done)
-  {
-    wxSleep(1);
-    if (!wxRenameFile(backupfile, file, true))
-      return false;
-  }
   if (markAsSaved)
+  {
+    // Changes that are made while the file is being written will mark the
+    // worksheet as modified again.
     m_saved = true;
 
-  wxLogMessage(_("wxmx file saved"));
-  return true;
+    // Tell the images where in the new version of the file their data will
+    // be found. If writing it fails m_wxmxArchive will make sure nobody tries
+    // to copy anything from it.
+    m_wxmxArchive = ++m_wxmxArchives;
+    for (Cell::CellPointers::WXMXFileList::iterator it = files.begin(); it != files.end(); ++it)
+      it->m_image->SetWXMXEntry(it->m_type, m_wxmxArchive, it->m_name);
+  }
+
+  return snapshot;
 }
 
 bool Worksheet::CanEdit()
@@ -7160,6 +7310,9 @@ void Worksheet::ScrollToCellIfNeeded()
     return;
   }
 
+  // We cannot scroll to the exact position of a cell whose size we have only estimated.
+  MeasureEstimatedCells(dynamic_cast<GroupCell *>(cell->GetGroup()));
+
   int cellY = cell->GetCurrentY();
 
   if (cellY < 0)
@@ -8208,7 +8361,11 @@ bool Worksheet::FindIncremental(wxString str, bool down, bool ignoreCase)
   if (str != wxEmptyString)
     return FindNext(str, down, ignoreCase, false);
   else
+  {
+    if (m_findDialog != NULL)
+      m_findDialog->ClearMatchCount();
     return true;
+  }
 }
 
 bool Worksheet::FindNext(wxString str, bool down, bool ignoreCase, bool warn)
@@ -8272,61 +8429,114 @@ bool Worksheet::FindNext(wxString str, bool down, bool ignoreCase, bool warn)
   if (pos == NULL)
     return false;
 
-  pos->GetEditable()->SearchStartedHere(pos->GetEditable()->GetCaretPosition());
-
-  // Remember where to go if we need to wrapp the search.
-  GroupCell *start = pos;
+  // Determine where in the worksheet the search starts: Behind the current
+  // selection or the cursor in the cell we start at.
+  SearchMatch start;
+  start.m_group = 0;
+  start.m_editor = pos->GetEditable();
+  for (GroupCell *group = m_tree; (group != NULL) && (group != pos);
+       group = dynamic_cast<GroupCell *>(group->m_next))
+    start.m_group++;
+  start.m_pos = down ? 0 : LONG_MAX;
+  if (start.m_editor != NULL)
+  {
+    start.m_editor->SearchStartedHere(start.m_editor->GetCaretPosition());
+    int selectionStart, selectionEnd;
+    start.m_editor->GetSelection(&selectionStart, &selectionEnd);
+    if (selectionStart >= 0)
+      start.m_pos = down ? selectionStart + 1 : selectionStart;
+    else if (start.m_editor->IsActive())
+      start.m_pos = down ? start.m_editor->GetCaretPosition() :
+        start.m_editor->GetCaretPosition() + 1;
+  }
+
+  std::vector<SearchMatch> matches;
+  FindAllMatches(str, ignoreCase, matches);
+  if (matches.empty())
+  {
+    if (m_findDialog != NULL)
+      m_findDialog->SetMatchCount(0, 0);
+    return false;
+  }
 
+  // The first match behind the start or the last one before it. If there is
+  // none the search wraps around.
   bool wrappedSearch = false;
+  std::vector<SearchMatch>::iterator match =
+    std::lower_bound(matches.begin(), matches.end(), start, SearchMatchBefore);
+  if (down)
+  {
+    if (match == matches.end())
+    {
+      wrappedSearch = true;
+      match = matches.begin();
+    }
+  }
+  else
+  {
+    if (match == matches.begin())
+    {
+      wrappedSearch = true;
+      match = matches.end();
+    }
+    --match;
+  }
 
-  while ((pos != start) || (!wrappedSearch))
+  EditorCell *editor = match->m_editor;
+  SetActiveCell(editor);
+  editor->SetSelection(match->m_pos, match->m_pos + str.Length());
+  ScrollToCaret();
+  UpdateTableOfContents();
+  RequestRedraw();
+  if (m_findDialog != NULL)
+    m_findDialog->SetMatchCount(match - matches.begin() + 1, matches.size());
+  if ((wrappedSearch) && warn)
   {
-    EditorCell *editor = dynamic_cast<EditorCell *>(pos->GetEditable());
+    wxMessageDialog dialog(m_findDialog,
+                           _("Wrapped search"),
+                           wxEmptyString, wxCENTER | wxOK);
+    dialog.ShowModal();
+  }
+  return true;
+}
 
-    if (editor != NULL)
-    {
-      bool found = editor->FindNext(str, down, ignoreCase);
+void Worksheet::FindAllMatches(const wxString &str, bool ignoreCase,
+                               std::vector<SearchMatch> &matches)
+{
+  matches.clear();
+  SearchIndex &index = m_cellPointers.m_searchIndex;
+  SearchIndex::CellSet candidates;
+  index.GetCandidates(str, candidates);
 
-      if (found)
-      {
-        int start, end;
-        editor->GetSelection(&start, &end);
-        SetActiveCell(editor);
-        editor->SetSelection(start, end);
-        ScrollToCaret();
-        UpdateTableOfContents();
-        RequestRedraw();
-        if ((wrappedSearch) && warn)
-        {
-          wxMessageDialog dialog(m_findDialog,
-                                 _("Wrapped search"),
-                                 wxEmptyString, wxCENTER | wxOK);
-          dialog.ShowModal();
-        }
-        return true;
-      }
-    }
+  std::vector<long> positions;
+  long groupNumber = 0;
+  for (GroupCell *group = m_tree; group != NULL;
+       group = dynamic_cast<GroupCell *>(group->m_next), groupNumber++)
+  {
+    EditorCell *editor = group->GetEditable();
+    if (editor == NULL)
+      continue;
 
-    if (down)
+    // A cell that has found its way into the worksheet without being
+    // inserted by InsertGroupCells() isn't indexed, yet.
+    if (!index.Contains(editor))
     {
-      pos = dynamic_cast<GroupCell *>(pos->m_next);
-      if (pos == NULL)
-      {
-        wrappedSearch = true;
-        pos = m_tree;
-      }
+      editor->SetIndexed(true);
+      index.FindAll(editor, str, ignoreCase, positions);
     }
-    else
+    else if (candidates.find(editor) != candidates.end())
+      index.FindAll(editor, str, ignoreCase, positions);
+
+    for (size_t i = 0; i < positions.size(); i++)
     {
-      pos = dynamic_cast<GroupCell *>(pos->m_previous);
-      if (pos == NULL)
-      {
-        wrappedSearch = true;
-        pos = m_last;
-      }
+      SearchMatch match;
+      match.m_group = groupNumber;
+      match.m_editor = editor;
+      match.m_pos = positions[i];
+      matches.push_back(match);
     }
+    positions.clear();
   }
-  return false;
 }
 
 bool Worksheet::CaretVisibleIs()
@@ -8352,6 +8562,7 @@ bool Worksheet::CaretVisibleIs()
   {
     if (GetActiveCell())
     {
+      MeasureEstimatedCells(dynamic_cast<GroupCell *>(GetActiveCell()->GetGroup()));
       wxPoint point = GetActiveCell()->PositionToPoint(m_configuration->GetDefaultFontSize());
       if (point.y < 1)
       {
@@ -8421,25 +8632,25 @@ int Worksheet::ReplaceAll(wxString oldString, wxString newString, bool ignoreCas
 
   int count = 0;
 
-  GroupCell *tmp = m_tree;
-
-  while (tmp != NULL)
+  // Only the cells the search string appears in need to be touched.
+  std::vector<SearchMatch> matches;
+  FindAllMatches(oldString, ignoreCase, matches);
+  for (size_t i = 0; i < matches.size(); i++)
   {
-    EditorCell *editor = dynamic_cast<EditorCell *>(tmp->GetEditable());
-
-    if (editor != NULL)
+    if ((i > 0) && (matches[i].m_editor == matches[i - 1].m_editor))
+      continue;
+    EditorCell *editor = matches[i].m_editor;
+    int replaced = editor->ReplaceAll(oldString, newString, ignoreCase);
+    if (replaced > 0)
     {
-      int replaced = editor->ReplaceAll(oldString, newString, ignoreCase);
-      if (replaced > 0)
-      {
-        count += replaced;
-        tmp->ResetInputLabel();
-        tmp->ResetSize();
-      }
+      count += replaced;
+      GroupCell *group = dynamic_cast<GroupCell *>(editor->GetGroup());
+      group->ResetInputLabel();
+      group->ResetSize();
     }
-
-    tmp = dynamic_cast<GroupCell *>(tmp->m_next);
   }
+  if (m_findDialog != NULL)
+    m_findDialog->ClearMatchCount();
 
   if (count > 0)
   {
@@ -8559,46 +8770,11 @@ bool Worksheet::Autocomplete(AutoComplete::autoCompletionType type)
     }
   }
 
-  if (type == AutoComplete::command)
-  {
-    // Update the list of words that might not be defined as maxima function or variable
-    // but that still appear on the workSheet.
-    m_autocomplete->ClearWorksheetWords();
-    GroupCell *tmp = m_tree;
-    while (tmp != NULL)
-    {
-      // Don't collect the current word as possible autocompletion.
-      if (tmp != GetActiveCell()->GetGroup())
-      {
-        // Only collect words from Code Cells.
-        if ((tmp->GetGroupType() == GC_TYPE_CODE) && (tmp->GetEditable() != NULL))
-          m_autocomplete->AddWorksheetWords(tmp->GetEditable()->GetWordList());
-      }
-      else
-      {
-        if ((tmp->GetGroupType() == GC_TYPE_CODE) && (tmp->GetEditable() != NULL))
-        {
-          wxArrayString wordList = tmp->GetEditable()->GetWordList();
-
-          // The current unfinished word is no valid autocompletion, if there is
-          // such a thing.
-          if (partial.Length() > 0)
-          {
-            // Don't remove the current word from autocompletion if it never has been
-            // added (which happens if autocompletion is called when the cursor is
-            // directly followed by the next command without a space or similar inbetween)
-            if (wordList.Index(partial) != wxNOT_FOUND)
-              wordList.Remove(partial);
-          }
-          m_autocomplete->AddWorksheetWords(wordList);
-        }
-      }
-      tmp = dynamic_cast<GroupCell *>(tmp->m_next);
-    }
-  }
-
-  m_completions = m_autocomplete->CompleteSymbol(partial, type);
-  m_completions.Sort();
+  // The words on the worksheet are known to m_cellPointers.m_worksheetWords. The
+  // word that is being completed is in there, too, but isn't a valid completion
+  // unless it appears elsewhere, as well.
+  m_completions = m_autocomplete->CompleteSymbol(partial, type,
+                                                 editor->ContainsIndexedWord(partial));
   m_autocompleteTemplates = (type == AutoComplete::tmplte);
 
   /// No completions - clear the selection and return false
@@ -8617,6 +8793,7 @@ bool Worksheet::Autocomplete(AutoComplete::autoCompletionType type)
     editor->ReplaceSelection(editor->GetSelectionString(), m_completions[0], true, false, true);
     editor->ClearSelection();
     editor->CaretToPosition(start);
+    m_autocomplete->CompletionAccepted(m_completions[0], type);
 
     if ((type != AutoComplete::tmplte) || !editor->FindNextTemplate())
       editor->CaretToPosition(start + m_completions[0].Length());
@@ -9141,6 +9318,7 @@ BEGIN_EVENT_TABLE(Worksheet, wxScrolledCanvas)
                 EVT_ENTER_WINDOW(Worksheet::OnMouseEnter)
                 EVT_LEAVE_WINDOW(Worksheet::OnMouseExit)
                 EVT_TIMER(wxID_ANY, Worksheet::OnTimer)
+                EVT_THREAD(ImageScaler::ImageScaled(), Worksheet::OnImageScaled)
                 EVT_KEY_DOWN(Worksheet::OnKeyDown)
                 EVT_CHAR(Worksheet::OnChar)
                 EVT_ERASE_BACKGROUND(Worksheet::OnEraseBackground)
@@ -36,6 +36,7 @@
 #include <wx/fdrepdlg.h>
 #include <wx/dc.h>
 #include <list>
+#include <vector>
 
 #include "VariablesPane.h"
 #include "Notification.h"
@@ -48,6 +49,7 @@
 #include "AutocompletePopup.h"
 #include "TableOfContents.h"
 #include "ToolBar.h"
+#include "WXMXSnapshot.h"
 
 /*! The canvas that contains the spreadsheet the whole program is about.
 
@@ -423,6 +425,9 @@ private:
   //! Is executed if a timer associated with Worksheet has expired.
   void OnTimer(wxTimerEvent &event);
 
+  //! Called when ImageScaler has prepared an image for being displayed
+  void OnImageScaled(wxThreadEvent &event);
+
   /*! Has the autosave interval expired?
 
     True means: A save will be issued after the user stops typing.
@@ -573,11 +578,65 @@ private:
   wxTimer m_caretTimer;
   //! True if no changes have to be saved.
   bool m_saved;
+  /*! The number of the version of the .wxmx file we have saved last
+
+    The images remember which of their files they have been saved to this
+    version as, so the next save can copy them from there. -1 = none.
+   */
+  long m_wxmxArchive;
+  //! The name of the .wxmx file we have saved last
+  wxString m_wxmxArchiveFile;
+  //! The modification time of m_wxmxArchiveFile after we have saved it.
+  wxDateTime m_wxmxArchiveTime;
+  //! The number of the last version of a .wxmx file we have saved
+  static long m_wxmxArchives;
+  //! The .wxmx file StartBackgroundSave() is writing. NULL = none.
+  WXMXSnapshot *m_backgroundSave;
+  /*! Takes a snapshot of everything the .wxmx file file is to contain
+
+    Has to be done in the GUI thread. If markAsSaved is true the images are
+    already told where their files will be found in the new version of the file
+    and the worksheet is marked as saved: Any change that happens while the file
+    is written marks the worksheet as modified again.
+
+    \return NULL, if the XML of a cell cannot be read again.
+   */
+  WXMXSnapshot *TakeWXMXSnapshot(wxString file, bool markAsSaved);
+  /*! Does the bookkeeping after a snapshot has been written and deletes it
+
+    \param snapshot The snapshot
+    \param markAsSaved Has the snapshot been taken with markAsSaved = true?
+    \param succeeded Has the file been written successfully?
+    \return succeeded
+   */
+  bool WXMXSnapshotWritten(WXMXSnapshot *snapshot, bool markAsSaved, bool succeeded);
   AutoComplete *m_autocomplete;
   wxArrayString m_completions;
   bool m_autocompleteTemplates;
   AutocompletePopup *m_autocompletePopup;
 
+  //! An occurrence of the search string in the worksheet
+  struct SearchMatch
+  {
+    //! The number of the GroupCell the match is in
+    long m_group;
+    //! The EditorCell the match is in
+    EditorCell *m_editor;
+    //! The position of the match in the text of m_editor
+    long m_pos;
+  };
+  //! Does the match a come before the match b?
+  static bool SearchMatchBefore(const SearchMatch &a, const SearchMatch &b)
+  { return (a.m_group < b.m_group) || ((a.m_group == b.m_group) && (a.m_pos < b.m_pos)); }
+  /*! Finds all occurrences of a string in the worksheet
+
+    Only the cells the search index names as candidates are searched.
+    \param str The string to search for
+    \param ignoreCase true means: Search case-insensitively
+    \param matches Returns the matches in the order they appear in the worksheet
+   */
+  void FindAllMatches(const wxString &str, bool ignoreCase, std::vector<SearchMatch> &matches);
+
 public:
   //! Is this worksheet empty?
   bool IsEmpty()
@@ -907,6 +966,16 @@ public:
   */
   GroupCell *InsertGroupCells(GroupCell *cells, GroupCell *where = NULL);
 
+  /*! Append group cells to the end of the worksheet
+
+    Meant for documents that are inserted into the worksheet piece by piece
+    while they are being loaded: If the worksheet's last cell has been added by
+    the last undoable action the new cells become part of this action.
+
+    \param cells The list of cells that has to be appended
+  */
+  GroupCell *AppendGroupCells(GroupCell *cells);
+
   /*! Add a new line to the output cell of the working group.
 
     If maxima isn't currently evaluating and therefore there is no working group
@@ -914,9 +983,21 @@ public:
   */
   void InsertLine(Cell *newLine, bool forceNewLine = false);
 
-  // Actually recalculate the worksheet.
+  /*! Actually recalculate the worksheet.
+
+    Only the cells down to a screen's height below the visible region are measured.
+    The sizes of all cells below that are only estimated until they are scrolled
+    into view.
+  */
   bool RecalculateIfNeeded();
 
+  /*! Measure all cells whose size has only been estimated.
+
+    \param upTo The last cell that needs to be measured. NULL means: Measure all
+                cells.
+  */
+  void MeasureEstimatedCells(GroupCell *upTo = NULL);
+
   //! Schedule a recalculation of the worksheet starting with the cell start.
   void Recalculate(Cell *start, bool force = false);
 
@@ -1103,12 +1184,39 @@ public:
   bool ExportToMAC(wxString file);
 
   /*! export to xml compatible file
+
+    If the file is the one we have saved last and hasn't been changed since
+    images and gnuplot data that haven't changed are copied from there without
+    recompressing them and the XML of unchanged cells isn't tested for validity
+    again.
+
     \param file The file name
     \param markAsSaved false means that this action doesn't clear the
                              worksheet's "modified" status.
   */
   bool ExportToWXMX(wxString file, bool markAsSaved = true);
 
+  /*! Saves the worksheet to a .wxmx file in the background
+
+    Only a snapshot of the worksheet is taken here: The file is written by a
+    thread of its own that sends handler a wxThreadEvent with the id id when it
+    has finished. The receiver then has to call FinishBackgroundSave().
+    \return false, if a background save is still running or the snapshot
+    couldn't be taken.
+   */
+  bool StartBackgroundSave(wxString file, wxEvtHandler *handler, int id);
+
+  //! Is StartBackgroundSave() writing a file?
+  bool BackgroundSaveRunning(){return m_backgroundSave != NULL;}
+
+  /*! Waits for the file StartBackgroundSave() writes to be saved
+
+    \param file Returns the name of the file that has been saved. wxEmptyString
+    if no background save was running.
+    \return true, if the file has been saved successfully.
+   */
+  bool FinishBackgroundSave(wxString *file = NULL);
+
   //! The start of a RTF document
   wxString RTFStart();
 
@@ -1181,6 +1289,13 @@ public:
   //! The first groupCell that is currently visible.
   GroupCell *FirstVisibleGC();
 
+  /*! The GroupCell at the y coordinate y
+
+    If y lies between two GroupCells the one below y is returned. NULL means:
+    There is no GroupCell at or below y.
+  */
+  GroupCell *GetGroupAt(int y);
+
   /*! Scrolls to a point on the worksheet
 
     \todo I have deactivated this assert for the release as it scares the users
@@ -1373,13 +1488,12 @@ public:
   /*! Do an incremental search from the cursor or the point the last search started at
 
     Used by the find dialog.
-    \todo Keep a list of positions the last few letters were found at?
    */
   bool FindIncremental(wxString str, bool down, bool ignoreCase);
 
   /*! Find the next ocourrence of a string
 
-    Used by the find dialog.
+    Used by the find dialog which is told which of how many matches has been selected.
    */
   bool FindNext(wxString str, bool down, bool ignoreCase, bool warn = true);
 
@@ -1506,6 +1620,10 @@ protected:
   void UpdateConfigurationClientSize();
   //! Where to start recalculation. NULL = No recalculation needed.
   GroupCell *m_recalculateStart;
+  //! Might there be cells whose size has only been estimated?
+  bool m_cellsWithEstimatedSize;
+  //! The y coordinate down to which RecalculateIfNeeded() has to measure cells
+  int MeasureUntil();
   //! The x position of the mouse pointer
   int m_pointer_x;
   //! The y position of the mouse pointer
@@ -0,0 +1,99 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ZipEntryCopier
+
+  ZipEntryCopier copies files from one .zip archive into another one.
+ */
+
+#include "ZipEntryCopier.h"
+
+ZipEntryCopier::ZipEntryCopier()
+{
+  m_file = NULL;
+  m_zip = NULL;
+  m_bytesCopied = 0;
+}
+
+ZipEntryCopier::~ZipEntryCopier()
+{
+  Close();
+}
+
+void ZipEntryCopier::Close()
+{
+  for (std::map<wxString, wxZipEntry *>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+    delete it->second;
+  m_entries.clear();
+  wxDELETE(m_zip);
+  wxDELETE(m_file);
+}
+
+bool ZipEntryCopier::Open(const wxString &file)
+{
+  Close();
+  m_file = new wxFFileInputStream(file);
+  if (!m_file->IsOk())
+  {
+    wxDELETE(m_file);
+    return false;
+  }
+
+  // As the file is seekable the entries are read from the archive's central
+  // directory which means we learn their sizes without reading their data.
+  m_zip = new wxZipInputStream(*m_file);
+  wxZipEntry *entry;
+  while ((entry = m_zip->GetNextEntry()) != NULL)
+  {
+    wxString name = entry->GetName(wxPATH_UNIX);
+    if (m_entries.find(name) != m_entries.end())
+      delete m_entries[name];
+    m_entries[name] = entry;
+  }
+
+  if (!m_zip->Eof() || m_entries.empty())
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool ZipEntryCopier::Copy(const wxString &name, const wxString &newName, wxZipOutputStream &zip)
+{
+  if (m_zip == NULL)
+    return false;
+
+  std::map<wxString, wxZipEntry *>::iterator it = m_entries.find(name);
+  if (it == m_entries.end())
+    return false;
+
+  // CopyEntry() takes ownership of the entry it is given, and it finds the
+  // data by the offset this copy of the entry has kept.
+  wxZipEntry *entry = new wxZipEntry(*it->second);
+  entry->SetName(newName, wxPATH_UNIX);
+  if (!zip.CopyEntry(entry, *m_zip))
+    return false;
+  m_bytesCopied += it->second->GetCompressedSize();
+  return true;
+}
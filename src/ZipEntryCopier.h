@@ -0,0 +1,83 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef ZIPENTRYCOPIER_H
+#define ZIPENTRYCOPIER_H
+
+#include <wx/wfstream.h>
+#include <wx/zipstrm.h>
+#include <map>
+
+/*!\file
+
+  This file declares the class ZipEntryCopier.
+
+  ZipEntryCopier copies files from one .zip archive into another one.
+ */
+
+/*! Copies files from one .zip archive into another one without recompressing them
+
+  Used for saving a .wxmx file: Images and gnuplot data that haven't changed since
+  the last save can be copied from the file that is about to be overwritten.
+ */
+class ZipEntryCopier
+{
+public:
+  ZipEntryCopier();
+  ~ZipEntryCopier();
+
+  /*! Opens the archive files are to be copied from
+
+    \return false, if the file isn't a readable .zip archive.
+   */
+  bool Open(const wxString &file);
+
+  //! Closes the archive. The number of bytes copied is kept.
+  void Close();
+
+  //! Has an archive been opened successfully?
+  bool IsOk() const {return m_zip != NULL;}
+
+  /*! Copies a file from the archive into zip
+
+    \param name The name of the file in the archive we copy from
+    \param newName The name of the file in zip
+    \param zip The archive to copy to
+    \return false if the file couldn't be copied. If this happens after the new
+    entry has been created zip is broken and must not be used.
+   */
+  bool Copy(const wxString &name, const wxString &newName, wxZipOutputStream &zip);
+
+  //! The number of bytes Copy() has copied so far
+  size_t GetBytesCopied() const {return m_bytesCopied;}
+
+private:
+  //! The file we copy from
+  wxFFileInputStream *m_file;
+  //! The .zip archive we copy from
+  wxZipInputStream *m_zip;
+  //! The entries of the archive. The key is their name.
+  std::map<wxString, wxZipEntry *> m_entries;
+  size_t m_bytesCopied;
+};
+
+#endif // ZIPENTRYCOPIER_H
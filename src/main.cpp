@@ -35,6 +35,7 @@
 #include <wx/fileconf.h>
 #include <wx/sysopt.h>
 #include "Dirstructure.h"
+#include "ImageScaler.h"
 #include <iostream>
 
 #include "wxMaxima.h"
@@ -310,6 +311,7 @@ bool MyApp::OnInit()
 
 int MyApp::OnExit()
 {
+  ImageScaler::Destroy();
   wxDELETE(m_dirstruct);
   m_dirstruct = NULL;
   return 0;
@@ -318,6 +320,9 @@ int MyApp::OnExit()
 int MyApp::OnRun()
 {
   wxApp::OnRun();
+  // Lets the test that compares the two math parsers fail.
+  if (MathParser::ParsersDisagreed())
+    return 1;
   return 0;
 }
 
@@ -67,6 +67,7 @@
 #include "ListSortWiz.h"
 #include "wxMaximaIcon.h"
 #include "ErrorRedirector.h"
+#include "ContentXMLReader.h"
 
 #include <wx/colordlg.h>
 #include <wx/clipbrd.h>
@@ -95,7 +96,9 @@
 
 #include <wx/url.h>
 #include <wx/sstream.h>
+#include <wx/stopwatch.h>
 #include <list>
+#include <algorithm>
 
 #if defined __WXOSX__
 #define MACPREFIX "wxMaxima.app/Contents/Resources/"
@@ -127,6 +130,8 @@ void wxMaxima::ConfigChanged()
   }
   m_worksheet->RecalculateForce();
   m_worksheet->RequestRedraw();
+  if (m_mathParserThread != NULL)
+    m_mathParserThread->SettingsChanged();
 
 #if defined (__WXOSX__)
   bool usepngCairo = false;
@@ -208,16 +213,8 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
   m_first = true;
   m_isRunning = false;
   m_dispReadOut = false;
-  m_promptPrefix = wxT("<PROMPT-P/>");
-  m_promptSuffix = wxT("<PROMPT-S/>");
-  m_suppressOutputPrefix = wxT("<suppressOutput>");
-  m_suppressOutputSuffix = wxT("</suppressOutput>");
-  m_symbolsPrefix = wxT("<wxxml-symbols>");
-  m_symbolsSuffix = wxT("</wxxml-symbols>");
-  m_variablesPrefix = wxT("<variables>");
-  m_variablesSuffix = wxT("</variables>");
-  m_addVariablesPrefix = wxT("<watch_variables_add>");
-  m_addVariablesSuffix = wxT("</watch_variables_add>");
+  m_promptPrefix = MaximaOutputScanner::PromptPrefix();
+  m_promptSuffix = MaximaOutputScanner::PromptSuffix();
   m_firstPrompt = wxT("(%i1) ");
 
   m_client = NULL;
@@ -271,15 +268,30 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, wxLocale *locale, const wxString ti
   m_statusBar->GetNetworkStatusElement()->Connect(wxEVT_LEFT_DCLICK,
                                                   wxCommandEventHandler(wxMaxima::NetworkDClick),
                                                   NULL, this);
-  m_clientStream = NULL;
-  m_clientTextStream = NULL;
   m_parser = new MathParser (&m_worksheet->m_configuration, &m_worksheet->m_cellPointers);
+
+  m_mathParserJob = 0;
+  m_mathParserBusy = false;
+  m_lastChunkType = MaximaOutputScanner::none;
+  m_mathParserThread = new MathParserThread(this, mathparser_thread_id,
+                                            &m_worksheet->m_cellPointers);
+  if (m_mathParserThread->Run() != wxTHREAD_NO_ERROR)
+  {
+    wxLogMessage(_("Cannot start the thread that parses maxima's output."));
+    wxDELETE(m_mathParserThread);
+  }
 }
 
 wxMaxima::~wxMaxima()
 {
   KillMaxima(false);
   wxDELETE(m_printData);m_printData = NULL;
+  if (m_mathParserThread != NULL)
+  {
+    m_mathParserThread->Stop();
+    m_mathParserThread->Wait();
+    wxDELETE(m_mathParserThread);
+  }
   delete(m_parser);
   m_parser = NULL;
   MyApp::m_topLevelWindows.remove(this);
@@ -804,6 +816,56 @@ void wxMaxima::SendMaxima(wxString s, bool addToHistory)
 ///  Socket stuff
 ///--------------------------------------------------------------------------------
 
+wxString wxMaxima::DecodeCompleteUtf8(wxMemoryBuffer &data)
+{
+  char *bytes = (char *)data.GetData();
+  size_t len = data.GetDataLen();
+  if(len == 0)
+    return wxEmptyString;
+
+  // Null bytes and EOTs are of no use to us and can never be part of a
+  // multi-byte UTF-8 sequence => we can drop them before decoding.
+  len = std::remove(bytes, bytes + len, '\0') - bytes;
+  len = std::remove(bytes, bytes + len, '\4') - bytes;
+
+  // Find out if the last char is cut off: Search backwards for the byte
+  // the last char starts with and compare its length with the number of
+  // bytes we have for it.
+  size_t complete = len;
+  for(size_t i = 1; (i <= 4) && (i <= len); i++)
+  {
+    unsigned char chr = bytes[len - i];
+    // A continuation byte: The start of the char is further back.
+    if((chr & 0xC0) == 0x80)
+      continue;
+    size_t charLength = 1;
+    if((chr & 0xE0) == 0xC0)
+      charLength = 2;
+    else if((chr & 0xF0) == 0xE0)
+      charLength = 3;
+    else if((chr & 0xF8) == 0xF0)
+      charLength = 4;
+    if(charLength > i)
+      complete = len - i;
+    break;
+  }
+
+  wxString retval;
+  if(complete > 0)
+  {
+    retval = wxString::FromUTF8(bytes, complete);
+    // Don't lose the whole block if maxima has sent us something that isn't
+    // valid UTF-8.
+    if(retval.IsEmpty())
+      retval = wxString(bytes, wxMBConvUTF8(wxMBConvUTF8::MAP_INVALID_UTF8_TO_PUA), complete);
+  }
+
+  // Keep only the beginning of the last char until the rest of it arrives.
+  memmove(bytes, bytes + complete, len - complete);
+  data.SetDataLen(len - complete);
+  return retval;
+}
+
 void wxMaxima::ClientEvent(wxSocketEvent &event)
 {
   switch (event.GetSocketEvent())
@@ -826,19 +888,20 @@ void wxMaxima::ClientEvent(wxSocketEvent &event)
 
     m_statusBar->NetworkStatus(StatusBar::receive);
 
-    // Read all new lines of text we received.
-    wxChar chr;
-
-    while((m_client->IsData()) && (!m_clientStream->Eof()))
-      {
-        chr = m_clientTextStream->GetChar();
-        if(chr == wxEOT)
-          break;
-        if(chr != '\0')
-          m_newCharsFromMaxima += chr;
-      }
-
-    m_bytesFromMaxima += m_newCharsFromMaxima.Length();
+    // Read all data we received in big blocks and convert it to unicode in one go.
+    wxStopWatch readTime;
+    while(m_client->IsData())
+    {
+      char *buf = (char *)m_uncompletedUtf8FromMaxima.GetAppendBuf(SOCKET_READ_BLOCKSIZE);
+      m_client->Read(buf, SOCKET_READ_BLOCKSIZE);
+      size_t bytesRead = m_client->LastCount();
+      m_uncompletedUtf8FromMaxima.UngetAppendBuf(bytesRead);
+      m_bytesFromMaxima += bytesRead;
+      if((bytesRead == 0) || (m_client->Error()))
+        break;
+    }
+    m_newCharsFromMaxima += DecodeCompleteUtf8(m_uncompletedUtf8FromMaxima);
+    m_millisecondsReadingFromMaxima += readTime.Time();
 
     if(m_newCharsFromMaxima.EndsWith("\n") || m_newCharsFromMaxima.EndsWith(m_promptSuffix) || (m_first))
     {
@@ -917,12 +980,11 @@ void wxMaxima::ServerEvent(wxSocketEvent &event)
 
       m_statusBar->NetworkStatus(StatusBar::idle);
       m_worksheet->QuestionAnswered();
-      m_currentOutput = wxEmptyString;
+      m_outputScanner.Clear();
+      AbandonMathParsing();
       m_isConnected = true;
       m_client = m_server->Accept(false);
-      m_clientStream = new wxSocketInputStream(*m_client);
-      m_clientTextStream = new wxTextInputStream(*m_clientStream, wxT('\t'),
-                                                 wxConvUTF8);
+      m_uncompletedUtf8FromMaxima.Clear();
       m_client->SetEventHandler(*this, socket_client_id);
       m_client->SetNotify(wxSOCKET_INPUT_FLAG|wxSOCKET_OUTPUT_FLAG|wxSOCKET_LOST_FLAG);
       m_client->Notify(true);
@@ -1248,7 +1310,8 @@ void wxMaxima::KillMaxima(bool logMessage)
   m_statusBar->SetMaximaCPUPercentage(0);
   m_CWD = wxEmptyString;
   m_worksheet->QuestionAnswered();
-  m_currentOutput = wxEmptyString;
+  m_outputScanner.Clear();
+  AbandonMathParsing();
   // If we did close maxima by hand we already might have a new process
   // and therefore invalidate the wrong process in this step
   if (m_process)
@@ -1257,9 +1320,7 @@ void wxMaxima::KillMaxima(bool logMessage)
   m_maximaStdout = NULL;
   m_maximaStderr = NULL;
 
-  wxDELETE(m_clientTextStream);m_clientTextStream = NULL;
-  //  wxDELETE(m_clientStream);
-  m_clientStream = NULL;
+  m_uncompletedUtf8FromMaxima.Clear();
 
   if(m_client)
   {
@@ -1379,13 +1440,24 @@ void wxMaxima::CleanUp()
 ///  Dealing with stuff read from the socket
 ///--------------------------------------------------------------------------------
 
+void wxMaxima::LogReadSpeed()
+{
+  if((m_bytesFromMaxima > 0) && (m_millisecondsReadingFromMaxima > 0))
+    wxLogDebug(wxT("Read %li bytes from maxima in %li ms (%.2f MB/s)"),
+               m_bytesFromMaxima, m_millisecondsReadingFromMaxima,
+               m_bytesFromMaxima / 1000.0 / m_millisecondsReadingFromMaxima);
+  m_bytesFromMaxima = 0;
+  m_millisecondsReadingFromMaxima = 0;
+}
+
 void wxMaxima::ReadFirstPrompt(wxString &data)
 {
   int end;
-  if((end = m_currentOutput.Find(m_firstPrompt)) == wxNOT_FOUND)
+  if((end = data.Find(m_firstPrompt)) == wxNOT_FOUND)
     return;
 
   m_bytesFromMaxima = 0;
+  m_millisecondsReadingFromMaxima = 0;
 
   int start = 0;
   start = data.Find(wxT("Maxima "));
@@ -1446,73 +1518,10 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
     TriggerEvaluation();
 }
 
-int wxMaxima::GetMiscTextEnd(const wxString &data)
+void wxMaxima::ReadMiscText(wxString miscText)
 {
-  // These tests are redundant with later tests. But they are faster.
-  if(data.StartsWith("<mth>"))
-    return 0;
-  if(data.StartsWith("<lbl>"))
-    return 0;
-  if(data.StartsWith("<statusbar>"))
-    return 0;
-  if(data.StartsWith(m_promptPrefix))
-    return 0;
-  if(data.StartsWith(m_symbolsPrefix))
-    return 0;
-  if(data.StartsWith(m_variablesPrefix))
-    return 0;
-  if(data.StartsWith(m_addVariablesPrefix))
-    return 0;
-  if(data.StartsWith(m_suppressOutputPrefix))
-    return 0;
-
-  int mthpos = data.Find("<mth>");
-  int lblpos = data.Find("<lbl>");
-  int statpos = data.Find("<statusbar>");
-  int prmptpos = data.Find(m_promptPrefix);
-  int symbolspos = data.Find(m_symbolsPrefix);
-  int suppressOutputPos = data.Find(m_suppressOutputPrefix);
-  int variablespos = data.Find(m_variablesPrefix);
-  int addvariablespos = data.Find(m_addVariablesPrefix);
-
-  int tagPos = data.Length();
-  if ((mthpos != wxNOT_FOUND) && (mthpos < tagPos))
-    tagPos = mthpos;
-  if ((tagPos == wxNOT_FOUND) || ((lblpos != wxNOT_FOUND) && (lblpos < tagPos)))
-    tagPos = lblpos;
-  if ((tagPos == wxNOT_FOUND) || ((statpos != wxNOT_FOUND) && (statpos < tagPos)))
-    tagPos = statpos;
-  if ((tagPos == wxNOT_FOUND) || ((prmptpos != wxNOT_FOUND) && (prmptpos < tagPos)))
-    tagPos = prmptpos;
-  if ((tagPos == wxNOT_FOUND) || ((prmptpos != wxNOT_FOUND) && (prmptpos < tagPos)))
-    tagPos = prmptpos;
-  if ((tagPos == wxNOT_FOUND) || ((symbolspos != wxNOT_FOUND) && (symbolspos < tagPos)))
-    tagPos = symbolspos;
-  if ((tagPos == wxNOT_FOUND) || ((variablespos != wxNOT_FOUND) && (variablespos < tagPos)))
-    tagPos = variablespos;
-  if ((tagPos == wxNOT_FOUND) || ((addvariablespos != wxNOT_FOUND) && (addvariablespos < tagPos)))
-    tagPos = addvariablespos;
-  if ((tagPos == wxNOT_FOUND) || ((suppressOutputPos != wxNOT_FOUND) && (suppressOutputPos < tagPos)))
-    tagPos = suppressOutputPos;
-  return tagPos;
-}
-
-void wxMaxima::ReadMiscText(wxString &data)
-{
-  if (data.IsEmpty())
-    return;
-
-  // Extract all text that isn't a xml tag known to us.
-  int miscTextLen = GetMiscTextEnd(data);
-  if(miscTextLen <= 0)
-  {
-    if(data != wxEmptyString)
-      m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+  if (miscText.IsEmpty())
     return;
-  }
-
-  wxString miscText = data.Left(miscTextLen);
-  data = data.Right(data.Length() - miscTextLen);
 
   // Stupid DOS and MAC line endings. The first of these commands won't work
   // if the "\r" is the last char of a packet containing a part of a very long
@@ -1605,274 +1614,253 @@ void wxMaxima::ReadMiscText(wxString &data)
   }
   if(miscText.EndsWith("\n"))
     m_worksheet->m_cellPointers.m_currentTextCell = NULL;
-
-  if(data != wxEmptyString)
-    m_worksheet->m_cellPointers.m_currentTextCell = NULL;
-}
-
-int wxMaxima::FindTagEnd(wxString &data, const wxString &tag)
-{
-  if((m_currentOutputEnd == wxEmptyString) || (m_currentOutputEnd.Find(tag) != wxNOT_FOUND))
-    return data.Find(tag);
-  else
-    return wxNOT_FOUND;
 }
 
-void wxMaxima::ReadStatusBar(wxString &data)
+void wxMaxima::ReadStatusBar(const wxString &xml)
 {
-  wxString statusbarStart = wxT("<statusbar>");
-  if (!data.StartsWith(statusbarStart))
-    return;
-
-  m_worksheet->m_cellPointers.m_currentTextCell = NULL;
-
-  wxString sts = wxT("</statusbar>");
-  int end;
-  if ((end = FindTagEnd(data,sts)) != wxNOT_FOUND)
+  wxXmlDocument xmldoc;
+  wxStringInputStream xmlStream(xml);
+  xmldoc.Load(xmlStream, wxT("UTF-8"));
+  wxXmlNode *node = xmldoc.GetRoot();
+  if(node != NULL)
   {
-    wxXmlDocument xmldoc;
-    wxString xml = data.Left( end + sts.Length());
-    wxStringInputStream xmlStream(xml);
-    xmldoc.Load(xmlStream, wxT("UTF-8"));
-    wxXmlNode *node = xmldoc.GetRoot();
-    if(node != NULL)
-    {
-      wxXmlNode *contents = node->GetChildren();
-      if(contents)
-        LeftStatusText(contents->GetContent(), false);
-    }
-    // Remove the status bar info from the data string
-    data = data.Right(data.Length()-end-sts.Length());
+    wxXmlNode *contents = node->GetChildren();
+    if(contents)
+      LeftStatusText(contents->GetContent(), false);
   }
 }
 
 /***
- * Checks if maxima displayed a new chunk of math
+ * Appends a new chunk of math maxima has sent us to the console
  */
-void wxMaxima::ReadMath(wxString &data)
+bool wxMaxima::ReadMath(wxString o)
 {
-  wxString mthstart = wxT("<mth>");
-  if (!data.StartsWith(mthstart))
-    return;
-
-  m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+  o.Trim(true);
+  o.Trim(false);
 
-  // Append everything from the "beginning of math" to the "end of math" marker
-  // to the console and remove it from the data we got.
-  wxString mthend = wxT("</mth>");
-  int end;
-  if ((end = FindTagEnd(data,mthend)) != wxNOT_FOUND)
+  if (o.Length() > 0)
   {
-    wxString o = data.Left(end + mthend.Length());
-    data = data.Right(data.Length()-end-mthend.Length());
-    o.Trim(true);
-    o.Trim(false);
+    wxString userLabel;
+    if (m_worksheet->m_configuration->UseUserLabels())
+      userLabel = m_worksheet->m_evaluationQueue.GetUserLabel();
 
-    if (o.Length() > 0)
-    {
-      if (m_worksheet->m_configuration->UseUserLabels())
-      {
-        ConsoleAppend(o, MC_TYPE_DEFAULT,m_worksheet->m_evaluationQueue.GetUserLabel());
-      }
-      else
-      {
-        ConsoleAppend(o, MC_TYPE_DEFAULT);
-      }
-    }
+    if (ParseMathInBackground(o, userLabel))
+      return true;
+
+    ConsoleAppend(o, MC_TYPE_DEFAULT, userLabel);
   }
+  return false;
 }
 
-void wxMaxima::ReadSuppressedOutput(wxString &data)
+bool wxMaxima::ParseMathInBackground(wxString o, const wxString &userLabel)
 {
-  if (!data.StartsWith(m_suppressOutputPrefix))
-    return;
-  int end = FindTagEnd(data, m_suppressOutputSuffix);
-  if (end != wxNOT_FOUND)
-  {
-    data = data.Right(data.Length()-end-m_suppressOutputSuffix.Length());
-  }
+  if (m_mathParserThread == NULL)
+    return false;
+
+  // Text in front of the math and the message that tells that the output
+  // is too long are handled by ConsoleAppend().
+  if (!o.StartsWith(wxT("<mth>")))
+    return false;
+  if ((m_maxOutputCellsPerCommand > 0) &&
+      (m_outputCellsFromCurrentCommand >= m_maxOutputCellsPerCommand))
+    return false;
+
+  // Images need to be loaded by the GUI thread.
+  if ((o.Find(wxT("<img")) != wxNOT_FOUND) || (o.Find(wxT("<slide")) != wxNOT_FOUND))
+    return false;
+
+  m_dispReadOut = false;
+  o.Replace(m_promptSuffix, wxEmptyString);
+  if (m_maxOutputCellsPerCommand > 0)
+    m_outputCellsFromCurrentCommand++;
+  StatusMaximaBusy(parsing);
+
+  // The same as DoConsoleAppend() does before parsing.
+  o.Replace(wxT("\n"), wxT(" "), true);
+  m_mathParserThread->Parse(wxT("<span>") + o + wxT("</span>"), MC_TYPE_DEFAULT,
+                            ++m_mathParserJob, userLabel, m_worksheet->m_configuration);
+  m_mathParserBusy = true;
+  return true;
 }
 
-void wxMaxima::ReadLoadSymbols(wxString &data)
+void wxMaxima::OnMathParsed(wxThreadEvent &event)
 {
-  if (!data.StartsWith(m_symbolsPrefix))
-    return;
-
-  m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+  Cell *cell = m_mathParserThread->TakeCells(event, &m_worksheet->m_configuration);
 
-  int end = FindTagEnd(data, m_symbolsSuffix);
+  // The result of a job we have abandoned since then
+  if ((!m_mathParserBusy) || (event.GetInt() != m_mathParserJob))
+  {
+    wxDELETE(cell);
+    return;
+  }
+  m_mathParserBusy = false;
 
-  if (end != wxNOT_FOUND)
+  wxASSERT_MSG(cell != NULL, _("There was an error in generated XML!\n\n"
+                               "Please report this as a bug."));
+  if (cell != NULL)
   {
-    // Put the symbols into a separate string
-    wxString symbols = data.Left( end + m_symbolsSuffix.Length());
-    m_worksheet->AddSymbols(symbols);
+    // If we want to append the output to the worksheet and there is no cell
+    // that can contain it we need to create such a cell.
+    if (m_worksheet->GetTree() == NULL)
+      m_worksheet->InsertGroupCells(
+        new GroupCell(&(m_worksheet->m_configuration), GC_TYPE_CODE, &m_worksheet->m_cellPointers, wxEmptyString));
 
-    // Remove the symbols from the data string
-    data = data.Right(data.Length()-end-m_symbolsSuffix.Length());
+    cell->SetSkip(true);
+    m_worksheet->InsertLine(cell, cell->BreakLineHere());
   }
+
+  // Now interpret the output that has arrived while we were waiting for the cells.
+  InterpretChunks();
 }
 
-void wxMaxima::ReadVariables(wxString &data)
+void wxMaxima::AbandonMathParsing()
 {
-  if (!data.StartsWith(m_variablesPrefix))
-    return;
-
-  int end = FindTagEnd(data, m_variablesSuffix);
+  // OnMathParsed() will discard the cells for the current job.
+  m_mathParserBusy = false;
+  m_lastChunkType = MaximaOutputScanner::none;
+  m_worksheet->m_cellPointers.m_workingGroupBeforePrompt = NULL;
+  m_worksheet->m_cellPointers.m_workingGroupAfterPrompt = NULL;
+}
 
-  if (end != wxNOT_FOUND)
+void wxMaxima::ReadVariables(const wxString &xml)
+{
+  int num = 0;
+  wxXmlDocument xmldoc;
+  wxStringInputStream xmlStream(xml);
+  xmldoc.Load(xmlStream, wxT("UTF-8"));
+  wxXmlNode *node = xmldoc.GetRoot();
+  if(node != NULL)
   {
-    int num = 0;
-    wxXmlDocument xmldoc;
-    wxString xml = data.Left( end + m_variablesSuffix.Length());
-    wxStringInputStream xmlStream(xml);
-    xmldoc.Load(xmlStream, wxT("UTF-8"));
-    wxXmlNode *node = xmldoc.GetRoot();
-    if(node != NULL)
+    wxXmlNode *vars = node->GetChildren();
+    while (vars != NULL)
     {
-      wxXmlNode *vars = node->GetChildren();
-      while (vars != NULL)
+      wxXmlNode *var = vars->GetChildren();
+
+      wxString name;
+      wxString value;
+      bool bound = false;
+      while(var != NULL)
       {
-        wxXmlNode *var = vars->GetChildren();
+        if(var->GetName() == wxT("name"))
+        {
+          num++;
+          wxXmlNode *namenode = var->GetChildren();
+          if(namenode)
+            name = namenode->GetContent();
+        }
+        if(var->GetName() == wxT("value"))
+        {
+          wxXmlNode *valnode = var->GetChildren();
+          if(valnode)
+          {
+            bound = true;
+            value = valnode->GetContent();
+          }
+        }
 
-        wxString name;
-        wxString value;
-        bool bound = false;
-        while(var != NULL)
+        if(bound)
         {
-          if(var->GetName() == wxT("name"))
+          if(name == "maxima_userdir")
           {
-            num++;
-            wxXmlNode *namenode = var->GetChildren();
-            if(namenode)
-              name = namenode->GetContent();
+            Dirstructure::Get()->UserConfDir(value);
+            wxLogMessage(wxString::Format("Maxima user configuration lies in directory %s",value));
           }
-          if(var->GetName() == wxT("value"))
+          if(name == "maxima_tempdir")
           {
-            wxXmlNode *valnode = var->GetChildren();
-            if(valnode)
+            m_maximaTempDir = value;
+            wxLogMessage(wxString::Format("Maxima uses temp directory %s",value));
             {
-              bound = true;
-              value = valnode->GetContent();
+              // Sometimes people delete their temp dir
+              // and gnuplot won't create a new one for them.
+              wxLogNull logNull;
+              wxMkDir(value, wxS_DIR_DEFAULT);
             }
           }
-
-          if(bound)
+          if(name == "*autoconf-version*")
           {
-            if(name == "maxima_userdir")
-            {
-              Dirstructure::Get()->UserConfDir(value);
-              wxLogMessage(wxString::Format("Maxima user configuration lies in directory %s",value));
-            }
-            if(name == "maxima_tempdir")
-            {
-              m_maximaTempDir = value;
-              wxLogMessage(wxString::Format("Maxima uses temp directory %s",value));
-              {
-                // Sometimes people delete their temp dir
-                // and gnuplot won't create a new one for them.
-                wxLogNull logNull;
-                wxMkDir(value, wxS_DIR_DEFAULT);
-              }
-            }
-            if(name == "*autoconf-version*")
-            {
-              m_maximaVersion = value;
-              wxLogMessage(wxString::Format("Maxima version: %s",value));
-            }
-            if(name == "*autoconf-host*")
-            {
-              m_maximaArch = value;
-              wxLogMessage(wxString::Format("Maxima architecture: %s",value));
-            }
-            if(name == "*maxima-infodir*")
-            {
-              m_maximaDocDir = value;
-              wxLogMessage(wxString::Format("Maxima's manual lies in directory %s",value));
-            }
-            if(name == "gnuplot_command")
-            {
-              m_gnuplotcommand = value;
-              wxLogMessage(wxString::Format("Gnuplot can be found at %s",value));
-            }
-            if(name == "*maxima-sharedir*")
-            {
-              m_worksheet->m_configuration->MaximaShareDir(value);
-              wxLogMessage(wxString::Format("Maxima's share files lie in directory %s",value));
-              /// READ FUNCTIONS FOR AUTOCOMPLETION
-              m_worksheet->LoadSymbols();
-            }
-            if(name == "*lisp-name*")
-            {
-              m_lispType = value;
-              wxLogMessage(wxString::Format("Maxima was compiled using %s",value));
-            }
-            if(name == "*lisp-version*")
-            {
-              m_lispVersion = value;
-              wxLogMessage(wxString::Format("Lisp version: %s",value));
-            }
-            if(name == "*wx-load-file-name*")
-            {
-              m_recentPackages.AddDocument(value);
-              wxLogMessage(wxString::Format(_("Maxima has loaded the file %s."),value));
-            }
-            m_worksheet->m_variablesPane->VariableValue(name, value);
+            m_maximaVersion = value;
+            wxLogMessage(wxString::Format("Maxima version: %s",value));
           }
-          else
-            m_worksheet->m_variablesPane->VariableUndefined(name);
-
-          var = var->GetNext();
+          if(name == "*autoconf-host*")
+          {
+            m_maximaArch = value;
+            wxLogMessage(wxString::Format("Maxima architecture: %s",value));
+          }
+          if(name == "*maxima-infodir*")
+          {
+            m_maximaDocDir = value;
+            wxLogMessage(wxString::Format("Maxima's manual lies in directory %s",value));
+          }
+          if(name == "gnuplot_command")
+          {
+            m_gnuplotcommand = value;
+            wxLogMessage(wxString::Format("Gnuplot can be found at %s",value));
+          }
+          if(name == "*maxima-sharedir*")
+          {
+            m_worksheet->m_configuration->MaximaShareDir(value);
+            wxLogMessage(wxString::Format("Maxima's share files lie in directory %s",value));
+            /// READ FUNCTIONS FOR AUTOCOMPLETION
+            m_worksheet->LoadSymbols();
+          }
+          if(name == "*lisp-name*")
+          {
+            m_lispType = value;
+            wxLogMessage(wxString::Format("Maxima was compiled using %s",value));
+          }
+          if(name == "*lisp-version*")
+          {
+            m_lispVersion = value;
+            wxLogMessage(wxString::Format("Lisp version: %s",value));
+          }
+          if(name == "*wx-load-file-name*")
+          {
+            m_recentPackages.AddDocument(value);
+            wxLogMessage(wxString::Format(_("Maxima has loaded the file %s."),value));
+          }
+          m_worksheet->m_variablesPane->VariableValue(name, value);
         }
-        vars = vars->GetNext();
+        else
+          m_worksheet->m_variablesPane->VariableUndefined(name);
+
+        var = var->GetNext();
       }
+      vars = vars->GetNext();
     }
+  }
 
-    if(num>1)
-      wxLogMessage(_("Maxima sends a new set of auto-completible symbols."));
-    else
-      wxLogMessage(_("Maxima has sent a new variable value."));
+  if(num>1)
+    wxLogMessage(_("Maxima sends a new set of auto-completible symbols."));
+  else
+    wxLogMessage(_("Maxima has sent a new variable value."));
 
-    // Remove the symbols from the data string
-    data = data.Right(data.Length()-end-m_variablesSuffix.Length());
-    TriggerEvaluation();
-    QueryVariableValue();
-  }
+  TriggerEvaluation();
+  QueryVariableValue();
 }
 
-void wxMaxima::ReadAddVariables(wxString &data)
+void wxMaxima::ReadAddVariables(const wxString &xml)
 {
-  if (!data.StartsWith(m_addVariablesPrefix))
-    return;
-
-  int end = FindTagEnd(data, m_addVariablesSuffix);
-
-  if (end != wxNOT_FOUND)
+  wxLogMessage(_("Maxima sends us a new set of variables for the watch list."));
+  wxXmlDocument xmldoc;
+  wxStringInputStream xmlStream(xml);
+  xmldoc.Load(xmlStream, wxT("UTF-8"));
+  wxXmlNode *node = xmldoc.GetRoot();
+  if(node != NULL)
   {
-    wxLogMessage(_("Maxima sends us a new set of variables for the watch list."));
-    wxXmlDocument xmldoc;
-    wxString xml = data.Left( end + m_addVariablesSuffix.Length());
-    wxStringInputStream xmlStream(xml);
-    xmldoc.Load(xmlStream, wxT("UTF-8"));
-    wxXmlNode *node = xmldoc.GetRoot();
-    if(node != NULL)
+    wxXmlNode *var = node->GetChildren();
+    while (var != NULL)
     {
-      wxXmlNode *var = node->GetChildren();
-      while (var != NULL)
+      wxString name;
       {
-        wxString name;
+        if(var->GetName() == wxT("variable"))
         {
-          if(var->GetName() == wxT("variable"))
-          {
-            wxXmlNode *valnode = var->GetChildren();
-            if(valnode)
-              m_worksheet->m_variablesPane->AddWatch(valnode->GetContent());
-          }
+          wxXmlNode *valnode = var->GetChildren();
+          if(valnode)
+            m_worksheet->m_variablesPane->AddWatch(valnode->GetContent());
         }
-        var = var->GetNext();
       }
+      var = var->GetNext();
     }
-    data = data.Right(data.Length()-end-m_addVariablesSuffix.Length());
   }
 }
 
@@ -1905,30 +1893,14 @@ bool wxMaxima::QueryVariableValue()
 /***
  * Checks if maxima displayed a new prompt.
  */
-void wxMaxima::ReadPrompt(wxString &data)
+void wxMaxima::ReadPrompt(wxString o)
 {
-  m_evalOnStartup = false;
-  if (!data.StartsWith(m_promptPrefix))
-    return;
-
-  m_worksheet->m_cellPointers.m_currentTextCell = NULL;
-
   // Assume we don't have a question prompt
   m_worksheet->m_questionPrompt = false;
   m_ready = true;
-  int end = FindTagEnd(data,m_promptSuffix);
-  // Did we find a prompt?
-  if (end == wxNOT_FOUND)
-    return;
 
   m_maximaBusy = false;
-  m_bytesFromMaxima = 0;
-
-  wxString o = data.SubString(m_promptPrefix.Length(), end - 1);
-  // Remove the prompt we will process from the string.
-  data = data.Right(data.Length()-end-m_promptSuffix.Length());
-  if(data == wxT(" "))
-    data = wxEmptyString;
+  LogReadSpeed();
 
   // If we got a prompt our connection to maxima was successful.
   if(m_unsuccessfulConnectionAttempts > 0)
@@ -2495,8 +2467,6 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
 
   RightStatusText(_("Opening file"));
 
-  wxWindowUpdateLocker noUpdates(document);
-
   // If the file is empty we don't want to generate an error, but just
   // open an empty file.
   //
@@ -2521,8 +2491,6 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
   }
 
   // open wxmx file
-  wxXmlDocument xmldoc;
-
   // We get only absolute paths so the path should start with a "/"
   //if(!file.StartsWith(wxT("/")))
   //  file = wxT("/") + file;
@@ -2555,42 +2523,7 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
   }
 
   // Did we succeed in opening the file?
-  if (fsfile)
-  {
-    // Let's see if we can load the XML contained in this file.
-    if (!xmldoc.Load(*(fsfile->GetStream()), wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES))
-    {
-      // If we cannot read the file a typical error in old wxMaxima versions was to include
-      // a letter of ascii code 27 in content.xml. Let's filter this char out.
-
-      // Re-open the file.
-      wxDELETE(fsfile);
-      fsfile = fs.OpenFile(filename);
-      if (fsfile)
-      {
-        // Read the file into a string
-        wxString s;
-        wxTextInputStream istream1(*fsfile->GetStream(), wxT('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-        while (!fsfile->GetStream()->Eof())
-          s += istream1.ReadLine() + wxT("\n");
-
-        // Remove the illegal character
-        s.Replace(wxT('\x1b'), wxT("|"));
-
-        {
-          // Write the string into a memory buffer
-          wxMemoryOutputStream ostream;
-          wxTextOutputStream txtstrm(ostream);
-          txtstrm.WriteString(s);
-          wxMemoryInputStream istream(ostream);
-
-          // Try to load the file from the memory buffer.
-          xmldoc.Load(istream, wxT("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
-        }
-      }
-    }
-  }
-  else
+  if (!fsfile)
   {
     if(m_worksheet)
     {
@@ -2605,10 +2538,12 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
     return false;
   }
 
-  wxDELETE(fsfile);
-
-  if (!xmldoc.IsOk())
+  // content.xml is read one cell at a time: A wxXmlDocument of the whole file
+  // would need several times the memory the file needs.
+  ContentXMLReader content(*fsfile->GetStream());
+  if (!content.ReadStartTag())
   {
+    wxDELETE(fsfile);
     wxMessageBox(_("wxMaxima cannot read the xml contents of ") + file, _("Error"),
                  wxOK | wxICON_EXCLAMATION);
     StatusMaximaBusy(waiting);
@@ -2617,8 +2552,9 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
   }
 
   // start processing the XML file
-  if (xmldoc.GetRoot()->GetName() != wxT("wxMaximaDocument"))
+  if (content.GetRootName() != wxT("wxMaximaDocument"))
   {
+    wxDELETE(fsfile);
     wxMessageBox(_("xml contained in the file claims not to be a wxMaxima worksheet. ") + file, _("Error"),
                  wxOK | wxICON_EXCLAMATION);
     StatusMaximaBusy(waiting);
@@ -2627,20 +2563,21 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
   }
 
   // read document version and complain
-  wxString docversion = xmldoc.GetRoot()->GetAttribute(wxT("version"), wxT("1.0"));
+  wxString docversion = content.GetAttribute(wxT("version"), wxT("1.0"));
   if (!CheckWXMXVersion(docversion))
   {
+    wxDELETE(fsfile);
     StatusMaximaBusy(waiting);
     return false;
   }
 
   // Determine where the cursor was before saving
-  wxString ActiveCellNumber_String = xmldoc.GetRoot()->GetAttribute(wxT("activecell"), wxT("-1"));
+  wxString ActiveCellNumber_String = content.GetAttribute(wxT("activecell"), wxT("-1"));
   long ActiveCellNumber;
   if (!ActiveCellNumber_String.ToLong(&ActiveCellNumber))
     ActiveCellNumber = -1;
 
-  wxString VariablesNumberString = xmldoc.GetRoot()->GetAttribute(wxT("variables_num"), wxT("0"));
+  wxString VariablesNumberString = content.GetAttribute(wxT("variables_num"), wxT("0"));
   long VariablesNumber;
   if (!VariablesNumberString.ToLong(&VariablesNumber))
     VariablesNumber = 0;
@@ -2650,18 +2587,18 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
 
     for(long i=0; i<VariablesNumber; i++)
     {
-      wxString variable = xmldoc.GetRoot()->GetAttribute(
+      wxString variable = content.GetAttribute(
         wxString::Format("variables_%li", i));
       m_worksheet->m_variablesPane->AddWatch(variable);
     }
   }
 
   // read the zoom factor
-  wxString doczoom = xmldoc.GetRoot()->GetAttribute(wxT("zoom"), wxT("100"));
+  wxString doczoom = content.GetAttribute(wxT("zoom"), wxT("100"));
 
-  // Read the worksheet's contents.
-  wxXmlNode *xmlcells = xmldoc.GetRoot();
-  GroupCell *tree = CreateTreeFromXMLNode(xmlcells, wxmxURI);
+  // Don't redraw the worksheet while it is filled. The lock is released early
+  // if the first screen is shown while the rest of the file is still loading.
+  wxWindowUpdateLocker *noUpdates = new wxWindowUpdateLocker(document);
 
   // from here on code is identical for wxm and wxmx
   if (clearDocument)
@@ -2674,7 +2611,45 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
     document->SetZoomFactor(double(zoom) / 100.0, false); // Set zoom if opening, don't recalculate
   }
 
-  document->InsertGroupCells(tree); // this also requests a recalculate
+  // Read the worksheet's contents. GroupCells are created as soon as their end
+  // tag has been read.
+  MathParser mp(&m_worksheet->m_configuration, &m_worksheet->m_cellPointers, wxmxURI);
+  GroupCell *tree = NULL;
+  GroupCell *last = NULL;
+  bool warning = true;
+  bool firstScreenShown = false;
+  wxStopWatch stopwatch;
+  wxXmlDocument element;
+  while (content.NextElement(element))
+  {
+    AppendCellFromXMLNode(mp, element.IsOk() ? element.GetRoot() : NULL,
+                          tree, last, warning);
+
+    // If loading a big file takes long we show the first screen of the
+    // worksheet while the rest of the cells are still loading.
+    if (clearDocument && (!firstScreenShown) && (tree != NULL) && (stopwatch.Time() > 250))
+    {
+      firstScreenShown = true;
+      wxDELETE(noUpdates);
+      document->InsertGroupCells(tree);
+      tree = last = NULL;
+      document->ForceRedraw();
+      document->Update();
+    }
+  }
+  wxDELETE(fsfile);
+
+  if ((!content.IsComplete()) && warning)
+    wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
+                 wxOK | wxICON_WARNING);
+  wxLogMessage(wxString::Format(_("Read content.xml keeping at most %lu chars of it in memory"),
+                                (unsigned long) content.GetPeakSize()));
+
+  // this also requests a recalculate
+  if (firstScreenShown)
+    document->AppendGroupCells(tree);
+  else
+    document->InsertGroupCells(tree);
   if (clearDocument)
   {
     m_worksheet->m_currentFile = file;
@@ -2703,6 +2678,7 @@ bool wxMaxima::OpenWXMXFile(wxString file, Worksheet *document, bool clearDocume
     if (pos)
       m_worksheet->SetHCaret(pos);
   }
+  wxDELETE(noUpdates);
   StatusMaximaBusy(waiting);
   RemoveTempAutosavefile();
 
@@ -2807,36 +2783,44 @@ GroupCell *wxMaxima::CreateTreeFromXMLNode(wxXmlNode *xmlcells, wxString wxmxfil
   while (xmlcells != NULL)
   {
     if (xmlcells->GetType() != wxXML_TEXT_NODE)
-    {
-      Cell *mc = mp.ParseTag(xmlcells, false);
-      if (mc != NULL)
-      {
-        GroupCell *cell = dynamic_cast<GroupCell *>(mc);
+      AppendCellFromXMLNode(mp, xmlcells, tree, last, warning);
+    xmlcells = xmlcells->GetNext();
+  }
+  return tree;
+}
 
-        if (last == NULL)
-        {
-          // first cell
-          last = tree = cell;
-        }
-        else
-        {
-          // The rest of the cells
-          last->m_next = last->m_nextToDraw = cell;
-          last->m_next->m_previous = last->m_next->m_previousToDraw = last;
+void wxMaxima::AppendCellFromXMLNode(MathParser &mp, wxXmlNode *xmlcell,
+                                     GroupCell *&tree, GroupCell *&last, bool &warning)
+{
+  Cell *mc = NULL;
+  if (xmlcell != NULL)
+    mc = mp.ParseTag(xmlcell, false);
 
-          last = dynamic_cast<GroupCell *>(last->m_next);
-        }
-      }
-      else if (warning)
-      {
-        wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
-                     wxOK | wxICON_WARNING);
-        warning = false;
-      }
+  if (mc == NULL)
+  {
+    if (warning)
+    {
+      wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
+                   wxOK | wxICON_WARNING);
+      warning = false;
     }
-    xmlcells = xmlcells->GetNext();
+    return;
+  }
+
+  GroupCell *cell = dynamic_cast<GroupCell *>(mc);
+  if (last == NULL)
+  {
+    // first cell
+    last = tree = cell;
+  }
+  else
+  {
+    // The rest of the cells
+    last->m_next = last->m_nextToDraw = cell;
+    last->m_next->m_previous = last->m_next->m_previousToDraw = last;
+
+    last = dynamic_cast<GroupCell *>(last->m_next);
   }
-  return tree;
 }
 
 wxString wxMaxima::EscapeForLisp(wxString str)
@@ -3230,83 +3214,133 @@ bool wxMaxima::InterpretDataFromMaxima()
 
   if ((m_xmlInspector) && (IsPaneDisplayed(menu_pane_xmlInspector)))
     m_xmlInspector->Add_FromMaxima(m_newCharsFromMaxima);
-  // This way we can avoid searching the whole string for a
-  // ending tag if we have received only a few bytes of the
-  // data between 2 tags
-  m_currentOutputEnd = m_currentOutput.Right(30) + m_newCharsFromMaxima;
 
-  m_currentOutput += m_newCharsFromMaxima;
+  m_outputScanner.Append(m_newCharsFromMaxima);
   m_newCharsFromMaxima = wxEmptyString;
-  if ((m_xmlInspector) && (IsPaneDisplayed(menu_pane_xmlInspector)))
-    m_xmlInspector->Add_FromMaxima(m_newCharsFromMaxima);
 
   if (!m_dispReadOut &&
-      (m_currentOutput != wxT("\n")) &&
-      (m_currentOutput != wxT("<wxxml-symbols></wxxml-symbols>")))
+      (!m_outputScanner.RemainingIs(wxT("\n"))) &&
+      (!m_outputScanner.RemainingIs(wxT("<wxxml-symbols></wxxml-symbols>"))))
   {
     StatusMaximaBusy(transferring);
     m_dispReadOut = true;
   }
 
-  size_t length_old = -1;
-
-  while (length_old != m_currentOutput.Length())
+  if (m_first)
   {
-    if (m_currentOutput.StartsWith("\n<"))
-      m_currentOutput = m_currentOutput.Right(m_currentOutput.Length() - 1);
+    // This function determines the port maxima is running on from  the text
+    // maxima outputs at startup. This piece of text is afterwards discarded.
+    wxString data = m_outputScanner.GetRemaining();
+    ReadFirstPrompt(data);
+    m_outputScanner.SetRemaining(data);
+    if (m_first)
+      return true;
+  }
+
+  m_evalOnStartup = false;
 
-    length_old = m_currentOutput.Length();
+  // If we are waiting for the cells for a chunk of math the output that has
+  // arrived after it has to wait, too.
+  if (m_mathParserBusy)
+    return true;
+
+  // Output that arrives directly after a prompt is assigned to the cell that was
+  // active before the prompt until a chunk type arrives that doesn't follow the
+  // prompt in the order the ChunkTypes are listed in.
+  m_worksheet->m_cellPointers.m_workingGroupBeforePrompt = NULL;
+  m_worksheet->m_cellPointers.m_workingGroupAfterPrompt = NULL;
+  m_lastChunkType = MaximaOutputScanner::none;
+  InterpretChunks();
+  return true;
+}
+
+void wxMaxima::InterpretChunks()
+{
+  Cell *&oldActiveCell = m_worksheet->m_cellPointers.m_workingGroupBeforePrompt;
+  Cell *&newActiveCell = m_worksheet->m_cellPointers.m_workingGroupAfterPrompt;
+  MaximaOutputScanner::ChunkType type;
+  wxString contents;
+  while (
+    ((type = m_outputScanner.NextChunk(contents)) != MaximaOutputScanner::none) &&
+    (type != MaximaOutputScanner::incomplete)
+    )
+  {
+    if((type <= m_lastChunkType) && (newActiveCell != oldActiveCell))
+    {
+      // Switch to the WorkingGroup the next bunch of data is for.
+      m_worksheet->m_cellPointers.SetWorkingGroup(newActiveCell);
+      oldActiveCell = newActiveCell = NULL;
+    }
+    m_lastChunkType = type;
 
-    GroupCell *oldActiveCell = NULL;
-    GroupCell *newActiveCell = NULL;
+    if((type != MaximaOutputScanner::miscText) &&
+       (type != MaximaOutputScanner::variables) &&
+       (type != MaximaOutputScanner::addVariables) &&
+       (type != MaximaOutputScanner::suppressedOutput))
+      m_worksheet->m_cellPointers.m_currentTextCell = NULL;
 
-    // Handle text that isn't wrapped in a known tag
-    if (!m_first)
+    switch (type)
     {
+    case MaximaOutputScanner::prompt:
       // First read the prompt that tells us that maxima awaits the next command:
       // If that is the case ReadPrompt() sends the next command to maxima and
       // maxima can work while we interpret its output.
       oldActiveCell = m_worksheet->GetWorkingGroup();
-      ReadPrompt(m_currentOutput);
+      ReadPrompt(contents);
       newActiveCell = m_worksheet->GetWorkingGroup();
 
       // Temporarily switch to the WorkingGroup the output we don't have interpreted yet
       // was for
       if(newActiveCell != oldActiveCell)
         m_worksheet->m_cellPointers.SetWorkingGroup(oldActiveCell);
+      break;
+    case MaximaOutputScanner::math:
       // Handle the <mth> tag that contains math output and sometimes text.
-      ReadMath(m_currentOutput);
-
-      // The following function calls each extract and remove one type of XML tag
-      // information from the beginning of the data string we got - but only do so
-      // after the closing tag has been transferred, as well.
-      ReadLoadSymbols(m_currentOutput);
-
+      if (ReadMath(contents))
+      {
+        // The rest of the output is interpreted after the cells for this
+        // chunk of math have been added to the worksheet.
+        m_outputScanner.Compact();
+        return;
+      }
+      break;
+    case MaximaOutputScanner::symbols:
+      m_worksheet->AddSymbols(contents);
+      break;
+    case MaximaOutputScanner::suppressedOutput:
       // Discard startup warnings
-      ReadSuppressedOutput(m_currentOutput);
-
+      break;
+    case MaximaOutputScanner::variables:
       // Let's see if maxima informs us about the values of variables
-      ReadVariables(m_currentOutput);
-
+      ReadVariables(contents);
+      break;
+    case MaximaOutputScanner::addVariables:
       // Let's see if maxima tells us to add new symbols to the watchlist
-      ReadAddVariables(m_currentOutput);
-
+      ReadAddVariables(contents);
+      break;
+    case MaximaOutputScanner::statusBar:
       // Handle the XML tag that contains Status bar updates
-      ReadStatusBar(m_currentOutput);
-
+      ReadStatusBar(contents);
+      break;
+    default:
       // Handle text that isn't XML output: Mostly Error messages or warnings.
-      ReadMiscText(m_currentOutput);
+      ReadMiscText(contents);
+      if(!m_outputScanner.IsEmpty())
+        m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+      break;
     }
-    else
-      // This function determines the port maxima is running on from  the text
-      // maxima outputs at startup. This piece of text is afterwards discarded.
-      ReadFirstPrompt(m_currentOutput);
-
-    // Switch to the WorkingGroup the next bunch of data is for.
-    if(newActiveCell != oldActiveCell)
-      m_worksheet->m_cellPointers.SetWorkingGroup(newActiveCell);
   }
-  return true;
+
+  if(type == MaximaOutputScanner::incomplete)
+    m_worksheet->m_cellPointers.m_currentTextCell = NULL;
+
+  // Switch to the WorkingGroup the next bunch of data is for.
+  if(newActiveCell != oldActiveCell)
+    m_worksheet->m_cellPointers.SetWorkingGroup(newActiveCell);
+  oldActiveCell = newActiveCell = NULL;
+
+  // Drop everything we have processed in one go.
+  m_outputScanner.Compact();
 }
 
 ///--------------------------------------------------------------------------------
@@ -4324,21 +4358,31 @@ void wxMaxima::OnTimerEvent(wxTimerEvent &event)
       {
         if (m_worksheet->m_configuration->AutoSaveMiliseconds() > 0)
         {
-          if(SaveNecessary())
+          // .wxmx files are written in the background: The user shouldn't have
+          // to stop typing while a big worksheet is saved. If the last autosave
+          // hasn't finished yet we wait for the next opportunity.
+          if(SaveNecessary() && !m_worksheet->BackgroundSaveRunning())
           {
             if ((m_worksheet->m_currentFile.Length() > 0))
             {
               // Automatically safe the file for the user making it seem like the file
               // is always saved -
-              SaveFile(false);
+              if (m_worksheet->m_currentFile.EndsWith(wxT(".wxmx")))
+              {
+                StatusSaveStart();
+                if (!m_worksheet->StartBackgroundSave(m_worksheet->m_currentFile,
+                                                      this, autosave_thread_id))
+                  StatusSaveFailed();
+              }
+              else
+                SaveFile(false);
             }
             else
             {
               // The file hasn't been given a name yet.
               // Save the file and remember the file name.
               wxString name = GetTempAutosavefileName();
-              m_worksheet->ExportToWXMX(name);
-              RegisterAutoSaveFile();
+              m_worksheet->StartBackgroundSave(name, this, autosave_thread_id);
               m_fileSaved = false;
             }
           }
@@ -4350,6 +4394,35 @@ void wxMaxima::OnTimerEvent(wxTimerEvent &event)
   }
 }
 
+void wxMaxima::OnAutoSaved(wxThreadEvent &WXUNUSED(event))
+{
+  wxString file;
+  bool succeeded = m_worksheet->FinishBackgroundSave(&file);
+
+  // A save that had to wait for the autosave might already have done the
+  // bookkeeping.
+  if (file.IsEmpty())
+    return;
+
+  if (file == m_worksheet->m_currentFile)
+  {
+    if (succeeded)
+    {
+      StatusSaveFinished();
+      RemoveTempAutosavefile();
+    }
+    else
+      StatusSaveFailed();
+    ResetTitle(m_worksheet->IsSaved());
+  }
+  else if ((file == m_tempfileName) && succeeded)
+  {
+    // The file hasn't been given a name yet: Remember the name of the file we
+    // have saved it to.
+    RegisterAutoSaveFile();
+  }
+}
+
 void wxMaxima::FileMenu(wxCommandEvent &event)
 {
   if(m_worksheet != NULL)
@@ -8969,6 +9042,8 @@ BEGIN_EVENT_TABLE(wxMaxima, wxFrame)
                 EVT_TOOL(ToolBar::tb_follow, wxMaxima::OnFollow)
                 EVT_SOCKET(socket_server_id, wxMaxima::ServerEvent)
                 EVT_SOCKET(socket_client_id, wxMaxima::ClientEvent)
+                EVT_THREAD(mathparser_thread_id, wxMaxima::OnMathParsed)
+                EVT_THREAD(autosave_thread_id, wxMaxima::OnAutoSaved)
 /* These commands somehow caused the menu to be updated six times on every
    keypress and the tool bar to be updated six times on every menu update
 
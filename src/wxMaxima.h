@@ -33,6 +33,8 @@
 
 #include "wxMaximaFrame.h"
 #include "MathParser.h"
+#include "MathParserThread.h"
+#include "MaximaOutputScanner.h"
 #include "Dirstructure.h"
 
 #include <wx/socket.h>
@@ -74,6 +76,8 @@
 
 //! How many miliseconds should we wait between polling for stdout+cpu power?
 #define MAXIMAPOLLMSECS 2000
+//! How many bytes we try to read from maxima's socket in one go
+#define SOCKET_READ_BLOCKSIZE 65536
 
 #ifndef __WXGTK__
 
@@ -315,6 +319,19 @@ protected:
       - false, if there wasn't any new data.
    */
   bool InterpretDataFromMaxima();
+  /*! Interpret the chunks of maxima's output that are waiting in m_outputScanner
+
+    Stops if a chunk of math is handed to m_mathParserThread: The following
+    chunks are interpreted by OnMathParsed() once its result has been inserted
+    into the worksheet.
+   */
+  void InterpretChunks();
+  //! Inserts the cells m_mathParserThread has created into the worksheet
+  void OnMathParsed(wxThreadEvent &event);
+  //! Forget about math that is still being parsed in the background
+  void AbandonMathParsing();
+  //! Does the bookkeeping after an autosave has been written in the background
+  void OnAutoSaved(wxThreadEvent &event);
   bool m_dataFromMaximaIs;
   
   void MenuCommand(wxString cmd);                  //!< Inserts command cmd into the worksheet
@@ -364,7 +381,7 @@ protected:
   /*! Is triggered on Input or disconnect from maxima
 
     The data we get from maxima is typically split into small packets we append to 
-    m_currentOutput until we got a full line we can display.
+    m_outputScanner until we got a full line we can display.
    */
   void ClientEvent(wxSocketEvent &event);
   //! Triggered when we get new chars from maxima.
@@ -464,65 +481,60 @@ protected:
    */
   void ReadFirstPrompt(wxString &data);
 
-  /*! Determine where the text for ReadMiscText ends
+  //! Writes how fast we read maxima's last output to the log and resets the counters
+  void LogReadSpeed();
 
-    Every error message or other line maxima outputs should end in a newline character. 
-    But sometimes it doesn't and a <code>\<mth\></code> tag comes first \f$ =>\f$ This 
-    function determines where the miscellaneous text ends.
-   */
-  int GetMiscTextEnd(const wxString &data);
+  /*! Converts all complete UTF-8 chars at the beginning of data to a wxString
 
-  //! Find the end of a tag in wxMaxima's output.
-  int FindTagEnd(wxString &data, const wxString &tag);
+    Removes the converted bytes from data so only the start of a char that has been
+    cut in half at the end of the buffer remains in there.
+   */
+  static wxString DecodeCompleteUtf8(wxMemoryBuffer &data);
 
   /*! Reads text that isn't enclosed between xml tags.
 
      Some commands provide status messages before the math output or the command has finished.
      This function makes wxMaxima output them directly as they arrive.
-
-     After processing the lines not enclosed in xml tags they are removed from data.
    */
-  void ReadMiscText(wxString &data);
+  void ReadMiscText(wxString miscText);
 
   /*! Reads the input prompt from Maxima.
 
-     After processing the input prompt it is removed from data.
+    \param o The text between the prompt markers
    */
-  void ReadPrompt(wxString &data);
+  void ReadPrompt(wxString o);
 
   /*! Reads the output of wxstatusbar() commands
 
     wxstatusbar allows the user to give and update visual feedback from long-running 
     commands and makes sure this feedback is deleted once the command is finished.
    */
-  void ReadStatusBar(wxString &data);
+  void ReadStatusBar(const wxString &xml);
 
   /*! Reads the math cell's contents from Maxima.
      
      Math cells are enclosed between the tags \<mth\> and \</mth\>. 
-     This function removes the from data after appending them
-     to the console.
-
-     After processing the status bar marker is removed from data.
+     This function appends them to the console.
+     \return true, if the math is being parsed in the background and the cells
+     will be appended by OnMathParsed().
    */
-  void ReadMath(wxString &data);
+  bool ReadMath(wxString o);
 
-  /*! Reads autocompletion templates we get on definition of a function or variable
+  /*! Hands a chunk of math to m_mathParserThread
 
-    After processing the templates they are removed from data.
+    \return false, if the math has to be parsed in the GUI thread instead: If it
+    contains images that cannot be loaded in a background thread or if it would
+    exceed the number of output cells the user allows per command.
    */
-  void ReadLoadSymbols(wxString &data);
-
-  //! Read (and discard) suppressed output
-  void ReadSuppressedOutput(wxString &data);
+  bool ParseMathInBackground(wxString o, const wxString &userLabel);
 
   /*! Reads the variable values maxima advertises to us
    */
-  void ReadVariables(wxString &data);
+  void ReadVariables(const wxString &xml);
   
   /*! Reads the "add variable to watch list" tag maxima can send us
    */
-  void ReadAddVariables(wxString &data);
+  void ReadAddVariables(const wxString &xml);
 
 #ifndef __WXMSW__
 
@@ -603,6 +615,18 @@ protected:
   //! Loads a wxmx description
   GroupCell *CreateTreeFromXMLNode(wxXmlNode *xmlcells, wxString wxmxfilename = wxEmptyString);
 
+  /*! Converts a cell of a wxmx description to a GroupCell and appends it to a list
+
+    \param mp      The parser that converts the XML to cells
+    \param xmlcell The cell. NULL means: The cell could not be read.
+    \param tree    The first cell of the list. NULL if the list is still empty.
+    \param last    The last cell of the list
+    \param warning true, if the user hasn't been told yet that a cell could not be
+                   read. Is set to false as soon as the user has been told.
+   */
+  void AppendCellFromXMLNode(MathParser &mp, wxXmlNode *xmlcell,
+                             GroupCell *&tree, GroupCell *&last, bool &warning);
+
   /*! Saves the current file
 
     \param forceSave true means: Always ask for a file name before saving.
@@ -621,8 +645,12 @@ protected:
   }
 
   wxSocketBase *m_client;
-  wxSocketInputStream *m_clientStream;
-  wxTextInputStream *m_clientTextStream;
+  /*! The bytes at the end of maxima's output that don't form a complete UTF-8 char, yet
+
+    Maxima's output is read in big blocks => A multi-byte char might be split between 
+    two blocks. Its first bytes are kept here until the rest of the char arrives.
+   */
+  wxMemoryBuffer m_uncompletedUtf8FromMaxima;
   wxSocketServer *m_server;
   //! Is the network connection to maxima working?
   bool m_isConnected;
@@ -634,39 +662,14 @@ protected:
   //! The stderr of the maxima process
   wxInputStream *m_maximaStderr;
   int m_port;
-  //! All chars from maxima that still aren't part of m_currentOutput
+  //! All chars from maxima that still aren't part of m_outputScanner
   wxString m_newCharsFromMaxima;
-  /*! The end of maxima's current uninterpreted output, see m_currentOutput.
-   
-    If we just want to look if maxima's current output contains an ending tag
-    this is the place we can search in fast.
-
-    wxEmptyString means that the current output isn't long enought to make 
-    creating this string worthwile.
-   */
-  wxString m_currentOutputEnd;
   //! All from maxima's current output we still haven't interpreted
-  wxString m_currentOutput;
+  MaximaOutputScanner m_outputScanner;
   //! The marker for the start of a input prompt
   wxString m_promptPrefix;
   //! The marker for the end of a input prompt
   wxString m_promptSuffix;
-  //! The marker for the start of a variables section
-  wxString m_variablesPrefix;
-  //! The marker for the end of a variables section
-  wxString m_variablesSuffix;
-  //! The marker for the start of a "add variables" section
-  wxString m_addVariablesPrefix;
-  //! The marker for the end of a "add variables" section
-  wxString m_addVariablesSuffix;
-  //! The marker for the start of a list of autocompletion templates
-  wxString m_symbolsPrefix;
-  //! The marker for the end of a list of autocompletion templates
-  wxString m_symbolsSuffix;
-  //! The marker that tells to start suppressing any output from maxima
-  wxString m_suppressOutputPrefix;
-  //! The marker that tells to stop to suppress any output from maxima
-  wxString m_suppressOutputSuffix;
   wxString m_firstPrompt;
   bool m_dispReadOut;               //!< what is displayed in statusbar
   wxString m_lastPrompt;
@@ -702,6 +705,14 @@ protected:
   wxRegEx m_blankStatementRegEx;
   wxRegEx m_sbclCompilationRegEx;
   MathParser *m_parser;
+  //! The thread that converts math from maxima to cells. NULL = parse in the GUI thread
+  MathParserThread *m_mathParserThread;
+  //! The number of the last chunk of math we have handed to m_mathParserThread
+  long m_mathParserJob;
+  //! Are we waiting for m_mathParserThread to return a chunk of math?
+  bool m_mathParserBusy;
+  //! The type of the last chunk of maxima's output InterpretChunks() has read
+  MaximaOutputScanner::ChunkType m_lastChunkType;
   bool m_maximaBusy;
   wxMemoryBuffer m_rawDataToSend;
   unsigned long int m_rawBytesSent;
@@ -52,6 +52,7 @@ wxMaximaFrame::wxMaximaFrame(wxWindow *parent, int id, const wxString &title,
   m_recentPackages(wxT("packages"))
 {
   m_bytesFromMaxima = 0;
+  m_millisecondsReadingFromMaxima = 0;
   // Suppress window updates until this window has fully been created.
   // Not redrawing the window whilst constructing it hopefully speeds up
   // everything.
@@ -489,7 +489,9 @@ public:
     socket_client_id,
     socket_server_id,
     maxima_process_id,
-    gnuplot_process_id
+    gnuplot_process_id,
+    mathparser_thread_id,
+    autosave_thread_id
   };
 
   /*! Update the recent documents list
@@ -572,6 +574,8 @@ public:
 protected:
   //! How many bytes did maxima send us until now?
   long m_bytesFromMaxima;
+  //! How many milliseconds did we spend reading and decoding the m_bytesFromMaxima bytes?
+  long m_millisecondsReadingFromMaxima;
   //! The process id of maxima. Is determined by ReadFirstPrompt.
   long m_pid;
   //! Did the user ever give this file a name?
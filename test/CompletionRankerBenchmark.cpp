@@ -0,0 +1,177 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+/*! \file
+  A micro-benchmark for CompletionRanker
+
+  Ranks maxima's built-in commands plus 5000 words a big worksheet might contain
+  for every keystroke of typing a few symbols and reports the average and the
+  median time per keystroke. Fails if the ranking doesn't put the matches we
+  expect first or if the median is above 5 ms. The time depends on the machine
+  the test runs on: Only if the environment variable WXMAXIMA_BENCHMARK_STRICT
+  is set the median must meet the goal of 1 ms.
+ */
+
+#include "CompletionRanker.h"
+#include <wx/stopwatch.h>
+#include <wx/textfile.h>
+#include <wx/fileconf.h>
+#include <wx/sstream.h>
+#include <wx/utils.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//! Ranks all symbols for partial the way AutoComplete::CompleteSymbol does
+static wxArrayString Rank(CompletionRanker &ranker, const wxString &partial,
+                          const std::vector<std::string> &builtins,
+                          const wxArrayString &worksheetWords)
+{
+  ranker.Start(partial);
+  for (size_t i = 0; i < builtins.size(); i++)
+    ranker.Add(builtins[i].c_str());
+  for (size_t i = 0; i < worksheetWords.GetCount(); i++)
+    ranker.Add(worksheetWords[i]);
+  return ranker.GetRanked();
+}
+
+//! Checks that expected is one of the first matches for partial
+static bool Expect(CompletionRanker &ranker, const wxString &partial, const wxString &expected,
+                   size_t within, const std::vector<std::string> &builtins,
+                   const wxArrayString &worksheetWords)
+{
+  wxArrayString ranked = Rank(ranker, partial, builtins, worksheetWords);
+  for (size_t i = 0; (i < within) && (i < ranked.GetCount()); i++)
+    if (ranked[i] == expected)
+      return true;
+  wxString got = ranked.IsEmpty() ? wxString(wxT("nothing")) : ranked[0];
+  std::cerr << "\"" << partial.utf8_str().data() << "\": Expected "
+            << expected.utf8_str().data() << " among the first " << within
+            << " matches, the best match is " << got.utf8_str().data() << std::endl;
+  return false;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " autocomplete_symbols.txt" << std::endl;
+    return 1;
+  }
+
+  // The commands autocompletion offers
+  std::vector<std::string> builtins;
+  wxTextFile symbolFile(wxString::FromUTF8(argv[1]));
+  if (!symbolFile.Open())
+  {
+    std::cerr << "Cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+  for (wxString line = symbolFile.GetFirstLine(); !symbolFile.Eof(); line = symbolFile.GetNextLine())
+  {
+    if (line.StartsWith(wxT("FUNCTION: ")) || line.StartsWith(wxT("OPTION  : ")))
+      builtins.push_back(std::string(line.Mid(10).utf8_str().data()));
+  }
+
+  // The words of a big worksheet
+  wxArrayString worksheetWords;
+  for (int i = 0; i < 5000; i++)
+    worksheetWords.Add(wxString::Format(wxT("%s_%i"),
+                                        builtins[(i * 7919) % builtins.size()].c_str(), i));
+
+  CompletionRanker ranker;
+  for (int i = 0; i < 5; i++)
+    ranker.Accepted(wxT("intersect"));
+
+  const wxString typed[] = {
+    wxT("integrate"), wxT("intg"), wxT("plot2d"), wxT("lsq"), wxT("wxdraw2d"),
+    wxT("makelist"), wxT("solve"), wxT("diff"), wxT("ratsimp"), wxT("xyz")
+  };
+  const size_t symbols = sizeof(typed) / sizeof(typed[0]);
+
+  long keystrokes = 0;
+  size_t matches = 0;
+  std::vector<double> keystrokeMillis;
+  wxStopWatch stopwatch;
+  for (int repetition = 0; repetition < 10; repetition++)
+  {
+    for (size_t i = 0; i < symbols; i++)
+    {
+      for (size_t length = 1; length <= typed[i].Length(); length++)
+      {
+        wxStopWatch keystroke;
+        matches += Rank(ranker, typed[i].Left(length), builtins, worksheetWords).GetCount();
+        keystrokeMillis.push_back(keystroke.TimeInMicro().ToDouble() / 1000.0);
+        keystrokes++;
+      }
+    }
+  }
+  long millis = stopwatch.Time();
+
+  std::nth_element(keystrokeMillis.begin(), keystrokeMillis.begin() + keystrokeMillis.size() / 2,
+                   keystrokeMillis.end());
+  double median = keystrokeMillis[keystrokeMillis.size() / 2];
+  double perKeystroke = static_cast<double>(millis) / keystrokes;
+  std::cout << "Ranked " << builtins.size() + worksheetWords.GetCount() << " symbols for "
+            << keystrokes << " keystrokes in " << millis << " ms ("
+            << perKeystroke << " ms per keystroke, median " << median << " ms, "
+            << matches / keystrokes << " matches per keystroke)" << std::endl;
+
+  bool ok = true;
+  double limit = wxGetEnv(wxT("WXMAXIMA_BENCHMARK_STRICT"), NULL) ? 1.0 : 5.0;
+  if (median > limit)
+  {
+    std::cerr << "Ranking takes longer than " << limit << " ms per keystroke" << std::endl;
+    ok = false;
+  }
+
+  // Exact matches first, fuzzy matches are found, and the symbols the user
+  // has chosen before are preferred
+  ok = Expect(ranker, wxT("integrate"), wxT("integrate"), 1, builtins, worksheetWords) && ok;
+  ok = Expect(ranker, wxT("intg"), wxT("integrate"), 5, builtins, worksheetWords) && ok;
+  ok = Expect(ranker, wxT("int"), wxT("intersect"), 1, builtins, worksheetWords) && ok;
+  ranker.Accepted(wxT("integrate(<expr>, <x>)"));
+  ok = Expect(ranker, wxT("intg"), wxT("integrate"), 1, builtins, worksheetWords) && ok;
+
+  // Templates are matched by the name of their function, not by their placeholders
+  if ((CompletionRanker::MatchScore(wxT("integrate(<expr>, <x>)"), wxT("ex")) >= 0) ||
+      (CompletionRanker::MatchScore(wxT("intersect(<a_1>, <a_2>)"), wxT("a1")) >= 0) ||
+      (CompletionRanker::MatchScore(wxT("integrate(<expr>, <x>)"), wxT("intg")) < 0))
+  {
+    std::cerr << "Templates are matched by their placeholders" << std::endl;
+    ok = false;
+  }
+
+  // The usage counts survive a round trip through the configuration
+  wxStringInputStream emptyConfig(wxEmptyString);
+  wxFileConfig config(emptyConfig);
+  ranker.WriteUsage(&config);
+  CompletionRanker reread;
+  reread.ReadUsage(&config);
+  if (reread.GetUsage(wxT("intersect(<a_1>, <a_2>)")) != 5)
+  {
+    std::cerr << "The usage counts weren't restored from the configuration" << std::endl;
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
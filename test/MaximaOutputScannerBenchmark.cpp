@@ -0,0 +1,117 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  A micro-benchmark for MaximaOutputScanner
+
+  Feeds a synthetic 50 MB maxima transcript consisting of many small results
+  through the scanner in network-packet-sized pieces and reports the throughput.
+  Fails if the scanner doesn't return exactly the chunks the transcript consists of.
+ */
+
+#include "MaximaOutputScanner.h"
+#include <wx/stopwatch.h>
+#include <iostream>
+
+int main()
+{
+  const wxString result =
+    wxT("<mth><lbl>(%o1) </lbl><v>x</v><h>*</h><n>2</n></mth>\n");
+  const wxString prompt =
+    MaximaOutputScanner::PromptPrefix() + wxT("(%i2) ") + MaximaOutputScanner::PromptSuffix();
+  const wxString statusbar = wxT("<statusbar>Calculating</statusbar>");
+  const wxString variables =
+    wxT("<variables><variable><name>x</name><value>1</value></variable></variables>");
+  const wxString text = wxT("A warning maxima has printed\n");
+  const size_t transcriptSize = 50 * 1000 * 1000;
+  const size_t packetSize = 1400;
+
+  // Build the transcript: Lots of small results separated by the occasional
+  // prompt, status bar update, variable value and line of text.
+  wxString transcript;
+  transcript.reserve(transcriptSize + 1000);
+  long expected[MaximaOutputScanner::miscText + 1] = {0};
+  for(long i = 0; transcript.Length() < transcriptSize; i++)
+  {
+    transcript += result;
+    expected[MaximaOutputScanner::math]++;
+    if(i % 10 == 0)
+    {
+      transcript += statusbar;
+      expected[MaximaOutputScanner::statusBar]++;
+    }
+    if(i % 100 == 0)
+    {
+      transcript += text;
+      expected[MaximaOutputScanner::miscText]++;
+      transcript += variables;
+      expected[MaximaOutputScanner::variables]++;
+      transcript += prompt;
+      expected[MaximaOutputScanner::prompt]++;
+    }
+  }
+
+  // Feed the transcript into the scanner the way wxMaxima::ClientEvent does:
+  // In packets that end in a newline.
+  long found[MaximaOutputScanner::miscText + 1] = {0};
+  MaximaOutputScanner scanner;
+  wxStopWatch stopwatch;
+  size_t pos = 0;
+  while(pos < transcript.Length())
+  {
+    size_t end = transcript.find(wxT('\n'), pos + packetSize);
+    if(end == wxString::npos)
+      end = transcript.Length();
+    else
+      end++;
+    scanner.Append(transcript.Mid(pos, end - pos));
+    pos = end;
+
+    wxString contents;
+    MaximaOutputScanner::ChunkType type;
+    while(((type = scanner.NextChunk(contents)) != MaximaOutputScanner::none) &&
+          (type != MaximaOutputScanner::incomplete))
+    {
+      // The newline that ends a packet isn't part of a chunk we are interested in.
+      if((type != MaximaOutputScanner::miscText) || (contents != wxT("\n")))
+        found[type]++;
+    }
+    scanner.Compact();
+  }
+  long millis = stopwatch.Time();
+
+  std::cout << "Scanned " << transcript.Length() << " chars in " << millis << " ms";
+  if(millis > 0)
+    std::cout << " (" << transcript.Length() / 1000.0 / millis << " MChars/s)";
+  std::cout << std::endl;
+
+  bool ok = scanner.IsEmpty();
+  for(int i = 0; i <= MaximaOutputScanner::miscText; i++)
+  {
+    if(found[i] != expected[i])
+    {
+      std::cerr << "Chunk type " << i << ": Expected " << expected[i]
+                << " chunks, got " << found[i] << std::endl;
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2019 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+
+
+/*! \file
+  A micro-benchmark for SearchIndex
+
+  Indexes the cells of a big worksheet and searches for a string as it is typed
+  into the find dialog, character by character, the way the incremental search
+  does. Reports the average and the median time per keystroke and compares them
+  to searching every cell. Fails if the index doesn't find exactly the matches
+  searching every cell finds or if the median is above 100 ms. The time depends
+  on the machine the test runs on: Only if the environment variable
+  WXMAXIMA_BENCHMARK_STRICT is set the median must meet the goal of 20 ms.
+ */
+
+#include "SearchIndex.h"
+#include <wx/stopwatch.h>
+#include <wx/utils.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+//! SearchIndex only needs pointers to the cells => a cell only needs to hold its text, here.
+class EditorCell
+{
+public:
+  wxString m_text;
+};
+
+//! Counts the matches the index finds for str in all cells
+static long CountIndexed(const SearchIndex &index, const std::vector<EditorCell> &cells,
+                         const wxString &str, bool ignoreCase)
+{
+  SearchIndex::CellSet candidates;
+  index.GetCandidates(str, candidates);
+  std::vector<long> positions;
+  for (size_t i = 0; i < cells.size(); i++)
+  {
+    if (candidates.find(&cells[i]) != candidates.end())
+      index.FindAll(&cells[i], str, ignoreCase, positions);
+  }
+  return positions.size();
+}
+
+//! Counts the matches for str by searching every cell the way EditorCell::FindNext does
+static long CountNaive(const std::vector<EditorCell> &cells, wxString str, bool ignoreCase)
+{
+  long count = 0;
+  if (ignoreCase)
+    str.MakeLower();
+  for (size_t i = 0; i < cells.size(); i++)
+  {
+    wxString text = cells[i].m_text;
+    text.Replace(wxT("\r"), wxT(" "));
+    if (ignoreCase)
+      text.MakeLower();
+    size_t pos = 0;
+    while ((pos = text.find(str, pos)) != wxString::npos)
+    {
+      count++;
+      pos++;
+    }
+  }
+  return count;
+}
+
+int main()
+{
+  const wxString words[] =
+  {
+    wxT("integrate"), wxT("diff"), wxT("Solve"), wxT("expand"), wxT("ratsimp"),
+    wxT("plot2d"), wxT("makelist"), wxT("sin"), wxT("cos"), wxT("Matrix")
+  };
+  const size_t cellCount = 20000;
+
+  // A big worksheet: Many cells with a few lines of code each.
+  std::vector<EditorCell> cells(cellCount);
+  unsigned long random = 42;
+  for (size_t i = 0; i < cellCount; i++)
+  {
+    for (int line = 0; line < 3; line++)
+    {
+      random = random * 1103515245 + 12345;
+      cells[i].m_text += wxString::Format(wxT("f%li(x):=%s(%s(x)^%li,x);\r"),
+                                          static_cast<long>(i),
+                                          words[(random >> 16) % WXSIZEOF(words)],
+                                          words[(random >> 20) % WXSIZEOF(words)],
+                                          static_cast<long>((random >> 8) % 1000));
+    }
+  }
+
+  wxStopWatch stopwatch;
+  SearchIndex index;
+  for (size_t i = 0; i < cellCount; i++)
+    index.Update(&cells[i], cells[i].m_text);
+  std::cout << "Indexed " << cellCount << " cells in " << stopwatch.Time() << " ms" << std::endl;
+
+  // Type the search string character by character.
+  const wxString search = wxT("integrate(sin(x)^42");
+  double indexedMillis = 0;
+  std::vector<double> keystrokeMillis;
+  long naiveMillis = 0;
+  bool ok = true;
+  for (size_t length = 1; length <= search.Length(); length++)
+  {
+    wxString str = search.Left(length);
+    stopwatch.Start();
+    long indexed = CountIndexed(index, cells, str, true);
+    keystrokeMillis.push_back(stopwatch.TimeInMicro().ToDouble() / 1000.0);
+    indexedMillis += keystrokeMillis.back();
+    stopwatch.Start();
+    long naive = CountNaive(cells, str, true);
+    naiveMillis += stopwatch.Time();
+    if (indexed != naive)
+    {
+      std::cerr << "\"" << str.utf8_str().data() << "\": The index found " << indexed
+                << " matches instead of " << naive << std::endl;
+      ok = false;
+    }
+  }
+  std::nth_element(keystrokeMillis.begin(), keystrokeMillis.begin() + keystrokeMillis.size() / 2,
+                   keystrokeMillis.end());
+  double median = keystrokeMillis[keystrokeMillis.size() / 2];
+  double perKeystroke = indexedMillis / search.Length();
+  std::cout << "Searched using the index in " << perKeystroke << " ms per keystroke "
+            << "(median " << median << " ms), searching every cell took "
+            << static_cast<double>(naiveMillis) / search.Length() << " ms" << std::endl;
+  double limit = wxGetEnv(wxT("WXMAXIMA_BENCHMARK_STRICT"), NULL) ? 20.0 : 100.0;
+  if (median > limit)
+  {
+    std::cerr << "Searching using the index takes longer than " << limit
+              << " ms per keystroke" << std::endl;
+    ok = false;
+  }
+
+  // Case-sensitive searches only find the spelling that was searched for.
+  if (CountIndexed(index, cells, wxT("Solve("), false) != CountNaive(cells, wxT("Solve("), false))
+  {
+    std::cerr << "Case-sensitive search found the wrong matches" << std::endl;
+    ok = false;
+  }
+  if (CountIndexed(index, cells, wxT("solve("), false) != 0)
+  {
+    std::cerr << "Case-sensitive search found matches in the wrong case" << std::endl;
+    ok = false;
+  }
+
+  // Edits and deleted cells
+  long before = CountIndexed(index, cells, wxT("unique_word"), true);
+  cells[17].m_text += wxT("unique_word(unique_word);");
+  index.Update(&cells[17], cells[17].m_text);
+  long afterEdit = CountIndexed(index, cells, wxT("unique_word"), true);
+  index.Remove(&cells[17]);
+  long afterRemove = CountIndexed(index, cells, wxT("unique_word"), true);
+  if ((before != 0) || (afterEdit != 2) || (afterRemove != 0))
+  {
+    std::cerr << "The index isn't updated correctly: " << before << " "
+              << afterEdit << " " << afterRemove << " matches" << std::endl;
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}